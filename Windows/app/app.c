@@ -143,3 +143,12 @@ uint64_t mono_millis()
 {
     return (mono_ticks() * 1000U) / s_perf_counter_freq;
 }
+
+uint64_t mono_micros()
+{
+    uint64_t const ticks = mono_ticks();
+    uint64_t const s = ticks / s_perf_counter_freq;
+
+    // split to avoid overflowing ticks * 10^6
+    return s * 1000000U + ((ticks - s * s_perf_counter_freq) * 1000000U) / s_perf_counter_freq;
+}
@@ -50,6 +50,8 @@
 #define LOG_FLAG_TXR        0x00000010
 #define LOG_FLAG_USB_STATE  0x00000020
 
+#define REPLAY_LEAD_US_DEFAULT 2000
+
 
 #ifdef __cplusplus
 extern "C" {
@@ -72,6 +74,7 @@ struct app_ctx {
     uint64_t rx_last_ts;
     HANDLE shutdown_event;
     void* priv;
+    void* replay;
     unsigned log_flags;
     unsigned tx_job_count;
     unsigned device_index;
@@ -81,6 +84,7 @@ struct app_ctx {
     int usb_rx_lost;
     int usb_tx_dropped;
     int debug_log_level;
+    unsigned replay_lead_us;
     bool rx_has_xtd_frame;
     bool rx_has_fdf_frame;
     bool fdf;
@@ -159,9 +163,19 @@ void log_candump(
 
 uint64_t mono_ticks();
 uint64_t mono_millis();
+uint64_t mono_micros();
 
 void app_init();
 
+/* Replay of a SuperCAN recording through the TX path, see replay.cpp */
+int replay_open(struct app_ctx* ctx, char const* path);
+void replay_close(struct app_ctx* ctx);
+void replay_sync(struct app_ctx* ctx, uint64_t dev_us);
+bool replay_next(struct app_ctx* ctx, struct tx_job* job, uint64_t* target_us, uint32_t* wait_us);
+void replay_sent(struct app_ctx* ctx, uint64_t target_us, uint64_t ts_us, bool dropped);
+bool replay_done(struct app_ctx* ctx);
+void replay_report(struct app_ctx* ctx);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
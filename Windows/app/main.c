@@ -76,6 +76,8 @@ static void usage(FILE* stream)
     fprintf(stream, "       esi     FD error state indicator (bool)\n");
     fprintf(stream, "       ext     extended format (29 bit identifier) (bool)\n");
     fprintf(stream, "       count   number of messages to generate (default 1)\n");
+    fprintf(stream, "--replay FILE  replay a SuperCAN recording with its original timing (requires --single)\n");
+    fprintf(stream, "--replay-lead US   queue replayed frames this many microseconds ahead (default %u)\n", REPLAY_LEAD_US_DEFAULT);
     fprintf(stream, "--shared BOOL  share device access (enabled by default)\n");
     fprintf(stream, "--single       request exclusive device access\n");
     fprintf(stream, "--config BOOL  request config level access (defaults to on)\n");
@@ -226,6 +228,7 @@ int main(int argc, char** argv)
    
     int error = SC_DLL_ERROR_NONE;
     bool shared = true;
+    char const* replay_path = NULL;
     
 
     memset(&ac, 0, sizeof(ac));
@@ -245,6 +248,7 @@ int main(int argc, char** argv)
     ac.candump = false;
     ac.debug_log_level = SC_DLL_LOG_LEVEL_OFF;
     ac.stop_on_error = true;
+    ac.replay_lead_us = REPLAY_LEAD_US_DEFAULT;
 
     cia_fd_cbt_init_default_real(&ac.nominal_user_constraints, &ac.data_user_constraints);
 
@@ -553,6 +557,35 @@ int main(int argc, char** argv)
                 goto Exit;
             }
         }
+        else if (0 == strcmp("--replay", argv[i])) {
+            if (i + 1 < argc) {
+                replay_path = argv[i + 1];
+                i += 2;
+            }
+            else {
+                fprintf(stderr, "ERROR %s expects a file argument\n", argv[i]);
+                error = SC_DLL_ERROR_INVALID_PARAM;
+                goto Exit;
+            }
+        }
+        else if (0 == strcmp("--replay-lead", argv[i])) {
+            if (i + 1 < argc) {
+                char* end = NULL;
+                ac.replay_lead_us = (unsigned)strtoul(argv[i + 1], &end, 10);
+                if (!end || end == argv[i + 1]) {
+                    fprintf(stderr, "ERROR failed to convert '%s' to int\n", argv[i + 1]);
+                    error = SC_DLL_ERROR_INVALID_PARAM;
+                    goto Exit;
+                }
+
+                i += 2;
+            }
+            else {
+                fprintf(stderr, "ERROR %s expects a positive integer argument\n", argv[i]);
+                error = SC_DLL_ERROR_INVALID_PARAM;
+                goto Exit;
+            }
+        }
         else {
             ++i;
         }
@@ -570,6 +603,19 @@ int main(int argc, char** argv)
     signal(SIGINT, &SignalHandler);
     signal(SIGTERM, &SignalHandler);
 
+    if (replay_path) {
+        if (shared) {
+            fprintf(stderr, "ERROR --replay requires --single\n");
+            error = SC_DLL_ERROR_INVALID_PARAM;
+            goto Exit;
+        }
+
+        error = replay_open(&ac, replay_path);
+        if (error) {
+            goto Exit;
+        }
+    }
+
     if (shared) {
         error = run_shared(&ac);
     }
@@ -578,6 +624,12 @@ int main(int argc, char** argv)
     }
 
 Exit:
+    if (ac.replay) {
+        // interrupted
+        replay_report(&ac);
+        replay_close(&ac);
+    }
+
     if (s_Shutdown) {
         CloseHandle(s_Shutdown);
     }
@@ -0,0 +1,193 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Jean Gressmann <jean@0x42.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "app.h"
+#include "supercan_misc.h"
+#include "supercan_replay.h"
+
+#include <new>
+
+namespace
+{
+
+struct replay_state
+{
+    sc::record_file_source source;
+    sc::record_reader reader;
+    sc::replay replay;
+    sc_dev_clock_t clock;
+    sc_mm_can_tx frame;
+    uint64_t in_flight;
+    uint64_t dropped;
+    bool started;
+    bool pending;
+};
+
+} // anon
+
+extern "C" int replay_open(struct app_ctx* ctx, char const* path)
+{
+    replay_state* s = new (std::nothrow) replay_state();
+    int error = SC_DLL_ERROR_NONE;
+
+    if (!s) {
+        return SC_DLL_ERROR_OUT_OF_MEM;
+    }
+
+    error = s->source.open(path);
+    if (error) {
+        fprintf(stderr, "ERROR failed to open %s: %s (%d)\n", path, sc_strerror(error), error);
+        goto error_exit;
+    }
+
+    error = s->reader.open(&s->source);
+    if (error) {
+        fprintf(stderr, "ERROR %s is not a SuperCAN recording: %s (%d)\n", path, sc_strerror(error), error);
+        goto error_exit;
+    }
+
+    sc_dc_init(&s->clock);
+    s->in_flight = 0;
+    s->dropped = 0;
+    s->started = false;
+    s->pending = false;
+    ctx->replay = s;
+
+success_exit:
+    return error;
+
+error_exit:
+    delete s;
+    goto success_exit;
+}
+
+extern "C" void replay_close(struct app_ctx* ctx)
+{
+    delete static_cast<replay_state*>(ctx->replay);
+    ctx->replay = nullptr;
+}
+
+extern "C" void replay_sync(struct app_ctx* ctx, uint64_t dev_us)
+{
+    replay_state* s = static_cast<replay_state*>(ctx->replay);
+
+    sc_dc_observe(&s->clock, dev_us, mono_micros());
+}
+
+extern "C" bool replay_next(struct app_ctx* ctx, struct tx_job* job, uint64_t* target_us, uint32_t* wait_us)
+{
+    replay_state* s = static_cast<replay_state*>(ctx->replay);
+    uint64_t now_us = 0;
+    uint32_t taken = 0;
+    int error = SC_DLL_ERROR_NONE;
+
+    *wait_us = UINT32_MAX;
+
+    // wait for the first device timestamp
+    if (!s->clock.initialized) {
+        return false;
+    }
+
+    now_us = sc_dc_now(&s->clock, mono_micros());
+
+    if (!s->started) {
+        s->started = true;
+
+        error = s->replay.start(&s->reader, now_us + ctx->replay_lead_us, ctx->replay_lead_us, sc::replay::FLAG_RX | sc::replay::FLAG_TX);
+        if (error) {
+            fprintf(stderr, "ERROR failed to read recording: %s (%d)\n", sc_strerror(error), error);
+            return false;
+        }
+    }
+
+    if (!s->pending) {
+        error = s->replay.next(now_us, &s->frame, 1, &taken, wait_us);
+        if (error) {
+            fprintf(stderr, "ERROR failed to read recording: %s (%d)\n", sc_strerror(error), error);
+            return false;
+        }
+
+        s->pending = taken > 0;
+    }
+
+    if (!s->pending) {
+        return false;
+    }
+
+    s->pending = false;
+    ++s->in_flight;
+
+    memset(job, 0, sizeof(*job));
+    job->can_id = s->frame.can_id;
+    job->flags = s->frame.flags;
+    job->dlc = s->frame.dlc;
+    memcpy(job->data, s->frame.data, sizeof(job->data));
+    *target_us = s->frame.timestamp_us;
+    *wait_us = 0;
+
+    return true;
+}
+
+extern "C" void replay_sent(struct app_ctx* ctx, uint64_t target_us, uint64_t ts_us, bool dropped)
+{
+    replay_state* s = static_cast<replay_state*>(ctx->replay);
+
+    --s->in_flight;
+
+    if (dropped) {
+        ++s->dropped;
+    }
+    else {
+        s->replay.sent(target_us, ts_us);
+    }
+}
+
+extern "C" bool replay_done(struct app_ctx* ctx)
+{
+    replay_state const* s = static_cast<replay_state const*>(ctx->replay);
+
+    return s->started && s->replay.end() && !s->in_flight;
+}
+
+extern "C" void replay_report(struct app_ctx* ctx)
+{
+    replay_state const* s = static_cast<replay_state const*>(ctx->replay);
+    sc::replay_stats stats;
+
+    s->replay.stats(&stats);
+
+    fprintf(stderr, "replay: frames=%llu sent=%llu dropped=%llu late=%llu\n",
+        (unsigned long long)stats.queued,
+        (unsigned long long)stats.sent,
+        (unsigned long long)s->dropped,
+        (unsigned long long)stats.late);
+
+    if (stats.sent) {
+        fprintf(stderr, "replay: timing error [us] min=%lld max=%lld mean abs=%.1f\n",
+            (long long)stats.error_min_us,
+            (long long)stats.error_max_us,
+            (double)stats.error_abs_sum_us / (double)stats.sent);
+    }
+}
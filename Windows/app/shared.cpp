@@ -31,6 +31,7 @@
 
 #import "supercan_srv.tlb" raw_interfaces_only
 #include "supercan_srv.h"
+#include "supercan_mm_ring.h"
 
 #ifdef min
 #undef min
@@ -100,10 +101,180 @@ struct com_dev_ctx {
     SuperCANDeviceData dev_data;
     sc_mm_data rx;
     sc_mm_data tx;
+    sc::mm::ring_consumer rx_ring;
+    sc::mm::var_ring_consumer rx_var_ring;
+    sc::mm::ring_producer tx_ring;
     uint32_t track_id;
+    uint32_t rx_format;
 };
 
 
+static void process_rx_slot(app_ctx* ac, sc_can_mm_slot_t const* slot)
+{
+    auto* hdr = &slot->hdr;
+
+    switch (hdr->type) {
+    case SC_MM_DATA_TYPE_CAN_STATUS: {
+        auto* status = &slot->status;
+
+        if (!ac->candump && (ac->log_flags & LOG_FLAG_CAN_STATE)) {
+            bool log = false;
+            if (ac->log_on_change) {
+                log = ac->can_rx_errors_last != status->rx_errors ||
+                    ac->can_tx_errors_last != status->tx_errors ||
+                    ac->can_bus_state_last != status->bus_status;
+            }
+            else {
+                log = true;
+            }
+
+            ac->can_rx_errors_last = status->rx_errors;
+            ac->can_tx_errors_last = status->tx_errors;
+            ac->can_bus_state_last = status->bus_status;
+
+            if (log) {
+                fprintf(stdout, "CAN rx errors=%u tx errors=%u bus=", status->rx_errors, status->tx_errors);
+                switch (status->bus_status) {
+                case SC_CAN_STATUS_ERROR_ACTIVE:
+                    fprintf(stdout, "error_active");
+                    break;
+                case SC_CAN_STATUS_ERROR_WARNING:
+                    fprintf(stdout, "error_warning");
+                    break;
+                case SC_CAN_STATUS_ERROR_PASSIVE:
+                    fprintf(stdout, "error_passive");
+                    break;
+                case SC_CAN_STATUS_BUS_OFF:
+                    fprintf(stdout, "off");
+                    break;
+                default:
+                    fprintf(stdout, "unknown");
+                    break;
+                }
+                fprintf(stdout, "\n");
+            }
+        }
+
+        if (!ac->candump && (ac->log_flags & LOG_FLAG_USB_STATE)) {
+            bool log = false;
+            bool irq_queue_full = status->flags & SC_CAN_STATUS_FLAG_IRQ_QUEUE_FULL;
+            bool desync = status->flags & SC_CAN_STATUS_FLAG_TXR_DESYNC;
+            auto rx_lost2 = status->rx_lost;
+            auto tx_dropped = status->tx_dropped;
+
+            if (ac->log_on_change) {
+                log = ac->usb_rx_lost != rx_lost2 ||
+                    ac->usb_tx_dropped != tx_dropped ||
+                    irq_queue_full || desync;
+            }
+            else {
+                log = true;
+            }
+
+            ac->usb_rx_lost = rx_lost2;
+            ac->usb_tx_dropped = tx_dropped;
+
+            if (log) {
+                fprintf(stdout, "CAN->USB rx lost=%u USB->CAN tx dropped=%u irqf=%u desync=%u\n", rx_lost2, tx_dropped, irq_queue_full, desync);
+            }
+        }
+    } break;
+    case SC_MM_DATA_TYPE_CAN_RX: {
+        auto* rx = &slot->rx;
+
+        if (ac->candump) {
+            log_candump(ac, stdout, rx->timestamp_us, rx->can_id, rx->flags, rx->dlc, rx->data);
+        }
+        else {
+            if (ac->log_flags & LOG_FLAG_RX_DT) {
+                int64_t dt_us = 0;
+                if (ac->rx_last_ts) {
+                    dt_us = rx->timestamp_us - ac->rx_last_ts;
+                    if (dt_us < 0) {
+                        fprintf(stderr, "WARN negative rx msg dt [us]: %lld\n", dt_us);
+                    }
+                }
+
+                ac->rx_last_ts = rx->timestamp_us;
+
+                fprintf(stdout, "rx delta %.3f [ms]\n", dt_us * 1e-3f);
+            }
+
+            if (ac->log_flags & LOG_FLAG_RX_MSG) {
+                fprintf(stdout, "RX ");
+                log_msg(ac, rx->can_id, rx->flags, rx->dlc, rx->data);
+            }
+        }
+    } break;
+    case SC_MM_DATA_TYPE_CAN_TX: {
+        auto* tx = &slot->tx;
+
+        if (ac->candump) {
+            log_candump(ac, stdout, tx->timestamp_us, tx->can_id, tx->flags, tx->dlc, tx->data);
+        }
+        else {
+            if (!tx->echo && (ac->log_flags & LOG_FLAG_TXR)) {
+                if (tx->flags & SC_CAN_FRAME_FLAG_DRP) {
+                    fprintf(stdout, "TXR %#08x was dropped @ %016llx\n", tx->track_id, tx->timestamp_us);
+                }
+                else {
+                    fprintf(stdout, "TXR %#08x was sent @ %016llx\n", tx->track_id, tx->timestamp_us);
+                }
+            }
+
+            if ((ac->log_flags & LOG_FLAG_TX_MSG)) {
+                fprintf(stdout, "TX ");
+                log_msg(ac, tx->can_id, tx->flags, tx->dlc, tx->data);
+            }
+        }
+    } break;
+    case SC_MM_DATA_TYPE_CAN_ERROR: {
+        auto* error = &slot->error;
+
+        if (SC_CAN_ERROR_NONE != error->error) {
+            fprintf(
+                stdout, "CAN ERROR %s %s ",
+                (error->flags & SC_CAN_ERROR_FLAG_RXTX_TX) ? "tx" : "rx",
+                (error->flags & SC_CAN_ERROR_FLAG_NMDT_DT) ? "data" : "arbitration");
+            switch (error->error) {
+            case SC_CAN_ERROR_STUFF:
+                fprintf(stdout, "stuff ");
+                break;
+            case SC_CAN_ERROR_FORM:
+                fprintf(stdout, "form ");
+                break;
+            case SC_CAN_ERROR_ACK:
+                fprintf(stdout, "ack ");
+                break;
+            case SC_CAN_ERROR_BIT1:
+                fprintf(stdout, "bit1 ");
+                break;
+            case SC_CAN_ERROR_BIT0:
+                fprintf(stdout, "bit0 ");
+                break;
+            case SC_CAN_ERROR_CRC:
+                fprintf(stdout, "crc ");
+                break;
+            default:
+                fprintf(stdout, "<unknown> ");
+                break;
+            }
+            fprintf(stdout, "error\n");
+        }
+    } break;
+    case SC_MM_DATA_TYPE_LOG_DATA: {
+        if (!ac->candump) {
+            auto* log_data = &slot->log_data;
+
+            fprintf(stderr, "%s: %.*s", log_data->src == SC_LOG_DATA_SRC_DLL ? "DLL" : "SRV", (int)log_data->bytes, (char const*)log_data->data);
+        }
+    } break;
+    default: {
+        fprintf(stderr, "WARN: unhandled msg id=%02x\n", hdr->type);
+    } break;
+    }
+}
+
 void process_rx(app_ctx* ac)
 {
     com_dev_ctx* com_ctx = static_cast<com_dev_ctx*>(ac->priv);
@@ -129,207 +300,64 @@ void process_rx(app_ctx* ac)
     }
 
 
-    auto gi = com_ctx->rx.hdr->get_index;
-    auto pi = com_ctx->rx.hdr->put_index;
-    auto used = pi - gi;
-    if (used > com_ctx->rx.elements) {
-        fprintf(stderr, "ERROR: RX mm data mismatch (pi=%lu gi=%u used=%u elements=%u)\n",
-            static_cast<unsigned long>(pi),
-            static_cast<unsigned long>(gi),
-            static_cast<unsigned long>(used),
-            static_cast<unsigned long>(com_ctx->rx.elements));
-    }
-    else if (used) {
-        for (uint32_t i = 0; i < used; ++i, ++gi) {
-            auto index = gi % com_ctx->rx.elements;
-            auto* hdr = &com_ctx->rx.hdr->elements[index].hdr;
-
-            switch (hdr->type) {
-            case SC_MM_DATA_TYPE_CAN_STATUS: {
-                auto* status = &com_ctx->rx.hdr->elements[index].status;
-                
-                if (!ac->candump && (ac->log_flags & LOG_FLAG_CAN_STATE)) {
-                    bool log = false;
-                    if (ac->log_on_change) {
-                        log = ac->can_rx_errors_last != status->rx_errors ||
-                            ac->can_tx_errors_last != status->tx_errors ||
-                            ac->can_bus_state_last != status->bus_status;
-                    }
-                    else {
-                        log = true;
-                    }
-
-                    ac->can_rx_errors_last = status->rx_errors;
-                    ac->can_tx_errors_last = status->tx_errors;
-                    ac->can_bus_state_last = status->bus_status;
-
-                    if (log) {
-                        fprintf(stdout, "CAN rx errors=%u tx errors=%u bus=", status->rx_errors, status->tx_errors);
-                        switch (status->bus_status) {
-                        case SC_CAN_STATUS_ERROR_ACTIVE:
-                            fprintf(stdout, "error_active");
-                            break;
-                        case SC_CAN_STATUS_ERROR_WARNING:
-                            fprintf(stdout, "error_warning");
-                            break;
-                        case SC_CAN_STATUS_ERROR_PASSIVE:
-                            fprintf(stdout, "error_passive");
-                            break;
-                        case SC_CAN_STATUS_BUS_OFF:
-                            fprintf(stdout, "off");
-                            break;
-                        default:
-                            fprintf(stdout, "unknown");
-                            break;
-                        }
-                        fprintf(stdout, "\n");
-                    }
-                }
-
-                if (!ac->candump && (ac->log_flags & LOG_FLAG_USB_STATE)) {
-                    bool log = false;
-                    bool irq_queue_full = status->flags & SC_CAN_STATUS_FLAG_IRQ_QUEUE_FULL;
-                    bool desync = status->flags & SC_CAN_STATUS_FLAG_TXR_DESYNC;
-                    auto rx_lost2 = status->rx_lost;
-                    auto tx_dropped = status->tx_dropped;
-
-                    if (ac->log_on_change) {
-                        log = ac->usb_rx_lost != rx_lost2 ||
-                            ac->usb_tx_dropped != tx_dropped ||
-                            irq_queue_full || desync;
-                    }
-                    else {
-                        log = true;
-                    }
-
-                    ac->usb_rx_lost = rx_lost2;
-                    ac->usb_tx_dropped = tx_dropped;
+    if (SC_MM_FORMAT_VAR == com_ctx->rx_format) {
+        sc_can_mm_slot_t slots[32];
+        uint32_t count = 0;
 
-                    if (log) {
-                        fprintf(stdout, "CAN->USB rx lost=%u USB->CAN tx dropped=%u irqf=%u desync=%u\n", rx_lost2, tx_dropped, irq_queue_full, desync);
-                    }
-                }
-            } break;
-            case SC_MM_DATA_TYPE_CAN_RX: {
-                auto* rx = &com_ctx->rx.hdr->elements[index].rx;
+        do {
+            if (com_ctx->rx_var_ring.pop(slots, _countof(slots), &count)) {
+                fprintf(stderr, "ERROR: RX mm data mismatch (pi=%lu gi=%lu words=%lu)\n",
+                    static_cast<unsigned long>(com_ctx->rx.hdr->put_index),
+                    static_cast<unsigned long>(com_ctx->rx.hdr->get_index),
+                    static_cast<unsigned long>(com_ctx->rx_var_ring.words()));
 
-                if (ac->candump) {
-                    log_candump(ac, stdout, rx->timestamp_us, rx->can_id, rx->flags, rx->dlc, rx->data);
-                }
-                else {
-                    if (ac->log_flags & LOG_FLAG_RX_DT) {
-                        int64_t dt_us = 0;
-                        if (ac->rx_last_ts) {
-                            dt_us = rx->timestamp_us - ac->rx_last_ts;
-                            if (dt_us < 0) {
-                                fprintf(stderr, "WARN negative rx msg dt [us]: %lld\n", dt_us);
-                            }
-                        }
-
-                        ac->rx_last_ts = rx->timestamp_us;
+                com_ctx->rx_var_ring.skip_all();
+                break;
+            }
 
-                        fprintf(stdout, "rx delta %.3f [ms]\n", dt_us * 1e-3f);
-                    }
+            for (uint32_t i = 0; i < count; ++i) {
+                process_rx_slot(ac, &slots[i]);
+            }
+        } while (count == _countof(slots));
 
-                    if (ac->log_flags & LOG_FLAG_RX_MSG) {
-                        fprintf(stdout, "RX ");
-                        log_msg(ac, rx->can_id, rx->flags, rx->dlc, rx->data);
-                    }
-                }
-            } break;
-            case SC_MM_DATA_TYPE_CAN_TX: {
-                auto* tx = &com_ctx->rx.hdr->elements[index].tx;
+        return;
+    }
 
-                if (ac->candump) {
-                    log_candump(ac, stdout, tx->timestamp_us, tx->can_id, tx->flags, tx->dlc, tx->data);
-                }
-                else {
-                    if (!tx->echo && (ac->log_flags & LOG_FLAG_TXR)) {
-                        if (tx->flags & SC_CAN_FRAME_FLAG_DRP) {
-                            fprintf(stdout, "TXR %#08x was dropped @ %016llx\n", tx->track_id, tx->timestamp_us);
-                        }
-                        else {
-                            fprintf(stdout, "TXR %#08x was sent @ %016llx\n", tx->track_id, tx->timestamp_us);
-                        }
-                    }
+    uint32_t used = 0;
 
-                    if ((ac->log_flags & LOG_FLAG_TX_MSG)) {
-                        fprintf(stdout, "TX ");
-                        log_msg(ac, tx->can_id, tx->flags, tx->dlc, tx->data);
-                    }
-                }
-            } break;
-            case SC_MM_DATA_TYPE_CAN_ERROR: {
-                auto* error = &com_ctx->rx.hdr->elements[index].error;
-
-                if (SC_CAN_ERROR_NONE != error->error) {
-                    fprintf(
-                        stdout, "CAN ERROR %s %s ",
-                        (error->flags & SC_CAN_ERROR_FLAG_RXTX_TX) ? "tx" : "rx",
-                        (error->flags & SC_CAN_ERROR_FLAG_NMDT_DT) ? "data" : "arbitration");
-                    switch (error->error) {
-                    case SC_CAN_ERROR_STUFF:
-                        fprintf(stdout, "stuff ");
-                        break;
-                    case SC_CAN_ERROR_FORM:
-                        fprintf(stdout, "form ");
-                        break;
-                    case SC_CAN_ERROR_ACK:
-                        fprintf(stdout, "ack ");
-                        break;
-                    case SC_CAN_ERROR_BIT1:
-                        fprintf(stdout, "bit1 ");
-                        break;
-                    case SC_CAN_ERROR_BIT0:
-                        fprintf(stdout, "bit0 ");
-                        break;
-                    case SC_CAN_ERROR_CRC:
-                        fprintf(stdout, "crc ");
-                        break;
-                    default:
-                        fprintf(stdout, "<unknown> ");
-                        break;
-                    }
-                    fprintf(stdout, "error\n");
-                }
-            } break;
-            case SC_MM_DATA_TYPE_LOG_DATA: {
-                if (!ac->candump) {
-                    auto* log_data = &com_ctx->rx.hdr->elements[index].log_data;
+    if (com_ctx->rx_ring.readable(&used)) {
+        fprintf(stderr, "ERROR: RX mm data mismatch (pi=%lu gi=%lu elements=%lu)\n",
+            static_cast<unsigned long>(com_ctx->rx.hdr->put_index),
+            static_cast<unsigned long>(com_ctx->rx.hdr->get_index),
+            static_cast<unsigned long>(com_ctx->rx.elements));
 
-                    fprintf(stderr, "%s: %s", log_data->src == SC_LOG_DATA_SRC_DLL ? "DLL" : "SRV", log_data->data);
-                }
-            } break;
-            default: {
-                fprintf(stderr, "WARN: unhandled msg id=%02x\n", hdr->type);
-            } break;
-            }
+        com_ctx->rx_ring.skip_all();
+    }
+    else if (used) {
+        for (uint32_t i = 0; i < used; ++i) {
+            process_rx_slot(ac, com_ctx->rx_ring.slot(i));
         }
 
-        com_ctx->rx.hdr->get_index = gi;
+        com_ctx->rx_ring.consume(used);
     }
 }
 
 static bool tx(app_ctx* ac, struct tx_job* job)
 {
     com_dev_ctx* com_ctx = static_cast<com_dev_ctx*>(ac->priv);
-    auto gi = com_ctx->tx.hdr->get_index;
-    auto pi = com_ctx->tx.hdr->put_index;
-    auto used = pi - gi;
-
-   if (used > com_ctx->tx.elements) {
-        fprintf(stderr, "ERROR: TX mm data mismatch (pi=%lu gi=%u used=%u elements=%u)\n",
-            static_cast<unsigned long>(pi),
-            static_cast<unsigned long>(gi),
-            static_cast<unsigned long>(used),
+    uint32_t available = 0;
+
+   if (com_ctx->tx_ring.writable(&available)) {
+        fprintf(stderr, "ERROR: TX mm data mismatch (pi=%lu gi=%lu elements=%lu)\n",
+            static_cast<unsigned long>(com_ctx->tx.hdr->put_index),
+            static_cast<unsigned long>(com_ctx->tx.hdr->get_index),
             static_cast<unsigned long>(com_ctx->tx.elements));
     }
-    else if (used == com_ctx->tx.elements) {
+    else if (!available) {
         // full
     }
     else {
-        auto index = pi % com_ctx->tx.elements;
-        auto* tx = &com_ctx->tx.hdr->elements[index].tx;
+        auto* tx = &com_ctx->tx_ring.slot()->tx;
 
         tx->type = SC_MM_DATA_TYPE_CAN_TX;
         tx->can_id = job->can_id;
@@ -340,7 +368,7 @@ static bool tx(app_ctx* ac, struct tx_job* job)
             memcpy(tx->data, job->data, dlc_to_len(job->dlc));
         }
 
-        com_ctx->tx.hdr->put_index = pi + 1;
+        com_ctx->tx_ring.commit();
 
         return true;
     }
@@ -522,6 +550,11 @@ int run(app_ctx* ac)
             }
         }
 
+        // no need to be signaled while we are reading
+        com_ctx->rx_ring.poll(true);
+        process_rx(ac);
+        com_ctx->rx_ring.poll(false);
+        // pick up what was stored before polling was switched off
         process_rx(ac);
 
         if (ac->tx_job_count) {
@@ -824,6 +857,27 @@ extern "C" int run_shared(struct app_ctx* ac)
             goto cleanup;
         }
 
+        // use compact RX ring format if the server supports it
+        if (com_ctx.rx.hdr->formats & (UINT32_C(1) << SC_MM_FORMAT_VAR)) {
+            ISuperCANDevice6Ptr device_ptr6;
+
+            hr = device_ptr->QueryInterface(&device_ptr6);
+            if (SUCCEEDED(hr)) {
+                hr = device_ptr6->SetRxRingFormat(SC_MM_FORMAT_VAR);
+            }
+
+            if (SUCCEEDED(hr)) {
+                com_ctx.rx_format = SC_MM_FORMAT_VAR;
+            }
+            else {
+                fprintf(stderr, "WARN: failed to select compact RX ring format, using fixed size slots (hr=%lx)\n", hr);
+            }
+        }
+
+        com_ctx.rx_ring.attach(com_ctx.rx.hdr, com_ctx.rx.elements);
+        com_ctx.rx_var_ring.attach(com_ctx.rx.hdr, com_ctx.rx.elements);
+        com_ctx.tx_ring.attach(com_ctx.tx.hdr, com_ctx.tx.elements);
+
         error = run(ac);
         
 cleanup:
@@ -35,6 +35,7 @@
 
 
 struct can_echo {
+    uint64_t target_us; ///< replay target time, 0 for --tx frames
     uint32_t can_id;
     uint8_t dlc;
     uint8_t flags;
@@ -63,6 +64,17 @@ static void log_callback(void* ctx, int level, char const* msg, size_t size)
 }
 
 
+static uint64_t track_time(struct app_ctx* ac, struct can_state* s, uint32_t timestamp_us)
+{
+    uint64_t ts_us = sc_tt_track(&s->tt, timestamp_us);
+
+    if (ac->replay) {
+        replay_sync(ac, ts_us);
+    }
+
+    return ts_us;
+}
+
 static bool process_buffer(
     struct app_ctx* ac,
     uint8_t* ptr, uint16_t size, uint16_t* left)
@@ -106,7 +118,7 @@ static bool process_buffer(
             uint16_t rx_lost = s->dev->dev_to_host16(status->rx_lost);
             uint16_t tx_dropped = s->dev->dev_to_host16(status->tx_dropped);
 
-            sc_tt_track(&s->tt, timestamp_us);
+            track_time(ac, s, timestamp_us);
 
             if (!ac->candump && (ac->log_flags & LOG_FLAG_CAN_STATE)) {
                 bool log = false;
@@ -176,7 +188,7 @@ static bool process_buffer(
 
             uint32_t timestamp_us = s->dev->dev_to_host32(error_msg->timestamp_us);
 
-            sc_tt_track(&s->tt, timestamp_us);
+            track_time(ac, s, timestamp_us);
 
             if (SC_CAN_ERROR_NONE != error_msg->error) {
                 fprintf(
@@ -215,7 +227,7 @@ static bool process_buffer(
             uint32_t timestamp_us = s->dev->dev_to_host32(rx->timestamp_us);
             uint8_t len = dlc_to_len(rx->dlc);
             uint8_t bytes = sizeof(*rx);
-            uint64_t ts_us = sc_tt_track(&s->tt, timestamp_us);
+            uint64_t ts_us = track_time(ac, s, timestamp_us);
 
             if (!(rx->flags & SC_CAN_FRAME_FLAG_RTR)) {
                 bytes += len;
@@ -262,9 +274,13 @@ static bool process_buffer(
             }
 
             timestamp_us = s->dev->dev_to_host32(txr->timestamp_us);
-            ts_us = sc_tt_track(&s->tt, timestamp_us);
+            ts_us = track_time(ac, s, timestamp_us);
             echo = &s->echos[txr->track_id];
 
+            if (echo->target_us && ac->replay) {
+                replay_sent(ac, echo->target_us, ts_us, (txr->flags & SC_CAN_FRAME_FLAG_DRP) == SC_CAN_FRAME_FLAG_DRP);
+            }
+
             if (s->available_track_id_count == _countof(s->available_track_id_buffer)) {
                 fprintf(stderr, "TXR track id buffer overrun\n");
                 return false;
@@ -318,7 +334,7 @@ static int process_can(
 }
 
 
-static int tx(struct app_ctx* ac, struct tx_job* job)
+static int tx(struct app_ctx* ac, struct tx_job* job, uint64_t target_us)
 {
     uint32_t buffer[24];
     struct can_state* can_state = ac->priv;
@@ -337,6 +353,7 @@ static int tx(struct app_ctx* ac, struct tx_job* job)
     track_id = can_state->available_track_id_buffer[--can_state->available_track_id_count];
     echo = &can_state->echos[track_id];
 
+    echo->target_us = target_us;
     echo->flags = job->flags;
     echo->can_id = job->can_id;
     echo->dlc = job->dlc;
@@ -716,7 +733,7 @@ int run_single(struct app_ctx* ac)
             }
         }
 
-        if (ac->tx_job_count) {
+        if (ac->tx_job_count || ac->replay) {
             if (elapsed_ms >= timeout_ms) {
                 timeout_ms = 0xffffffff;
             }
@@ -743,7 +760,7 @@ int run_single(struct app_ctx* ac)
                     job->last_tx_ts_ms = now;
 
                     while (job->count > 0) {
-                        error = tx(ac, job);
+                        error = tx(ac, job, 0);
 
                         switch (error) {
                         case SC_DLL_ERROR_NONE:
@@ -775,6 +792,44 @@ int run_single(struct app_ctx* ac)
                 }
             }
 
+            if (ac->replay) {
+                struct tx_job job;
+                uint64_t target_us = 0;
+                uint32_t wait_us = UINT32_MAX;
+
+                // frames are handed out ahead of time, one track id each
+                while (can_state.available_track_id_count && replay_next(ac, &job, &target_us, &wait_us)) {
+                    error = tx(ac, &job, target_us);
+                    if (error) {
+                        replay_sent(ac, target_us, 0, true);
+
+                        if (ac->stop_on_error && SC_DLL_ERROR_AGAIN != error) {
+                            goto Exit;
+                        }
+                    }
+                }
+
+                if (!can_state.available_track_id_count) {
+                    // next TXR wakes us
+                    wait_us = UINT32_MAX;
+                }
+
+                if (wait_us / 1000 < timeout_ms) {
+                    // sub-millisecond waits poll
+                    timeout_ms = wait_us / 1000;
+                }
+
+                if (replay_done(ac)) {
+                    replay_report(ac);
+                    replay_close(ac);
+
+                    if (!ac->tx_job_count) {
+                        sc_can_stream_tx_batch_end(can_state.stream);
+                        break;
+                    }
+                }
+            }
+
             error = sc_can_stream_tx_batch_end(can_state.stream);
             if (error) {
                 if (ac->stop_on_error) {
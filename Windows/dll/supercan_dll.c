@@ -49,6 +49,9 @@ DEFINE_GUID(GUID_DEVINTERFACE_supercan,
 #include <stdbool.h>
 #include <supercan_dll.h>
 #include <supercan_winapi.h>
+#include <supercan_cmd.h>
+#include <supercan_log.h>
+#include <usnprintf.h>
 #include <stdio.h>
 
 
@@ -63,12 +66,16 @@ DEFINE_GUID(GUID_DEVINTERFACE_supercan,
 #define SC_CAN_STREAM_MAX_RX_WAIT_HANDLES 64
 #define SC_CAN_STREAM_DEFAULT_RX_WAIT_HANDLES 32
 
+#define SC_LOG_RECORDS 1024
+#define SC_LOG_DRAIN_INTERVAL_MS 10
+
+/* Log messages are formatted and delivered by a background thread,
+ * see sc_log_deferred. Format strings must follow the rules of sc_log_t.
+ */
 #define LOG_LIB(level, ...) \
 	do { \
         if (level <= s_LogLevel) {\
-		    char buf[256]; \
-		    int chars = _snprintf_s(buf, sizeof(buf), _TRUNCATE, __VA_ARGS__); \
-            s_LogCallback(s_LogCtx, level, buf, chars); \
+            sc_log_deferred(s_LogCallback, s_LogCtx, level, __VA_ARGS__); \
         } \
 	} while (0)
 
@@ -76,9 +83,7 @@ DEFINE_GUID(GUID_DEVINTERFACE_supercan,
 #define LOG_DEV(dev, level, ...) \
 	do { \
         if (level <= (dev)->log_level) { \
-		    char buf[256]; \
-		    int chars = _snprintf_s(buf, sizeof(buf), _TRUNCATE, __VA_ARGS__); \
-            (dev)->log_callback((dev)->log_ctx, level, buf, chars); \
+            sc_log_deferred((dev)->log_callback, (dev)->log_ctx, level, __VA_ARGS__); \
         } \
 	} while (0)
 
@@ -98,7 +103,6 @@ DEFINE_GUID(GUID_DEVINTERFACE_supercan,
 
 #define SC_DLL_VERSION_BUILD 0
 #define SC_CMD_TIMEOUT_MS 3000
-#define SC_STREAM_TIMEOUT_MS 5000
 
 static void Nop(void * dev, int level, char const* msg, size_t size)
 {
@@ -112,6 +116,117 @@ static int s_LogLevel = SC_DLL_LOG_LEVEL_OFF;
 static void* s_LogCtx = NULL;
 static sc_log_callback_t s_LogCallback = &Nop;
 
+static struct sc_log_state {
+    sc_log_t log;
+    SRWLOCK drain_lock;
+    INIT_ONCE init_once;
+    HANDLE stop_event;
+    HANDLE thread;
+    LONG volatile running;
+} s_Log = { { 0 }, SRWLOCK_INIT, INIT_ONCE_STATIC_INIT };
+
+static void sc_log_flush(void)
+{
+    if (s_Log.running) {
+        AcquireSRWLockExclusive(&s_Log.drain_lock);
+        sc_log_drain(&s_Log.log, 0);
+        ReleaseSRWLockExclusive(&s_Log.drain_lock);
+    }
+}
+
+static DWORD WINAPI sc_log_thread_main(void* ctx)
+{
+    (void)ctx;
+
+    while (WAIT_TIMEOUT == WaitForSingleObject(s_Log.stop_event, SC_LOG_DRAIN_INTERVAL_MS)) {
+        sc_log_flush();
+    }
+
+    sc_log_flush();
+
+    return 0;
+}
+
+static BOOL CALLBACK sc_log_start_once(PINIT_ONCE once, void* param, void** ctx)
+{
+    (void)once;
+    (void)param;
+    (void)ctx;
+
+    if (sc_log_init(&s_Log.log, SC_LOG_RECORDS)) {
+        return TRUE;
+    }
+
+    s_Log.stop_event = CreateEventW(NULL, TRUE, FALSE, NULL);
+    if (!s_Log.stop_event) {
+        goto error_exit;
+    }
+
+    s_Log.running = 1;
+
+    s_Log.thread = CreateThread(NULL, 0, &sc_log_thread_main, NULL, 0, NULL);
+    if (!s_Log.thread) {
+        s_Log.running = 0;
+        CloseHandle(s_Log.stop_event);
+        s_Log.stop_event = NULL;
+        goto error_exit;
+    }
+
+    return TRUE;
+
+error_exit:
+    sc_log_uninit(&s_Log.log);
+    return TRUE;
+}
+
+/* Starts the log thread the first time logging is enabled */
+static void sc_log_start(int level)
+{
+    if (level > SC_DLL_LOG_LEVEL_OFF) {
+        InitOnceExecuteOnce(&s_Log.init_once, &sc_log_start_once, NULL, NULL);
+    }
+}
+
+static void sc_log_stop(void)
+{
+    if (s_Log.thread) {
+        SetEvent(s_Log.stop_event);
+        WaitForSingleObject(s_Log.thread, INFINITE);
+        CloseHandle(s_Log.thread);
+        CloseHandle(s_Log.stop_event);
+        s_Log.running = 0;
+        s_Log.thread = NULL;
+        s_Log.stop_event = NULL;
+        sc_log_uninit(&s_Log.log);
+        InitOnceInitialize(&s_Log.init_once);
+    }
+}
+
+/* Queues a log message for the log thread
+ *
+ * Falls back to formatting on the calling thread if the log thread isn't running.
+ */
+static void sc_log_deferred(sc_log_callback_t callback, void* ctx, int level, char const* fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+
+    if (s_Log.running) {
+        sc_log_vwrite(&s_Log.log, callback, ctx, level, fmt, args);
+    }
+    else {
+        char buf[SC_LOG_LINE_SIZE];
+        int chars = uvsnprintf(buf, sizeof(buf), fmt, args);
+
+        if (chars > 0) {
+            callback(ctx, level, buf, (size_t)chars);
+        }
+    }
+
+    va_end(args);
+}
+
 
 
 static struct sc_data {
@@ -150,21 +265,22 @@ struct sc_dev_ex {
     int log_level;
 };
 
+struct sc_winusb_pipe {
+    struct sc_dev_ex* dev;
+    OVERLAPPED* rx_ovs;
+    OVERLAPPED* tx_ovs;
+    uint8_t epp;
+};
+
 struct sc_stream {
     sc_can_stream_t exposed;
     struct sc_dev_ex* dev;
-    void* ctx;
-    sc_can_stream_rx_callback rx_callback;
-    PUCHAR rx_buffers;
-    PUCHAR tx_buffers;
+    struct sc_winusb_pipe pipe;
+    sc_stream_core_t core;
     OVERLAPPED* rx_ovs;
-    OVERLAPPED tx_ovs[2];
-    size_t buffer_size;
-    int error;
-    uint16_t tx_size;
+    OVERLAPPED* tx_ovs;
     uint8_t rx_count;
-    uint8_t rx_next;
-    uint8_t tx_index;
+    uint8_t tx_count;
 };
 
 static inline void sc_devs_free(void)
@@ -261,11 +377,15 @@ SC_DLL_API void sc_version(sc_version_t* version)
 
 SC_DLL_API void sc_log_set_level(int level)
 {
+    sc_log_start(level);
     s_LogLevel = level;
 }
 
 SC_DLL_API void sc_log_set_callback(void* ctx, sc_log_callback_t callback)
 {
+    // deliver queued messages to the previous callback
+    sc_log_flush();
+
     s_LogCtx = ctx;
     s_LogCallback = callback ? callback : &Nop;
 }
@@ -278,6 +398,7 @@ SC_DLL_API void sc_init(void)
 SC_DLL_API void sc_uninit(void)
 {
     sc_devs_free();
+    sc_log_stop();
 }
 
 SC_DLL_API int sc_dev_scan(void)
@@ -400,6 +521,9 @@ SC_DLL_API void sc_dev_close(sc_dev_t* dev)
     if (dev) {
         struct sc_dev_ex* d = (struct sc_dev_ex*)dev;
 
+        // deliver queued messages while the callback is still valid
+        sc_log_flush();
+
         if (d->usb_handle) {
             WinUsb_Free(d->usb_handle);
         }
@@ -959,6 +1083,7 @@ SC_DLL_API int sc_dev_log_set_level(sc_dev_t* _dev, int level)
         return SC_DLL_ERROR_INVALID_PARAM;
     }
 
+    sc_log_start(level);
     dev->log_level = level;
 
     return SC_DLL_ERROR_NONE;
@@ -972,18 +1097,169 @@ SC_DLL_API int sc_dev_log_set_callback(sc_dev_t* _dev, void* ctx, sc_log_callbac
         return SC_DLL_ERROR_INVALID_PARAM;
     }
 
+    sc_log_flush();
+
     dev->log_ctx = ctx;
     dev->log_callback = callback ? callback : &Nop;
 
     return SC_DLL_ERROR_NONE;
 }
 
+static int sc_winusb_submit_read(void* ctx, unsigned slot, uint8_t* buffer, size_t bytes)
+{
+    struct sc_winusb_pipe* pipe = (struct sc_winusb_pipe*)ctx;
+    OVERLAPPED* ov = &pipe->rx_ovs[slot];
+
+    ResetEvent(ov->hEvent);
+
+    if (WinUsb_ReadPipe(
+        pipe->dev->usb_handle,
+        pipe->epp | 0x80,
+        buffer,
+        (ULONG)bytes,
+        NULL,
+        ov)) {
+        return SC_DLL_ERROR_UNKNOWN; // shouldn't happen with OVERLAPPED
+    }
+
+    DWORD e = GetLastError();
+    if (ERROR_IO_PENDING != e) {
+        return sc_map_win_error_ex(pipe->dev, e);
+    }
+
+    LOG_DEV_DEBUG3(pipe->dev, "sc_winusb_pipe %02x submit read %u\n", pipe->epp, slot);
+
+    return SC_DLL_ERROR_NONE;
+}
+
+static int sc_winusb_submit_write(void* ctx, unsigned slot, uint8_t const* buffer, size_t bytes)
+{
+    struct sc_winusb_pipe* pipe = (struct sc_winusb_pipe*)ctx;
+    OVERLAPPED* ov = &pipe->tx_ovs[slot];
+
+    ResetEvent(ov->hEvent);
+
+    if (WinUsb_WritePipe(
+        pipe->dev->usb_handle,
+        pipe->epp,
+        (PUCHAR)buffer,
+        (ULONG)bytes,
+        NULL,
+        ov)) {
+        return SC_DLL_ERROR_UNKNOWN; // shouldn't happen with OVERLAPPED
+    }
+
+    DWORD e = GetLastError();
+    if (ERROR_IO_PENDING != e) {
+        return sc_map_win_error_ex(pipe->dev, e);
+    }
+
+    return SC_DLL_ERROR_NONE;
+}
+
+static int sc_winusb_reap(void* ctx, int dir, unsigned slot, size_t* transferred, uint32_t timeout_ms)
+{
+    struct sc_winusb_pipe* pipe = (struct sc_winusb_pipe*)ctx;
+    OVERLAPPED* ov = SC_TRANSPORT_DIR_IN == dir ? &pipe->rx_ovs[slot] : &pipe->tx_ovs[slot];
+    DWORD bytes = 0;
+    DWORD dw = WaitForSingleObject(ov->hEvent, timeout_ms);
+
+    if (WAIT_TIMEOUT == dw) {
+        return SC_DLL_ERROR_TIMEOUT;
+    }
+
+    if (WAIT_OBJECT_0 != dw) {
+        return sc_map_win_error_ex(pipe->dev, GetLastError());
+    }
+
+    if (!WinUsb_GetOverlappedResult(
+        pipe->dev->usb_handle,
+        ov,
+        &bytes,
+        FALSE)) {
+        return sc_map_win_error_ex(pipe->dev, GetLastError());
+    }
+
+    ResetEvent(ov->hEvent);
+
+    *transferred = bytes;
+
+    return SC_DLL_ERROR_NONE;
+}
+
+static int sc_winusb_pending(void* ctx, int dir, unsigned slot)
+{
+    struct sc_winusb_pipe* pipe = (struct sc_winusb_pipe*)ctx;
+    OVERLAPPED* ov = SC_TRANSPORT_DIR_IN == dir ? &pipe->rx_ovs[slot] : &pipe->tx_ovs[slot];
+
+    return !HasOverlappedIoCompleted(ov);
+}
+
+static int sc_winusb_cancel(void* ctx, int dir, unsigned slot)
+{
+    struct sc_winusb_pipe* pipe = (struct sc_winusb_pipe*)ctx;
+    OVERLAPPED* ov = SC_TRANSPORT_DIR_IN == dir ? &pipe->rx_ovs[slot] : &pipe->tx_ovs[slot];
+
+    return sc_dev_cancel((sc_dev_t*)pipe->dev, ov);
+}
+
+static inline void sc_winusb_transport(struct sc_winusb_pipe* pipe, sc_transport_t* transport)
+{
+    transport->ctx = pipe;
+    transport->submit_read = &sc_winusb_submit_read;
+    transport->submit_write = &sc_winusb_submit_write;
+    transport->reap = &sc_winusb_reap;
+    transport->cancel = &sc_winusb_cancel;
+    transport->pending = &sc_winusb_pending;
+}
+
+static void sc_can_stream_tx_ovs_free(OVERLAPPED* ovs, unsigned count)
+{
+    if (ovs) {
+        for (unsigned i = 0; i < count; ++i) {
+            if (!ovs[i].hEvent) {
+                break;
+            }
+
+            CloseHandle(ovs[i].hEvent);
+        }
+
+        free(ovs);
+    }
+}
+
+static int sc_can_stream_tx_ovs_alloc(struct sc_dev_ex* dev, unsigned count, OVERLAPPED** _ovs)
+{
+    OVERLAPPED* ovs = calloc(count, sizeof(*ovs));
+
+    if (!ovs) {
+        return SC_DLL_ERROR_OUT_OF_MEM;
+    }
+
+    for (unsigned i = 0; i < count; ++i) {
+        HANDLE h = CreateEventW(NULL, TRUE, TRUE, NULL);
+
+        if (!h) {
+            int error = sc_map_win_error_ex(dev, GetLastError());
+            sc_can_stream_tx_ovs_free(ovs, count);
+            return error;
+        }
+
+        ovs[i].hEvent = h;
+    }
+
+    *_ovs = ovs;
+
+    return SC_DLL_ERROR_NONE;
+}
+
 SC_DLL_API void sc_can_stream_uninit(sc_can_stream_t* _stream)
 {
     struct sc_stream* stream = (struct sc_stream*)_stream;
 
     if (stream) {
-        struct sc_dev_ex *dev = (struct sc_dev_ex*)stream->dev;
+        // cancels requests in flight, must run while the events are still around
+        sc_stream_core_uninit(&stream->core);
 
         if (stream->rx_ovs) {
             for (unsigned i = 0; i < stream->rx_count; ++i) {
@@ -991,41 +1267,48 @@ SC_DLL_API void sc_can_stream_uninit(sc_can_stream_t* _stream)
                     break;
                 }
 
-                sc_dev_cancel((sc_dev_t*)dev, &stream->rx_ovs[i]);
                 CloseHandle(stream->rx_ovs[i].hEvent);
             }
 
             free(stream->rx_ovs);
         }
 
-        for (size_t i = 0; i < _countof(stream->tx_ovs); ++i) {
-            if (!stream->tx_ovs[i].hEvent) {
-                break;
-            }
+        sc_can_stream_tx_ovs_free(stream->tx_ovs, stream->tx_count);
 
-            sc_dev_cancel((sc_dev_t*)dev, &stream->tx_ovs[i]);
-            CloseHandle(stream->tx_ovs[i].hEvent);
-        }
-
-        free(stream->rx_buffers);
-        free(stream->tx_buffers);
         free(stream);
     }
 }
 
-SC_DLL_API int sc_can_stream_init(
+static uint64_t sc_can_stream_clock_us(void* ctx)
+{
+    LARGE_INTEGER now, freq;
+
+    (void)ctx;
+
+    QueryPerformanceCounter(&now);
+    QueryPerformanceFrequency(&freq);
+
+    return
+        (uint64_t)(now.QuadPart / freq.QuadPart) * 1000000u +
+        (uint64_t)(now.QuadPart % freq.QuadPart) * 1000000u / (uint64_t)freq.QuadPart;
+}
+
+static int sc_can_stream_init_ex(
     sc_dev_t* dev,
     DWORD buffer_size,
     void* ctx,
     sc_can_stream_rx_callback callback,
+    sc_can_stream_rx_batch_callback batch_callback,
+    size_t frame_count,
     int rreqs,
     sc_can_stream_t** _stream)
 {
     struct sc_stream* stream = NULL;
     int error = SC_DLL_ERROR_NONE;
     DWORD win_error = ERROR_SUCCESS;
+    sc_transport_t transport;
 
-    if (!dev || !_stream || !buffer_size || !callback) {
+    if (!dev || !_stream || !buffer_size || (!callback && !batch_callback)) {
         error = SC_DLL_ERROR_INVALID_PARAM;
         goto Exit;
     }
@@ -1046,21 +1329,6 @@ SC_DLL_API int sc_can_stream_init(
     }
 
     stream->dev = (struct sc_dev_ex*)dev;
-    stream->ctx = ctx;
-    stream->rx_callback = callback;
-    stream->buffer_size = buffer_size;
-    
-    stream->rx_buffers = calloc(rreqs, stream->buffer_size);
-    if (!stream->rx_buffers) {
-        error = SC_DLL_ERROR_OUT_OF_MEM;
-        goto Error;
-    }
-
-    stream->tx_buffers = calloc(2, stream->buffer_size);
-    if (!stream->tx_buffers) {
-        error = SC_DLL_ERROR_OUT_OF_MEM;
-        goto Error;
-    }
 
     stream->rx_ovs = calloc(rreqs, sizeof(*stream->rx_ovs));
     if (!stream->rx_ovs) {
@@ -1068,18 +1336,13 @@ SC_DLL_API int sc_can_stream_init(
         goto Error;
     }
 
-    
-    for (size_t i = 0; i < _countof(stream->tx_ovs); ++i) {
-        HANDLE h = CreateEventW(NULL, TRUE, TRUE, NULL);
-
-        if (!h) {
-            goto error_exit_win_error;
-        }
-
-        stream->tx_ovs[i].hEvent = h;
+    error = sc_can_stream_tx_ovs_alloc(stream->dev, SC_STREAM_TX_BUFFERS, &stream->tx_ovs);
+    if (error) {
+        goto Error;
     }
 
-    // create and submit all IN tokens
+    stream->tx_count = SC_STREAM_TX_BUFFERS;
+
     for (size_t i = 0; i < (size_t)rreqs; ++i) {
         /* Never, never use automatic reset events!!! 
          *
@@ -1094,34 +1357,46 @@ SC_DLL_API int sc_can_stream_init(
         }
 
         stream->rx_ovs[i].hEvent = h;
+        ++stream->rx_count;
+    }
 
-        if (!WinUsb_ReadPipe(
-            stream->dev->usb_handle,
-            stream->dev->exposed.can_epp | 0x80,
-            stream->rx_buffers + i * stream->buffer_size,
-            (ULONG)stream->buffer_size,
-            NULL,
-            &stream->rx_ovs[i])) {
-            DWORD e = GetLastError();
+    stream->pipe.dev = stream->dev;
+    stream->pipe.rx_ovs = stream->rx_ovs;
+    stream->pipe.tx_ovs = stream->tx_ovs;
+    stream->pipe.epp = stream->dev->exposed.can_epp;
 
-            if (ERROR_IO_PENDING != e) {
-                error = sc_map_win_error_ex(stream->dev, e);
-                goto Error;
-            }
+    sc_winusb_transport(&stream->pipe, &transport);
 
-            error = SC_DLL_ERROR_NONE;
-        }
-        else {
-            error = SC_DLL_ERROR_UNKNOWN;
+    error = sc_stream_core_init(
+        &stream->core,
+        &transport,
+        buffer_size,
+        stream->dev->exposed.epp_size,
+        stream->rx_count,
+        stream->dev->exposed.dev_to_host32 != &Nop32);
+    if (error) {
+        goto Error;
+    }
+
+    sc_stream_core_set_clock(&stream->core, &sc_can_stream_clock_us, NULL);
+
+    if (batch_callback) {
+        error = sc_stream_core_set_rx_batch_callback(&stream->core, ctx, batch_callback, frame_count);
+        if (error) {
             goto Error;
         }
+    }
+    else {
+        sc_stream_core_set_rx_callback(&stream->core, ctx, callback);
+    }
 
-        LOG_DEV_DEBUG1(stream->dev, "sc_can_stream_init submit %u\n", (unsigned)i);
-
-        ++stream->rx_count;
+    // submit all IN tokens
+    error = sc_stream_core_start(&stream->core);
+    if (error) {
+        goto Error;
     }
 
-    stream->exposed.tx_capacity = (uint16_t)stream->buffer_size;
+    stream->exposed.tx_capacity = stream->core.tx_capacity;
 
     *_stream = (sc_can_stream_t*)stream;
 Exit:
@@ -1136,108 +1411,27 @@ Error:
     goto Exit;
 }
 
-static int sc_process_rx_buffer(
-    struct sc_stream* stream,
-    PUCHAR ptr, uint16_t bytes)
-{
-    PUCHAR const in_beg = ptr;
-    PUCHAR const in_end = in_beg + bytes;
-    PUCHAR in_ptr = in_beg;
-    int error = SC_DLL_ERROR_NONE;
-
-    while (in_ptr + SC_MSG_CAN_LEN_MULTIPLE <= in_end) {
-        struct sc_msg_header const* msg = (struct sc_msg_header const*)in_ptr;
-
-        if (!msg->id || !msg->len) {
-            // Allow end-of-input message to work around need to send ZLP
-            break;
-        }
-
-        if (msg->len < SC_MSG_CAN_LEN_MULTIPLE) {
-            error = SC_DLL_ERROR_PROTO_VIOLATION;
-            break;
-        }
-
-        if (in_ptr + msg->len > in_end) {
-            error = SC_DLL_ERROR_PROTO_VIOLATION;
-            break;
-        }
-
-        error = stream->rx_callback(stream->ctx, msg, msg->len);
-        if (error) {
-            break;
-        }
-
-        in_ptr += msg->len;
-    }
-
-    return error;
-}
-
-static inline int sc_rx_submit(
-    struct sc_stream* stream)
+SC_DLL_API int sc_can_stream_init(
+    sc_dev_t* dev,
+    DWORD buffer_size,
+    void* ctx,
+    sc_can_stream_rx_callback callback,
+    int rreqs,
+    sc_can_stream_t** stream)
 {
-    if (!WinUsb_ReadPipe(
-        stream->dev->usb_handle,
-        stream->dev->exposed.can_epp | 0x80,
-        stream->rx_buffers + (size_t)stream->rx_next * stream->buffer_size,
-        (ULONG)stream->buffer_size,
-        NULL,
-        &stream->rx_ovs[stream->rx_next])) {
-        DWORD e = GetLastError();
-
-        if (ERROR_IO_PENDING != e) {
-            return sc_map_win_error_ex(stream->dev, e);
-        }
-    }
-    else {
-        return SC_DLL_ERROR_UNKNOWN;
-    }
-
-    stream->rx_next = (stream->rx_next + 1) % stream->rx_count;
-
-    return SC_DLL_ERROR_NONE;
+    return sc_can_stream_init_ex(dev, buffer_size, ctx, callback, NULL, 0, rreqs, stream);
 }
 
-static int sc_can_stream_rx_process_signaled_ex(struct sc_stream* stream)
+SC_DLL_API int sc_can_stream_init_batch(
+    sc_dev_t* dev,
+    DWORD buffer_size,
+    void* ctx,
+    sc_can_stream_rx_batch_callback callback,
+    size_t frame_count,
+    int rreqs,
+    sc_can_stream_t** stream)
 {
-    int error = SC_DLL_ERROR_NONE;
-    int user_error = SC_DLL_ERROR_NONE;
-    DWORD transferred = 0;
-    uint8_t const index = stream->rx_next;
-
-    if (!WinUsb_GetOverlappedResult(
-        stream->dev->usb_handle,
-        &stream->rx_ovs[index],
-        &transferred,
-        FALSE)) {
-        error = sc_map_win_error_ex(stream->dev, GetLastError());
-        stream->error = error;
-        return error;
-    }
-
-    if (transferred) {
-        PUCHAR ptr = stream->rx_buffers + stream->buffer_size * index;
-
-        user_error = sc_process_rx_buffer(stream, ptr, (uint16_t)transferred);
-    }
-
-    /* Keep stream processing, return user error later on. */
-    ResetEvent(stream->rx_ovs[index].hEvent);
-
-    error = sc_rx_submit(stream);
-    if (error) {
-        stream->error = error;
-        return error;
-    }
-
-    LOG_DEV_DEBUG3(stream->dev, "sc_can_stream_rx submit %u\n", index);
-
-    if (user_error) {
-        return user_error;
-    }
-
-    return error;
+    return sc_can_stream_init_ex(dev, buffer_size, ctx, NULL, callback, frame_count, rreqs, stream);
 }
 
 SC_DLL_API int sc_can_stream_rx_process_signaled_wait_handle(sc_can_stream_t* _stream)
@@ -1248,11 +1442,7 @@ SC_DLL_API int sc_can_stream_rx_process_signaled_wait_handle(sc_can_stream_t* _s
         return SC_DLL_ERROR_INVALID_PARAM;
     }
 
-    if (stream->error) {
-        return stream->error;
-    }
-
-    return sc_can_stream_rx_process_signaled_ex(stream);
+    return sc_stream_core_rx(&stream->core, 0);
 }
 
 SC_DLL_API int sc_can_stream_rx(sc_can_stream_t* _stream, DWORD timeout_ms)
@@ -1265,11 +1455,11 @@ SC_DLL_API int sc_can_stream_rx(sc_can_stream_t* _stream, DWORD timeout_ms)
         return SC_DLL_ERROR_INVALID_PARAM;
     }
 
-    if (stream->error) {
-        return stream->error;
+    if (stream->core.error) {
+        return stream->core.error;
     }
 
-    uint8_t const index = stream->rx_next;
+    uint8_t const index = stream->core.rx_next;
 
     if (stream->exposed.user_handle) {
         HANDLE const wait_handles[] = {
@@ -1299,7 +1489,7 @@ SC_DLL_API int sc_can_stream_rx(sc_can_stream_t* _stream, DWORD timeout_ms)
     }
    
     if (WAIT_OBJECT_0 == dw) {
-        return sc_can_stream_rx_process_signaled_ex(stream);
+        return sc_stream_core_rx(&stream->core, 0);
     }
     else if (WAIT_TIMEOUT == dw) {
         // nothing to do
@@ -1307,7 +1497,7 @@ SC_DLL_API int sc_can_stream_rx(sc_can_stream_t* _stream, DWORD timeout_ms)
     }
     
     error = sc_map_win_error_ex(stream->dev, GetLastError());
-    stream->error = error;
+    stream->core.error = error;
 
     return error;
 }
@@ -1320,146 +1510,230 @@ SC_DLL_API int sc_can_stream_rx_next_wait_handle(sc_can_stream_t* _stream, HANDL
         return SC_DLL_ERROR_INVALID_PARAM;
     }
 
-    *handle = stream->rx_ovs[stream->rx_next].hEvent;
+    *handle = stream->rx_ovs[stream->core.rx_next].hEvent;
 
     return SC_DLL_ERROR_NONE;
 }
 
-static int sc_can_stream_tx_send_buffer(struct sc_stream* stream)
+SC_DLL_API int sc_can_stream_tx_batch_begin(sc_can_stream_t* _stream)
 {
-    int error = SC_DLL_ERROR_NONE;
-    DWORD dw = 0;
-    uint8_t prev_index = (stream->tx_index + 1) & 0x1;
+    struct sc_stream* stream = (struct sc_stream*)_stream;
+    
+    if (!stream) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
 
-    dw = WaitForSingleObject(stream->tx_ovs[prev_index].hEvent, SC_STREAM_TIMEOUT_MS);
-    if (WAIT_OBJECT_0 == dw) {
-        ResetEvent(stream->tx_ovs[stream->tx_index].hEvent);
+    return sc_stream_core_tx_batch_begin(&stream->core);
+}
+
+SC_DLL_API int sc_can_stream_tx_batch_add(
+    sc_can_stream_t* _stream,
+    uint8_t const** buffers,
+    uint16_t const* sizes,
+    size_t count,
+    size_t* added)
+{
+    struct sc_stream* stream = (struct sc_stream*)_stream;
+
+    if (!stream || !buffers || !added) {
+        return SC_DLL_ERROR_INVALID_PARAM;
     }
-    else if (WAIT_TIMEOUT == dw) {
-        LOG_DEV_ERROR(stream->dev, "CAN stream tx timed out after %u [ms]\n", SC_STREAM_TIMEOUT_MS);
-        error = SC_DLL_ERROR_TIMEOUT;
-        goto exit_error;
-    } 
-    else {
-        goto fetch_error;
+
+    return sc_stream_core_tx_batch_add(&stream->core, buffers, sizes, count, added);
+}
+
+SC_DLL_API int sc_can_stream_tx_reserve(sc_can_stream_t* _stream, uint16_t bytes, uint8_t** ptr)
+{
+    struct sc_stream* stream = (struct sc_stream*)_stream;
+
+    if (!stream || !ptr) {
+        return SC_DLL_ERROR_INVALID_PARAM;
     }
 
-    if (WinUsb_WritePipe(
-        stream->dev->usb_handle,
-        stream->dev->exposed.can_epp,
-        &stream->tx_buffers[stream->tx_index * stream->buffer_size],
-        stream->tx_size,
-        NULL,
-        &stream->tx_ovs[stream->tx_index])) {
-        error = SC_DLL_ERROR_UNKNOWN; // shouldn't happen with OVERLAPPED
-        goto exit_error;
+    return sc_stream_core_tx_reserve(&stream->core, bytes, ptr);
+}
+
+SC_DLL_API int sc_can_stream_tx_commit(sc_can_stream_t* _stream, uint16_t bytes)
+{
+    struct sc_stream* stream = (struct sc_stream*)_stream;
+
+    if (!stream) {
+        return SC_DLL_ERROR_INVALID_PARAM;
     }
 
-    dw = GetLastError();
-    if (ERROR_IO_PENDING != dw) {
-        goto fetch_error;
+    return sc_stream_core_tx_commit(&stream->core, bytes);
+}
+
+SC_DLL_API int sc_can_stream_tx_batch_end(sc_can_stream_t* _stream)
+{
+    struct sc_stream* stream = (struct sc_stream*)_stream;
+    int error = SC_DLL_ERROR_NONE;
+
+    if (!stream) {
+        return SC_DLL_ERROR_INVALID_PARAM;
     }
 
-    // swap tx buffers
-    stream->tx_index = prev_index;
+    error = sc_stream_core_tx_batch_end(&stream->core);
+    if (SC_DLL_ERROR_TIMEOUT == error) {
+        LOG_DEV_ERROR(stream->dev, "CAN stream tx timed out after %u [ms]\n", SC_STREAM_TX_TIMEOUT_MS);
+    }
 
-exit:
     return error;
+}
 
-fetch_error:
-    dw = GetLastError();
-    error = sc_map_win_error_ex(stream->dev, dw);
+SC_DLL_API int sc_can_stream_tx_batch_submit(sc_can_stream_t* _stream)
+{
+    struct sc_stream* stream = (struct sc_stream*)_stream;
 
-exit_error:
-    stream->error = error;
-    goto exit;
-}
+    if (!stream) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
 
+    return sc_stream_core_tx_batch_submit(&stream->core);
+}
 
-SC_DLL_API int sc_can_stream_tx_batch_begin(sc_can_stream_t* _stream)
+SC_DLL_API int sc_can_stream_tx_poll(sc_can_stream_t* _stream, DWORD timeout_ms, unsigned* pending)
 {
     struct sc_stream* stream = (struct sc_stream*)_stream;
-    
+    int error = SC_DLL_ERROR_NONE;
+
     if (!stream) {
         return SC_DLL_ERROR_INVALID_PARAM;
     }
 
-    if (stream->tx_size) {
-        return SC_DLL_ERROR_INVALID_OPERATION;
+    error = sc_stream_core_tx_poll(&stream->core, timeout_ms);
+
+    if (pending) {
+        *pending = stream->core.tx_inflight;
     }
 
-    return SC_DLL_ERROR_NONE;
+    return error;
 }
 
-SC_DLL_API int sc_can_stream_tx_batch_add(
-    sc_can_stream_t* _stream,
-    uint8_t const** buffers,
-    uint16_t const* sizes,
-    size_t count,
-    size_t* added)
+SC_DLL_API int sc_can_stream_set_tx_buffers(sc_can_stream_t* _stream, int count)
 {
     struct sc_stream* stream = (struct sc_stream*)_stream;
-    size_t buffers_to_add = 0;
-    uint16_t bytes = 0;
+    OVERLAPPED* ovs = NULL;
+    int error = SC_DLL_ERROR_NONE;
 
-    if (!stream || !buffers || !added) {
+    if (!stream || count < 0) {
         return SC_DLL_ERROR_INVALID_PARAM;
     }
 
-    bytes = stream->tx_size;
+    if (!count) {
+        count = SC_STREAM_TX_BUFFERS;
+    }
+
+    if (count < 2 || count > SC_STREAM_TX_MAX_BUFFERS) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
 
-    for (; buffers_to_add < count; ++buffers_to_add) {
-        uint16_t new_bytes = bytes + sizes[buffers_to_add];
-        if (new_bytes > stream->exposed.tx_capacity) {
-            break;
-        }
+    if (stream->core.tx_inflight || stream->core.tx_size) {
+        return SC_DLL_ERROR_INVALID_OPERATION;
+    }
 
-        bytes = new_bytes;
+    error = sc_can_stream_tx_ovs_alloc(stream->dev, (unsigned)count, &ovs);
+    if (error) {
+        return error;
     }
 
-    for (size_t i = 0; i < buffers_to_add; ++i) {
-        memcpy(&stream->tx_buffers[stream->tx_index * stream->buffer_size + stream->tx_size], buffers[i], sizes[i]);
-        stream->tx_size += sizes[i];
+    error = sc_stream_core_set_tx_count(&stream->core, (unsigned)count);
+    if (error) {
+        sc_can_stream_tx_ovs_free(ovs, (unsigned)count);
+        return error;
     }
 
-    *added = buffers_to_add;
+    sc_can_stream_tx_ovs_free(stream->tx_ovs, stream->tx_count);
+    stream->tx_ovs = ovs;
+    stream->tx_count = (uint8_t)count;
+    stream->pipe.tx_ovs = ovs;
 
     return SC_DLL_ERROR_NONE;
 }
 
-SC_DLL_API int sc_can_stream_tx_batch_end(sc_can_stream_t* _stream)
+SC_DLL_API int sc_can_stream_set_tx_auto_flush(
+    sc_can_stream_t* _stream,
+    int enable,
+    uint16_t bytes,
+    uint32_t latency_us)
 {
     struct sc_stream* stream = (struct sc_stream*)_stream;
+    sc_stream_tx_flush_t policy;
 
     if (!stream) {
         return SC_DLL_ERROR_INVALID_PARAM;
     }
 
-    if (stream->error) {
-        return stream->error;
+    if (!enable) {
+        return sc_stream_core_set_tx_auto_flush(&stream->core, NULL);
     }
 
-    if (stream->tx_size) {
-        if (stream->tx_size & (SC_MSG_CAN_LEN_MULTIPLE - 1)) {
-            return SC_DLL_ERROR_PROTO_VIOLATION;
-        }
+    policy.clock = &sc_can_stream_clock_us;
+    policy.clock_ctx = NULL;
+    policy.bytes = bytes;
+    policy.latency_us = latency_us;
 
-        // Check if we need to work around having to send a ZLP
-        if (stream->dev->exposed.epp_size < stream->buffer_size &&
-            stream->tx_size < stream->buffer_size &&
-            (stream->tx_size % stream->dev->exposed.epp_size) == 0) {
-            *((uint32_t*)&stream->tx_buffers[stream->tx_index * stream->buffer_size + stream->tx_size]) = 0;
-            stream->tx_size += 4;
-        }
+    return sc_stream_core_set_tx_auto_flush(&stream->core, &policy);
+}
 
-        int error = sc_can_stream_tx_send_buffer(stream);
-        if (error) {
-            return error;
-        }
+SC_DLL_API int sc_can_stream_tx_flush_if_due(sc_can_stream_t* _stream, DWORD* timeout_ms)
+{
+    struct sc_stream* stream = (struct sc_stream*)_stream;
+    uint32_t wait_us = 0;
+    int error = SC_DLL_ERROR_NONE;
+
+    if (!stream || !timeout_ms) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
 
-        stream->tx_size = 0;
+    error = sc_stream_core_tx_flush_if_due(&stream->core, &wait_us);
+
+    if (UINT32_MAX == wait_us) {
+        *timeout_ms = INFINITE;
+    }
+    else {
+        *timeout_ms = (wait_us + 999) / 1000;
     }
 
+    return error;
+}
+
+SC_DLL_API int sc_can_stream_tx_flush_stats(sc_can_stream_t* _stream, sc_stream_tx_flush_stats_t* stats)
+{
+    struct sc_stream* stream = (struct sc_stream*)_stream;
+
+    if (!stream || !stats) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+
+    *stats = stream->core.tx_flush_stats;
+
+    return SC_DLL_ERROR_NONE;
+}
+
+SC_DLL_API int sc_can_stream_stats(sc_can_stream_t* _stream, sc_stream_stats_t* stats, int reset)
+{
+    struct sc_stream* stream = (struct sc_stream*)_stream;
+
+    if (!stream || (!stats && !reset)) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+
+    sc_stream_core_stats(&stream->core, stats, reset);
+
+    return SC_DLL_ERROR_NONE;
+}
+
+SC_DLL_API int sc_can_stream_set_rx_reassembly(sc_can_stream_t* _stream, int enable)
+{
+    struct sc_stream* stream = (struct sc_stream*)_stream;
+
+    if (!stream) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+
+    sc_stream_core_set_rx_reassembly(&stream->core, enable);
+
     return SC_DLL_ERROR_NONE;
 }
 
@@ -1564,109 +1838,59 @@ SC_DLL_API int sc_cmd_ctx_run(
     uint16_t* response_size,
     DWORD timeout_ms)
 {
-    struct sc_dev_ex* dev = NULL;
-    DWORD transferred = 0;
-    DWORD result = 0;
-    int error = SC_DLL_ERROR_NONE;
-    uint16_t dummy = 0;
-    bool rx_submitted = false;
+    struct sc_winusb_pipe pipe;
+    sc_transport_t transport;
 
     if (!ctx || !bytes) {
-        error = SC_DLL_ERROR_INVALID_PARAM;
-        goto error_exit;
-    }
-
-    if (!response_size) {
-        response_size = &dummy;
+        return SC_DLL_ERROR_INVALID_PARAM;
     }
 
-    *response_size = 0;
-
-    dev = (struct sc_dev_ex*)ctx->dev;
-
-    // submit in token
-    if (!WinUsb_ReadPipe(
-        dev->usb_handle,
-        dev->exposed.cmd_epp | 0x80,
-        ctx->rx_buffer,
-        dev->exposed.cmd_buffer_size,
-        NULL,
-        &ctx->rx_ov)) {
-        DWORD e = GetLastError();
-        if (ERROR_IO_PENDING != e) {
-            error = sc_map_win_error_ex(dev, e);
-            goto error_exit;
-        }
-    }
+    pipe.dev = (struct sc_dev_ex*)ctx->dev;
+    pipe.rx_ovs = &ctx->rx_ov;
+    pipe.tx_ovs = &ctx->tx_ov;
+    pipe.epp = ctx->dev->cmd_epp;
 
-    rx_submitted = true;
+    sc_winusb_transport(&pipe, &transport);
 
-    if (!WinUsb_WritePipe(
-        dev->usb_handle,
-        dev->exposed.cmd_epp,
+    return sc_cmd_exchange(
+        &transport,
         ctx->tx_buffer,
         bytes,
-        NULL,
-        &ctx->tx_ov)) {
-        DWORD e = GetLastError();
-        if (ERROR_IO_PENDING != e) {
-            error = sc_map_win_error_ex(dev, e);
-            goto error_exit;
-        }
-    }
-
-    result = WaitForSingleObject(ctx->tx_ov.hEvent, timeout_ms);
-    switch (result) {
-    case WAIT_OBJECT_0:
-        break;
-    case WAIT_TIMEOUT:
-        error = SC_DLL_ERROR_TIMEOUT;
-        sc_dev_cancel((sc_dev_t*)dev, &ctx->tx_ov);
-        goto error_exit;
-    default:
-        goto error_exit_win_error;
-        break;
-    }
+        ctx->rx_buffer,
+        ctx->dev->cmd_buffer_size,
+        response_size,
+        timeout_ms);
+}
 
-    if (!WinUsb_GetOverlappedResult(dev->usb_handle, &ctx->tx_ov, &transferred, FALSE)) {
-        goto error_exit_win_error;
+SC_DLL_API int sc_cmd_ctx_batch_init(sc_cmd_ctx_t* ctx, sc_cmd_batch_t* batch)
+{
+    if (!ctx || !batch) {
+        return SC_DLL_ERROR_INVALID_PARAM;
     }
 
-    if (transferred < bytes) {
-        error = SC_DLL_ERROR_DEVICE_FAILURE;
-        goto error_exit;
-    }
+    sc_cmd_batch_init(batch, ctx->tx_buffer, ctx->dev->cmd_buffer_size);
 
-    result = WaitForSingleObject(ctx->rx_ov.hEvent, timeout_ms);
-    switch (result) {
-    case WAIT_OBJECT_0:
-        break;
-    case WAIT_TIMEOUT:
-        error = SC_DLL_ERROR_TIMEOUT;
-        goto error_exit;
-    default:
-        goto error_exit_win_error;
-        break;
-    }
+    return SC_DLL_ERROR_NONE;
+}
 
-    rx_submitted = false;
+SC_DLL_API int sc_cmd_ctx_batch_run(
+    sc_cmd_ctx_t* ctx,
+    sc_cmd_batch_t const* batch,
+    sc_cmd_reply_t* replies,
+    DWORD timeout_ms)
+{
+    uint16_t bytes = 0;
+    int error = SC_DLL_ERROR_NONE;
 
-    if (!WinUsb_GetOverlappedResult(dev->usb_handle, &ctx->rx_ov, &transferred, FALSE)) {
-        goto error_exit_win_error;
+    if (!ctx || !batch || batch->buffer != ctx->tx_buffer) {
+        return SC_DLL_ERROR_INVALID_PARAM;
     }
 
-    *response_size = (uint16_t)transferred;
-
-success_exit:
-    return error;
-
-error_exit_win_error:
-    error = sc_map_win_error_ex(dev, GetLastError());
-
-error_exit:
-    if (rx_submitted) {
-        sc_dev_cancel((sc_dev_t*)dev, &ctx->rx_ov);
+    error = sc_cmd_ctx_run(ctx, batch->size, &bytes, timeout_ms);
+    if (error) {
+        return error;
     }
-    goto success_exit;
+
+    return sc_cmd_batch_parse(batch, ctx->rx_buffer, bytes, replies);
 }
 
@@ -27,6 +27,10 @@
 
 #include <stdint.h>
 
+#include "supercan_error.h"
+#include "supercan_stream.h"
+#include "supercan_cmd.h"
+
 
 #ifndef SC_DLL_API
 #   ifdef SC_STATIC
@@ -60,29 +64,6 @@ extern "C" {
 
 
 
-#define SC_DLL_ERROR_UNKNOWN                -1
-#define SC_DLL_ERROR_NONE                   0
-#define SC_DLL_ERROR_INVALID_PARAM          1
-#define SC_DLL_ERROR_OUT_OF_MEM             2
-#define SC_DLL_ERROR_DEV_COUNT_CHANGED      4
-#define SC_DLL_ERROR_DEV_UNSUPPORTED        5   ///< not a SuperCAN device
-#define SC_DLL_ERROR_VERSION_UNSUPPORTED    6   ///< unsupported SuperCAN protocol version
-#define SC_DLL_ERROR_IO_PENDING             7   ///< I/O is underway
-#define SC_DLL_ERROR_DEVICE_FAILURE         8   ///< USB related device failure, i.e. unplug
-#define SC_DLL_ERROR_DEVICE_BUSY            9   ///< device not available (already opened)
-#define SC_DLL_ERROR_ABORTED                10  ///< request was aborted / canceled
-#define SC_DLL_ERROR_DEV_NOT_IMPLEMENTED    11  ///< device doesn't implement requested feature
-#define SC_DLL_ERROR_PROTO_VIOLATION        12  ///< malformed data buffer
-#define SC_DLL_ERROR_SEQ_VIOLATION          13  ///< jumbled CAN message sequence
-#define SC_DLL_ERROR_REASSEMBLY_SPACE       14  ///< insufficient message reassembly buffer space
-#define SC_DLL_ERROR_TIMEOUT                15  ///< timeout
-#define SC_DLL_ERROR_AGAIN                  16  ///< try again (later)
-#define SC_DLL_ERROR_BUFFER_TOO_SMALL       17  ///< buffer too small
-#define SC_DLL_ERROR_USER_HANDLE_SIGNALED   18  ///< user provided handle was signaled
-#define SC_DLL_ERROR_ACCESS_DENIED          19  ///< access denied
-#define SC_DLL_ERROR_INVALID_OPERATION      20  ///< operation not possible in current state
-#define SC_DLL_ERROR_DEVICE_GONE            21  ///< device was removed from the system
-
 typedef struct sc_version {
     char const* commit;
     uint16_t major;
@@ -265,6 +246,28 @@ SC_DLL_API int sc_cmd_ctx_run(
     uint16_t* reply_bytes,
     DWORD timeout_ms);
 
+/** Starts a command batch on the context's command buffer
+ *
+ * Add requests with sc_cmd_batch_add, then send them all
+ * in a single round trip with sc_cmd_ctx_batch_run.
+ */
+SC_DLL_API int sc_cmd_ctx_batch_init(sc_cmd_ctx_t* ctx, sc_cmd_batch_t* batch);
+
+/** Sends a command batch to the device and splits the response
+ *
+ * \param ctx           command context
+ * \param batch         batch started with sc_cmd_ctx_batch_init
+ * \param replies       (out) array of batch->count replies, pointing into ctx->rx_buffer
+ * \param timeout_ms    time to wait for each direction
+ *
+ * \returns error code, device errors are reported per request in replies
+ */
+SC_DLL_API int sc_cmd_ctx_batch_run(
+    sc_cmd_ctx_t* ctx,
+    sc_cmd_batch_t const* batch,
+    sc_cmd_reply_t* replies,
+    DWORD timeout_ms);
+
 
 typedef struct sc_can_stream {
     HANDLE user_handle;     ///< optional user handle to wait on in sc_can_stream_rx
@@ -272,8 +275,6 @@ typedef struct sc_can_stream {
     uint16_t reserved;
 } sc_can_stream_t;
 
-typedef int (*sc_can_stream_rx_callback)(void* ctx, void const* ptr, uint16_t bytes);
-
 /** Uninitializes the stream
  *
  * \param stream object to uninitialize, can be NULL
@@ -302,6 +303,34 @@ SC_DLL_API int sc_can_stream_init(
     int rreqs,
     sc_can_stream_t** stream);
 
+/** Initializes the stream for batched reception
+ *
+ * Same as sc_can_stream_init except that received messages are
+ * decoded by the library and handed to the callback in batches
+ * instead of one message at a time.
+ *
+ * \param dev   device
+ * \param buffer_size   size of the device buffer as retrieved
+ *      through sc_msg_can_info.
+ * \param ctx   context passed to rx callback
+ * \param callback  callback to invoke on message reception
+ * \param frame_count  maximum number of frames per callback,
+ *      pass 0 to deliver all frames of a transfer at once.
+ * \param rreqs  number of read requests to submit to the USB stack
+ *      pass 0 to use default.
+ * \param [out] stream
+ *
+ * \returns error code
+ */
+SC_DLL_API int sc_can_stream_init_batch(
+    sc_dev_t* dev,
+    DWORD buffer_size,
+    void* ctx,
+    sc_can_stream_rx_batch_callback callback,
+    size_t frame_count,
+    int rreqs,
+    sc_can_stream_t** stream);
+
 
 /** Starts a new batched transmit
  *
@@ -328,6 +357,34 @@ SC_DLL_API int sc_can_stream_tx_batch_add(
     size_t count,
     size_t* added);
 
+/** Reserves space in the current transmit batch
+ *
+ * Use this function to encode messages directly into the transmit
+ * buffer instead of copying them with sc_can_stream_tx_batch_add.
+ * The reservation is valid until the next call to any of the
+ * transmit functions.
+ *
+ * \param stream    CAN stream
+ * \param bytes     Bytes to reserve, a multiple of SC_MSG_CAN_LEN_MULTIPLE
+ * \param ptr       Output pointer to reserved space
+ *
+ * \returns SC_DLL_ERROR_BUFFER_TOO_SMALL if the current batch doesn't have
+ *      enough space left. End the batch and start a new one.
+ */
+SC_DLL_API int sc_can_stream_tx_reserve(
+    sc_can_stream_t* stream,
+    uint16_t bytes,
+    uint8_t** ptr);
+
+/** Adds reserved bytes to the current transmit batch
+ *
+ * \param stream    CAN stream
+ * \param bytes     Bytes to add, at most the bytes reserved.
+ *
+ * \returns error code
+ */
+SC_DLL_API int sc_can_stream_tx_commit(sc_can_stream_t* stream, uint16_t bytes);
+
 /** Finishes the current batch
  *
  * Is is legal to end an empty batch in which case
@@ -339,6 +396,110 @@ SC_DLL_API int sc_can_stream_tx_batch_add(
  */
 SC_DLL_API int sc_can_stream_tx_batch_end(sc_can_stream_t* stream);
 
+/** Finishes the current batch without waiting
+ *
+ * Same as sc_can_stream_tx_batch_end except that the function
+ * doesn't wait for a transmit buffer to become available.
+ *
+ * \param stream    CAN stream
+ *
+ * \returns SC_DLL_ERROR_AGAIN if all transmit buffers are in flight.
+ *      The batch is kept, retry after sc_can_stream_tx_poll.
+ */
+SC_DLL_API int sc_can_stream_tx_batch_submit(sc_can_stream_t* stream);
+
+/** Reaps completed transmits
+ *
+ * \param stream        CAN stream
+ * \param timeout_ms    time to wait for the oldest transmit to complete
+ * \param pending       Output number of transmits still in flight, can be NULL
+ *
+ * \returns SC_DLL_ERROR_TIMEOUT if no transmit completed in time, else error code
+ */
+SC_DLL_API int sc_can_stream_tx_poll(sc_can_stream_t* stream, DWORD timeout_ms, unsigned* pending);
+
+/** Sets the number of transmit buffers
+ *
+ * Up to count - 1 transmits are in flight while the next
+ * batch is assembled. Call prior to the first transmit.
+ *
+ * \param stream    CAN stream
+ * \param count     number of buffers, 2..SC_STREAM_TX_MAX_BUFFERS,
+ *      pass 0 to use default.
+ *
+ * \returns error code
+ */
+SC_DLL_API int sc_can_stream_set_tx_buffers(sc_can_stream_t* stream, int count);
+
+/** Configures automatic flushing of transmit batches
+ *
+ * With automatic flushing on, batches are sent when the transmit
+ * buffer is full, when the batch reaches the byte threshold, or when
+ * the oldest message exceeds the latency budget. Batches stay open
+ * across calls to sc_can_stream_tx_batch_begin and need not be ended.
+ *
+ * The latency budget is checked when messages are added and by
+ * sc_can_stream_tx_flush_if_due.
+ *
+ * \param stream        CAN stream
+ * \param enable        non-zero to turn automatic flushing on
+ * \param bytes         byte threshold, 0 to disable
+ * \param latency_us    latency budget in microseconds, 0 to disable
+ *
+ * \returns error code
+ */
+SC_DLL_API int sc_can_stream_set_tx_auto_flush(
+    sc_can_stream_t* stream,
+    int enable,
+    uint16_t bytes,
+    uint32_t latency_us);
+
+/** Sends the current batch if its latency budget is exhausted
+ *
+ * \param stream        CAN stream
+ * \param timeout_ms    Output time until the current batch is due,
+ *      INFINITE if nothing is pending. Use as wait timeout.
+ *
+ * \returns error code
+ */
+SC_DLL_API int sc_can_stream_tx_flush_if_due(sc_can_stream_t* stream, DWORD* timeout_ms);
+
+/** Retrieves counters of sent batches by flush trigger
+ *
+ * \param stream        CAN stream
+ * \param stats         Output counters
+ *
+ * \returns error code
+ */
+SC_DLL_API int sc_can_stream_tx_flush_stats(sc_can_stream_t* stream, sc_stream_tx_flush_stats_t* stats);
+
+/** Retrieves stream counters and histograms
+ *
+ * Counters are cheap to maintain and always on. They accumulate
+ * from stream creation or the last reset. This function may be called
+ * from any thread, i.e. to periodically scrape the counters.
+ *
+ * \param stream        CAN stream
+ * \param stats         Output counters since the last reset, can be NULL
+ * \param reset         Non-zero to reset the counters after the snapshot
+ *
+ * \returns error code
+ */
+SC_DLL_API int sc_can_stream_stats(sc_can_stream_t* stream, sc_stream_stats_t* stats, int reset);
+
+/** Enables reassembly of messages that cross transfer boundaries
+ *
+ * Lets devices fill transfers completely instead of padding
+ * them with an end-of-input message. Disabled by default.
+ * Call before sc_can_stream_rx.
+ *
+ * \param stream        CAN stream
+ * \param enable        Non-zero to enable reassembly
+ *
+ * \returns error code
+ */
+SC_DLL_API int sc_can_stream_set_rx_reassembly(sc_can_stream_t* stream, int enable);
+
 /** Transmit a frame
  *
  * \param stream    CAN stream
@@ -155,6 +155,15 @@ enum sc_mm_flags {
      SC_MM_FLAG_GONE = 0x4,
 };
 
+enum sc_mm_client_flags {
+    /** The client is actively reading the RX ring
+      *
+      * While set, the server doesn't signal the RX event. Clients must
+      * clear the flag and check the ring once more before they wait.
+      */
+    SC_MM_CLIENT_FLAG_POLLING = 0x1,
+};
+
 struct sc_can_mm_header {
     /* Clients should atomically swap with 0 to get lost_* 
      * 
@@ -171,16 +180,196 @@ struct sc_can_mm_header {
     volatile uint32_t flags;            ///< flags
     volatile uint32_t log_lost;         ///< log messages lost
     volatile uint32_t generation;       ///< device generation, incremented each time the device is re-discovered
-    volatile uint32_t reserved1[6];     // reserved for now
+    volatile uint32_t client_flags;     ///< SC_MM_CLIENT_FLAG_*, written by the client (RX ring only)
+    volatile uint32_t formats;          ///< bitmask of supported formats (1 << SC_MM_FORMAT_*), 0 for older servers (RX ring only)
+    volatile uint32_t format;           ///< SC_MM_FORMAT_* of the ring data (RX ring only)
+    volatile uint32_t reserved1[3];     // reserved for now
     sc_can_mm_slot_t elements[0];
 };
 
+enum sc_mm_format {
+    SC_MM_FORMAT_FIXED,     ///< SC_MM_ELEMENT_SIZE byte slots (default)
+    SC_MM_FORMAT_VAR,       ///< variable length records, see sc_mm_var_header
+};
+
+enum sc_tx_sched {
+    SC_TX_SCHED_FIFO,       ///< devices take turns, frames in ring order (default)
+    SC_TX_SCHED_PRIO,       ///< frames in CAN ID priority order across devices
+};
+
+#define SC_MM_VAR_WORD_SIZE             8
+#define SC_MM_VAR_WORDS_PER_ELEMENT     (SC_MM_ELEMENT_SIZE / SC_MM_VAR_WORD_SIZE)
+
+/* Variable length RX ring format (SC_MM_FORMAT_VAR)
+ *
+ * The slot array is treated as an array of 64 bit words, the ring
+ * indices count words. The ring spans the largest power of two words
+ * that fit into the slot array, so index modulo ring size stays
+ * continuous when the indices wrap. Each record starts with a
+ * sc_mm_var_header and takes up a multiple of 8 bytes. Records never
+ * wrap. If a record doesn't fit into the words left before the end of
+ * the ring, the server fills them with a SC_MM_DATA_TYPE_NONE record
+ * and places the record at the start of the ring. Clients should skip
+ * records of unknown type.
+ *
+ * A classic CAN frame takes 24 bytes instead of SC_MM_ELEMENT_SIZE.
+ */
+struct sc_mm_var_header {
+    uint8_t type;
+    uint8_t words;              ///< size of the record in words, including the header
+};
+
+struct sc_mm_var_can_rx {
+    uint8_t type;
+    uint8_t words;
+    uint8_t dlc;
+    uint8_t flags;
+    uint32_t can_id;
+    uint64_t timestamp_us;
+    uint8_t data[0];            ///< dlc to length bytes, none for RTR frames
+};
+
+struct sc_mm_var_can_tx {
+    uint8_t type;
+    uint8_t words;
+    uint8_t dlc;
+    uint8_t flags;
+    uint8_t echo;               ///< TX echo (ignore track_id)
+    uint8_t reserved[3];
+    uint32_t track_id;
+    uint32_t can_id;
+    uint64_t timestamp_us;
+    uint8_t data[0];            ///< dlc to length bytes, none for RTR frames
+};
+
+struct sc_mm_var_can_status {
+    uint8_t type;
+    uint8_t words;
+    uint8_t flags;
+    uint8_t bus_status;
+    uint16_t rx_lost;
+    uint16_t tx_dropped;
+    uint64_t timestamp_us;
+    uint8_t rx_errors;
+    uint8_t tx_errors;
+    uint8_t rx_fifo_size;
+    uint8_t tx_fifo_size;
+    uint8_t reserved[4];
+};
+
+struct sc_mm_var_can_error {
+    uint8_t type;
+    uint8_t words;
+    uint8_t error;
+    uint8_t flags;
+    uint8_t reserved[4];
+    uint64_t timestamp_us;
+};
+
+struct sc_mm_var_log_data {
+    uint8_t type;
+    uint8_t words;
+    int8_t level;
+    uint8_t flags;
+    uint8_t bytes;
+    uint8_t src;
+    uint8_t reserved[2];
+    uint8_t data[0];            ///< UTF-8, bytes long
+};
+
+#define SC_MM_BC_CLIENTS 8
+
+/* Client part of the broadcast RX ring header
+ *
+ * The server places each client in its own cache line.
+ */
+struct sc_can_mm_bc_client {
+    /* Clients should atomically swap with 0 to get lost_*
+     *
+     * Counts messages overwritten before the client got to read them.
+     */
+    volatile uint32_t can_lost_rx;      ///< CAN RX frames lost
+    volatile uint32_t can_lost_status;  ///< CAN status messages lost
+    volatile uint32_t can_lost_tx;      ///< CAN TX receipt/echo messages lost
+    volatile uint32_t can_lost_error;   ///< CAN error messages lost
+    volatile uint32_t log_lost;         ///< log messages lost
+    volatile uint32_t get_index;        ///< client read cursor, must be advanced with compare and swap
+    volatile uint32_t client_flags;     ///< SC_MM_CLIENT_FLAG_*, written by the client
+    volatile uint32_t reserved[9];      // reserved for now
+};
+
+/* Broadcast RX ring
+ *
+ * The server writes each message once, all clients which opted into
+ * the broadcast ring read from it using their own cursor. The server
+ * never waits for clients. If a client falls behind by a full ring, the
+ * server moves the client's cursor ahead and accounts the skipped
+ * messages in the client's lost counters. A client that fails to
+ * advance its cursor must discard what it read.
+ *
+ * For TX messages, sc_mm_can_tx::echo is a bitmask of client indices,
+ * bit n is set if the message was sent by client n.
+ *
+ * Error, flags, and generation remain in the client's private RX ring header.
+ */
+struct sc_can_mm_bc_header {
+    volatile uint32_t put_index;        ///< not an index, need to be %'d
+    volatile uint32_t reserved[15];     // reserved for now
+    struct sc_can_mm_bc_client clients[SC_MM_BC_CLIENTS];
+    sc_can_mm_slot_t elements[0];
+};
+
+#define SC_MM_TX_LATENCY_BUCKETS 32
+
+/* TX latency histogram of one stage
+ *
+ * Bucket 0 counts zeros, bucket i > 0 counts latencies
+ * in [2^(i-1), 2^i) microseconds. The last bucket also
+ * counts all larger latencies.
+ */
+struct sc_mm_tx_latency_stage {
+    uint64_t max_us;
+    uint64_t sum_us;
+    uint64_t buckets[SC_MM_TX_LATENCY_BUCKETS];
+};
+
+/* TX latency statistics of a COM device
+ *
+ * Frames the COM device sent while tracing was on (ISuperCANDevice7::SetTxTracing)
+ * are accounted once the device reports them back.
+ *
+ * server: server took the frame off the TX ring -> USB submit returned
+ * device: USB submit returned -> frame on the bus (device TXR timestamp)
+ * total: server took the frame off the TX ring -> frame on the bus
+ *
+ * Bus times are device timestamps mapped to host time.
+ *
+ * The server updates the page under a sequence lock. Readers must
+ * retry if seq is odd or has changed after copying the page.
+ */
+struct sc_mm_tx_latency {
+    volatile uint32_t seq;
+    uint32_t reserved;
+    uint64_t frames;
+    struct sc_mm_tx_latency_stage server;
+    struct sc_mm_tx_latency_stage device;
+    struct sc_mm_tx_latency_stage total;
+};
+
 enum {
+    sc_static_assert_sizeof_sc_can_mm_bc_client_is_cache_line = sizeof(int[sizeof(struct sc_can_mm_bc_client) == 64 ? 1 : -1]),
     sc_static_assert_sizeof_sc_mm_can_rx_fits = sizeof(int[sizeof(struct sc_mm_can_rx) <= SC_MM_ELEMENT_SIZE ? 1 : -1]),
     sc_static_assert_sizeof_sc_mm_can_tx_fits = sizeof(int[sizeof(struct sc_mm_can_tx) == SC_MM_ELEMENT_SIZE ? 1 : -1]),
     sc_static_assert_sizeof_sc_mm_can_status_fits = sizeof(int[sizeof(struct sc_mm_can_status) <= SC_MM_ELEMENT_SIZE ? 1 : -1]),
     sc_static_assert_sizeof_sc_mm_can_error_fits = sizeof(int[sizeof(struct sc_mm_can_error) <= SC_MM_ELEMENT_SIZE ? 1 : -1]),
     sc_static_assert_sizeof_sc_mm_log_data_fits = sizeof(int[sizeof(struct sc_mm_log_data) == SC_MM_ELEMENT_SIZE ? 1 : -1]),
+    sc_static_assert_sizeof_sc_mm_element_is_whole_words = sizeof(int[SC_MM_ELEMENT_SIZE % SC_MM_VAR_WORD_SIZE == 0 ? 1 : -1]),
+    sc_static_assert_sizeof_sc_mm_var_can_rx = sizeof(int[sizeof(struct sc_mm_var_can_rx) == 16 ? 1 : -1]),
+    sc_static_assert_sizeof_sc_mm_var_can_tx = sizeof(int[sizeof(struct sc_mm_var_can_tx) == 24 ? 1 : -1]),
+    sc_static_assert_sizeof_sc_mm_var_can_status = sizeof(int[sizeof(struct sc_mm_var_can_status) == 24 ? 1 : -1]),
+    sc_static_assert_sizeof_sc_mm_var_can_error = sizeof(int[sizeof(struct sc_mm_var_can_error) == 16 ? 1 : -1]),
+    sc_static_assert_sizeof_sc_mm_var_log_data = sizeof(int[sizeof(struct sc_mm_var_log_data) == 8 ? 1 : -1]),
+    sc_static_assert_sizeof_sc_mm_tx_latency = sizeof(int[sizeof(struct sc_mm_tx_latency) == 832 ? 1 : -1]),
 };
 
 #ifdef __cplusplus
@@ -25,24 +25,4 @@
 
 #pragma once
 
-#include <stdint.h>
-
-#ifdef _MSC_VER
-#   pragma warning(push)
-#   pragma warning(disable: 4200)
-
-#   pragma pack(push, 1)
-#   define SC_PACKED
-
-#   include "supercan.h"
-
-#   pragma pack(pop)
-#   pragma warning(pop)
-#else
-#   ifdef __GNUC__
-#       define SC_PACKED __attribute__((packed))
-#       include "supercan.h"
-#   else
-#       error Unsupported compiler
-#   endif
-#endif
+#include "supercan_proto.h"
@@ -875,6 +875,9 @@ struct sc_exclusive : public sc_base
             goto cleanup;
         }
 
+        // messages split across transfers are completed by the stream
+        sc_can_stream_set_rx_reassembly(stream, 1);
+
         stream->user_handle = rx_event;
         receive_own_messages = config.receive_own_messages;
         fdf = config.fdf;
@@ -48,10 +48,10 @@ def main():
     # running from source or installer tree?
     if os.path.exists("supercan_dll.c"):
         # installer tree
-        sources.extend(["supercan_dll.c", "../src/can_bit_timing.c"])
+        sources.extend(["supercan_dll.c", "../src/can_bit_timing.c", "../src/supercan_rx.c", "../src/supercan_stream.c", "../src/supercan_cmd.c", "../src/supercan_log.c", "../src/usnprintf.c"])
         include_dirs.extend(["../src"])
     else:
-        sources.extend(["../dll/supercan_dll.c", "../../src/can_bit_timing.c"])
+        sources.extend(["../dll/supercan_dll.c", "../../src/can_bit_timing.c", "../../src/supercan_rx.c", "../../src/supercan_stream.c", "../../src/supercan_cmd.c", "../../src/supercan_log.c", "../../src/usnprintf.c"])
         include_dirs.extend(["../../src"])
 
     setup(
@@ -67,7 +67,7 @@ def main():
                 name="supercan",
                 sources=sources,
                 include_dirs=include_dirs,
-                define_macros=[("SC_STATIC", "1")],
+                define_macros=[("SC_STATIC", "1"), ("USNPRINTF_WITH_LONGLONG", "1")],
                 undef_macros=["NDEBUG"] if debug else [],
                 libraries=["winusb", "Cfgmgr32", "Ole32"],
             )
@@ -39,6 +39,15 @@
 #include "../inc/supercan_winapi.h"
 #include "../inc/supercan_srv.h"
 #include "../src/supercan_misc.h"
+#include "supercan_mm_ring.h"
+#include "supercan_mpsc_queue.h"
+#include "supercan_recorder.h"
+#include "supercan_cyclic.h"
+#include "supercan_filter.h"
+#include "supercan_track.h"
+#include "supercan_tx_prio.h"
+#include "supercan_tx_trace.h"
+#include "supercan_pool.h"
 
 
 #ifdef min
@@ -56,12 +65,24 @@ OBJECT_ENTRY_AUTO(CLSID_CSuperCAN, CSuperCAN)
 #include <cstdio>
 #include <atomic>
 #include <cstdarg>
+#include <mutex>
 
 
 #define CMD_TIMEOUT_MS 3000
 #define MAX_COM_DEVICES_PER_SC_DEVICE_BITS 3
 #define MAX_COM_DEVICES_PER_SC_DEVICE (1u<<MAX_COM_DEVICES_PER_SC_DEVICE_BITS)
 
+/* By default each device has dedicated RX and TX threads. Setting
+ * SUPERCAN_SRV_RX_WORKERS=n in the server's environment services the RX
+ * side of all devices on a shared pool of n workers instead. The workers
+ * run at the same priority as the dedicated threads.
+ * SUPERCAN_SRV_RX_AFFINITY optionally takes comma separated hex CPU masks,
+ * one per worker, e.g. 0x4,0x8.
+ */
+#define RX_POOL_WORKERS_ENV "SUPERCAN_SRV_RX_WORKERS"
+#define RX_POOL_AFFINITY_ENV "SUPERCAN_SRV_RX_AFFINITY"
+#define RX_POOL_MAX_WORKERS 64
+
 extern "C" int sc_map_cm_error(CONFIGRET cr);
 extern "C" int sc_map_win_error(sc_dev_t * _dev, DWORD error);
 
@@ -69,6 +90,7 @@ namespace
 {
 
 constexpr unsigned long CONFIG_ACCESS_TIMEOUT_MS = 1ul << 13;
+constexpr uint32_t TX_QUANTUM_DEFAULT = 32; // frames per client per TX pass
 typedef uint8_t sc_com_dev_index_t;
 
 inline int map_device_error(uint8_t error)
@@ -101,6 +123,97 @@ inline uint8_t dlc_to_len(uint8_t dlc)
 	return map[dlc & 0xf];
 }
 
+inline uint64_t qpc_to_us(uint64_t ticks, uint64_t freq)
+{
+	uint64_t const s = ticks / freq;
+
+	// split to avoid overflowing ticks * 10^6
+	return s * 1000000u + ((ticks - s * freq) * 1000000u) / freq;
+}
+
+static std::mutex s_RxPoolLock;
+static sc::worker_pool s_RxPool;
+static uint32_t s_RxPoolRefs;
+static uint32_t s_RxPoolNextHome;
+
+/* Returns the shared RX pool, started on first use.
+ *
+ * nullptr if the pool is off or failed to start, the device
+ * then falls back to a dedicated RX thread.
+ */
+static sc::worker_pool* RxPoolAcquire(uint32_t* home)
+{
+	char buffer[RX_POOL_MAX_WORKERS * 20];
+	uint64_t affinity[RX_POOL_MAX_WORKERS];
+	uint32_t workers = 0;
+	DWORD len = 0;
+	int error = SC_DLL_ERROR_NONE;
+
+	std::lock_guard<std::mutex> g(s_RxPoolLock);
+
+	if (!s_RxPoolRefs) {
+		len = GetEnvironmentVariableA(RX_POOL_WORKERS_ENV, buffer, sizeof(buffer));
+		if (!len || len >= sizeof(buffer)) {
+			return nullptr;
+		}
+
+		workers = strtoul(buffer, nullptr, 10);
+		if (!workers) {
+			return nullptr;
+		}
+
+		if (workers > RX_POOL_MAX_WORKERS) {
+			workers = RX_POOL_MAX_WORKERS;
+		}
+
+		memset(affinity, 0, sizeof(affinity));
+
+		len = GetEnvironmentVariableA(RX_POOL_AFFINITY_ENV, buffer, sizeof(buffer));
+		if (len && len < sizeof(buffer)) {
+			char* p = buffer;
+
+			for (uint32_t i = 0; i < workers; ++i) {
+				affinity[i] = _strtoui64(p, &p, 16);
+
+				if (',' != *p) {
+					break;
+				}
+
+				++p;
+			}
+		}
+
+		error = s_RxPool.start(workers, affinity);
+		if (error) {
+			LOG_SRV(SC_DLL_LOG_LEVEL_ERROR, "failed to start %u RX pool workers: %s (%d)\n", workers, sc_strerror(error), error);
+			return nullptr;
+		}
+
+		for (uint32_t i = 0; i < workers; ++i) {
+			// same as RxMain
+			SetThreadPriority(s_RxPool.native_handle(i), THREAD_PRIORITY_HIGHEST);
+		}
+
+		LOG_SRV(SC_DLL_LOG_LEVEL_INFO, "started %u RX pool workers\n", workers);
+	}
+
+	++s_RxPoolRefs;
+	*home = s_RxPoolNextHome++;
+
+	return &s_RxPool;
+}
+
+static void RxPoolRelease()
+{
+	std::lock_guard<std::mutex> g(s_RxPoolLock);
+
+	assert(s_RxPoolRefs);
+
+	if (!--s_RxPoolRefs) {
+		s_RxPool.stop();
+	}
+}
+
 class ATL_NO_VTABLE XSuperCANDevice;
 
 class Guard
@@ -132,6 +245,9 @@ struct sc_mm_data {
 struct com_device_data {
 	sc_mm_data rx;
 	sc_mm_data tx;
+	sc_mm_data bc_rx; // shared by all COM devices, event is rx's
+	sc_mm_data stats; // TX latency page, no event
+	sc_mm_data log; // opt-in log ring, event is rx's
 };
 
 class ScDev : public std::enable_shared_from_this<ScDev>
@@ -148,9 +264,23 @@ public:
 	void ReleaseConfigurationAccess(sc_com_dev_index_t index);
 	int SetBus(sc_com_dev_index_t index, bool on);
 	int SetLogLevel(sc_com_dev_index_t index, int level);
+	int SetLogQueueSize(sc_com_dev_index_t index, uint32_t entries);
+	int EnableLogRing(sc_com_dev_index_t index);
+	int SetTxQuantum(sc_com_dev_index_t index, uint32_t frames);
+	int SetTxScheduling(sc_com_dev_index_t index, uint32_t mode);
+	int StartRecording(sc_com_dev_index_t index, wchar_t const* path);
+	int StopRecording(sc_com_dev_index_t index);
+	int AddCyclicTx(sc_com_dev_index_t index, sc::cyclic_tx_def const* def, uint32_t* handle);
+	int RemoveCyclicTx(sc_com_dev_index_t index, uint32_t handle);
+	int SetCyclicTxTick(sc_com_dev_index_t index, uint32_t tick_us);
+	int SetTxTracing(sc_com_dev_index_t index, bool on);
+	int GetTxLatency(sc_com_dev_index_t index, sc_mm_tx_latency* latency);
 	int SetFeatureFlags(sc_com_dev_index_t index, uint32_t flags);
 	int SetNominalBitTiming(sc_com_dev_index_t index, SuperCANBitTimingParams params);
 	int SetDataBitTiming(sc_com_dev_index_t index, SuperCANBitTimingParams params);
+	int EnableRxBroadcast(sc_com_dev_index_t index);
+	int SetFilters(sc_com_dev_index_t index, sc_filter_rule const* rules, size_t count);
+	int SetRxFormat(sc_com_dev_index_t index, uint32_t format);
 
 public:
 	const std::wstring& name() const { return m_Name; }
@@ -171,24 +301,35 @@ private:
 	int OpenDevice();
 	void CloseDevice();
 	void SetDeviceError(int error);
-	int SetBusOn();
+	int SetBusOn(bool bus_off);
 	void SetBusOff();
 	void BusCleanup();
+	int StartWorkers();
+	void StopWorkers();
 	bool VerifyConfigurationAccess(sc_com_dev_index_t index) const;
 	void ComDeviceAddedTx(sc_com_dev_index_t index);
 	void ComDeviceRemovedTx(sc_com_dev_index_t index);
 	void ComDeviceRemovedRx(sc_com_dev_index_t index);
+	void ComDeviceBroadcastRx(sc_com_dev_index_t index);
+	void ComDeviceRxFormat(sc_com_dev_index_t index, uint8_t format);
+	void ComDeviceLogRing(sc_com_dev_index_t index);
 	void Notify(uint8_t code, uint8_t value);
+	bool RxRunning() const { return m_RxThread || m_RxPool; }
+	static void RxRun(void* self);
+	void RxRun();
+	void RxArm();
+	static void CALLBACK OnRxWait(PTP_CALLBACK_INSTANCE instance, void* self, PTP_WAIT wait, TP_WAIT_RESULT result);
 	void ProcessRxNotification(bool* done, bool* performed_work);
 	void ProcessLog(bool* performed_work);
 	void ProcessRxStream(bool* stream_error, bool* performed_work);
+	void WakeRxClients();
 	void ResetTxrMap();
+	void ResetTxLatency();
+	void TraceDeviceTime(uint64_t ts_us);
+	void WakeCyclicTx();
 	void LogFormatQueue(int level, char const* fmt, ...);
 	void LogFormatDirect(int level, char const* fmt, ...);
-	int Cmd(uint16_t size);
-	int SetFeatureFlags();
-	int SetNominalBitTiming();
-	int SetDataBitTiming();
+	int Configure(bool bus_off);
 	static DWORD WINAPI OnDeviceNotification(
 		HCMNOTIFICATION hNotify,
 		PVOID Context,
@@ -204,17 +345,36 @@ private:
 		HANDLE file;
 		HANDLE ev;
 		sc_can_mm_header* hdr;
-		uint32_t index;
 	};
 
 	struct com_device_txr_data {
 		std::atomic<uint32_t> index;
 	};
 
+	struct tx_trace_data {
+		uint64_t dequeue_us; // TX thread, published along with m_TxrMap
+		std::atomic<uint64_t> submit_us; // TX thread once the USB submit returned, 0 until then
+	};
+
 	struct com_device_data_private {
 		com_device_mm_data_private rx;
 		com_device_mm_data_private tx;
+		sc::mm::ring_producer rx_ring;
+		sc::mm::var_ring_producer rx_var_ring;
+		sc::mm::ring_consumer tx_ring;
 		XSuperCANDevice* com_device;
+		sc_filter_t filters[2]; // RX thread uses filters[filter_index]
+		uint8_t filter_index;
+		bool rx_broadcast; // reads from broadcast ring
+		uint8_t rx_format; // SC_MM_FORMAT_*, selects rx_ring or rx_var_ring
+		uint8_t rx_format_next; // passed to RX thread along with NOTIFICATION_FORMAT
+		uint32_t tx_sent; // frames sent, TX thread
+		std::atomic<uint32_t> tx_done; // frames reported back by the device, RX thread
+		HANDLE stats_file;
+		sc_mm_tx_latency* tx_latency; // written by RX thread
+		HANDLE log_file;
+		sc::mm::ring_producer log_ring;
+		bool rx_log_ring; // logs go to log_ring instead of the RX ring, RX thread
 	};
 
 	enum {
@@ -223,10 +383,30 @@ private:
 		NOTIFICATION_SET,
 		NOTIFICATION_ADD,
 		NOTIFICATION_REMOVE,
+		NOTIFICATION_BROADCAST,
+		NOTIFICATION_FILTER,
+		NOTIFICATION_FORMAT,
+		NOTIFICATION_BUS_OFF,
+		NOTIFICATION_RECORD,
+		NOTIFICATION_TRACE,
+		NOTIFICATION_LOG_RING,
+		NOTIFICATION_LOG_QUEUE,
+	};
+
+	enum {
+		LOG_BUFFER_SIZE = 116,
+		LOG_SLOTS_PER_ENTRY = (LOG_BUFFER_SIZE + SC_LOG_DATA_BUFFER_SIZE - 1) / SC_LOG_DATA_BUFFER_SIZE,
+		LOG_BATCH_SIZE = 32, // entries fanned out at once
+		LOG_QUEUE_SIZE_DEFAULT = 256,
+		LOG_RING_SIZE_DEFAULT = 256,
+		LOG_RESERVE_DIVISOR = 4, // logs leave 1/LOG_RESERVE_DIVISOR of CAN data rings free
 	};
 
 	enum {
-		LOG_BUFFER_SIZE = 116
+		RX_WAIT_NOTIFICATION,
+		RX_WAIT_STREAM,
+		RX_WAIT_LOG,
+		RX_WAIT_COUNT
 	};
 
 	struct log_entry {
@@ -240,6 +420,10 @@ private:
 
 private:
 	void StoreLogMessage(log_entry const * const e);
+	static uint32_t ChunkLogMessage(log_entry const * const e, sc_can_mm_slot_t* slots);
+	void StoreLogSlots(sc_can_mm_slot_t const* slots, uint32_t count);
+	template<typename A, typename F>
+	void StoreRx(volatile uint32_t sc_can_mm_header::* lost, A&& accept, F&& fill);
 
 private:
 	std::wstring m_Name;
@@ -256,17 +440,29 @@ private:
 	HANDLE m_TxThreadNotificationEvent;
 	HANDLE m_RxThread;
 	HANDLE m_TxThread;
-	HANDLE m_TxFifoAvailable;
+	sc::worker_pool* m_RxPool; // shared RX pool, nullptr if RX runs on m_RxThread
+	sc::pool_task m_RxTask; // runs RxRun on m_RxPool
+	PTP_WAIT m_RxWaits[RX_WAIT_COUNT]; // post m_RxTask once signaled
+	HANDLE m_RxDone; // signaled by RxRun on NOTIFICATION_SHUTDOWN, non-null once m_RxTask was posted
+	HANDLE m_TxFifoAvailable; // signaled when m_TrackIds wakes the TX thread
+	HANDLE m_TxCyclicEvent; // signaled on m_Cyclic changes
+	HANDLE m_TxCyclicTimer; // armed by the TX thread for the next m_Cyclic tick
 	HANDLE m_LogEvent;
 	CRITICAL_SECTION m_Lock;
-	CRITICAL_SECTION m_LogLock;
 	com_device_data m_ComDeviceData[MAX_COM_DEVICES_PER_SC_DEVICE];
 	com_device_data_private m_ComDeviceDataPrivate[MAX_COM_DEVICES_PER_SC_DEVICE];
+	HANDLE m_BcFile;
+	sc::mm::bc_ring_producer m_BcRing;
 	sc_com_dev_index_t m_ConfigurationAccessIndex;
-	com_device_txr_data m_TxrMap[256];
-	sc_mm_can_tx m_TxEchoMap[256];
+	com_device_txr_data m_TxrMap[SC_TRACK_IDS];
+	sc_track_ids_t m_TrackIds; // one id per TX FIFO entry, allocated by TX thread, freed by RX thread
+	sc_mm_can_tx m_TxEchoMap[SC_TRACK_IDS];
+	tx_trace_data m_TxTrace[SC_TRACK_IDS]; // parallel to m_TxEchoMap
 	DWORD m_ConfigurationAccessClaimed;
 	std::atomic_int m_LogLevel;
+	std::atomic<uint32_t> m_TxQuantum; // max frames per client per TX pass
+	std::atomic<uint8_t> m_TxScheduling; // SC_TX_SCHED_*
+	uint32_t m_TxFifoSize;
 	std::atomic<uint8_t> m_RxThreadNotificationCode;
 	std::atomic<uint8_t> m_TxThreadNotificationCode;
 	std::atomic<uint8_t> m_RxThreadNotificationValue;
@@ -276,12 +472,25 @@ private:
 	bool m_Opened;
 	bool m_OnBus;
 	bool m_Gone;
+	bool m_RxThreadOnBus; // RX thread only, messages are dropped while off bus
+	bool m_RxStreamError; // RxRun only
+	bool m_RxStopped; // RxRun only, set on NOTIFICATION_SHUTDOWN
+	std::atomic<bool> m_WorkerError; // set by SetDeviceError, workers are restarted on the next bus on
+	bool m_RxThreadRecording; // RX thread only while workers run, feeds m_Recorder
+	bool m_Tracing; // TX latency tracing, see SetTxTracing
+	bool m_RxThreadTracing; // RX thread only while workers run
+	sc_dev_clock_t m_RxThreadClock; // maps device timestamps to host time while tracing
+	uint64_t m_RxThreadHostUs; // host time of the current sc_can_stream_rx call while tracing
+	uint64_t m_QpcFrequency;
+	sc::recorder m_Recorder;
+	sc::record_file_sink m_RecordSink;
+	sc::cyclic_tx m_Cyclic; // scheduled by TX thread
 	sc_com_dev_index_t m_RxThreadLiveComDevBuffer[MAX_COM_DEVICES_PER_SC_DEVICE];
 	sc_com_dev_index_t m_RxThreadLiveComDevCount;
-	uint32_t m_LogLost;
-	unsigned m_LogRingGetIndex; // full range
-	unsigned m_LogRingPutIndex; // full range
-	log_entry m_LogRingBuffer[64];
+	sc::mpsc_queue<log_entry> m_LogQueue; // filled by any thread, drained by the RX thread
+	std::atomic<uint32_t> m_LogLost; // entries that found m_LogQueue full
+	uint32_t m_LogQueueSizeNext; // passed to RX thread along with NOTIFICATION_LOG_QUEUE
+	sc_can_mm_slot_t m_RxThreadLogSlots[LOG_BATCH_SIZE * LOG_SLOTS_PER_ENTRY];
 };
 
 using ScDevPtr = std::shared_ptr<ScDev>;
@@ -294,13 +503,17 @@ using ScDevPtr = std::shared_ptr<ScDev>;
 
 class ATL_NO_VTABLE XSuperCANDevice :
 	public ATL::CComObjectRoot, // need lock for ScDev
-	public ISuperCANDevice3
+	public ISuperCANDevice7
 {
 public:
 	BEGIN_COM_MAP(XSuperCANDevice)
 		COM_INTERFACE_ENTRY(ISuperCANDevice)
 		COM_INTERFACE_ENTRY(ISuperCANDevice2)
 		COM_INTERFACE_ENTRY(ISuperCANDevice3)
+		COM_INTERFACE_ENTRY(ISuperCANDevice4)
+		COM_INTERFACE_ENTRY(ISuperCANDevice5)
+		COM_INTERFACE_ENTRY(ISuperCANDevice6)
+		COM_INTERFACE_ENTRY(ISuperCANDevice7)
 	END_COM_MAP()
 public:
 	~XSuperCANDevice();
@@ -319,6 +532,21 @@ public:
 	STDMETHOD(GetDeviceData)(SuperCANDeviceData* data);
 	STDMETHOD(SetLogLevel)(int level);
 	STDMETHOD(GetDeviceData2)(SuperCANDeviceData2* data);
+	STDMETHOD(GetBroadcastRingBufferMapping)(SuperCANRingBufferMapping* rx, unsigned char* index);
+	STDMETHOD(AddFilter)(SuperCANFilter filter);
+	STDMETHOD(ApplyFilters)();
+	STDMETHOD(SetRxRingFormat)(unsigned long format);
+	STDMETHOD(SetTxQuantum)(unsigned long frames);
+	STDMETHOD(SetTxScheduling)(unsigned long mode);
+	STDMETHOD(StartRecording)(BSTR path);
+	STDMETHOD(StopRecording)();
+	STDMETHOD(AddCyclicTx)(SuperCANCyclicTx* def, unsigned long* handle);
+	STDMETHOD(RemoveCyclicTx)(unsigned long handle);
+	STDMETHOD(SetCyclicTxTick)(unsigned long tick_us);
+	STDMETHOD(SetTxTracing)(boolean on);
+	STDMETHOD(GetTxLatency)(SuperCANTxLatency* latency);
+	STDMETHOD(SetLogQueueSize)(unsigned long entries);
+	STDMETHOD(GetLogRingBufferMapping)(SuperCANRingBufferMapping* log);
 	void Init(const ScDevPtr& dev, sc_com_dev_index_t index, com_device_data* mm);
 	void SetSuperCAN(ISuperCAN2* sc);
 
@@ -326,6 +554,7 @@ private:
 	ScDevPtr m_SharedDevice;
 	ISuperCAN2* m_Sc;
 	com_device_data* m_Mm;
+	std::vector<sc_filter_rule> m_FilterRules; // staged by AddFilter
 	sc_com_dev_index_t m_Index;
 };
 
@@ -382,8 +611,12 @@ ScDev::~ScDev()
 {
 	Uninit();
 
+	for (sc_com_dev_index_t i = 0; i < _countof(m_ComDeviceDataPrivate); ++i) {
+		sc_filter_uninit(&m_ComDeviceDataPrivate[i].filters[0]);
+		sc_filter_uninit(&m_ComDeviceDataPrivate[i].filters[1]);
+	}
+
 	DeleteCriticalSection(&m_Lock);
-	DeleteCriticalSection(&m_LogLock);
 
 	if (m_LogEvent) {
 		CloseHandle(m_LogEvent);
@@ -397,8 +630,14 @@ ScDev::ScDev()
 	ZeroMemory(&m_CmdCtx, sizeof(m_CmdCtx));
 	m_RxThread = nullptr;
 	m_TxThread = nullptr;
+	m_RxPool = nullptr;
+	m_RxTask.run = &ScDev::RxRun;
+	m_RxTask.ctx = this;
+	ZeroMemory(m_RxWaits, sizeof(m_RxWaits));
+	m_RxDone = nullptr;
+	m_RxStreamError = false;
+	m_RxStopped = false;
 	InitializeCriticalSection(&m_Lock);
-	InitializeCriticalSection(&m_LogLock);
 	m_LogEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
 	
 	
@@ -411,6 +650,11 @@ ScDev::ScDev()
 
 	ZeroMemory(m_ComDeviceData, sizeof(m_ComDeviceData));
 	ZeroMemory(m_ComDeviceDataPrivate, sizeof(m_ComDeviceDataPrivate));
+
+	for (sc_com_dev_index_t i = 0; i < _countof(m_ComDeviceDataPrivate); ++i) {
+		sc_filter_init(&m_ComDeviceDataPrivate[i].filters[0]);
+		sc_filter_init(&m_ComDeviceDataPrivate[i].filters[1]);
+	}
 	
 	/* Create a unique id for this device.
 	 * We could, of course, also use Windows USB device name
@@ -440,27 +684,56 @@ ScDev::ScDev()
 		_snwprintf_s(data->rx.ev_name, _countof(data->rx.ev_name), _TRUNCATE, L"Local\\sc-i%s-com%u-rx-ev", guid_str, i);
 		_snwprintf_s(data->tx.mem_name, _countof(data->tx.mem_name), _TRUNCATE, L"Local\\sc-i%s-com%u-tx-mem", guid_str, i);
 		_snwprintf_s(data->tx.ev_name, _countof(data->tx.ev_name), _TRUNCATE, L"Local\\sc-i%s-com%u-tx-ev", guid_str, i);
+		_snwprintf_s(data->bc_rx.mem_name, _countof(data->bc_rx.mem_name), _TRUNCATE, L"Local\\sc-i%s-bc-rx-mem", guid_str);
+		wcscpy_s(data->bc_rx.ev_name, _countof(data->bc_rx.ev_name), data->rx.ev_name);
+		_snwprintf_s(data->stats.mem_name, _countof(data->stats.mem_name), _TRUNCATE, L"Local\\sc-i%s-com%u-stats-mem", guid_str, i);
+		_snwprintf_s(data->log.mem_name, _countof(data->log.mem_name), _TRUNCATE, L"Local\\sc-i%s-com%u-log-mem", guid_str, i);
+		wcscpy_s(data->log.ev_name, _countof(data->log.ev_name), data->rx.ev_name);
 		data->rx.elements = 1u<<16;
 		data->tx.elements = 1u<<16;
+		data->bc_rx.elements = 1u<<16;
+		data->log.elements = LOG_RING_SIZE_DEFAULT;
 	}
 
+	m_BcFile = nullptr;
+
 	m_TxFifoAvailable = nullptr;
+	m_TxCyclicEvent = nullptr;
+	m_TxCyclicTimer = nullptr;
 	m_ThreadNotificationAcknowledgeCount = nullptr;
 	m_RxThreadNotificationEvent = nullptr;
 	m_TxThreadNotificationEvent = nullptr;
+	m_RxThreadOnBus = false;
+	m_WorkerError = false;
+	m_RxThreadRecording = false;
+	m_Tracing = false;
+	m_RxThreadTracing = false;
+	sc_dc_init(&m_RxThreadClock);
+	m_RxThreadHostUs = 0;
+	m_QpcFrequency = 1;
+	QueryPerformanceFrequency((LARGE_INTEGER*)&m_QpcFrequency);
 	m_ConfigurationAccessClaimed = 0;
 	ZeroMemory(&m_TimeTracker, sizeof(m_TimeTracker));
 	m_Mapped = false;
 	m_Initialized = false;
 	ZeroMemory(m_TxEchoMap, sizeof(m_TxEchoMap));
+
+	for (size_t i = 0; i < _countof(m_TxTrace); ++i) {
+		m_TxTrace[i].dequeue_us = 0;
+		m_TxTrace[i].submit_us.store(0, std::memory_order_relaxed);
+	}
+
 	m_RxThreadLiveComDevCount = 0;
 	ZeroMemory(m_RxThreadLiveComDevBuffer, sizeof(m_RxThreadLiveComDevBuffer));
 	ResetTxrMap();
+	sc_track_ids_init(&m_TrackIds, 0);
 	m_LogLevel = SC_DLL_LOG_LEVEL_OFF;
-	m_LogRingGetIndex = 0;
-	m_LogRingPutIndex = 0;
+	m_TxQuantum = TX_QUANTUM_DEFAULT;
+	m_TxScheduling = SC_TX_SCHED_FIFO;
+	m_TxFifoSize = 0;
+	m_LogQueue.init(LOG_QUEUE_SIZE_DEFAULT); // on failure all entries count as lost
 	m_LogLost = 0;
-	ZeroMemory(m_LogRingBuffer, sizeof(m_LogRingBuffer));
+	m_LogQueueSizeNext = LOG_QUEUE_SIZE_DEFAULT;
 	m_OnBus = false;
 	m_Opened = false;
 	m_Gone = false;
@@ -563,9 +836,94 @@ void ScDev::ReleaseConfigurationAccess(sc_com_dev_index_t index)
 	}
 }
 
-void ScDev::StoreLogMessage(log_entry const * const e)
+/* Stores a message in the private RX ring of each live COM device and
+ * once in the broadcast ring if any COM device reads from it.
+ *
+ * For private rings in SC_MM_FORMAT_VAR the message is filled into a
+ * temporary slot and then encoded into the ring.
+ *
+ * accept is invoked with the COM device's filter. Broadcast ring clients
+ * receive messages accepted by any of their filters.
+ *
+ * fill is invoked with the slot and the COM device index, or
+ * MAX_COM_DEVICES_PER_SC_DEVICE for the broadcast ring.
+ */
+template<typename A, typename F>
+void ScDev::StoreRx(volatile uint32_t sc_can_mm_header::* lost, A&& accept, F&& fill)
 {
-	for (size_t offset = 0; offset < e->bytes; ) {
+	bool broadcast = false;
+
+	for (sc_com_dev_index_t i = 0; i < m_RxThreadLiveComDevCount; ++i) {
+		auto com_dev_index = m_RxThreadLiveComDevBuffer[i];
+		auto* priv = &m_ComDeviceDataPrivate[com_dev_index];
+		uint32_t available = 0;
+
+		if (!accept(&priv->filters[priv->filter_index])) {
+			continue;
+		}
+
+		if (priv->rx_broadcast) {
+			broadcast = true;
+			continue;
+		}
+
+		if (SC_MM_FORMAT_VAR == priv->rx_format) {
+			sc_can_mm_slot_t slot;
+
+			fill(&slot, com_dev_index);
+
+			switch (priv->rx_var_ring.push(&slot)) {
+			case SC_DLL_ERROR_NONE:
+				break;
+			case SC_DLL_ERROR_AGAIN:
+				InterlockedIncrement(&(priv->rx.hdr->*lost));
+				priv->rx_var_ring.notify();
+				break;
+			default:
+				// rogue client
+				break;
+			}
+		}
+		else if (priv->rx_ring.writable(&available)) {
+			// rogue client
+		}
+		else if (!available) {
+			InterlockedIncrement(&(priv->rx.hdr->*lost));
+			priv->rx_ring.notify();
+		}
+		else {
+			fill(priv->rx_ring.slot(), com_dev_index);
+			priv->rx_ring.commit();
+		}
+	}
+
+	if (broadcast) {
+		fill(m_BcRing.claim(), static_cast<sc_com_dev_index_t>(MAX_COM_DEVICES_PER_SC_DEVICE));
+		m_BcRing.commit();
+	}
+
+	if (m_RxThreadRecording) {
+		sc_can_mm_slot_t slot;
+
+		// unfiltered, TX echo carries the sender's bit like the broadcast ring
+		fill(&slot, static_cast<sc_com_dev_index_t>(MAX_COM_DEVICES_PER_SC_DEVICE));
+		m_Recorder.record(&slot);
+	}
+}
+
+// filters apply to CAN frames only
+static inline int AcceptAll(sc_filter_t const*)
+{
+	return 1;
+}
+
+/* Splits the entry into log data slots, returns the number of slots (at most LOG_SLOTS_PER_ENTRY) */
+uint32_t ScDev::ChunkLogMessage(log_entry const * const e, sc_can_mm_slot_t* slots)
+{
+	uint32_t index = 0;
+
+	for (size_t offset = 0; offset < e->bytes; ++index) {
+		sc_can_mm_slot_t* slot = &slots[index];
 		uint8_t count = 0;
 		uint8_t flags = 0;
 
@@ -577,42 +935,125 @@ void ScDev::StoreLogMessage(log_entry const * const e)
 			count = static_cast<uint8_t>(e->bytes - offset);
 		}
 
-		for (sc_com_dev_index_t i = 0; i < m_RxThreadLiveComDevCount; ++i) {
-			auto com_dev_index = m_RxThreadLiveComDevBuffer[i];
-			auto* data = &m_ComDeviceData[com_dev_index];
-			auto* priv = &m_ComDeviceDataPrivate[com_dev_index];
-			auto gi = priv->rx.hdr->get_index;
-			auto pi = priv->rx.hdr->put_index;
-			auto used = pi - gi;
+		slot->log_data.type = SC_MM_DATA_TYPE_LOG_DATA;
+		slot->log_data.level = e->level;
+		slot->log_data.src = e->src;
+		//slot->log_data.timestamp_qpc = e->timestamp_qpc;
+		slot->log_data.flags = flags;
+		slot->log_data.bytes = count;
+		memcpy(slot->log_data.data, e->data + offset, count);
 
-			if (pi != priv->rx.index || used > data->rx.elements) {
-				// rogue client
+		offset += count;
+	}
+
+	return index;
+}
+
+void ScDev::StoreLogMessage(log_entry const * const e)
+{
+	sc_can_mm_slot_t slots[LOG_SLOTS_PER_ENTRY];
+
+	StoreLogSlots(slots, ChunkLogMessage(e, slots));
+}
+
+/* Fans log data slots out to the COM devices.
+ *
+ * Logs must never displace CAN data. They go into a COM device's RX ring
+ * or the broadcast ring only while 1/LOG_RESERVE_DIVISOR of the ring stays
+ * free, slots that don't fit count as lost. COM devices that have a log
+ * ring (see EnableLogRing) receive logs there only.
+ */
+void ScDev::StoreLogSlots(sc_can_mm_slot_t const* slots, uint32_t count)
+{
+	uint32_t bc_clients = 0;
+
+	for (sc_com_dev_index_t i = 0; i < m_RxThreadLiveComDevCount; ++i) {
+		auto com_dev_index = m_RxThreadLiveComDevBuffer[i];
+		auto* priv = &m_ComDeviceDataPrivate[com_dev_index];
+		volatile uint32_t* lost = &priv->rx.hdr->log_lost;
+		uint32_t stored = 0;
+		uint32_t available = 0;
+
+		if (priv->rx_log_ring) {
+			if (priv->log_ring.push(slots, count, &stored)) {
+				continue; // rogue client
 			}
-			else if (used == data->rx.elements) { // just be safe, could be a rogue client
-				InterlockedIncrement(&priv->rx.hdr->log_lost);
-				SetEvent(priv->rx.ev);
+
+			if (stored < count) {
+				lost = &priv->log_ring.header()->log_lost;
+				priv->log_ring.notify();
 			}
-			else {
-				uint32_t index = priv->rx.index % data->rx.elements;
-				sc_can_mm_slot_t* slot = &priv->rx.hdr->elements[index];
+		}
+		else if (priv->rx_broadcast) {
+			bc_clients |= UINT32_C(1) << com_dev_index;
+			continue;
+		}
+		else if (SC_MM_FORMAT_VAR == priv->rx_format) {
+			if (priv->rx_var_ring.writable(&available)) {
+				continue; // rogue client
+			}
+
+			uint32_t const reserve = priv->rx_var_ring.words() / LOG_RESERVE_DIVISOR;
 
-				slot->log_data.type = SC_MM_DATA_TYPE_LOG_DATA;
-				slot->log_data.level = e->level;
-				slot->log_data.src = e->src;
-				//slot->log_data.timestamp_qpc = e->timestamp_qpc;
-				slot->log_data.flags = flags;
-				slot->log_data.bytes = count;
-				memcpy(slot->log_data.data, e->data + offset, count);
+			for (; stored < count; ++stored) {
+				// padding at the end of the ring may take more, push has the final say
+				uint32_t const words = sc::mm::var_words(&slots[stored]);
 
-				++priv->rx.index;
+				if (available < reserve + words || priv->rx_var_ring.push(&slots[stored])) {
+					break;
+				}
 
-				priv->rx.hdr->put_index = priv->rx.index;
+				available -= words;
+			}
 
-				SetEvent(priv->rx.ev);
+			if (stored < count) {
+				priv->rx_var_ring.notify();
 			}
 		}
+		else {
+			if (priv->rx_ring.writable(&available)) {
+				continue; // rogue client
+			}
 
-		offset += count;
+			uint32_t const reserve = priv->rx_ring.elements() / LOG_RESERVE_DIVISOR;
+			uint32_t const room = available > reserve ? available - reserve : 0;
+
+			priv->rx_ring.push(slots, std::min(count, room), &stored);
+
+			if (stored < count) {
+				priv->rx_ring.notify();
+			}
+		}
+
+		if (stored < count) {
+			InterlockedAdd((volatile LONG*)lost, (LONG)(count - stored));
+		}
+	}
+
+	if (bc_clients) {
+		uint32_t const reserve = m_BcRing.elements() / LOG_RESERVE_DIVISOR;
+		uint32_t const backlog = m_BcRing.backlog();
+		uint32_t const room = m_BcRing.elements() - backlog > reserve ? m_BcRing.elements() - backlog - reserve : 0;
+		uint32_t const stored = std::min(count, room);
+
+		for (uint32_t i = 0; i < stored; ++i) {
+			*m_BcRing.claim() = slots[i];
+			m_BcRing.commit();
+		}
+
+		if (stored < count) {
+			for (uint8_t i = 0; bc_clients; ++i, bc_clients >>= 1) {
+				if (bc_clients & 1) {
+					InterlockedAdd((volatile LONG*)&m_BcRing.client(i)->log_lost, (LONG)(count - stored));
+				}
+			}
+		}
+	}
+
+	if (m_RxThreadRecording) {
+		for (uint32_t i = 0; i < count; ++i) {
+			m_Recorder.record(&slots[i]);
+		}
 	}
 }
 
@@ -627,8 +1068,6 @@ int ScDev::SetLogLevel(sc_com_dev_index_t index, int level)
 		return SC_DLL_ERROR_ACCESS_DENIED;
 	}
 
-	Guard g2(m_LogLock);
-
 	m_LogLevel = level;
 
 	sc_dev_log_set_level(m_Device, level);
@@ -636,151 +1075,481 @@ int ScDev::SetLogLevel(sc_com_dev_index_t index, int level)
 	return SC_DLL_ERROR_NONE;;
 }
 
-int ScDev::SetFeatureFlags(sc_com_dev_index_t index, uint32_t flags)
+/* Resizes the queue log messages wait in for the RX thread, see ISuperCANDevice7::SetLogQueueSize */
+int ScDev::SetLogQueueSize(sc_com_dev_index_t index, uint32_t entries)
 {
 	assert(m_Initialized);
 
+	if (!entries || entries > decltype(m_LogQueue)::MAX_CAPACITY) {
+		return SC_DLL_ERROR_INVALID_PARAM;
+	}
+
+	uint32_t size = 1;
+
+	while (size < entries) {
+		size <<= 1;
+	}
+
 	Guard g(m_Lock);
 
 	if (!VerifyConfigurationAccess(index)) {
 		return SC_DLL_ERROR_ACCESS_DENIED;
 	}
 
-	flags &= ~SC_FEATURE_FLAG_TXR;
+	if (size == m_LogQueue.capacity()) {
+		return SC_DLL_ERROR_NONE;
+	}
 
-	if ((flags & (dev_info.feat_conf | dev_info.feat_perm)) != flags) {
-		return SC_DLL_ERROR_INVALID_PARAM;
+	m_LogQueueSizeNext = size;
+
+	if (RxRunning()) {
+		Notify(NOTIFICATION_LOG_QUEUE, 0);
+	}
+	else {
+		uint32_t dropped = 0;
+
+		m_LogQueue.resize(size, &dropped);
+		m_LogLost += dropped;
 	}
 
-	m_FeatureFlags = flags | SC_FEATURE_FLAG_TXR;
+	// resize leaves the queue as is on error
+	if (size != m_LogQueue.capacity()) {
+		return SC_DLL_ERROR_OUT_OF_MEM;
+	}
 
 	return SC_DLL_ERROR_NONE;
 }
 
-int ScDev::SetFeatureFlags()
+int ScDev::SetTxQuantum(sc_com_dev_index_t index, uint32_t frames)
 {
-	
-	sc_msg_features* feat = reinterpret_cast<sc_msg_features*>(m_CmdCtx.tx_buffer);
-	feat->id = SC_MSG_FEATURES;
-	feat->op = SC_FEAT_OP_CLEAR;
-	feat->len = sizeof(*feat);
-	feat->arg = 0;
+	assert(m_Initialized);
 
-	auto error = Cmd(feat->len);
+	if (!frames) {
+		return SC_DLL_ERROR_INVALID_PARAM;
+	}
 
-	if (SC_DLL_ERROR_NONE != error) {
-		return error;
+	Guard g(m_Lock);
+
+	if (!VerifyConfigurationAccess(index)) {
+		return SC_DLL_ERROR_ACCESS_DENIED;
 	}
 
-	feat->op = SC_FEAT_OP_OR;
-	feat->arg = m_Device->dev_to_host32(m_FeatureFlags);
+	m_TxQuantum.store(frames, std::memory_order_relaxed);
 
-	return Cmd(feat->len);
+	return SC_DLL_ERROR_NONE;
 }
 
-int ScDev::SetNominalBitTiming(sc_com_dev_index_t index, SuperCANBitTimingParams params)
+int ScDev::SetTxScheduling(sc_com_dev_index_t index, uint32_t mode)
 {
 	assert(m_Initialized);
 
+	switch (mode) {
+	case SC_TX_SCHED_FIFO:
+	case SC_TX_SCHED_PRIO:
+		break;
+	default:
+		return SC_DLL_ERROR_INVALID_PARAM;
+	}
+
 	Guard g(m_Lock);
 
 	if (!VerifyConfigurationAccess(index)) {
 		return SC_DLL_ERROR_ACCESS_DENIED;
 	}
 
-	if (params.brp < can_info.nmbt_brp_min || params.brp > can_info.nmbt_brp_max ||
-		params.sjw < 1 || params.sjw > can_info.nmbt_sjw_max ||
-		params.tseg1 < can_info.nmbt_tseg1_min || params.tseg1 > can_info.nmbt_tseg1_max ||
-		params.tseg2 < can_info.nmbt_tseg2_min || params.tseg2 > can_info.nmbt_tseg2_max) {
-		return SC_DLL_ERROR_INVALID_PARAM;
-	}
-
-	m_Nm.brp = params.brp;
-	m_Nm.sjw = params.sjw;
-	m_Nm.tseg1 = params.tseg1;
-	m_Nm.tseg2 = params.tseg2;
+	m_TxScheduling.store(static_cast<uint8_t>(mode), std::memory_order_relaxed);
 
 	return SC_DLL_ERROR_NONE;
 }
 
-int ScDev::SetNominalBitTiming()
+/* Records all messages the RX thread sees to path, see ISuperCANDevice7::StartRecording */
+int ScDev::StartRecording(sc_com_dev_index_t index, wchar_t const* path)
 {
-	sc_msg_bittiming* bt = reinterpret_cast<sc_msg_bittiming*>(m_CmdCtx.tx_buffer);
-	bt->id = SC_MSG_NM_BITTIMING;
-	bt->len = sizeof(*bt);
-	bt->brp = m_Device->dev_to_host16(m_Nm.brp);
-	bt->sjw = m_Nm.sjw;
-	bt->tseg1 = m_Device->dev_to_host16(m_Nm.tseg1);
-	bt->tseg2 = m_Nm.tseg2;
-
-	return Cmd(bt->len);
-}
+	int error = SC_DLL_ERROR_NONE;
 
-int ScDev::SetDataBitTiming(sc_com_dev_index_t index, SuperCANBitTimingParams params)
-{
 	assert(m_Initialized);
 
+	if (!path || !*path) {
+		return SC_DLL_ERROR_INVALID_PARAM;
+	}
+
 	Guard g(m_Lock);
 
 	if (!VerifyConfigurationAccess(index)) {
 		return SC_DLL_ERROR_ACCESS_DENIED;
 	}
 
-	if (params.brp < can_info.dtbt_brp_min || params.brp > can_info.dtbt_brp_max ||
-		params.sjw < 1 || params.sjw > can_info.dtbt_sjw_max ||
-		params.tseg1 < can_info.dtbt_tseg1_min || params.tseg1 > can_info.dtbt_tseg1_max ||
-		params.tseg2 < can_info.dtbt_tseg2_min || params.tseg2 > can_info.dtbt_tseg2_max) {
-		return SC_DLL_ERROR_INVALID_PARAM;
+	if (!m_Opened || m_Recorder.started()) {
+		return SC_DLL_ERROR_INVALID_OPERATION;
 	}
 
-	m_Dt.brp = params.brp;
-	m_Dt.sjw = params.sjw;
-	m_Dt.tseg1 = params.tseg1;
-	m_Dt.tseg2 = params.tseg2;
+	error = m_RecordSink.open(path);
+	if (error) {
+		LOG_SRV(SC_DLL_LOG_LEVEL_ERROR, "%s: failed to open recording file (%d)\n", m_DeviceName.c_str(), error);
+		return error;
+	}
+
+	error = m_Recorder.start(&m_RecordSink, 0, sc::recorder::DEFAULT_SYNC_CHUNKS);
+	if (error) {
+		m_RecordSink.close();
+		return error;
+	}
+
+	if (RxRunning()) {
+		Notify(NOTIFICATION_RECORD, 1);
+	}
+	else {
+		m_RxThreadRecording = true;
+	}
 
 	return SC_DLL_ERROR_NONE;
 }
 
-int ScDev::SetDataBitTiming()
+int ScDev::StopRecording(sc_com_dev_index_t index)
 {
-	sc_msg_bittiming* bt = reinterpret_cast<sc_msg_bittiming*>(m_CmdCtx.tx_buffer);
-	bt->id = SC_MSG_DT_BITTIMING;
-	bt->len = sizeof(*bt);
-	bt->brp = m_Device->dev_to_host16(m_Dt.brp);
-	bt->sjw = m_Dt.sjw;
-	bt->tseg1 = m_Device->dev_to_host16(m_Dt.tseg1);
-	bt->tseg2 = m_Dt.tseg2;
+	sc::recorder_stats stats;
 
-	return Cmd(bt->len);
-}
+	assert(m_Initialized);
 
-DWORD ScDev::OnDeviceNotification(
-	HCMNOTIFICATION hNotify,
-	PVOID Context,
-	CM_NOTIFY_ACTION Action,
-	PCM_NOTIFY_EVENT_DATA EventData,
-	DWORD EventDataSize)
-{
-	(void)hNotify;
-	(void)EventDataSize;
-	(void)EventData;
+	Guard g(m_Lock);
 
-	switch (Action) {
-	case CM_NOTIFY_ACTION_DEVICEINSTANCEENUMERATED:
-		// sent prior to 'started' 
-		break;
-	case CM_NOTIFY_ACTION_DEVICEINSTANCESTARTED:
-		static_cast<ScDev*>(Context)->OnDeviceDiscovered();
-		break;
-	case CM_NOTIFY_ACTION_DEVICEINSTANCEREMOVED:
-		static_cast<ScDev*>(Context)->OnDeviceGone();
-		break;
+	if (!VerifyConfigurationAccess(index)) {
+		return SC_DLL_ERROR_ACCESS_DENIED;
 	}
 
-	return ERROR_SUCCESS;
-}
+	if (!m_Recorder.started()) {
+		return SC_DLL_ERROR_NONE;
+	}
 
-void ScDev::OnDeviceGone()
+	if (RxRunning()) {
+		Notify(NOTIFICATION_RECORD, 0);
+	}
+	else {
+		m_RxThreadRecording = false;
+	}
+
+	// RX thread has let go, flush the rest from here
+	m_Recorder.stop();
+	m_RecordSink.close();
+	m_Recorder.stats(&stats);
+
+	LOG_SRV(SC_DLL_LOG_LEVEL_INFO, "%s: recorded %llu messages, dropped %llu\n",
+		m_DeviceName.c_str(),
+		static_cast<unsigned long long>(stats.records),
+		static_cast<unsigned long long>(stats.dropped));
+
+	return stats.error;
+}
+
+/* Adds a frame for the TX thread to send periodically, see ISuperCANDevice7::AddCyclicTx */
+int ScDev::AddCyclicTx(sc_com_dev_index_t index, sc::cyclic_tx_def const* def, uint32_t* handle)
+{
+	assert(m_Initialized);
+
+	Guard g(m_Lock);
+
+	auto error = m_Cyclic.add(index, def, handle);
+
+	if (error) {
+		return error;
+	}
+
+	WakeCyclicTx();
+
+	return SC_DLL_ERROR_NONE;
+}
+
+int ScDev::RemoveCyclicTx(sc_com_dev_index_t index, uint32_t handle)
+{
+	assert(m_Initialized);
+
+	Guard g(m_Lock);
+
+	auto error = m_Cyclic.remove(index, handle);
+
+	if (error) {
+		return error;
+	}
+
+	WakeCyclicTx();
+
+	return SC_DLL_ERROR_NONE;
+}
+
+int ScDev::SetCyclicTxTick(sc_com_dev_index_t index, uint32_t tick_us)
+{
+	assert(m_Initialized);
+
+	Guard g(m_Lock);
+
+	if (!VerifyConfigurationAccess(index)) {
+		return SC_DLL_ERROR_ACCESS_DENIED;
+	}
+
+	auto error = m_Cyclic.set_tick(tick_us);
+
+	if (error) {
+		return error;
+	}
+
+	WakeCyclicTx();
+
+	return SC_DLL_ERROR_NONE;
+}
+
+/* Stamps frames on their way to the bus, see ISuperCANDevice7::SetTxTracing */
+int ScDev::SetTxTracing(sc_com_dev_index_t index, bool on)
+{
+	assert(m_Initialized);
+
+	Guard g(m_Lock);
+
+	if (!VerifyConfigurationAccess(index)) {
+		return SC_DLL_ERROR_ACCESS_DENIED;
+	}
+
+	if (on == m_Tracing) {
+		return SC_DLL_ERROR_NONE;
+	}
+
+	m_Tracing = on;
+
+	if (RxRunning()) {
+		Notify(NOTIFICATION_TRACE, on ? 1 : 0);
+	}
+	else {
+		m_RxThreadTracing = on;
+
+		if (on) {
+			ResetTxLatency();
+		}
+	}
+
+	return SC_DLL_ERROR_NONE;
+}
+
+int ScDev::GetTxLatency(sc_com_dev_index_t index, sc_mm_tx_latency* latency)
+{
+	assert(m_Initialized);
+	assert(index < MAX_COM_DEVICES_PER_SC_DEVICE);
+	assert(latency);
+
+	Guard g(m_Lock);
+
+	if (!m_Mapped) {
+		return SC_DLL_ERROR_INVALID_OPERATION;
+	}
+
+	return sc_tx_latency_read(m_ComDeviceDataPrivate[index].tx_latency, latency);
+}
+
+/* Feeds the device clock estimate with a timestamp received
+ * in the current sc_can_stream_rx call, RX thread only.
+ */
+void ScDev::TraceDeviceTime(uint64_t ts_us)
+{
+	if (m_RxThreadTracing) {
+		sc_dc_observe(&m_RxThreadClock, ts_us, m_RxThreadHostUs);
+	}
+}
+
+/* Clears the TX latency pages, called by the RX thread or
+ * with m_Lock held while there is none.
+ */
+void ScDev::ResetTxLatency()
+{
+	sc_dc_init(&m_RxThreadClock);
+
+	for (sc_com_dev_index_t i = 0; i < _countof(m_ComDeviceDataPrivate); ++i) {
+		auto* page = m_ComDeviceDataPrivate[i].tx_latency;
+
+		if (page) {
+			sc_tx_latency_reset(page);
+		}
+	}
+}
+
+/* Hands m_Cyclic changes to the TX thread, or applies them right away
+ * while there is none. Requires m_Lock.
+ */
+void ScDev::WakeCyclicTx()
+{
+	if (m_TxThread) {
+		SetEvent(m_TxCyclicEvent);
+	}
+	else {
+		m_Cyclic.apply(0);
+	}
+}
+
+int ScDev::SetFeatureFlags(sc_com_dev_index_t index, uint32_t flags)
+{
+	assert(m_Initialized);
+
+	Guard g(m_Lock);
+
+	if (!VerifyConfigurationAccess(index)) {
+		return SC_DLL_ERROR_ACCESS_DENIED;
+	}
+
+	flags &= ~SC_FEATURE_FLAG_TXR;
+
+	if ((flags & (dev_info.feat_conf | dev_info.feat_perm)) != flags) {
+		return SC_DLL_ERROR_INVALID_PARAM;
+	}
+
+	m_FeatureFlags = flags | SC_FEATURE_FLAG_TXR;
+
+	return SC_DLL_ERROR_NONE;
+}
+
+int ScDev::SetNominalBitTiming(sc_com_dev_index_t index, SuperCANBitTimingParams params)
+{
+	assert(m_Initialized);
+
+	Guard g(m_Lock);
+
+	if (!VerifyConfigurationAccess(index)) {
+		return SC_DLL_ERROR_ACCESS_DENIED;
+	}
+
+	if (params.brp < can_info.nmbt_brp_min || params.brp > can_info.nmbt_brp_max ||
+		params.sjw < 1 || params.sjw > can_info.nmbt_sjw_max ||
+		params.tseg1 < can_info.nmbt_tseg1_min || params.tseg1 > can_info.nmbt_tseg1_max ||
+		params.tseg2 < can_info.nmbt_tseg2_min || params.tseg2 > can_info.nmbt_tseg2_max) {
+		return SC_DLL_ERROR_INVALID_PARAM;
+	}
+
+	m_Nm.brp = params.brp;
+	m_Nm.sjw = params.sjw;
+	m_Nm.tseg1 = params.tseg1;
+	m_Nm.tseg2 = params.tseg2;
+
+	return SC_DLL_ERROR_NONE;
+}
+
+int ScDev::SetDataBitTiming(sc_com_dev_index_t index, SuperCANBitTimingParams params)
+{
+	assert(m_Initialized);
+
+	Guard g(m_Lock);
+
+	if (!VerifyConfigurationAccess(index)) {
+		return SC_DLL_ERROR_ACCESS_DENIED;
+	}
+
+	if (params.brp < can_info.dtbt_brp_min || params.brp > can_info.dtbt_brp_max ||
+		params.sjw < 1 || params.sjw > can_info.dtbt_sjw_max ||
+		params.tseg1 < can_info.dtbt_tseg1_min || params.tseg1 > can_info.dtbt_tseg1_max ||
+		params.tseg2 < can_info.dtbt_tseg2_min || params.tseg2 > can_info.dtbt_tseg2_max) {
+		return SC_DLL_ERROR_INVALID_PARAM;
+	}
+
+	m_Dt.brp = params.brp;
+	m_Dt.sjw = params.sjw;
+	m_Dt.tseg1 = params.tseg1;
+	m_Dt.tseg2 = params.tseg2;
+
+	return SC_DLL_ERROR_NONE;
+}
+
+/* Configures the device and puts it on bus in a single command transfer
+ *
+ * With bus_off the batch first takes the device off bus.
+ */
+int ScDev::Configure(bool bus_off)
+{
+	sc_cmd_batch_t batch;
+	sc_cmd_reply_t replies[6];
+	sc_msg_config* bus = nullptr;
+	sc_msg_features* feat = nullptr;
+	sc_msg_bittiming* bt = nullptr;
+	int error = SC_DLL_ERROR_NONE;
+
+	sc_cmd_ctx_batch_init(&m_CmdCtx, &batch);
+
+	// all requests fit into the minimum command buffer size
+	if (bus_off) {
+		sc_cmd_batch_add(&batch, sizeof(*bus), reinterpret_cast<void**>(&bus));
+		bus->id = SC_MSG_BUS;
+		bus->arg = 0;
+	}
+
+	sc_cmd_batch_add(&batch, sizeof(*feat), reinterpret_cast<void**>(&feat));
+	feat->id = SC_MSG_FEATURES;
+	feat->op = SC_FEAT_OP_CLEAR;
+
+	sc_cmd_batch_add(&batch, sizeof(*feat), reinterpret_cast<void**>(&feat));
+	feat->id = SC_MSG_FEATURES;
+	feat->op = SC_FEAT_OP_OR;
+	feat->arg = m_Device->dev_to_host32(m_FeatureFlags);
+
+	sc_cmd_batch_add(&batch, sizeof(*bt), reinterpret_cast<void**>(&bt));
+	bt->id = SC_MSG_NM_BITTIMING;
+	bt->brp = m_Device->dev_to_host16(m_Nm.brp);
+	bt->sjw = m_Nm.sjw;
+	bt->tseg1 = m_Device->dev_to_host16(m_Nm.tseg1);
+	bt->tseg2 = m_Nm.tseg2;
+
+	if ((m_FeatureFlags & SC_FEATURE_FLAG_FDF) || (dev_info.feat_perm & SC_FEATURE_FLAG_FDF)) {
+		sc_cmd_batch_add(&batch, sizeof(*bt), reinterpret_cast<void**>(&bt));
+		bt->id = SC_MSG_DT_BITTIMING;
+		bt->brp = m_Device->dev_to_host16(m_Dt.brp);
+		bt->sjw = m_Dt.sjw;
+		bt->tseg1 = m_Device->dev_to_host16(m_Dt.tseg1);
+		bt->tseg2 = m_Dt.tseg2;
+	}
+
+	sc_cmd_batch_add(&batch, sizeof(*bus), reinterpret_cast<void**>(&bus));
+	bus->id = SC_MSG_BUS;
+	bus->arg = m_Device->dev_to_host16(1);
+
+	error = sc_cmd_ctx_batch_run(&m_CmdCtx, &batch, replies, CMD_TIMEOUT_MS);
+	if (error) {
+		return error;
+	}
+
+	for (uint16_t i = 0; i < batch.count; ++i) {
+		if (SC_MSG_ERROR != replies[i].msg[0]) {
+			return SC_DLL_ERROR_PROTO_VIOLATION;
+		}
+
+		if (replies[i].error) {
+			LOG_SRV(SC_DLL_LOG_LEVEL_ERROR, "%s: config request %u failed: %d\n", m_DeviceName.c_str(), unsigned(i), replies[i].error);
+			return map_device_error(replies[i].error);
+		}
+	}
+
+	return SC_DLL_ERROR_NONE;
+}
+
+DWORD ScDev::OnDeviceNotification(
+	HCMNOTIFICATION hNotify,
+	PVOID Context,
+	CM_NOTIFY_ACTION Action,
+	PCM_NOTIFY_EVENT_DATA EventData,
+	DWORD EventDataSize)
+{
+	(void)hNotify;
+	(void)EventDataSize;
+	(void)EventData;
+
+	switch (Action) {
+	case CM_NOTIFY_ACTION_DEVICEINSTANCEENUMERATED:
+		// sent prior to 'started' 
+		break;
+	case CM_NOTIFY_ACTION_DEVICEINSTANCESTARTED:
+		static_cast<ScDev*>(Context)->OnDeviceDiscovered();
+		break;
+	case CM_NOTIFY_ACTION_DEVICEINSTANCEREMOVED:
+		static_cast<ScDev*>(Context)->OnDeviceGone();
+		break;
+	}
+
+	return ERROR_SUCCESS;
+}
+
+void ScDev::OnDeviceGone()
 {
 	Guard g(m_Lock);
 
@@ -826,29 +1595,6 @@ void ScDev::OnDeviceDiscovered()
 	}
 }
 
-int ScDev::Cmd(uint16_t bytes_in)
-{
-	assert(m_Initialized);
-
-	sc_msg_error* e = reinterpret_cast<sc_msg_error*>(m_CmdCtx.rx_buffer);
-	uint16_t bytes_out = 0;
-	auto error = sc_cmd_ctx_run(&m_CmdCtx, bytes_in, &bytes_out, CMD_TIMEOUT_MS);
-
-	if (error) {
-		return error;
-	}
-
-	if (bytes_out < sizeof(*e)) {
-		return SC_DLL_ERROR_PROTO_VIOLATION;
-	}
-
-	if (e->id != SC_MSG_ERROR || e->len < sizeof(*e)) {
-		return SC_DLL_ERROR_PROTO_VIOLATION;
-	}
-
-	return map_device_error(e->error);
-}
-
 int ScDev::OnRx(void* ctx, void const* ptr, uint16_t bytes)
 {
 	return static_cast<ScDev*>(ctx)->OnRx(static_cast<sc_msg_header const*>(ptr), bytes);
@@ -860,6 +1606,11 @@ int ScDev::OnRx(sc_msg_header const* _msg, unsigned bytes)
 
 	(void)bytes; // fingers crossed
 
+	if (!m_RxThreadOnBus) {
+		// left over from the last time on bus
+		return SC_DLL_ERROR_NONE;
+	}
+
 	switch (msg->id) {
 	case SC_MSG_CAN_TXR: {
 		sc_msg_can_txr *txr = reinterpret_cast<sc_msg_can_txr*>(msg);
@@ -868,6 +1619,7 @@ int ScDev::OnRx(sc_msg_header const* _msg, unsigned bytes)
 		
 		txr->timestamp_us = m_Device->dev_to_host32(txr->timestamp_us);
 		ts = sc_tt_track(&m_TimeTracker, txr->timestamp_us);
+		TraceDeviceTime(ts);
 
 		tx_com_dev_index = static_cast<sc_com_dev_index_t>(m_TxrMap[txr->track_id].index.load(std::memory_order_acquire));
 
@@ -875,45 +1627,49 @@ int ScDev::OnRx(sc_msg_header const* _msg, unsigned bytes)
 			auto const* echo = &m_TxEchoMap[txr->track_id];
 			auto data_len = dlc_to_len(echo->dlc);
 
-			for (sc_com_dev_index_t i = 0; i < m_RxThreadLiveComDevCount; ++i) {
-				auto com_dev_index = m_RxThreadLiveComDevBuffer[i];
-				auto* data = &m_ComDeviceData[com_dev_index];
-				auto* priv = &m_ComDeviceDataPrivate[com_dev_index];
-				auto gi = priv->rx.hdr->get_index;
-				auto pi = priv->rx.hdr->put_index;
-				auto used = pi - gi;
-
-				if (pi != priv->rx.index || used > data->rx.elements) {
-					// rogue client
-				}
-				else if (used == data->rx.elements) { // just be safe, could be a rogue client
-					InterlockedIncrement(&priv->rx.hdr->can_lost_tx);
-					SetEvent(priv->rx.ev);
+			auto accept = [=](sc_filter_t const* filter) {
+				return sc_filter_accept(filter, echo->can_id, txr->flags);
+			};
+
+			StoreRx(&sc_can_mm_header::can_lost_tx, accept, [=](sc_can_mm_slot_t* slot, sc_com_dev_index_t com_dev_index) {
+				slot->tx.type = SC_MM_DATA_TYPE_CAN_TX;
+				slot->tx.can_id = echo->can_id;
+				slot->tx.flags = txr->flags;
+				slot->tx.dlc = echo->dlc;
+				slot->tx.track_id = echo->track_id;
+				slot->tx.timestamp_us = ts;
+				memcpy(slot->tx.data, echo->data, data_len);
+
+				if (MAX_COM_DEVICES_PER_SC_DEVICE == com_dev_index) {
+					slot->tx.echo = static_cast<uint8_t>(1u << tx_com_dev_index);
 				}
 				else {
-					uint32_t const slot_index = priv->rx.index % data->rx.elements;
-					sc_can_mm_slot_t* slot = &priv->rx.hdr->elements[slot_index];
-
-					slot->tx.type = SC_MM_DATA_TYPE_CAN_TX;
-					slot->tx.can_id = echo->can_id;
-					slot->tx.flags = txr->flags;
-					slot->tx.dlc = echo->dlc;
-					slot->tx.track_id = echo->track_id;
-					slot->tx.timestamp_us = ts;
-					memcpy(slot->tx.data, echo->data, data_len);
-
 					slot->tx.echo = tx_com_dev_index == com_dev_index;
-
-					++priv->rx.index;
-
-					priv->rx.hdr->put_index = priv->rx.index;
-
-					SetEvent(priv->rx.ev);
+				}
+			});
+
+			if (m_RxThreadTracing) {
+				auto const* trace = &m_TxTrace[txr->track_id];
+
+				// frames sent before tracing was turned on aren't stamped
+				if (trace->dequeue_us) {
+					sc_tx_latency_add(
+						m_ComDeviceDataPrivate[tx_com_dev_index].tx_latency,
+						trace->dequeue_us,
+						trace->submit_us.load(std::memory_order_relaxed),
+						sc_dc_host(&m_RxThreadClock, ts));
 				}
 			}
 
 			m_TxrMap[txr->track_id].index.store(MAX_COM_DEVICES_PER_SC_DEVICE, std::memory_order_release);
-			ReleaseSemaphore(m_TxFifoAvailable, 1, nullptr);
+
+			auto* tx_done = &m_ComDeviceDataPrivate[tx_com_dev_index].tx_done;
+
+			tx_done->store(tx_done->load(std::memory_order_relaxed) + 1, std::memory_order_release);
+
+			if (sc_track_id_free(&m_TrackIds, txr->track_id)) {
+				SetEvent(m_TxFifoAvailable);
+			}
 		}
 		else {
 			// happens for instance if a COM devices is removed and there are outstanding TXs
@@ -926,44 +1682,23 @@ int ScDev::OnRx(sc_msg_header const* _msg, unsigned bytes)
 		rx->can_id = m_Device->dev_to_host32(rx->can_id);
 		rx->timestamp_us = m_Device->dev_to_host32(rx->timestamp_us);
 		ts = sc_tt_track(&m_TimeTracker, rx->timestamp_us);
+		TraceDeviceTime(ts);
 
-		for (sc_com_dev_index_t i = 0; i < m_RxThreadLiveComDevCount; ++i) {
-			auto com_dev_index = m_RxThreadLiveComDevBuffer[i];
-			auto* data = &m_ComDeviceData[com_dev_index];
-			auto* priv = &m_ComDeviceDataPrivate[com_dev_index];
-			auto gi = priv->rx.hdr->get_index;
-			auto pi = priv->rx.hdr->put_index;
-			auto used = pi - gi;
+		auto accept = [=](sc_filter_t const* filter) {
+			return sc_filter_accept(filter, rx->can_id, rx->flags);
+		};
 
-			if (pi != priv->rx.index || used > data->rx.elements) {
-				// rogue client
-			}
-			else if (used == data->rx.elements) { // just be safe, could be a rogue client
-				InterlockedIncrement(&priv->rx.hdr->can_lost_rx);
-				SetEvent(priv->rx.ev);
-			}
-			else {
-				uint32_t index = priv->rx.index % data->rx.elements;
-				sc_can_mm_slot_t* slot = &priv->rx.hdr->elements[index];
-				slot->rx.type = SC_MM_DATA_TYPE_CAN_RX;
-				slot->rx.can_id = rx->can_id;
-				slot->rx.dlc = rx->dlc;
-				slot->rx.flags = rx->flags;
-				slot->rx.timestamp_us = ts;
-
-				if (!(slot->rx.flags & SC_CAN_FRAME_FLAG_RTR)) {
-					memcpy(slot->rx.data, rx->data, dlc_to_len(rx->dlc));
-				}
-
-				++priv->rx.index;
-
-				priv->rx.hdr->put_index = priv->rx.index;
+		StoreRx(&sc_can_mm_header::can_lost_rx, accept, [=](sc_can_mm_slot_t* slot, sc_com_dev_index_t) {
+			slot->rx.type = SC_MM_DATA_TYPE_CAN_RX;
+			slot->rx.can_id = rx->can_id;
+			slot->rx.dlc = rx->dlc;
+			slot->rx.flags = rx->flags;
+			slot->rx.timestamp_us = ts;
 
-				//std::atomic_thread_fence(std::memory_order_release);
-
-				SetEvent(priv->rx.ev);
+			if (!(slot->rx.flags & SC_CAN_FRAME_FLAG_RTR)) {
+				memcpy(slot->rx.data, rx->data, dlc_to_len(rx->dlc));
 			}
-		}
+		});
 	} break;
 	case SC_MSG_CAN_STATUS: {
 		sc_msg_can_status* status = reinterpret_cast<sc_msg_can_status*>(msg);
@@ -973,45 +1708,20 @@ int ScDev::OnRx(sc_msg_header const* _msg, unsigned bytes)
 		status->tx_dropped = m_Device->dev_to_host16(status->tx_dropped);
 		status->timestamp_us = m_Device->dev_to_host32(status->timestamp_us);
 		ts = sc_tt_track(&m_TimeTracker, status->timestamp_us);
-
-		for (sc_com_dev_index_t i = 0; i < m_RxThreadLiveComDevCount; ++i) {
-			auto com_dev_index = m_RxThreadLiveComDevBuffer[i];
-			auto* data = &m_ComDeviceData[com_dev_index];
-			auto* priv = &m_ComDeviceDataPrivate[com_dev_index];
-			auto gi = priv->rx.hdr->get_index;
-			auto pi = priv->rx.hdr->put_index;
-			auto used = pi - gi;
-
-			if (pi != priv->rx.index || used > data->rx.elements) {
-				// rogue client
-			}
-			else if (used == data->rx.elements) { // just be safe, could be a rogue client
-				InterlockedIncrement(&priv->rx.hdr->can_lost_status);
-				SetEvent(priv->rx.ev);
-			}
-			else {
-				uint32_t index = priv->rx.index % data->rx.elements;
-				sc_can_mm_slot_t* slot = &priv->rx.hdr->elements[index];
-
-				slot->status.type = SC_MM_DATA_TYPE_CAN_STATUS;
-				slot->status.flags = status->flags;
-				slot->status.bus_status = status->bus_status;
-				slot->status.timestamp_us = ts;
-				slot->status.rx_lost = status->rx_lost;
-				slot->status.tx_dropped = status->tx_dropped;
-				slot->status.rx_errors = status->rx_errors;
-				slot->status.tx_errors = status->tx_errors;
-				slot->status.rx_fifo_size = status->rx_fifo_size;
-				slot->status.tx_fifo_size = status->tx_fifo_size;
-
-
-				++priv->rx.index;
-
-				priv->rx.hdr->put_index = priv->rx.index;
-
-				SetEvent(priv->rx.ev);
-			}
-		}
+		TraceDeviceTime(ts);
+
+		StoreRx(&sc_can_mm_header::can_lost_status, AcceptAll, [=](sc_can_mm_slot_t* slot, sc_com_dev_index_t) {
+			slot->status.type = SC_MM_DATA_TYPE_CAN_STATUS;
+			slot->status.flags = status->flags;
+			slot->status.bus_status = status->bus_status;
+			slot->status.timestamp_us = ts;
+			slot->status.rx_lost = status->rx_lost;
+			slot->status.tx_dropped = status->tx_dropped;
+			slot->status.rx_errors = status->rx_errors;
+			slot->status.tx_errors = status->tx_errors;
+			slot->status.rx_fifo_size = status->rx_fifo_size;
+			slot->status.tx_fifo_size = status->tx_fifo_size;
+		});
 	} break;
 	case SC_MSG_CAN_ERROR: {
 		auto* error = reinterpret_cast<sc_msg_can_error*>(msg);
@@ -1019,38 +1729,14 @@ int ScDev::OnRx(sc_msg_header const* _msg, unsigned bytes)
 
 		error->timestamp_us = m_Device->dev_to_host32(error->timestamp_us);
 		ts = sc_tt_track(&m_TimeTracker, error->timestamp_us);
-
-		for (sc_com_dev_index_t i = 0; i < m_RxThreadLiveComDevCount; ++i) {
-			auto com_dev_index = m_RxThreadLiveComDevBuffer[i];
-			auto* data = &m_ComDeviceData[com_dev_index];
-			auto* priv = &m_ComDeviceDataPrivate[com_dev_index];
-			auto gi = priv->rx.hdr->get_index;
-			auto pi = priv->rx.hdr->put_index;
-			auto used = pi - gi;
-
-			if (pi != priv->rx.index || used > data->rx.elements) {
-				// rogue client
-			}
-			else if (used == data->rx.elements) { // just be safe, could be a rogue client
-				InterlockedIncrement(&priv->rx.hdr->can_lost_error);
-				SetEvent(priv->rx.ev);
-			}
-			else {
-				uint32_t index = priv->rx.index % data->rx.elements;
-				sc_can_mm_slot_t* slot = &priv->rx.hdr->elements[index];
-
-				slot->error.type = SC_MM_DATA_TYPE_CAN_ERROR;
-				slot->error.flags = error->flags;
-				slot->error.timestamp_us = ts;
-				slot->error.error = error->error;
-
-				++priv->rx.index;
-
-				priv->rx.hdr->put_index = priv->rx.index;
-
-				SetEvent(priv->rx.ev);
-			}
-		}
+		TraceDeviceTime(ts);
+
+		StoreRx(&sc_can_mm_header::can_lost_error, AcceptAll, [=](sc_can_mm_slot_t* slot, sc_com_dev_index_t) {
+			slot->error.type = SC_MM_DATA_TYPE_CAN_ERROR;
+			slot->error.flags = error->flags;
+			slot->error.timestamp_us = ts;
+			slot->error.error = error->error;
+		});
 	} break;
 	}
 
@@ -1088,6 +1774,16 @@ void ScDev::Unmap()
 {
 	m_Mapped = false;
 
+	if (m_BcRing.header()) {
+		UnmapViewOfFile(m_BcRing.header());
+		m_BcRing = sc::mm::bc_ring_producer();
+	}
+
+	if (m_BcFile) {
+		CloseHandle(m_BcFile);
+		m_BcFile = nullptr;
+	}
+
 	for (sc_com_dev_index_t i = 0; i < _countof(m_ComDeviceData); ++i) {
 		//auto* data = &m_ComDeviceData[i];
 		auto* priv = &m_ComDeviceDataPrivate[i];
@@ -1121,12 +1817,63 @@ void ScDev::Unmap()
 			CloseHandle(priv->tx.ev);
 			priv->tx.ev = nullptr;
 		}
+
+		if (priv->tx_latency) {
+			UnmapViewOfFile(priv->tx_latency);
+			priv->tx_latency = nullptr;
+		}
+
+		if (priv->stats_file) {
+			CloseHandle(priv->stats_file);
+			priv->stats_file = nullptr;
+		}
+
+		if (priv->log_ring.header()) {
+			UnmapViewOfFile(priv->log_ring.header());
+			priv->log_ring = sc::mm::ring_producer();
+		}
+
+		if (priv->log_file) {
+			CloseHandle(priv->log_file);
+			priv->log_file = nullptr;
+		}
 	}
 }
 
 int ScDev::Map()
 {
 	int error = SC_DLL_ERROR_NONE;
+	uint64_t bc_bytes = m_ComDeviceData[0].bc_rx.elements * sizeof(sc_can_mm_slot_t) + sizeof(sc_can_mm_bc_header);
+	sc_can_mm_bc_header* bc_hdr = nullptr;
+	sc_can_mm_header* log_hdr = nullptr;
+
+	m_BcFile = CreateFileMappingW(
+		INVALID_HANDLE_VALUE, // hFile -> page file
+		NULL, // lpFileMappingAttributes
+		PAGE_READWRITE, // flProtect
+		static_cast<DWORD>(bc_bytes >> 32), // dwMaximumSizeHigh
+		static_cast<DWORD>(bc_bytes), // dwMaximumSizeLow
+		m_ComDeviceData[0].bc_rx.mem_name); // lpName
+
+	if (nullptr == m_BcFile) {
+		error = SC_DLL_ERROR_OUT_OF_MEM;
+		goto error_exit;
+	}
+
+	bc_hdr = static_cast<sc_can_mm_bc_header*>(MapViewOfFile(
+		m_BcFile,
+		FILE_MAP_READ | FILE_MAP_WRITE,
+		0,
+		0,
+		static_cast<SIZE_T>(bc_bytes)));
+
+	if (!bc_hdr) {
+		error = SC_DLL_ERROR_OUT_OF_MEM;
+		goto error_exit;
+	}
+
+	memset(bc_hdr, 0, sizeof(*bc_hdr));
+	m_BcRing.attach(bc_hdr, m_ComDeviceData[0].bc_rx.elements);
 
 	for (sc_com_dev_index_t i = 0; i < _countof(m_ComDeviceData); ++i) {
 		auto* data = &m_ComDeviceData[i];
@@ -1160,6 +1907,8 @@ int ScDev::Map()
 		}
 
 		memset(priv->rx.hdr, 0, sizeof(*priv->rx.hdr));
+		priv->rx.hdr->formats = (UINT32_C(1) << SC_MM_FORMAT_FIXED) | (UINT32_C(1) << SC_MM_FORMAT_VAR);
+		priv->rx_ring.attach(priv->rx.hdr, data->rx.elements);
 
 		bytes = data->tx.elements * sizeof(sc_can_mm_slot_t) + sizeof(sc_can_mm_header);
 		priv->tx.file = CreateFileMappingW(
@@ -1189,6 +1938,7 @@ int ScDev::Map()
 		}
 
 		memset(priv->tx.hdr, 0, sizeof(*priv->tx.hdr));
+		priv->tx_ring.attach(priv->tx.hdr, data->tx.elements);
 
 		// events
 		priv->rx.ev = CreateEventW(nullptr, FALSE, FALSE, data->rx.ev_name);
@@ -1202,6 +1952,65 @@ int ScDev::Map()
 			error = SC_DLL_ERROR_OUT_OF_MEM;
 			goto error_exit;
 		}
+
+		// statistics
+		priv->stats_file = CreateFileMappingW(
+			INVALID_HANDLE_VALUE, // hFile -> page file
+			NULL, // lpFileMappingAttributes
+			PAGE_READWRITE, // flProtect
+			0, // dwMaximumSizeHigh
+			static_cast<DWORD>(sizeof(sc_mm_tx_latency)), // dwMaximumSizeLow
+			data->stats.mem_name); // lpName
+
+		if (nullptr == priv->stats_file) {
+			error = SC_DLL_ERROR_OUT_OF_MEM;
+			goto error_exit;
+		}
+
+		priv->tx_latency = static_cast<sc_mm_tx_latency*>(MapViewOfFile(
+			priv->stats_file,
+			FILE_MAP_READ | FILE_MAP_WRITE,
+			0,
+			0,
+			sizeof(sc_mm_tx_latency)));
+
+		if (!priv->tx_latency) {
+			error = SC_DLL_ERROR_OUT_OF_MEM;
+			goto error_exit;
+		}
+
+		memset(priv->tx_latency, 0, sizeof(*priv->tx_latency));
+
+		// log ring
+		bytes = data->log.elements * sizeof(sc_can_mm_slot_t) + sizeof(sc_can_mm_header);
+		priv->log_file = CreateFileMappingW(
+			INVALID_HANDLE_VALUE, // hFile -> page file
+			NULL, // lpFileMappingAttributes
+			PAGE_READWRITE, // flProtect
+			static_cast<DWORD>(bytes >> 32), // dwMaximumSizeHigh
+			static_cast<DWORD>(bytes), // dwMaximumSizeLow
+			data->log.mem_name); // lpName
+
+		if (nullptr == priv->log_file) {
+			error = SC_DLL_ERROR_OUT_OF_MEM;
+			goto error_exit;
+		}
+
+		log_hdr = static_cast<sc_can_mm_header*>(MapViewOfFile(
+			priv->log_file,
+			FILE_MAP_READ | FILE_MAP_WRITE,
+			0,
+			0,
+			static_cast<SIZE_T>(bytes)));
+
+		if (!log_hdr) {
+			error = SC_DLL_ERROR_OUT_OF_MEM;
+			goto error_exit;
+		}
+
+		memset(log_hdr, 0, sizeof(*log_hdr));
+		log_hdr->formats = UINT32_C(1) << SC_MM_FORMAT_FIXED;
+		priv->log_ring.attach(log_hdr, data->log.elements);
 	}
 
 	m_Mapped = true;
@@ -1221,29 +2030,22 @@ void ScDev::Log(void* ctx, int level, const char* msg, size_t bytes)
 
 void ScDev::Log(int level, const char* msg, size_t bytes)
 {
-	Guard g(m_LogLock);
-
-	unsigned used = m_LogRingPutIndex - m_LogRingGetIndex;
-
-	if (used < _countof(m_LogRingBuffer)) {
-		const unsigned index = m_LogRingPutIndex % _countof(m_LogRingBuffer);
-		log_entry* const e = &m_LogRingBuffer[index];
-
+	auto pushed = m_LogQueue.push([=](log_entry* e) {
 		//QueryPerformanceCounter((LARGE_INTEGER*)&e->timestamp_qpc);
 		e->level = static_cast<int8_t>(level);
 		e->src = SC_LOG_DATA_SRC_DLL;
 		e->bytes = static_cast<uint8_t>(std::min(_countof(e->data) - 1, bytes));
 		memcpy(e->data, msg, e->bytes);
 		e->data[e->bytes] = 0;
+	});
 
-		++m_LogRingPutIndex;
-
+	if (pushed) {
 		SetEvent(m_LogEvent);
 	}
 	else {
-		++m_LogLost;
+		m_LogLost.fetch_add(1, std::memory_order_relaxed);
 
-		OutputDebugStringA("SC SRV: log ring buffer full\n");
+		OutputDebugStringA("SC SRV: log queue full\n");
 		// Should we still log?
 	}
 }
@@ -1251,34 +2053,29 @@ void ScDev::Log(int level, const char* msg, size_t bytes)
 void ScDev::LogFormatQueue(int level, const char* fmt, ...)
 {
 	if (level <= m_LogLevel.load(std::memory_order_relaxed)) {
+		va_list vl;
 
-		Guard g(m_LogLock);
-
-		unsigned used = m_LogRingPutIndex - m_LogRingGetIndex;
-
-		if (used < _countof(m_LogRingBuffer)) {
-			const unsigned index = m_LogRingPutIndex % _countof(m_LogRingBuffer);
-			log_entry* const e = &m_LogRingBuffer[index];
-			va_list vl;
+		va_start(vl, fmt);
 
+		auto pushed = m_LogQueue.push([&](log_entry* e) {
 			e->level = static_cast<int8_t>(level);
 			e->src = SC_LOG_DATA_SRC_SRV;
 			//QueryPerformanceCounter((LARGE_INTEGER*)&e->timestamp_qpc);
 
-			va_start(vl, fmt);
-			
-			e->bytes = (uint8_t)_vsnprintf_s(e->data, _countof(e->data), _TRUNCATE, fmt, vl);
+			int const r = _vsnprintf_s(e->data, _countof(e->data), _TRUNCATE, fmt, vl);
 
-			va_end(vl);
+			e->bytes = static_cast<uint8_t>(r < 0 ? _countof(e->data) - 1 : r); // -1 on truncation
+		});
 
-			++m_LogRingPutIndex;
+		va_end(vl);
 
+		if (pushed) {
 			SetEvent(m_LogEvent);
 		}
 		else {
-			++m_LogLost;
+			m_LogLost.fetch_add(1, std::memory_order_relaxed);
 
-			OutputDebugStringA("SC SRV: log ring buffer full\n");
+			OutputDebugStringA("SC SRV: log queue full\n");
 		}
 	}
 }
@@ -1297,10 +2094,12 @@ void ScDev::LogFormatDirect(int level, const char* fmt, ...)
 
 		va_start(vl, fmt);
 
-		e.bytes = (uint8_t)_vsnprintf_s(e.data, _countof(e.data), _TRUNCATE, fmt, vl);
+		int const r = _vsnprintf_s(e.data, _countof(e.data), _TRUNCATE, fmt, vl);
 
 		va_end(vl);
 
+		e.bytes = static_cast<uint8_t>(r < 0 ? _countof(e.data) - 1 : r); // -1 on truncation
+
 		StoreLogMessage(&e);
 	}
 }
@@ -1317,6 +2116,12 @@ int ScDev::Init(std::wstring&& name)
 		goto error_exit;
 	}
 
+	error = m_Cyclic.init(sc::cyclic_tx::DEFAULT_CAPACITY);
+
+	if (error) {
+		goto error_exit;
+	}
+
 	CONFIGRET cr;
 	DEVPROPTYPE prop_type = 0;
 	CM_NOTIFY_FILTER filter;
@@ -1453,6 +2258,14 @@ error_exit:
 
 void ScDev::CloseDevice()
 {
+	// the stream uses the device
+	StopWorkers();
+
+	// no more records from the RX thread
+	m_Recorder.stop();
+	m_RecordSink.close();
+	m_RxThreadRecording = false;
+
 	sc_cmd_ctx_uninit(&m_CmdCtx);
 	ZeroMemory(&m_CmdCtx, sizeof(m_CmdCtx));
 
@@ -1501,10 +2314,8 @@ error_exit:
 	goto success_exit;
 }
 
-void ScDev::BusCleanup()
+void ScDev::StopWorkers()
 {
-	assert(m_Initialized);
-
 	m_RxThreadNotificationCode.store(NOTIFICATION_SHUTDOWN, std::memory_order_release);
 	m_TxThreadNotificationCode.store(NOTIFICATION_SHUTDOWN, std::memory_order_release);
 
@@ -1518,11 +2329,35 @@ void ScDev::BusCleanup()
 
 	if (m_RxThread) {
 		WaitForSingleObject(m_RxThread, INFINITE);
+		CloseHandle(m_RxThread);
 		m_RxThread = nullptr;
 	}
 
+	if (m_RxDone) {
+		WaitForSingleObject(m_RxDone, INFINITE);
+		CloseHandle(m_RxDone);
+		m_RxDone = nullptr;
+	}
+
+	for (size_t i = 0; i < _countof(m_RxWaits); ++i) {
+		if (m_RxWaits[i]) {
+			SetThreadpoolWait(m_RxWaits[i], nullptr, nullptr);
+			WaitForThreadpoolWaitCallbacks(m_RxWaits[i], TRUE);
+			CloseThreadpoolWait(m_RxWaits[i]);
+			m_RxWaits[i] = nullptr;
+		}
+	}
+
+	if (m_RxPool) {
+		// a wait may have posted the task once more before it was cancelled
+		m_RxPool->wait(&m_RxTask);
+		m_RxPool = nullptr;
+		RxPoolRelease();
+	}
+
 	if (m_TxThread) {
 		WaitForSingleObject(m_TxThread, INFINITE);
+		CloseHandle(m_TxThread);
 		m_TxThread = nullptr;
 	}
 
@@ -1540,19 +2375,170 @@ void ScDev::BusCleanup()
 		m_TxThreadNotificationEvent = nullptr;
 	}
 
-	if (m_ThreadNotificationAcknowledgeCount) {
-		CloseHandle(m_ThreadNotificationAcknowledgeCount);
-		m_ThreadNotificationAcknowledgeCount = nullptr;
+	if (m_ThreadNotificationAcknowledgeCount) {
+		CloseHandle(m_ThreadNotificationAcknowledgeCount);
+		m_ThreadNotificationAcknowledgeCount = nullptr;
+	}
+
+	if (m_TxFifoAvailable) {
+		CloseHandle(m_TxFifoAvailable);
+		m_TxFifoAvailable = nullptr;
+	}
+
+	if (m_TxCyclicEvent) {
+		CloseHandle(m_TxCyclicEvent);
+		m_TxCyclicEvent = nullptr;
+	}
+
+	if (m_TxCyclicTimer) {
+		CloseHandle(m_TxCyclicTimer);
+		m_TxCyclicTimer = nullptr;
+	}
+
+	// TX thread is gone, keep the definitions for the next start
+	m_Cyclic.stop();
+	m_Cyclic.apply(0);
+
+	if (m_Stream) {
+		sc_can_stream_uninit(m_Stream);
+		m_Stream = nullptr;
+	}
+
+	m_RxThreadOnBus = false;
+	m_WorkerError = false;
+}
+
+/* Creates the CAN stream and the RX / TX threads.
+ *
+ * The workers live until the device is closed. While off bus they only
+ * service notifications and drop whatever the device still sends.
+ * With the shared RX pool on, RX runs as a task on the pool instead.
+ */
+int ScDev::StartWorkers()
+{
+	int error = SC_DLL_ERROR_NONE;
+	DWORD thread_id = 0;
+
+	assert(m_Opened);
+
+	LOG_SRV(SC_DLL_LOG_LEVEL_DEBUG, "%s: init CAN stream\n", m_DeviceName.c_str());
+
+	assert(!m_Stream);
+	error = sc_can_stream_init(
+		m_Device,
+		can_info.msg_buffer_size,
+		this,
+		&ScDev::OnRx,
+		-1,
+		&m_Stream);
+
+	if (error) {
+		goto error_exit;
+	}
+
+	assert(!m_Stream->user_handle);
+
+	m_RxThreadNotificationEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+	if (!m_RxThreadNotificationEvent) {
+		error = SC_DLL_ERROR_OUT_OF_MEM;
+		goto error_exit;
+	}
+
+	m_TxThreadNotificationEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+	if (!m_TxThreadNotificationEvent) {
+		error = SC_DLL_ERROR_OUT_OF_MEM;
+		goto error_exit;
+	}
+
+	m_TxFifoAvailable = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+	if (!m_TxFifoAvailable) {
+		error = SC_DLL_ERROR_OUT_OF_MEM;
+		goto error_exit;
+	}
+
+	m_TxCyclicEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+	if (!m_TxCyclicEvent) {
+		error = SC_DLL_ERROR_OUT_OF_MEM;
+		goto error_exit;
+	}
+
+#ifdef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+	// Windows 10 1803 and later, default resolution is the system tick
+	m_TxCyclicTimer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+#endif
+
+	if (!m_TxCyclicTimer) {
+		m_TxCyclicTimer = CreateWaitableTimerW(nullptr, FALSE, nullptr);
+		if (!m_TxCyclicTimer) {
+			error = SC_DLL_ERROR_OUT_OF_MEM;
+			goto error_exit;
+		}
+	}
+
+	m_ThreadNotificationAcknowledgeCount = CreateSemaphoreW(nullptr, 0, 2, nullptr);
+	if (!m_ThreadNotificationAcknowledgeCount) {
+		error = SC_DLL_ERROR_OUT_OF_MEM;
+		goto error_exit;
+	}
+
+	m_RxThreadOnBus = false;
+	m_WorkerError = false;
+
+	m_RxPool = RxPoolAcquire(&m_RxTask.home);
+
+	if (m_RxPool) {
+		for (size_t i = 0; i < _countof(m_RxWaits); ++i) {
+			m_RxWaits[i] = CreateThreadpoolWait(&ScDev::OnRxWait, this, nullptr);
+			if (!m_RxWaits[i]) {
+				error = SC_DLL_ERROR_OUT_OF_MEM;
+				goto error_exit;
+			}
+		}
+
+		m_RxDone = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+		if (!m_RxDone) {
+			error = SC_DLL_ERROR_OUT_OF_MEM;
+			goto error_exit;
+		}
+
+		m_RxStreamError = false;
+		m_RxStopped = false;
+
+		// first run arms the waits
+		m_RxPool->post(&m_RxTask);
+	}
+	else {
+		m_RxThread = CreateThread(NULL, 0, &ScDev::RxMain, this, 0, &thread_id);
+		if (!m_RxThread) {
+			error = SC_DLL_ERROR_OUT_OF_MEM;
+			goto error_exit;
+		}
+	}
+
+	m_TxThread = CreateThread(NULL, 0, &ScDev::TxMain, this, 0, &thread_id);
+	if (!m_TxThread) {
+		error = SC_DLL_ERROR_OUT_OF_MEM;
+		goto error_exit;
 	}
 
-	if (m_TxFifoAvailable) {
-		CloseHandle(m_TxFifoAvailable);
-		m_TxFifoAvailable = nullptr;
-	}
+success_exit:
+	return error;
 
-	if (m_Stream) {
-		sc_can_stream_uninit(m_Stream);
-		m_Stream = nullptr;
+error_exit:
+	StopWorkers();
+	goto success_exit;
+}
+
+void ScDev::BusCleanup()
+{
+	assert(m_Initialized);
+
+	if (m_WorkerError.load(std::memory_order_acquire)) {
+		// start over with a fresh stream
+		StopWorkers();
+	}
+	else if (m_OnBus) {
+		Notify(NOTIFICATION_BUS_OFF, 0);
 	}
 
 	ZeroMemory(&m_TimeTracker, sizeof(m_TimeTracker));
@@ -1591,41 +2577,17 @@ void ScDev::SetBusOff()
 	BusCleanup();
 }
 
-int ScDev::SetBusOn()
+/* Puts the device on bus, with bus_off the device is still on bus
+ * and workers have already been taken off bus, see SetBus.
+ */
+int ScDev::SetBusOn(bool bus_off)
 {
 	int error = SC_DLL_ERROR_NONE;
-	DWORD thread_id = 0;
 	decltype(m_TxThreadNotificationValue)::value_type bitmask = 0;
 
 	assert(m_Initialized);
 	assert(m_Opened);
 
-	LOG_SRV(SC_DLL_LOG_LEVEL_DEBUG, "%s: set feature flags\n", m_DeviceName.c_str());
-	
-	error = SetFeatureFlags();
-
-	if (error) {
-		goto error_exit;
-	}
-
-	LOG_SRV(SC_DLL_LOG_LEVEL_DEBUG, "%s: set nominal bit timing\n", m_DeviceName.c_str());
-
-	error = SetNominalBitTiming();
-
-	if (error) {
-		goto error_exit;
-	}
-
-	if ((m_FeatureFlags & SC_FEATURE_FLAG_FDF) || (dev_info.feat_perm & SC_FEATURE_FLAG_FDF)) {
-		LOG_SRV(SC_DLL_LOG_LEVEL_DEBUG, "%s: set data bit timing\n", m_DeviceName.c_str());
-
-		error = SetDataBitTiming();
-
-		if (error) {
-			goto error_exit;
-		}
-	}
-
 	LOG_SRV(SC_DLL_LOG_LEVEL_DEBUG, "%s: clear MM error\n", m_DeviceName.c_str());
 
 	for (sc_com_dev_index_t i = 0; i < _countof(m_ComDeviceDataPrivate); ++i) {
@@ -1642,88 +2604,40 @@ int ScDev::SetBusOn()
 		}
 	}
 
-	sc_tt_init(&m_TimeTracker);
-
-	LOG_SRV(SC_DLL_LOG_LEVEL_DEBUG, "%s: init CAN stream\n", m_DeviceName.c_str());
-
-	assert(!m_Stream);
-	error = sc_can_stream_init(
-		m_Device,
-		can_info.msg_buffer_size,
-		this,
-		&ScDev::OnRx,
-		-1,
-		&m_Stream);
-
-	if (error) {
-		goto error_exit;
+	if (m_WorkerError.load(std::memory_order_acquire)) {
+		StopWorkers();
 	}
 
-	assert(!m_Stream->user_handle);
-
-	m_RxThreadNotificationEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
-	if (!m_RxThreadNotificationEvent) {
-		error = SC_DLL_ERROR_OUT_OF_MEM;
-		goto error_exit;
-	}
+	if (!RxRunning()) {
+		error = StartWorkers();
 
-	m_TxThreadNotificationEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
-	if (!m_TxThreadNotificationEvent) {
-		error = SC_DLL_ERROR_OUT_OF_MEM;
-		goto error_exit;
+		if (error) {
+			goto error_exit;
+		}
 	}
 
-	// CreateSemaphoreW fails if max count <= 0, https://docs.microsoft.com/en-us/windows/win32/api/synchapi/nf-synchapi-createsemaphorew
-	m_TxFifoAvailable = CreateSemaphoreW(nullptr, can_info.tx_fifo_size, can_info.tx_fifo_size, nullptr);
-	if (!m_TxFifoAvailable) {
-		error = SC_DLL_ERROR_OUT_OF_MEM;
-		goto error_exit;
-	}
+	// workers are off bus, safe to reset their state
+	sc_tt_init(&m_TimeTracker);
+	sc_dc_init(&m_RxThreadClock);
 
-	m_ThreadNotificationAcknowledgeCount = CreateSemaphoreW(nullptr, 0, 2, nullptr);
-	if (!m_ThreadNotificationAcknowledgeCount) {
-		error = SC_DLL_ERROR_OUT_OF_MEM;
-		goto error_exit;
-	}
+	// TX FIFO credits are the track ids
+	sc_track_ids_init(&m_TrackIds, can_info.tx_fifo_size);
+	m_TxFifoSize = can_info.tx_fifo_size;
 
-	m_RxThread = CreateThread(NULL, 0, &ScDev::RxMain, this, 0, &thread_id);
-	if (!m_RxThread) {
-		error = SC_DLL_ERROR_OUT_OF_MEM;
-		goto error_exit;
+	for (sc_com_dev_index_t i = 0; i < _countof(m_ComDeviceDataPrivate); ++i) {
+		m_ComDeviceDataPrivate[i].tx_sent = 0;
+		m_ComDeviceDataPrivate[i].tx_done.store(0, std::memory_order_relaxed);
 	}
 
-	m_TxThread = CreateThread(NULL, 0, &ScDev::TxMain, this, 0, &thread_id);
-	if (!m_TxThread) {
-		error = SC_DLL_ERROR_OUT_OF_MEM;
-		goto error_exit;
-	}
+	ResetEvent(m_TxFifoAvailable);
 
-	LOG_SRV(SC_DLL_LOG_LEVEL_DEBUG, "%s: go on bus\n", m_DeviceName.c_str());
+	LOG_SRV(SC_DLL_LOG_LEVEL_DEBUG, "%s: set feature flags, bit timing and go on bus\n", m_DeviceName.c_str());
 
-	sc_msg_config* bus = reinterpret_cast<sc_msg_config*>(m_CmdCtx.tx_buffer);
-	bus->id = SC_MSG_BUS;
-	bus->len = sizeof(*bus);
-	bus->arg = m_Device->dev_to_host16(1);
+	error = Configure(bus_off);
 
-	uint16_t bytes_out = 0;
-	error = sc_cmd_ctx_run(&m_CmdCtx, bus->len, &bytes_out, CMD_TIMEOUT_MS);
 	if (error) {
-		goto error_exit;
-	}
-
-	auto *e = reinterpret_cast<sc_msg_error*>(m_CmdCtx.rx_buffer);
-	if (bytes_out < sizeof(*e)) {
-		error = SC_DLL_ERROR_PROTO_VIOLATION;
-		goto error_exit;
-	}
-
-	if (e->id != SC_MSG_ERROR || e->len < sizeof(*e)) {
-		error = SC_DLL_ERROR_PROTO_VIOLATION;
-		goto error_exit;
-	}
-
-	if (e->error) {
-		error = map_device_error(e->error);
+		// the device handles each request of the batch, it may be on bus
+		m_OnBus = true;
 		goto error_exit;
 	}
 
@@ -1766,12 +2680,17 @@ int ScDev::SetBus(sc_com_dev_index_t index, bool on)
 		return SC_DLL_ERROR_INVALID_OPERATION;
 	}
 
-	SetBusOff();
-
 	if (on) {
-		return SetBusOn();
+		// SetBusOn takes the device off bus in the same transfer
+		bool const bus_off = m_OnBus;
+
+		BusCleanup();
+
+		return SetBusOn(bus_off);
 	}
 
+	SetBusOff();
+
 	return SC_DLL_ERROR_NONE;
 }
 
@@ -1830,6 +2749,115 @@ int ScDev::AddComDevice(XSuperCANDevice* device)
 	return SC_DLL_ERROR_NONE;
 }
 
+/* Switches the COM device from its private RX ring to the broadcast RX ring.
+ *
+ * The private ring's header still carries flags, error, and generation.
+ */
+int ScDev::EnableRxBroadcast(sc_com_dev_index_t index)
+{
+	assert(index < _countof(m_ComDeviceData));
+
+	Guard g(m_Lock);
+
+	if (!m_Mapped) {
+		return SC_DLL_ERROR_INVALID_OPERATION;
+	}
+
+	if (m_ComDeviceDataPrivate[index].rx_broadcast) {
+		return SC_DLL_ERROR_NONE;
+	}
+
+	if (m_OnBus) { // on bus
+		Notify(NOTIFICATION_BROADCAST, index);
+	}
+	else {
+		ComDeviceBroadcastRx(index);
+	}
+
+	return SC_DLL_ERROR_NONE;
+}
+
+/* Moves the COM device's log messages from its RX ring to its log ring, see ISuperCANDevice7::GetLogRingBufferMapping */
+int ScDev::EnableLogRing(sc_com_dev_index_t index)
+{
+	assert(index < _countof(m_ComDeviceData));
+
+	Guard g(m_Lock);
+
+	if (!m_Mapped) {
+		return SC_DLL_ERROR_INVALID_OPERATION;
+	}
+
+	if (m_ComDeviceDataPrivate[index].rx_log_ring) {
+		return SC_DLL_ERROR_NONE;
+	}
+
+	if (RxRunning()) {
+		Notify(NOTIFICATION_LOG_RING, index);
+	}
+	else {
+		ComDeviceLogRing(index);
+	}
+
+	return SC_DLL_ERROR_NONE;
+}
+
+/* Builds the COM device's filter off to the side, then has the RX thread switch to it */
+int ScDev::SetFilters(sc_com_dev_index_t index, sc_filter_rule const* rules, size_t count)
+{
+	assert(index < _countof(m_ComDeviceData));
+
+	Guard g(m_Lock);
+
+	auto* priv = &m_ComDeviceDataPrivate[index];
+	auto error = sc_filter_set(&priv->filters[priv->filter_index ^ 1], rules, count);
+
+	if (error) {
+		return error;
+	}
+
+	if (m_OnBus) { // on bus
+		Notify(NOTIFICATION_FILTER, index);
+	}
+	else {
+		priv->filter_index ^= 1;
+	}
+
+	return SC_DLL_ERROR_NONE;
+}
+
+/* Switches the COM device's private RX ring to format, see ISuperCANDevice6::SetRxRingFormat */
+int ScDev::SetRxFormat(sc_com_dev_index_t index, uint32_t format)
+{
+	assert(index < _countof(m_ComDeviceData));
+
+	if (format > SC_MM_FORMAT_VAR) {
+		return SC_DLL_ERROR_INVALID_PARAM;
+	}
+
+	Guard g(m_Lock);
+
+	if (!m_Mapped) {
+		return SC_DLL_ERROR_INVALID_OPERATION;
+	}
+
+	auto* priv = &m_ComDeviceDataPrivate[index];
+
+	if (priv->rx_format == format) {
+		return SC_DLL_ERROR_NONE;
+	}
+
+	if (m_OnBus) { // on bus
+		priv->rx_format_next = static_cast<uint8_t>(format);
+		Notify(NOTIFICATION_FORMAT, index);
+	}
+	else {
+		ComDeviceRxFormat(index, static_cast<uint8_t>(format));
+	}
+
+	return SC_DLL_ERROR_NONE;
+}
+
 void ScDev::RemoveComDevice(sc_com_dev_index_t index)
 {
 	assert(index < _countof(m_ComDeviceData));
@@ -1843,6 +2871,9 @@ void ScDev::RemoveComDevice(sc_com_dev_index_t index)
 
 	m_ComDeviceDataPrivate[index].com_device = nullptr;
 
+	m_Cyclic.remove_all(index);
+	WakeCyclicTx();
+
 	if (m_OnBus) { // on bus
 		Notify(NOTIFICATION_REMOVE, index);
 	}
@@ -1856,15 +2887,14 @@ void ScDev::ComDeviceAddedTx(sc_com_dev_index_t index)
 {
 	auto* priv = &m_ComDeviceDataPrivate[index];
 
-	priv->tx.index = priv->tx.hdr->get_index;
+	priv->tx_ring.attach(priv->tx.hdr, m_ComDeviceData[index].tx.elements);
 }
 
 void ScDev::ComDeviceRemovedTx(sc_com_dev_index_t index)
 {
 	auto* priv = &m_ComDeviceDataPrivate[index];
 
-	priv->tx.hdr->get_index = priv->tx.hdr->put_index;
-	priv->tx.index = priv->tx.hdr->put_index;
+	priv->tx_ring.skip_all();
 
 	ResetEvent(priv->tx.ev);
 }
@@ -1878,13 +2908,64 @@ void ScDev::ComDeviceRemovedRx(sc_com_dev_index_t index)
 	InterlockedExchange(&priv->rx.hdr->can_lost_status, 0);
 	InterlockedExchange(&priv->rx.hdr->can_lost_error, 0);
 	InterlockedExchange(&priv->rx.hdr->log_lost, 0);
+	InterlockedExchange(&priv->rx.hdr->client_flags, 0);
+
+	ComDeviceRxFormat(index, SC_MM_FORMAT_FIXED);
+
+	if (priv->rx_broadcast) {
+		priv->rx_broadcast = false;
+		m_BcRing.remove_client(index);
+	}
+
+	if (priv->rx_log_ring) {
+		priv->rx_log_ring = false;
+		priv->log_ring.reset();
+		InterlockedExchange(&priv->log_ring.header()->log_lost, 0);
+		InterlockedExchange(&priv->log_ring.header()->client_flags, 0);
+	}
 
-	priv->rx.hdr->put_index = priv->rx.index;
-	priv->rx.hdr->get_index = priv->rx.index;
+	sc_filter_uninit(&priv->filters[0]);
+	sc_filter_uninit(&priv->filters[1]);
 	
 	ResetEvent(priv->rx.ev);
 }
 
+void ScDev::ComDeviceBroadcastRx(sc_com_dev_index_t index)
+{
+	auto* priv = &m_ComDeviceDataPrivate[index];
+
+	priv->rx_broadcast = true;
+	m_BcRing.add_client(index);
+}
+
+void ScDev::ComDeviceLogRing(sc_com_dev_index_t index)
+{
+	auto* priv = &m_ComDeviceDataPrivate[index];
+
+	priv->log_ring.reset();
+	InterlockedExchange(&priv->log_ring.header()->log_lost, 0);
+	priv->rx_log_ring = true;
+}
+
+/* Empties the COM device's private RX ring and continues in format */
+void ScDev::ComDeviceRxFormat(sc_com_dev_index_t index, uint8_t format)
+{
+	auto* priv = &m_ComDeviceDataPrivate[index];
+	auto const elements = m_ComDeviceData[index].rx.elements;
+
+	if (SC_MM_FORMAT_VAR == format) {
+		priv->rx_var_ring.attach(priv->rx.hdr, elements);
+		priv->rx_var_ring.reset();
+	}
+	else {
+		priv->rx_ring.attach(priv->rx.hdr, elements);
+		priv->rx_ring.reset();
+	}
+
+	priv->rx_format = format;
+	InterlockedExchange(&priv->rx.hdr->format, format);
+}
+
 
 DWORD ScDev::RxMain(void* self)
 {
@@ -1898,8 +2979,8 @@ void ScDev::RxMain()
 	auto stream_error = false;
 	HANDLE handles[] = {
 		m_RxThreadNotificationEvent,
-		m_LogEvent,
-		nullptr,
+		nullptr, // stream
+		m_LogEvent, // on bus only, log messages are kept until then
 	};
 
 	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST);
@@ -1917,7 +2998,7 @@ void ScDev::RxMain()
 			}
 		}
 		else {
-			auto error = sc_can_stream_rx_next_wait_handle(m_Stream, &handles[2]);
+			auto error = sc_can_stream_rx_next_wait_handle(m_Stream, &handles[1]);
 
 			if (error) {
 				SetDeviceError(error);
@@ -1925,9 +3006,10 @@ void ScDev::RxMain()
 				stream_error = true;
 			}
 			else {
-				DWORD r = WaitForMultipleObjects(static_cast<DWORD>(_countof(handles)), handles, FALSE, INFINITE);
+				DWORD const count = m_RxThreadOnBus ? static_cast<DWORD>(_countof(handles)) : 2;
+				DWORD r = WaitForMultipleObjects(count, handles, FALSE, INFINITE);
 
-				if (r >= WAIT_OBJECT_0 && r < WAIT_OBJECT_0 + _countof(handles)) {
+				if (r >= WAIT_OBJECT_0 && r < WAIT_OBJECT_0 + count) {
 					auto rx_notification_had_work = false;
 					auto log_had_work = false;
 					auto rx_had_work = false;
@@ -1938,9 +3020,17 @@ void ScDev::RxMain()
 					 * https://docs.microsoft.com/en-us/windows/win32/api/synchapi/nf-synchapi-waitformultipleobjects
 					 */
 					ProcessRxNotification(&done, &rx_notification_had_work);
-					ProcessLog(&log_had_work);
+
+					if (m_RxThreadOnBus) {
+						ProcessLog(&log_had_work);
+					}
+
 					ProcessRxStream(&stream_error, &rx_had_work);
 
+					if (m_RxThreadOnBus) {
+						WakeRxClients();
+					}
+
 					if (!rx_notification_had_work &&
 						!log_had_work &&
 						!rx_had_work) {
@@ -1953,44 +3043,149 @@ void ScDev::RxMain()
 				else {
 					auto e = GetLastError();
 
-					SetDeviceError(sc_map_win_error(m_Device, e));
-					LogFormatDirect(SC_DLL_LOG_LEVEL_ERROR, "WaitForMultipleObjects failed: %lu (error=%lu)\n", r, e);
-					stream_error = true;
-				}
-			}
-		}
+					SetDeviceError(sc_map_win_error(m_Device, e));
+					LogFormatDirect(SC_DLL_LOG_LEVEL_ERROR, "WaitForMultipleObjects failed: %lu (error=%lu)\n", r, e);
+					stream_error = true;
+				}
+			}
+		}
+	}
+}
+
+void ScDev::RxRun(void* self)
+{
+	static_cast<ScDev*>(self)->RxRun();
+}
+
+/* One pass of the RX thread loop on the shared pool.
+ *
+ * Instead of blocking, the pass ends by arming the waits which post
+ * the task again. Waits on handles that are still signaled fire right
+ * away so there is no need to loop here.
+ */
+void ScDev::RxRun()
+{
+	auto done = false;
+	auto rx_notification_had_work = false;
+	auto log_had_work = false;
+	auto rx_had_work = false;
+
+	if (m_RxStopped) {
+		return;
+	}
+
+	ProcessRxNotification(&done, &rx_notification_had_work);
+
+	if (done) {
+		m_RxStopped = true;
+		SetEvent(m_RxDone);
+		return;
+	}
+
+	if (!m_RxStreamError) {
+		if (m_RxThreadOnBus) {
+			ProcessLog(&log_had_work);
+		}
+
+		ProcessRxStream(&m_RxStreamError, &rx_had_work);
+
+		if (m_RxThreadOnBus) {
+			WakeRxClients();
+		}
+	}
+
+	RxArm();
+}
+
+void ScDev::RxArm()
+{
+	SetThreadpoolWait(m_RxWaits[RX_WAIT_NOTIFICATION], m_RxThreadNotificationEvent, nullptr);
+
+	if (m_RxStreamError) {
+		// continue to service requests, especially the ones that require acknowledge
+		return;
+	}
+
+	HANDLE stream = nullptr;
+	auto error = sc_can_stream_rx_next_wait_handle(m_Stream, &stream);
+
+	if (error) {
+		SetDeviceError(error);
+		LogFormatDirect(SC_DLL_LOG_LEVEL_ERROR, "sc_can_stream_rx_next_wait_handle failed: %s (%d)\n", sc_strerror(error), error);
+		m_RxStreamError = true;
+		return;
+	}
+
+	SetThreadpoolWait(m_RxWaits[RX_WAIT_STREAM], stream, nullptr);
+
+	if (m_RxThreadOnBus) {
+		SetThreadpoolWait(m_RxWaits[RX_WAIT_LOG], m_LogEvent, nullptr);
 	}
 }
 
+void CALLBACK ScDev::OnRxWait(PTP_CALLBACK_INSTANCE instance, void* self, PTP_WAIT wait, TP_WAIT_RESULT result)
+{
+	auto* dev = static_cast<ScDev*>(self);
+
+	(void)instance;
+	(void)wait;
+	(void)result;
+
+	dev->m_RxPool->post(&dev->m_RxTask);
+}
+
 void ScDev::ProcessLog(bool* performed_work)
 {
 	*performed_work = false;
 
-	Guard g(m_LogLock);
-
+	// Producers push, then signal. Resetting ahead of draining
+	// can't lose a wakeup.
 	ResetEvent(m_LogEvent);
 
-	if (m_LogLost) {
+	auto const lost = m_LogLost.exchange(0, std::memory_order_relaxed);
+
+	if (lost) {
 		for (sc_com_dev_index_t i = 0; i < m_RxThreadLiveComDevCount; ++i) {
 			auto com_dev_index = m_RxThreadLiveComDevBuffer[i];
 			auto* priv = &m_ComDeviceDataPrivate[com_dev_index];
 
-			InterlockedAdd((volatile LONG*)&priv->rx.hdr->log_lost, (LONG)m_LogLost);
-			SetEvent(priv->rx.ev);
+			if (priv->rx_log_ring) {
+				InterlockedAdd((volatile LONG*)&priv->log_ring.header()->log_lost, (LONG)lost);
+				priv->log_ring.notify();
+			}
+			else {
+				InterlockedAdd((volatile LONG*)&priv->rx.hdr->log_lost, (LONG)lost);
+
+				if (SC_MM_FORMAT_VAR == priv->rx_format) {
+					priv->rx_var_ring.notify();
+				}
+				else {
+					priv->rx_ring.notify();
+				}
+			}
 		}
 
-		m_LogLost = 0;
+		for (uint8_t i = 0; i < MAX_COM_DEVICES_PER_SC_DEVICE; ++i) {
+			if (m_BcRing.clients() & (1u << i)) {
+				InterlockedAdd((volatile LONG*)&m_BcRing.client(i)->log_lost, (LONG)lost);
+			}
+		}
 
 		*performed_work = true;
 	}
 
-	if (m_LogRingGetIndex != m_LogRingPutIndex) {
-		do {
-			const unsigned index = m_LogRingGetIndex++ % _countof(m_LogRingBuffer);
-			log_entry const* const e = &m_LogRingBuffer[index];
+	// chunk a batch of entries once, then hand the slots to each COM device in one go
+	uint32_t count = 0;
+	auto const entries = m_LogQueue.drain([&](log_entry const* e) {
+		count += ChunkLogMessage(e, &m_RxThreadLogSlots[count]);
+	}, LOG_BATCH_SIZE);
+
+	if (entries) {
+		StoreLogSlots(m_RxThreadLogSlots, count);
 
-			StoreLogMessage(e);
-		} while (m_LogRingGetIndex != m_LogRingPutIndex);
+		if (!m_LogQueue.empty()) {
+			SetEvent(m_LogEvent); // next round, CAN data goes first
+		}
 
 		*performed_work = true;
 	}
@@ -2000,6 +3195,14 @@ void ScDev::ProcessRxStream(bool* stream_error, bool* performed_work)
 {
 	*performed_work = false;
 
+	if (m_RxThreadTracing) {
+		uint64_t ticks;
+
+		// messages handled by the call below arrived before now
+		QueryPerformanceCounter((LARGE_INTEGER*)&ticks);
+		m_RxThreadHostUs = qpc_to_us(ticks, m_QpcFrequency);
+	}
+
 	auto error = sc_can_stream_rx(m_Stream, 0);
 
 	if (error) {
@@ -2018,6 +3221,33 @@ void ScDev::ProcessRxStream(bool* stream_error, bool* performed_work)
 	}
 }
 
+/* Signals each client at most once for all messages stored since the last call.
+ * Clients that advertise polling in their RX ring header aren't signaled at all.
+ */
+void ScDev::WakeRxClients()
+{
+	for (sc_com_dev_index_t i = 0; i < m_RxThreadLiveComDevCount; ++i) {
+		auto com_dev_index = m_RxThreadLiveComDevBuffer[i];
+		auto* priv = &m_ComDeviceDataPrivate[com_dev_index];
+
+		// only the ring in use can have a wakeup pending
+		bool const rx = priv->rx_ring.wake() || priv->rx_var_ring.wake();
+
+		// the log ring shares the RX ring's event
+		if (priv->log_ring.wake() || rx) {
+			SetEvent(priv->rx.ev);
+		}
+	}
+
+	uint32_t bc = m_BcRing.wake();
+
+	for (uint8_t i = 0; bc; ++i, bc >>= 1) {
+		if (bc & 1) {
+			SetEvent(m_ComDeviceDataPrivate[i].rx.ev);
+		}
+	}
+}
+
 void ScDev::ProcessRxNotification(bool *done, bool* performed_work)
 {
 	uint8_t code = 0;
@@ -2041,14 +3271,69 @@ void ScDev::ProcessRxNotification(bool *done, bool* performed_work)
 			}
 		}
 
+		m_RxThreadOnBus = true;
 		ReleaseSemaphore(m_ThreadNotificationAcknowledgeCount, 1, NULL);
 		break;
 
+	case NOTIFICATION_BUS_OFF:
+		m_RxThreadOnBus = false;
+		m_RxThreadLiveComDevCount = 0;
+
+		if (m_RxThreadRecording) {
+			m_Recorder.flush();
+		}
+
+		ReleaseSemaphore(m_ThreadNotificationAcknowledgeCount, 1, nullptr);
+		break;
+
+	case NOTIFICATION_RECORD:
+		m_RxThreadRecording = value != 0;
+		ReleaseSemaphore(m_ThreadNotificationAcknowledgeCount, 1, nullptr);
+		break;
+
+	case NOTIFICATION_TRACE:
+		m_RxThreadTracing = value != 0;
+
+		if (m_RxThreadTracing) {
+			ResetTxLatency();
+		}
+
+		ReleaseSemaphore(m_ThreadNotificationAcknowledgeCount, 1, nullptr);
+		break;
+
 	case NOTIFICATION_ADD:
 		m_RxThreadLiveComDevBuffer[m_RxThreadLiveComDevCount++] = static_cast<sc_com_dev_index_t>(value);
 		ReleaseSemaphore(m_ThreadNotificationAcknowledgeCount, 1, nullptr);
 		break;
 
+	case NOTIFICATION_BROADCAST:
+		ComDeviceBroadcastRx(static_cast<sc_com_dev_index_t>(value));
+		ReleaseSemaphore(m_ThreadNotificationAcknowledgeCount, 1, nullptr);
+		break;
+
+	case NOTIFICATION_FILTER:
+		m_ComDeviceDataPrivate[value].filter_index ^= 1;
+		ReleaseSemaphore(m_ThreadNotificationAcknowledgeCount, 1, nullptr);
+		break;
+
+	case NOTIFICATION_FORMAT:
+		ComDeviceRxFormat(static_cast<sc_com_dev_index_t>(value), m_ComDeviceDataPrivate[value].rx_format_next);
+		ReleaseSemaphore(m_ThreadNotificationAcknowledgeCount, 1, nullptr);
+		break;
+
+	case NOTIFICATION_LOG_RING:
+		ComDeviceLogRing(static_cast<sc_com_dev_index_t>(value));
+		ReleaseSemaphore(m_ThreadNotificationAcknowledgeCount, 1, nullptr);
+		break;
+
+	case NOTIFICATION_LOG_QUEUE: {
+		uint32_t dropped = 0;
+
+		m_LogQueue.resize(m_LogQueueSizeNext, &dropped);
+		m_LogLost += dropped;
+		ReleaseSemaphore(m_ThreadNotificationAcknowledgeCount, 1, nullptr);
+	} break;
+
 	case NOTIFICATION_REMOVE: {
 		ComDeviceRemovedRx(static_cast<sc_com_dev_index_t>(value));
 
@@ -2064,8 +3349,14 @@ void ScDev::ProcessRxNotification(bool *done, bool* performed_work)
 			auto const com_dev_index = m_TxrMap[i].index.load(std::memory_order_acquire);
 
 			if (value == com_dev_index) {
+				auto* tx_done = &m_ComDeviceDataPrivate[value].tx_done;
+
 				m_TxrMap[i].index.store(MAX_COM_DEVICES_PER_SC_DEVICE, std::memory_order_release);
-				ReleaseSemaphore(m_TxFifoAvailable, 1, nullptr);
+				tx_done->store(tx_done->load(std::memory_order_relaxed) + 1, std::memory_order_release);
+
+				if (sc_track_id_free(&m_TrackIds, static_cast<uint32_t>(i))) {
+					SetEvent(m_TxFifoAvailable);
+				}
 			}
 		}
 
@@ -2084,42 +3375,221 @@ DWORD ScDev::TxMain(void* self)
 
 void ScDev::TxMain()
 {
-	const unsigned TX_HANDLE_OFFSET = 1;
+	const unsigned TX_HANDLE_OFFSET = 3;
 	HANDLE handles[TX_HANDLE_OFFSET + MAX_COM_DEVICES_PER_SC_DEVICE];
-	uint32_t aligned_sc_msg_can_tx_buffer[25];
-	sc_msg_can_tx* tx = reinterpret_cast<sc_msg_can_tx*>(aligned_sc_msg_can_tx_buffer);
-	uint8_t* sc_msg_can_tx_data;
+	uint8_t sc_msg_can_tx_id;
 	uint8_t sc_msg_can_tx_len;
 	sc_com_dev_index_t live_com_dev_buffer[MAX_COM_DEVICES_PER_SC_DEVICE];
 	sc_com_dev_index_t live_com_dev_count = 0;
 	auto stream_error = false;
+	uint64_t qpc_freq = 1;
+	uint64_t cyclic_armed_us = sc::cyclic_tx::NEVER;
+	auto tracing = m_Tracing;
+	uint8_t trace_pending[SC_TRACK_IDS]; // track ids of traced frames in the USB buffer
+	unsigned trace_pending_count = 0;
 
 	if (dev_info.fw_ver_major > 1 || dev_info.fw_ver_minor >= 6) {
-		tx->id = SC_MSG_CAN_TX4;
-		sc_msg_can_tx_data = &tx->data[3];
+		sc_msg_can_tx_id = SC_MSG_CAN_TX4;
 		sc_msg_can_tx_len = sizeof(sc_msg_can_tx4);
 	}
 	else {
-		tx->id = SC_MSG_CAN_TX;
-		sc_msg_can_tx_data = tx->data;
+		sc_msg_can_tx_id = SC_MSG_CAN_TX;
 		sc_msg_can_tx_len = sizeof(sc_msg_can_tx);
 	}
 
 	assert(m_TxThreadNotificationEvent);
+	assert(m_TxCyclicEvent);
+	assert(m_TxCyclicTimer);
 	handles[0] = m_TxThreadNotificationEvent;
+	handles[1] = m_TxCyclicEvent;
+	handles[2] = m_TxCyclicTimer;
+
+	QueryPerformanceFrequency((LARGE_INTEGER*)&qpc_freq);
+
+	auto now_us = [&] {
+		uint64_t ticks;
+
+		QueryPerformanceCounter((LARGE_INTEGER*)&ticks);
+
+		return qpc_to_us(ticks, qpc_freq);
+	};
 
 	for (sc_com_dev_index_t i = 0; i < _countof(m_ComDeviceData); ++i) {
 		assert(m_ComDeviceDataPrivate[i].tx.ev);
 		handles[TX_HANDLE_OFFSET + i] = m_ComDeviceDataPrivate[i].tx.ev;
 	}
 
+	/* Takes a track id, if block is set waits for the device to
+	 * return one for up to a millisecond.
+	 *
+	 * *txr_slot is negative if no id is available.
+	 */
+	auto acquire_track_id = [&](bool block, int* txr_slot) {
+		*txr_slot = sc_track_id_alloc(&m_TrackIds);
+
+		if (*txr_slot < 0 && block) {
+			sc_track_ids_wait(&m_TrackIds);
+			*txr_slot = sc_track_id_alloc(&m_TrackIds);
+
+			if (*txr_slot < 0) {
+				// wait with a timeout to prevent spinning
+				auto r = WaitForSingleObject(m_TxFifoAvailable, 1);
+
+				if (WAIT_OBJECT_0 == r) {
+					*txr_slot = sc_track_id_alloc(&m_TrackIds);
+				}
+				else if (WAIT_TIMEOUT != r) {
+					auto error = sc_map_win_error(m_Device, GetLastError());
+
+					SetDeviceError(error);
+
+					return error;
+				}
+			}
+		}
+
+		return SC_DLL_ERROR_NONE;
+	};
+
+	/* Submits the USB buffer. While tracing, frames in the buffer are
+	 * stamped once the submit returned which includes any wait for the
+	 * DLL to free a buffer.
+	 */
+	auto submit = [&] {
+		auto error = sc_can_stream_tx_batch_end(m_Stream);
+
+		if (trace_pending_count) {
+			uint64_t const now = now_us();
+
+			for (unsigned i = 0; i < trace_pending_count; ++i) {
+				m_TxTrace[trace_pending[i]].submit_us.store(now, std::memory_order_relaxed);
+			}
+
+			trace_pending_count = 0;
+		}
+
+		return error;
+	};
+
+	// encodes the frame directly into the USB buffer
+	auto send = [&](sc_com_dev_index_t com_dev_index, sc_mm_can_tx const* frame, int txr_slot) {
+		uint16_t len = sc_msg_can_tx_len;
+		uint8_t const dlc = frame->dlc & 0xf;
+		uint8_t const data_len = dlc_to_len(dlc);
+		uint8_t const rtr = frame->flags & SC_CAN_FRAME_FLAG_RTR;
+
+		if (!rtr) {
+			len += data_len;
+		}
+
+		if (len & (SC_MSG_CAN_LEN_MULTIPLE - 1)) {
+			len += SC_MSG_CAN_LEN_MULTIPLE - (len & (SC_MSG_CAN_LEN_MULTIPLE - 1));
+		}
+
+		assert(MAX_COM_DEVICES_PER_SC_DEVICE == m_TxrMap[txr_slot].index.load(std::memory_order_relaxed));
+		auto* echo = &m_TxEchoMap[txr_slot];
+
+		echo->dlc = frame->dlc;
+		echo->can_id = frame->can_id;
+		echo->track_id = frame->track_id;
+		memcpy(echo->data, frame->data, data_len);
+
+		auto* trace = &m_TxTrace[txr_slot];
+
+		trace->dequeue_us = tracing ? now_us() : 0;
+		trace->submit_us.store(0, std::memory_order_relaxed);
+
+		m_TxrMap[txr_slot].index.store(static_cast<uint32_t>(com_dev_index), std::memory_order_release);
+
+		uint8_t* buffer = nullptr;
+
+		for (;;) {
+			auto error = sc_can_stream_tx_reserve(m_Stream, len, &buffer);
+
+			if (!error) {
+				break;
+			}
+
+			if (SC_DLL_ERROR_BUFFER_TOO_SMALL != error) {
+				LogFormatQueue(SC_DLL_LOG_LEVEL_ERROR, "sc_can_stream_tx_reserve failed: %s (%d)\n", sc_strerror(error), error);
+				SetDeviceError(error);
+				return error;
+			}
+
+			error = submit();
+			if (error) {
+				LogFormatQueue(SC_DLL_LOG_LEVEL_ERROR, "sc_can_stream_tx_batch_end failed: %s (%d)\n", sc_strerror(error), error);
+				SetDeviceError(error);
+				return error;
+			}
+
+			error = sc_can_stream_tx_batch_begin(m_Stream);
+			if (error) {
+				LogFormatQueue(SC_DLL_LOG_LEVEL_ERROR, "sc_can_stream_tx_batch_begin failed: %s (%d)\n", sc_strerror(error), error);
+				SetDeviceError(error);
+				return error;
+			}
+		}
+
+		auto* tx = reinterpret_cast<sc_msg_can_tx*>(buffer);
+
+		// clear padding and reserved bytes
+		memset(buffer + len - SC_MSG_CAN_LEN_MULTIPLE, 0, SC_MSG_CAN_LEN_MULTIPLE);
+		memset(buffer + sizeof(sc_msg_can_tx), 0, sc_msg_can_tx_len - sizeof(sc_msg_can_tx));
+
+		tx->id = sc_msg_can_tx_id;
+		tx->len = static_cast<uint8_t>(len);
+		tx->dlc = dlc;
+		tx->flags = frame->flags;
+		tx->can_id = m_Device->dev_to_host32(frame->can_id);
+		tx->track_id = static_cast<uint8_t>(txr_slot);
+
+		if (!rtr) {
+			memcpy(buffer + sc_msg_can_tx_len, frame->data, data_len);
+		}
+
+		sc_can_stream_tx_commit(m_Stream, len);
+
+		if (tracing) {
+			trace_pending[trace_pending_count++] = static_cast<uint8_t>(txr_slot);
+		}
+
+		return SC_DLL_ERROR_NONE;
+	};
+
 	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST);
 
 	auto batch_started = false;
+	auto on_bus = false;
 
 	for (;;) {
+		if (on_bus && !stream_error) {
+			/* One wakeup per tick at most, ticks without due frames
+			 * are skipped (see timer_wheel::next).
+			 */
+			uint64_t const next_us = m_Cyclic.next_us();
+
+			if (next_us != cyclic_armed_us && sc::cyclic_tx::NEVER != next_us) {
+				uint64_t const now = now_us();
+				LARGE_INTEGER due;
+
+				// relative, in 100 ns units
+				due.QuadPart = next_us > now ? -static_cast<LONGLONG>((next_us - now) * 10) : -1;
+
+				if (SetWaitableTimer(m_TxCyclicTimer, &due, 0, nullptr, nullptr, FALSE)) {
+					cyclic_armed_us = next_us;
+				}
+				else {
+					auto e = GetLastError();
+
+					SetDeviceError(sc_map_win_error(m_Device, e));
+					LogFormatQueue(SC_DLL_LOG_LEVEL_ERROR, "SetWaitableTimer failed (error=%lu)\n", e);
+					stream_error = true;
+				}
+			}
+		}
+
 		auto r = WaitForMultipleObjects(static_cast<DWORD>(_countof(handles)), handles, FALSE, INFINITE);
-		auto finish_batch = true;
 
 		if (r >= WAIT_OBJECT_0 && r < WAIT_OBJECT_0 + _countof(handles)) {
 			const auto handle_index = r - WAIT_OBJECT_0;
@@ -2148,8 +3618,19 @@ void ScDev::TxMain()
 						}
 					}
 
+					on_bus = true;
+					m_Cyclic.apply(now_us());
+					m_Cyclic.start(now_us());
 					ReleaseSemaphore(m_ThreadNotificationAcknowledgeCount, 1, NULL);
 				} break;
+				case NOTIFICATION_BUS_OFF:
+					on_bus = false;
+					live_com_dev_count = 0;
+					m_Cyclic.stop();
+					CancelWaitableTimer(m_TxCyclicTimer);
+					cyclic_armed_us = sc::cyclic_tx::NEVER;
+					ReleaseSemaphore(m_ThreadNotificationAcknowledgeCount, 1, NULL);
+					break;
 				case NOTIFICATION_ADD: {
 					live_com_dev_buffer[live_com_dev_count++] = static_cast<sc_com_dev_index_t>(value);
 					ComDeviceAddedTx(static_cast<sc_com_dev_index_t>(value));
@@ -2164,193 +3645,313 @@ void ScDev::TxMain()
 							break;
 						}
 					}
-					ReleaseSemaphore(m_ThreadNotificationAcknowledgeCount, 1, NULL);
-				} break;
-				case NOTIFICATION_NONE:
-					// for manual reset event this could be active a bit
-					Sleep(0); // yield
+					ReleaseSemaphore(m_ThreadNotificationAcknowledgeCount, 1, NULL);
+				} break;
+				case NOTIFICATION_TRACE:
+					tracing = value != 0;
+					trace_pending_count = 0;
+					ReleaseSemaphore(m_ThreadNotificationAcknowledgeCount, 1, NULL);
+					break;
+				case NOTIFICATION_BROADCAST:
+				case NOTIFICATION_FILTER:
+				case NOTIFICATION_FORMAT:
+				case NOTIFICATION_RECORD:
+				case NOTIFICATION_LOG_RING:
+				case NOTIFICATION_LOG_QUEUE:
+					// RX only
+					ReleaseSemaphore(m_ThreadNotificationAcknowledgeCount, 1, NULL);
+					break;
+				case NOTIFICATION_NONE:
+					// for manual reset event this could be active a bit
+					Sleep(0); // yield
+					break;
+				}
+			}
+			else if (m_TxCyclicTimer == handle) {
+				cyclic_armed_us = sc::cyclic_tx::NEVER;
+			}
+		}
+		else if (WAIT_TIMEOUT == r) {
+			// ?
+		}
+		else {
+			auto e = GetLastError();
+
+			SetDeviceError(sc_map_win_error(m_Device, e));
+			LogFormatQueue(SC_DLL_LOG_LEVEL_ERROR, "WaitForMultipleObjects failed: %lu (error=%lu)\n", r, e);
+			stream_error = true;
+		}
+
+		// take definition changes even off bus
+		m_Cyclic.apply(now_us());
+
+		if (stream_error) {
+			// Do continue to serice requests that require acknowledge.
+			goto service_end;
+		}
+
+		if (!on_bus) {
+			goto service_end;
+		}
+
+		if (!batch_started) {
+			auto error = sc_can_stream_tx_batch_begin(m_Stream);
+
+			if (error) {
+				SetDeviceError(error);
+				stream_error = true;
+				goto service_end;
+			}
+
+			batch_started = true;
+		}
+
+		{
+			/* Cyclic frames are due now and go ahead of the clients' rings.
+			 * Frames that don't fit into the TX FIFO stay queued.
+			 */
+			sc_mm_can_tx const* frame = nullptr;
+			uint8_t owner = 0;
+
+			m_Cyclic.run(now_us());
+
+			for (bool first = true; m_Cyclic.front(&owner, &frame); first = false) {
+				int txr_slot = -1;
+				auto error = acquire_track_id(first, &txr_slot);
+
+				if (error) {
+					stream_error = true;
+					goto service_end;
+				}
+
+				if (txr_slot < 0) {
+					// come back once the device has caught up
+					SetEvent(m_TxCyclicEvent);
+					break;
+				}
+
+				error = send(owner, frame, txr_slot);
+
+				if (error) {
+					stream_error = true;
+					goto service_end;
+				}
+
+				++m_ComDeviceDataPrivate[owner].tx_sent;
+				m_Cyclic.pop();
+			}
+		}
+
+		if (SC_TX_SCHED_PRIO == m_TxScheduling.load(std::memory_order_relaxed)) {
+			/* Sends the client's frame that wins arbitration first. Each
+			 * client may only occupy its share of the TX FIFO.
+			 *
+			 * Frames taken are released to the clients once at the end.
+			 */
+			uint32_t const credits = sc_tx_prio_credits(m_TxFifoSize, live_com_dev_count);
+			uint32_t taken[MAX_COM_DEVICES_PER_SC_DEVICE] = { 0 };
+			uint32_t backlog = 0;
+			bool waited = false;
+			sc_tx_prio_t prio;
+
+			for (;;) {
+				bool capped = false;
+				int txr_slot = -1;
+
+				sc_tx_prio_init(&prio);
+				backlog = 0;
+
+				for (sc_com_dev_index_t i = 0; i < live_com_dev_count; ++i) {
+					sc_com_dev_index_t const com_dev_index = live_com_dev_buffer[i];
+					auto* data = &m_ComDeviceData[com_dev_index];
+					auto* priv = &m_ComDeviceDataPrivate[com_dev_index];
+					sc_can_mm_slot_t const* slot = nullptr;
+					uint32_t used = 0;
+
+					if (priv->tx_ring.readable(&used)) {
+						// rogue client
+						LogFormatQueue(SC_DLL_LOG_LEVEL_WARNING, "TX ring index=%u gi=%lu pi=%lu elements=%lu is inconsistent, resetting ring\n",
+							com_dev_index,
+							static_cast<unsigned long>(priv->tx.hdr->get_index),
+							static_cast<unsigned long>(priv->tx.hdr->put_index),
+							static_cast<unsigned long>(data->tx.elements));
+
+						priv->tx_ring.skip_all();
+						taken[com_dev_index] = 0;
+						continue;
+					}
+
+					for (used -= taken[com_dev_index]; used; --used, ++taken[com_dev_index]) {
+						slot = priv->tx_ring.slot(taken[com_dev_index]);
+
+						if (SC_MM_DATA_TYPE_CAN_TX == slot->tx.type) {
+							break;
+						}
+
+						// drop
+						LogFormatQueue(SC_DLL_LOG_LEVEL_WARNING, "TX ring index=%u unhandled entry type=%d will be ignored\n",
+							(priv->tx_ring.index() + taken[com_dev_index]) % data->tx.elements, slot->tx.type);
+					}
+
+					if (!used) {
+						continue;
+					}
+
+					backlog |= 1u << com_dev_index;
+
+					if (priv->tx_sent - priv->tx_done.load(std::memory_order_acquire) >= credits) {
+						capped = true;
+						continue;
+					}
+
+					sc_tx_prio_set(&prio, com_dev_index, sc_tx_prio_key(slot->tx.can_id, slot->tx.flags));
+				}
+
+				int const source = sc_tx_prio_pick(&prio);
+
+				if (source < 0) {
+					if (capped && !waited) {
+						// wait for the device to finish a frame
+						waited = true;
+						sc_track_ids_wait(&m_TrackIds);
+						r = WaitForSingleObject(m_TxFifoAvailable, 1);
+
+						if (WAIT_OBJECT_0 != r && WAIT_TIMEOUT != r) {
+							SetDeviceError(sc_map_win_error(m_Device, GetLastError()));
+							stream_error = true;
+							goto service_end;
+						}
+
+						continue;
+					}
+
 					break;
 				}
-			}
-		}
-		else if (WAIT_TIMEOUT == r) {
-			// ?
-		}
-		else {
-			auto e = GetLastError();
 
-			SetDeviceError(sc_map_win_error(m_Device, e));
-			LogFormatQueue(SC_DLL_LOG_LEVEL_ERROR, "WaitForMultipleObjects failed: %lu (error=%lu)\n", r, e);
-			stream_error = true;
-		}
+				auto error = acquire_track_id(!waited, &txr_slot);
 
-		if (stream_error) {
-			// Do continue to serice requests that require acknowledge.
-			goto service_end;
-		}
+				if (error) {
+					stream_error = true;
+					goto service_end;
+				}
 
-		if (!batch_started) {
-			auto error = sc_can_stream_tx_batch_begin(m_Stream);
+				if (txr_slot < 0) {
+					if (waited) {
+						break;
+					}
 
-			if (error) {
-				SetDeviceError(error);
-				stream_error = true;
-				goto service_end;
-			}
+					waited = true;
+					continue;
+				}
 
-			batch_started = true;
-		}
+				auto* priv = &m_ComDeviceDataPrivate[source];
+
+				error = send(static_cast<sc_com_dev_index_t>(source), &priv->tx_ring.slot(taken[source])->tx, txr_slot);
 
-		for (bool done = false; !done; ) {
-			done = true;
+				if (error) {
+					stream_error = true;
+					goto service_end;
+				}
+
+				++taken[source];
+				++priv->tx_sent;
+			}
 
 			for (sc_com_dev_index_t i = 0; i < live_com_dev_count; ++i) {
 				sc_com_dev_index_t const com_dev_index = live_com_dev_buffer[i];
-				auto* data = &m_ComDeviceData[com_dev_index];
 				auto* priv = &m_ComDeviceDataPrivate[com_dev_index];
-				auto gi = priv->tx.hdr->get_index;
-				auto pi = priv->tx.hdr->put_index;
-				auto used = pi - gi;
-
-				if (gi != priv->tx.index || used > data->tx.elements) {
-					// rogue client
-					LogFormatQueue(SC_DLL_LOG_LEVEL_WARNING, "TX ring index=%u gi=%lu pi=%lu used=%lu elements=%lu is inconsistent, resetting ring\n",
-						com_dev_index,
-						static_cast<unsigned long>(gi),
-						static_cast<unsigned long>(pi),
-						static_cast<unsigned long>(used),
-						static_cast<unsigned long>(data->tx.elements));
-
-					priv->tx.index = pi;
-					priv->tx.hdr->get_index = pi;
+
+				if (taken[com_dev_index]) {
+					priv->tx_ring.consume(taken[com_dev_index]);
 				}
-				else if (used) {
-					auto const slot_index = priv->tx.index % data->tx.elements;
-					sc_can_mm_slot_t* slot = &priv->tx.hdr->elements[slot_index];
 
-					if (SC_MM_DATA_TYPE_CAN_TX == slot->tx.type) {
-						// wait with a timeout to prevent spinning
-						r = WaitForSingleObject(m_TxFifoAvailable, 1);
-						if (WAIT_OBJECT_0 == r) {
-							uint16_t len = sc_msg_can_tx_len;
-							uint8_t const dlc = slot->tx.dlc & 0xf;
-							uint8_t const data_len = dlc_to_len(dlc);
-
-							if (!(slot->tx.flags & SC_CAN_FRAME_FLAG_RTR)) {
-								len += data_len;
-								memcpy(sc_msg_can_tx_data, slot->tx.data, data_len);
-							}
-
-							if (len & (SC_MSG_CAN_LEN_MULTIPLE - 1)) {
-								len += SC_MSG_CAN_LEN_MULTIPLE - (len & (SC_MSG_CAN_LEN_MULTIPLE - 1));
-							}
-
-							tx->can_id = m_Device->dev_to_host32(slot->tx.can_id);
-							tx->dlc = dlc;
-							tx->len = static_cast<uint8_t>(len);
-							tx->flags = slot->tx.flags;
-
-							size_t txr_slot = _countof(m_TxrMap);
-
-							// find free txr slot
-							for (size_t j = 0; j < _countof(m_TxrMap); ++j) {
-								if (MAX_COM_DEVICES_PER_SC_DEVICE == m_TxrMap[j].index.load(std::memory_order_acquire)) {
-									txr_slot = j;
-									break;
-								}
-							}
-
-							assert(txr_slot != _countof(m_TxrMap));
-							auto* echo = &m_TxEchoMap[txr_slot];
-
-							echo->dlc = slot->tx.dlc;
-							echo->can_id = slot->tx.can_id;
-							echo->track_id = slot->tx.track_id;
-							memcpy(echo->data, sc_msg_can_tx_data, data_len);
-
-							m_TxrMap[txr_slot].index.store(static_cast<uint32_t>(com_dev_index), std::memory_order_release);
-
-							tx->track_id = static_cast<uint8_t>(txr_slot);
-
-							for (;;) {
-								uint8_t const* buffer = reinterpret_cast<uint8_t*>(tx);
-								size_t added = 0;
-								auto error = sc_can_stream_tx_batch_add(
-									m_Stream,
-									&buffer,
-									&len,
-									1,
-									&added);
-
-								if (error) {
-									LogFormatQueue(SC_DLL_LOG_LEVEL_ERROR, "sc_can_stream_tx_batch_add failed: %s (%d)\n", sc_strerror(error), error);
-									SetDeviceError(error);
-									stream_error = true;
-									goto service_end;
-								}
-
-								if (added) {
-									break;
-								}
-
-								error = sc_can_stream_tx_batch_end(m_Stream);
-								if (error) {
-									LogFormatQueue(SC_DLL_LOG_LEVEL_ERROR, "sc_can_stream_tx_batch_end failed: %s (%d)\n", sc_strerror(error), error);
-									SetDeviceError(error);
-									stream_error = true;
-									goto service_end;
-								}
-
-								error = sc_can_stream_tx_batch_begin(m_Stream);
-								if (error) {
-									LogFormatQueue(SC_DLL_LOG_LEVEL_ERROR, "sc_can_stream_tx_batch_begin failed: %s (%d)\n", sc_strerror(error), error);
-									stream_error = true;
-									goto service_end;
-								}
-							}
-
-							++priv->tx.index;
-
-							priv->tx.hdr->get_index = priv->tx.index;
-
-							if (used > 1) {
-								SetEvent(priv->tx.ev);
-								finish_batch = false;
-							}
-
-							done = false;
-						}
-						else if (WAIT_TIMEOUT == r) {
-							SetEvent(priv->tx.ev);
+				if (backlog & (1u << com_dev_index)) {
+					// come back once the device has caught up
+					SetEvent(priv->tx.ev);
+				}
+			}
+		}
+		else {
+			/* Each pass sends up to m_TxQuantum frames per client with a single
+			 * get_index update, then moves on to the next client. Passes repeat
+			 * until no client makes progress.
+			 */
+			for (bool done = false; !done; ) {
+				uint32_t const quantum = m_TxQuantum.load(std::memory_order_relaxed);
+
+				done = true;
+
+				for (sc_com_dev_index_t i = 0; i < live_com_dev_count; ++i) {
+					sc_com_dev_index_t const com_dev_index = live_com_dev_buffer[i];
+					auto* data = &m_ComDeviceData[com_dev_index];
+					auto* priv = &m_ComDeviceDataPrivate[com_dev_index];
+					uint32_t used = 0;
+					uint32_t count = 0;
+
+					if (priv->tx_ring.readable(&used)) {
+						// rogue client
+						LogFormatQueue(SC_DLL_LOG_LEVEL_WARNING, "TX ring index=%u gi=%lu pi=%lu elements=%lu is inconsistent, resetting ring\n",
+							com_dev_index,
+							static_cast<unsigned long>(priv->tx.hdr->get_index),
+							static_cast<unsigned long>(priv->tx.hdr->put_index),
+							static_cast<unsigned long>(data->tx.elements));
+
+						priv->tx_ring.skip_all();
+						continue;
+					}
+
+					if (used > quantum) {
+						used = quantum;
+					}
+
+					for (; count < used; ++count) {
+						sc_can_mm_slot_t const* slot = priv->tx_ring.slot(count);
+						int txr_slot = -1;
+
+						if (SC_MM_DATA_TYPE_CAN_TX != slot->tx.type) {
+							// drop
+							//++data->tx.hdr->txr_lost;
+							LogFormatQueue(SC_DLL_LOG_LEVEL_WARNING, "TX ring index=%u unhandled entry type=%d will be ignored\n",
+								(priv->tx_ring.index() + count) % data->tx.elements, slot->tx.type);
+							continue;
 						}
-						else {
-							SetDeviceError(sc_map_win_error(m_Device, GetLastError()));
+
+						// only block if nothing was sent, else publish and wait on the next pass
+						auto error = acquire_track_id(!count, &txr_slot);
+
+						if (error) {
 							stream_error = true;
 							goto service_end;
 						}
-					}
-					else {
-						// drop
-						//++data->tx.hdr->txr_lost;
-						LogFormatQueue(SC_DLL_LOG_LEVEL_WARNING, "TX ring index=%u unhandled entry type=%d will be ignored\n", slot_index, slot->tx.type);
 
-						++priv->tx.index;
+						if (txr_slot < 0) {
+							break;
+						}
 
-						priv->tx.hdr->get_index = priv->tx.index;
+						error = send(com_dev_index, &slot->tx, txr_slot);
 
-						if (used > 1) {
-							SetEvent(priv->tx.ev);
-							finish_batch = false;
+						if (error) {
+							stream_error = true;
+							goto service_end;
 						}
 
+						++priv->tx_sent;
+					}
+
+					if (count) {
+						priv->tx_ring.consume(count);
 						done = false;
 					}
+					else if (used) {
+						// out of TX FIFO credits, come back once the device has caught up
+						SetEvent(priv->tx.ev);
+					}
 				}
 			}
 		}
 
-		if (finish_batch) {
-			auto error = sc_can_stream_tx_batch_end(m_Stream);
+		{
+			auto error = submit();
 			if (error) {
 				LogFormatQueue(SC_DLL_LOG_LEVEL_ERROR, "sc_can_stream_tx_batch_end failed: %s (%d)\n", sc_strerror(error), error);
 				SetDeviceError(error);
@@ -2368,6 +3969,8 @@ service_end:
 
 void ScDev::SetDeviceError(int error) 
 {
+	m_WorkerError.store(true, std::memory_order_release);
+
 	for (sc_com_dev_index_t i = 0; i < _countof(m_ComDeviceDataPrivate); ++i) {
 		m_ComDeviceDataPrivate[i].rx.hdr->error = error;
 		m_ComDeviceDataPrivate[i].tx.hdr->error = error;
@@ -2422,6 +4025,272 @@ STDMETHODIMP XSuperCANDevice::GetRingBufferMappings(SuperCANRingBufferMapping* r
 	return S_OK;
 }
 
+STDMETHODIMP XSuperCANDevice::GetBroadcastRingBufferMapping(SuperCANRingBufferMapping* rx, unsigned char* index)
+{
+	ATLASSERT(rx);
+	ATLASSERT(index);
+
+	ObjectLock g(this);
+
+	auto error = m_SharedDevice->EnableRxBroadcast(m_Index);
+
+	if (error) {
+		return SC_HRESULT_FROM_ERROR(error);
+	}
+
+	rx->Bytes = m_Mm->bc_rx.elements * sizeof(sc_can_mm_slot_t) + sizeof(sc_can_mm_bc_header);
+	rx->Elements = m_Mm->bc_rx.elements;
+	rx->MemoryName = SysAllocString(m_Mm->bc_rx.mem_name);
+	rx->EventName = SysAllocString(m_Mm->bc_rx.ev_name);
+	*index = m_Index;
+
+	return S_OK;
+}
+
+STDMETHODIMP XSuperCANDevice::AddFilter(SuperCANFilter filter)
+{
+	ObjectLock g(this);
+
+	sc_filter_rule rule;
+
+	rule.id = filter.id;
+	rule.mask_or_last = filter.mask_or_last;
+	rule.flags = filter.flags;
+
+	try {
+		m_FilterRules.push_back(rule);
+	}
+	catch (std::bad_alloc const&) {
+		return E_OUTOFMEMORY;
+	}
+
+	return S_OK;
+}
+
+STDMETHODIMP XSuperCANDevice::ApplyFilters()
+{
+	ObjectLock g(this);
+
+	auto error = m_SharedDevice->SetFilters(m_Index, m_FilterRules.data(), m_FilterRules.size());
+
+	m_FilterRules.clear();
+
+	if (error) {
+		return SC_HRESULT_FROM_ERROR(error);
+	}
+
+	return S_OK;
+}
+
+STDMETHODIMP XSuperCANDevice::SetRxRingFormat(unsigned long format)
+{
+	ObjectLock g(this);
+
+	auto error = m_SharedDevice->SetRxFormat(m_Index, format);
+
+	if (error) {
+		return SC_HRESULT_FROM_ERROR(error);
+	}
+
+	return S_OK;
+}
+
+STDMETHODIMP XSuperCANDevice::SetTxQuantum(unsigned long frames)
+{
+	ObjectLock g(this);
+
+	auto error = m_SharedDevice->SetTxQuantum(m_Index, frames);
+
+	if (error) {
+		return SC_HRESULT_FROM_ERROR(error);
+	}
+
+	return S_OK;
+}
+
+STDMETHODIMP XSuperCANDevice::SetTxScheduling(unsigned long mode)
+{
+	ObjectLock g(this);
+
+	auto error = m_SharedDevice->SetTxScheduling(m_Index, mode);
+
+	if (error) {
+		return SC_HRESULT_FROM_ERROR(error);
+	}
+
+	return S_OK;
+}
+
+STDMETHODIMP XSuperCANDevice::StartRecording(BSTR path)
+{
+	ObjectLock g(this);
+
+	auto error = m_SharedDevice->StartRecording(m_Index, path);
+
+	if (error) {
+		return SC_HRESULT_FROM_ERROR(error);
+	}
+
+	return S_OK;
+}
+
+STDMETHODIMP XSuperCANDevice::StopRecording()
+{
+	ObjectLock g(this);
+
+	auto error = m_SharedDevice->StopRecording(m_Index);
+
+	if (error) {
+		return SC_HRESULT_FROM_ERROR(error);
+	}
+
+	return S_OK;
+}
+
+STDMETHODIMP XSuperCANDevice::AddCyclicTx(SuperCANCyclicTx* def, unsigned long* handle)
+{
+	ObjectLock g(this);
+
+	if (!def || !handle) {
+		return E_INVALIDARG;
+	}
+
+	static_assert(sizeof(def->data) == sizeof(sc::cyclic_tx_def::data), "data size mismatch");
+
+	sc::cyclic_tx_def d;
+	uint32_t h = 0;
+
+	d.can_id = def->id;
+	d.period_us = def->period_us;
+	d.phase_us = def->phase_us;
+	d.count = def->count;
+	d.flags = def->flags;
+	d.dlc = def->dlc;
+	memcpy(d.data, def->data, sizeof(d.data));
+
+	auto error = m_SharedDevice->AddCyclicTx(m_Index, &d, &h);
+
+	if (error) {
+		return SC_HRESULT_FROM_ERROR(error);
+	}
+
+	*handle = h;
+
+	return S_OK;
+}
+
+STDMETHODIMP XSuperCANDevice::RemoveCyclicTx(unsigned long handle)
+{
+	ObjectLock g(this);
+
+	auto error = m_SharedDevice->RemoveCyclicTx(m_Index, handle);
+
+	if (error) {
+		return SC_HRESULT_FROM_ERROR(error);
+	}
+
+	return S_OK;
+}
+
+STDMETHODIMP XSuperCANDevice::SetCyclicTxTick(unsigned long tick_us)
+{
+	ObjectLock g(this);
+
+	auto error = m_SharedDevice->SetCyclicTxTick(m_Index, tick_us);
+
+	if (error) {
+		return SC_HRESULT_FROM_ERROR(error);
+	}
+
+	return S_OK;
+}
+
+STDMETHODIMP XSuperCANDevice::SetTxTracing(boolean on)
+{
+	ObjectLock g(this);
+
+	auto error = m_SharedDevice->SetTxTracing(m_Index, on != 0);
+
+	if (error) {
+		return SC_HRESULT_FROM_ERROR(error);
+	}
+
+	return S_OK;
+}
+
+STDMETHODIMP XSuperCANDevice::GetTxLatency(SuperCANTxLatency* latency)
+{
+	ObjectLock g(this);
+
+	if (!latency) {
+		return E_INVALIDARG;
+	}
+
+	sc_mm_tx_latency page;
+
+	auto error = m_SharedDevice->GetTxLatency(m_Index, &page);
+
+	if (error) {
+		return SC_HRESULT_FROM_ERROR(error);
+	}
+
+	auto clamp = [](uint64_t us) {
+		return static_cast<unsigned long>(us > ULONG_MAX ? ULONG_MAX : us);
+	};
+
+	auto percentile = [&](sc_mm_tx_latency_stage const* stage, unsigned permille) {
+		return clamp(sc_tx_latency_percentile(stage, page.frames, permille));
+	};
+
+	latency->MemoryName = SysAllocString(m_Mm->stats.mem_name);
+	latency->Bytes = sizeof(sc_mm_tx_latency);
+	latency->frames = static_cast<unsigned long>(page.frames);
+	latency->server_p50_us = percentile(&page.server, 500);
+	latency->server_p99_us = percentile(&page.server, 990);
+	latency->server_max_us = clamp(page.server.max_us);
+	latency->device_p50_us = percentile(&page.device, 500);
+	latency->device_p99_us = percentile(&page.device, 990);
+	latency->device_max_us = clamp(page.device.max_us);
+	latency->total_p50_us = percentile(&page.total, 500);
+	latency->total_p99_us = percentile(&page.total, 990);
+	latency->total_max_us = clamp(page.total.max_us);
+
+	return S_OK;
+}
+
+STDMETHODIMP XSuperCANDevice::SetLogQueueSize(unsigned long entries)
+{
+	ObjectLock g(this);
+
+	auto error = m_SharedDevice->SetLogQueueSize(m_Index, entries);
+
+	if (error) {
+		return SC_HRESULT_FROM_ERROR(error);
+	}
+
+	return S_OK;
+}
+
+STDMETHODIMP XSuperCANDevice::GetLogRingBufferMapping(SuperCANRingBufferMapping* log)
+{
+	ATLASSERT(log);
+
+	ObjectLock g(this);
+
+	auto error = m_SharedDevice->EnableLogRing(m_Index);
+
+	if (error) {
+		return SC_HRESULT_FROM_ERROR(error);
+	}
+
+	log->Bytes = m_Mm->log.elements * sizeof(sc_can_mm_slot_t) + sizeof(sc_can_mm_header);
+	log->Elements = m_Mm->log.elements;
+	log->MemoryName = SysAllocString(m_Mm->log.mem_name);
+	log->EventName = SysAllocString(m_Mm->log.ev_name);
+
+	return S_OK;
+}
+
 void XSuperCANDevice::Init(
 	const ScDevPtr& dev,
 	sc_com_dev_index_t index,
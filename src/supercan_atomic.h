@@ -0,0 +1,155 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Jean Gressmann <jean@0x42.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+/* 32 bit atomics for memory shared between threads or processes
+ *
+ * The variables are plain volatile uint32_t since they are part of
+ * structures shared with C code and other processes.
+ */
+
+#include <stdint.h>
+
+#if defined(_MSC_VER)
+#   include <intrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static inline uint32_t sc_atomic_load_acquire32(uint32_t volatile* ptr)
+{
+#if defined(_MSC_VER)
+#   if defined(_M_ARM64)
+    return __ldar32((unsigned __int32 volatile*)ptr);
+#   else
+    uint32_t value = *ptr;
+    _ReadWriteBarrier();
+    return value;
+#   endif
+#else
+    return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static inline void sc_atomic_store_release32(uint32_t volatile* ptr, uint32_t value)
+{
+#if defined(_MSC_VER)
+#   if defined(_M_ARM64)
+    __stlr32((unsigned __int32 volatile*)ptr, value);
+#   else
+    _ReadWriteBarrier();
+    *ptr = value;
+#   endif
+#else
+    __atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+#endif
+}
+
+/* Relaxed 64 bit load, doesn't tear on 32 bit targets */
+static inline uint64_t sc_atomic_load_relaxed64(uint64_t volatile* ptr)
+{
+#if defined(_MSC_VER)
+    return (uint64_t)__iso_volatile_load64((__int64 const volatile*)ptr);
+#else
+    return __atomic_load_n(ptr, __ATOMIC_RELAXED);
+#endif
+}
+
+/* Relaxed 64 bit store, doesn't tear on 32 bit targets */
+static inline void sc_atomic_store_relaxed64(uint64_t volatile* ptr, uint64_t value)
+{
+#if defined(_MSC_VER)
+    __iso_volatile_store64((__int64 volatile*)ptr, (__int64)value);
+#else
+    __atomic_store_n(ptr, value, __ATOMIC_RELAXED);
+#endif
+}
+
+/* Compare and swap, on failure *expected receives the current value */
+static inline int sc_atomic_cas32(uint32_t volatile* ptr, uint32_t* expected, uint32_t desired)
+{
+#if defined(_MSC_VER)
+    uint32_t prev = (uint32_t)_InterlockedCompareExchange((long volatile*)ptr, (long)desired, (long)*expected);
+
+    if (prev == *expected) {
+        return 1;
+    }
+
+    *expected = prev;
+    return 0;
+#else
+    return __atomic_compare_exchange_n(ptr, expected, desired, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+#endif
+}
+
+static inline uint32_t sc_atomic_inc32(uint32_t volatile* ptr)
+{
+#if defined(_MSC_VER)
+    return (uint32_t)_InterlockedIncrement((long volatile*)ptr);
+#else
+    return __atomic_add_fetch(ptr, 1, __ATOMIC_RELAXED);
+#endif
+}
+
+static inline uint32_t sc_atomic_exchange32(uint32_t volatile* ptr, uint32_t value)
+{
+#if defined(_MSC_VER)
+    return (uint32_t)_InterlockedExchange((long volatile*)ptr, (long)value);
+#else
+    return __atomic_exchange_n(ptr, value, __ATOMIC_ACQ_REL);
+#endif
+}
+
+/* Atomically sets bits, returns the previous value */
+static inline uint32_t sc_atomic_or32(uint32_t volatile* ptr, uint32_t bits)
+{
+#if defined(_MSC_VER)
+    return (uint32_t)_InterlockedOr((long volatile*)ptr, (long)bits);
+#else
+    return __atomic_fetch_or(ptr, bits, __ATOMIC_ACQ_REL);
+#endif
+}
+
+/* Full memory barrier, orders prior stores before subsequent loads */
+static inline void sc_atomic_fence(void)
+{
+#if defined(_MSC_VER)
+#   if defined(_M_ARM64)
+    __dmb(_ARM64_BARRIER_ISH);
+#   else
+    long volatile dummy = 0;
+    _InterlockedOr(&dummy, 0);
+#   endif
+#else
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+#endif
+}
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,201 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020-2025 Jean Gressmann <jean@0x42.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "supercan_error.h"
+#include "supercan_proto.h"
+#include "supercan_cmd.h"
+
+
+int sc_cmd_exchange(
+    sc_transport_t const* t,
+    uint8_t const* tx,
+    uint16_t bytes,
+    uint8_t* rx,
+    uint16_t rx_capacity,
+    uint16_t* response_size,
+    uint32_t timeout_ms)
+{
+    size_t transferred = 0;
+    int error = SC_DLL_ERROR_NONE;
+    int rx_submitted = 0;
+    uint16_t dummy = 0;
+
+    if (!t || !tx || !bytes || !rx || !rx_capacity) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+
+    if (!response_size) {
+        response_size = &dummy;
+    }
+
+    *response_size = 0;
+
+    // submit in token
+    error = t->submit_read(t->ctx, 0, rx, rx_capacity);
+    if (error) {
+        goto exit;
+    }
+
+    rx_submitted = 1;
+
+    error = t->submit_write(t->ctx, 0, tx, bytes);
+    if (error) {
+        goto exit;
+    }
+
+    error = t->reap(t->ctx, SC_TRANSPORT_DIR_OUT, 0, &transferred, timeout_ms);
+    if (error) {
+        if (SC_DLL_ERROR_TIMEOUT == error) {
+            t->cancel(t->ctx, SC_TRANSPORT_DIR_OUT, 0);
+        }
+
+        goto exit;
+    }
+
+    if (transferred < bytes) {
+        error = SC_DLL_ERROR_DEVICE_FAILURE;
+        goto exit;
+    }
+
+    error = t->reap(t->ctx, SC_TRANSPORT_DIR_IN, 0, &transferred, timeout_ms);
+    if (error) {
+        goto exit;
+    }
+
+    rx_submitted = 0;
+
+    *response_size = (uint16_t)transferred;
+
+exit:
+    if (rx_submitted) {
+        t->cancel(t->ctx, SC_TRANSPORT_DIR_IN, 0);
+    }
+
+    return error;
+}
+
+void sc_cmd_batch_init(sc_cmd_batch_t* batch, uint8_t* buffer, uint16_t capacity)
+{
+    batch->buffer = buffer;
+    batch->capacity = capacity;
+    batch->size = 0;
+    batch->count = 0;
+}
+
+int sc_cmd_batch_add(sc_cmd_batch_t* batch, uint8_t bytes, void** msg)
+{
+    struct sc_msg_header* hdr = NULL;
+    unsigned len = 0;
+
+    if (!batch || !msg || bytes < SC_MSG_HEADER_LEN) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+
+    len = (bytes + SC_MSG_CAN_LEN_MULTIPLE - 1) & ~(SC_MSG_CAN_LEN_MULTIPLE - 1);
+
+    if (len > 0xff || (unsigned)batch->size + len > batch->capacity) {
+        return SC_DLL_ERROR_BUFFER_TOO_SMALL;
+    }
+
+    hdr = (struct sc_msg_header*)(batch->buffer + batch->size);
+    memset(hdr, 0, len);
+    hdr->len = (uint8_t)len;
+
+    batch->size += (uint16_t)len;
+    ++batch->count;
+
+    *msg = hdr;
+
+    return SC_DLL_ERROR_NONE;
+}
+
+int sc_cmd_batch_parse(
+    sc_cmd_batch_t const* batch,
+    uint8_t const* rsp,
+    uint16_t bytes,
+    sc_cmd_reply_t* replies)
+{
+    uint16_t offset = 0;
+    uint16_t i = 0;
+
+    if (!batch || (!rsp && bytes) || (!replies && batch->count)) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+
+    for (i = 0; i < batch->count; ++i) {
+        struct sc_msg_header const* hdr = NULL;
+
+        if (offset + SC_MSG_HEADER_LEN > bytes) {
+            return SC_DLL_ERROR_PROTO_VIOLATION;
+        }
+
+        hdr = (struct sc_msg_header const*)(rsp + offset);
+
+        if (SC_MSG_EOF == hdr->id || hdr->len < SC_MSG_HEADER_LEN || offset + hdr->len > bytes) {
+            return SC_DLL_ERROR_PROTO_VIOLATION;
+        }
+
+        replies[i].msg = rsp + offset;
+        replies[i].error = SC_ERROR_NONE;
+
+        if (SC_MSG_ERROR == hdr->id) {
+            if (hdr->len < sizeof(struct sc_msg_error)) {
+                return SC_DLL_ERROR_PROTO_VIOLATION;
+            }
+
+            replies[i].error = ((struct sc_msg_error const*)hdr)->error;
+        }
+
+        offset += hdr->len;
+    }
+
+    return SC_DLL_ERROR_NONE;
+}
+
+int sc_cmd_batch_run(
+    sc_transport_t const* transport,
+    sc_cmd_batch_t const* batch,
+    uint8_t* rx,
+    uint16_t rx_capacity,
+    sc_cmd_reply_t* replies,
+    uint32_t timeout_ms)
+{
+    uint16_t bytes = 0;
+    int error = SC_DLL_ERROR_NONE;
+
+    if (!batch || !batch->count) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+
+    error = sc_cmd_exchange(transport, batch->buffer, batch->size, rx, rx_capacity, &bytes, timeout_ms);
+    if (error) {
+        return error;
+    }
+
+    return sc_cmd_batch_parse(batch, rx, bytes, replies);
+}
@@ -0,0 +1,126 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020-2025 Jean Gressmann <jean@0x42.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "supercan_transport.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Command batch
+ *
+ * Packs several requests into a single command buffer so that
+ * they cost one round trip to the device.
+ */
+typedef struct sc_cmd_batch {
+    uint8_t* buffer;    ///< command buffer
+    uint16_t capacity;  ///< size of command buffer, typically cmd_buffer_size
+    uint16_t size;      ///< bytes used in command buffer
+    uint16_t count;     ///< number of requests in batch
+} sc_cmd_batch_t;
+
+/** Reply to a request of a command batch */
+typedef struct sc_cmd_reply {
+    uint8_t const* msg; ///< reply message, points into response buffer
+    int8_t error;       ///< SC_ERROR_* of SC_MSG_ERROR replies, SC_ERROR_NONE otherwise
+} sc_cmd_reply_t;
+
+/** Initializes an empty batch on top of a command buffer */
+void sc_cmd_batch_init(sc_cmd_batch_t* batch, uint8_t* buffer, uint16_t capacity);
+
+/** Appends a request to the batch
+ *
+ * The request is zeroed and its length is set. The caller fills in
+ * the message id and payload.
+ *
+ * \param batch     batch to append to
+ * \param bytes     request size, rounded up to a multiple of SC_MSG_CAN_LEN_MULTIPLE
+ * \param msg       (out) request in command buffer
+ *
+ * \returns SC_DLL_ERROR_BUFFER_TOO_SMALL if the request doesn't fit
+ */
+int sc_cmd_batch_add(sc_cmd_batch_t* batch, uint8_t bytes, void** msg);
+
+/** Splits a device response into one reply per request
+ *
+ * The device answers each request in order, either with SC_MSG_ERROR
+ * or with a dedicated reply message (i.e. SC_MSG_DEVICE_INFO).
+ *
+ * \param batch     batch the response belongs to
+ * \param rsp       response buffer
+ * \param bytes     bytes in response buffer
+ * \param replies   (out) array of batch->count replies
+ *
+ * \returns SC_DLL_ERROR_PROTO_VIOLATION if the response is malformed
+ *          or doesn't contain a reply for every request
+ */
+int sc_cmd_batch_parse(
+    sc_cmd_batch_t const* batch,
+    uint8_t const* rsp,
+    uint16_t bytes,
+    sc_cmd_reply_t* replies);
+
+/** Sends a command batch and splits the response
+ *
+ * \returns error code, device errors are reported per request in replies
+ */
+int sc_cmd_batch_run(
+    sc_transport_t const* transport,
+    sc_cmd_batch_t const* batch,
+    uint8_t* rx,
+    uint16_t rx_capacity,
+    sc_cmd_reply_t* replies,
+    uint32_t timeout_ms);
+
+/** Sends a command buffer and waits for the device's response
+ *
+ * Uses request slot 0 of the transport in both directions.
+ *
+ * \param transport     command pipe transport
+ * \param tx            command buffer
+ * \param bytes         bytes in command buffer
+ * \param rx            response buffer
+ * \param rx_capacity   size of response buffer
+ * \param response_size (out) bytes in response buffer, can be NULL
+ * \param timeout_ms    time to wait for each direction
+ *
+ * \returns error code
+ */
+int sc_cmd_exchange(
+    sc_transport_t const* transport,
+    uint8_t const* tx,
+    uint16_t bytes,
+    uint8_t* rx,
+    uint16_t rx_capacity,
+    uint16_t* response_size,
+    uint32_t timeout_ms);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
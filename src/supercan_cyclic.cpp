@@ -0,0 +1,455 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Jean Gressmann <jean@0x42.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "supercan_cyclic.h"
+
+#include <string.h>
+
+#include <new>
+
+#include "supercan_error.h"
+
+namespace sc {
+
+cyclic_tx::cyclic_tx()
+    : m_NextGen(1)
+    , m_Changed(false)
+    , m_QueueHead(NIL)
+    , m_QueueTail(NIL)
+    , m_TickUs(DEFAULT_TICK_US)
+    , m_Started(false)
+{
+    memset(&m_Stats, 0, sizeof(m_Stats));
+}
+
+int cyclic_tx::init(uint32_t capacity)
+{
+    if (!capacity || capacity > MAX_CAPACITY) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+
+    try {
+        m_Gen.assign(capacity, 0);
+        m_Owner.assign(capacity, 0);
+        m_Free.resize(capacity);
+        m_Entries.resize(capacity);
+        m_Changes.reserve(capacity);
+        m_Applying.reserve(capacity);
+    }
+    catch (std::bad_alloc const&) {
+        return SC_DLL_ERROR_OUT_OF_MEM;
+    }
+
+    for (uint32_t i = 0; i < capacity; ++i) {
+        // hand out low indices first
+        m_Free[i] = capacity - 1 - i;
+        m_Entries[i].live = false;
+    }
+
+    m_Changes.clear();
+    m_Changed.store(false, std::memory_order_relaxed);
+    stop();
+
+    return SC_DLL_ERROR_NONE;
+}
+
+int cyclic_tx::add(uint8_t owner, cyclic_tx_def const* def, uint32_t* handle)
+{
+    uint8_t const flags_supported = SC_CAN_FRAME_FLAG_EXT | SC_CAN_FRAME_FLAG_RTR | SC_CAN_FRAME_FLAG_FDF | SC_CAN_FRAME_FLAG_BRS;
+
+    if (!def || !handle) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+
+    if (def->period_us < MIN_TICK_US || (def->flags & ~flags_supported)) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+
+    if (def->can_id > ((def->flags & SC_CAN_FRAME_FLAG_EXT) ? 0x1fffffffu : 0x7ffu)) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+
+    if (def->dlc > ((def->flags & SC_CAN_FRAME_FLAG_FDF) ? 15 : 8)) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+
+    if ((def->flags & SC_CAN_FRAME_FLAG_FDF) && (def->flags & SC_CAN_FRAME_FLAG_RTR)) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+
+    std::lock_guard<std::mutex> g(m_Lock);
+
+    if (m_Free.empty()) {
+        return SC_DLL_ERROR_OUT_OF_MEM;
+    }
+
+    uint32_t const index = m_Free.back();
+    uint16_t const gen = m_NextGen++;
+
+    if (!m_NextGen) {
+        m_NextGen = 1;
+    }
+
+    m_Free.pop_back();
+    m_Gen[index] = gen;
+    m_Owner[index] = owner;
+
+    change c;
+
+    c.type = CHANGE_ADD;
+    c.owner = owner;
+    c.value = make_handle(index, gen);
+    c.def = *def;
+
+    m_Changes.push_back(c);
+    m_Changed.store(true, std::memory_order_release);
+
+    *handle = c.value;
+
+    return SC_DLL_ERROR_NONE;
+}
+
+int cyclic_tx::remove(uint8_t owner, uint32_t handle)
+{
+    uint32_t const index = handle & 0xffff;
+    uint16_t const gen = static_cast<uint16_t>(handle >> 16);
+
+    std::lock_guard<std::mutex> g(m_Lock);
+
+    if (!gen || index >= m_Gen.size() || m_Gen[index] != gen || m_Owner[index] != owner) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+
+    // the scheduling thread removes before it adds, thus the index can be reused right away
+    m_Gen[index] = 0;
+    m_Free.push_back(index);
+
+    change c;
+
+    c.type = CHANGE_REMOVE;
+    c.owner = owner;
+    c.value = index;
+
+    m_Changes.push_back(c);
+    m_Changed.store(true, std::memory_order_release);
+
+    return SC_DLL_ERROR_NONE;
+}
+
+void cyclic_tx::remove_all(uint8_t owner)
+{
+    std::lock_guard<std::mutex> g(m_Lock);
+
+    for (uint32_t i = 0; i < m_Gen.size(); ++i) {
+        if (m_Gen[i] && m_Owner[i] == owner) {
+            change c;
+
+            c.type = CHANGE_REMOVE;
+            c.owner = owner;
+            c.value = i;
+
+            m_Gen[i] = 0;
+            m_Free.push_back(i);
+            m_Changes.push_back(c);
+            m_Changed.store(true, std::memory_order_release);
+        }
+    }
+}
+
+int cyclic_tx::set_tick(uint32_t tick_us)
+{
+    if (tick_us < MIN_TICK_US) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+
+    std::lock_guard<std::mutex> g(m_Lock);
+
+    change c;
+
+    c.type = CHANGE_TICK;
+    c.owner = 0;
+    c.value = tick_us;
+
+    m_Changes.push_back(c);
+    m_Changed.store(true, std::memory_order_release);
+
+    return SC_DLL_ERROR_NONE;
+}
+
+bool cyclic_tx::apply(uint64_t now_us)
+{
+    if (!m_Changed.load(std::memory_order_acquire)) {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> g(m_Lock);
+
+        m_Changed.store(false, std::memory_order_relaxed);
+        m_Changes.swap(m_Applying);
+    }
+
+    for (size_t i = 0; i < m_Applying.size(); ++i) {
+        change const* c = &m_Applying[i];
+
+        switch (c->type) {
+        case CHANGE_ADD: {
+            entry* e = &m_Entries[c->value & 0xffff];
+
+            memset(&e->frame, 0, sizeof(e->frame));
+            e->frame.type = SC_MM_DATA_TYPE_CAN_TX;
+            e->frame.can_id = c->def.can_id;
+            e->frame.flags = c->def.flags;
+            e->frame.dlc = c->def.dlc;
+            e->frame.track_id = c->value;
+            memcpy(e->frame.data, c->def.data, sizeof(e->frame.data));
+
+            e->period_us = c->def.period_us;
+            e->phase_us = c->def.phase_us;
+            e->count = c->def.count;
+            e->left = c->def.count;
+            e->owner = c->owner;
+            e->live = true;
+            e->queued = false;
+
+            if (m_Started) {
+                e->due_us = now_us + e->phase_us;
+                schedule(e);
+            }
+        } break;
+        case CHANGE_REMOVE: {
+            entry* e = &m_Entries[c->value];
+
+            if (e->live) {
+                unschedule(e);
+                e->live = false;
+            }
+        } break;
+        case CHANGE_TICK:
+            m_TickUs = c->value;
+
+            if (m_Started) {
+                // due times are kept in microseconds, place all timers again
+                m_Wheel.reset(now_us / m_TickUs);
+
+                for (size_t j = 0; j < m_Entries.size(); ++j) {
+                    entry* e = &m_Entries[j];
+                    bool const scheduled = e->live && e->timer.linked();
+
+                    e->timer.next = nullptr;
+                    e->timer.pprev = nullptr;
+
+                    if (scheduled) {
+                        schedule(e);
+                    }
+                }
+            }
+            break;
+        }
+    }
+
+    m_Applying.clear();
+
+    return true;
+}
+
+void cyclic_tx::start(uint64_t now_us)
+{
+    m_Started = true;
+    m_Wheel.reset(now_us / m_TickUs);
+    m_QueueHead = NIL;
+    m_QueueTail = NIL;
+
+    for (size_t i = 0; i < m_Entries.size(); ++i) {
+        entry* e = &m_Entries[i];
+
+        e->timer.next = nullptr;
+        e->timer.pprev = nullptr;
+        e->queued = false;
+
+        if (e->live) {
+            e->left = e->count;
+            e->due_us = now_us + e->phase_us;
+            schedule(e);
+        }
+    }
+}
+
+void cyclic_tx::stop()
+{
+    m_Started = false;
+    m_Wheel.reset(0);
+    m_QueueHead = NIL;
+    m_QueueTail = NIL;
+
+    for (size_t i = 0; i < m_Entries.size(); ++i) {
+        entry* e = &m_Entries[i];
+
+        e->timer.next = nullptr;
+        e->timer.pprev = nullptr;
+        e->queued = false;
+    }
+}
+
+void cyclic_tx::run(uint64_t now_us)
+{
+    if (!m_Started) {
+        return;
+    }
+
+    m_Wheel.advance(now_us / m_TickUs, [&](timer_wheel::timer* t) {
+        expire(reinterpret_cast<entry*>(t), now_us);
+    });
+}
+
+bool cyclic_tx::front(uint8_t* owner, sc_mm_can_tx const** frame) const
+{
+    if (NIL == m_QueueHead) {
+        return false;
+    }
+
+    entry const* e = &m_Entries[m_QueueHead];
+
+    *owner = e->owner;
+    *frame = &e->frame;
+
+    return true;
+}
+
+void cyclic_tx::pop()
+{
+    if (NIL != m_QueueHead) {
+        dequeue(m_QueueHead);
+    }
+}
+
+uint64_t cyclic_tx::next_us() const
+{
+    if (!m_Started) {
+        return NEVER;
+    }
+
+    uint64_t const tick = m_Wheel.next();
+
+    if (timer_wheel::NEVER == tick) {
+        return NEVER;
+    }
+
+    return tick * m_TickUs;
+}
+
+void cyclic_tx::schedule(entry* e)
+{
+    // round up, frames are never early
+    e->timer.due = (e->due_us + m_TickUs - 1) / m_TickUs;
+    m_Wheel.insert(&e->timer);
+}
+
+void cyclic_tx::unschedule(entry* e)
+{
+    if (e->timer.linked()) {
+        m_Wheel.remove(&e->timer);
+    }
+
+    if (e->queued) {
+        dequeue(static_cast<uint32_t>(e - m_Entries.data()));
+    }
+}
+
+void cyclic_tx::expire(entry* e, uint64_t now_us)
+{
+    uint64_t periods = 1;
+
+    if (e->queued) {
+        ++m_Stats.overruns;
+    }
+    else {
+        enqueue(static_cast<uint32_t>(e - m_Entries.data()));
+        ++m_Stats.queued;
+    }
+
+    e->due_us += e->period_us;
+
+    if (e->due_us <= now_us) {
+        // fell behind, stay on the grid
+        uint64_t const skip = (now_us - e->due_us) / e->period_us + 1;
+
+        e->due_us += skip * e->period_us;
+        m_Stats.skipped += skip;
+        periods += skip;
+    }
+
+    if (e->count) {
+        if (e->left <= periods) {
+            e->left = 0;
+            return;
+        }
+
+        e->left -= static_cast<uint32_t>(periods);
+    }
+
+    schedule(e);
+}
+
+void cyclic_tx::enqueue(uint32_t index)
+{
+    entry* e = &m_Entries[index];
+
+    e->queued = true;
+    e->queue_next = NIL;
+    e->queue_prev = m_QueueTail;
+
+    if (NIL == m_QueueTail) {
+        m_QueueHead = index;
+    }
+    else {
+        m_Entries[m_QueueTail].queue_next = index;
+    }
+
+    m_QueueTail = index;
+}
+
+void cyclic_tx::dequeue(uint32_t index)
+{
+    entry* e = &m_Entries[index];
+
+    if (NIL == e->queue_prev) {
+        m_QueueHead = e->queue_next;
+    }
+    else {
+        m_Entries[e->queue_prev].queue_next = e->queue_next;
+    }
+
+    if (NIL == e->queue_next) {
+        m_QueueTail = e->queue_prev;
+    }
+    else {
+        m_Entries[e->queue_next].queue_prev = e->queue_prev;
+    }
+
+    e->queued = false;
+}
+
+} // sc
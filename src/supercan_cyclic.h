@@ -0,0 +1,206 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Jean Gressmann <jean@0x42.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#ifndef __cplusplus
+#   error "supercan_cyclic.h requires C++"
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "supercan_proto.h"
+#include "supercan_srv.h"
+#include "supercan_timer_wheel.h"
+
+namespace sc {
+
+/** Cyclic transmission of a single frame */
+struct cyclic_tx_def {
+    uint32_t can_id;
+    uint32_t period_us;         ///< time between transmissions, at least cyclic_tx::MIN_TICK_US
+    uint32_t phase_us;          ///< offset of the first transmission from the start
+    uint32_t count;             ///< number of periods, 0 for no limit
+    uint8_t flags;              ///< SC_CAN_FRAME_FLAG_*
+    uint8_t dlc;
+    uint8_t data[64];
+};
+
+struct cyclic_tx_stats {
+    uint64_t queued;            ///< frames queued for transmission
+    uint64_t skipped;           ///< periods skipped because run wasn't called in time
+    uint64_t overruns;          ///< frames not queued because the previous one was still queued
+};
+
+/** Scheduler for cyclic frames
+ *
+ * Definitions are added and removed from any thread. The changes are
+ * picked up by the scheduling thread in apply, which is the only one
+ * to touch the timer wheel and the queue of due frames.
+ *
+ * Times are in microseconds of an arbitrary monotonic clock. Frames
+ * are due at start + phase + n * period and are queued on the first
+ * tick at or after that time, hence never early and at most a tick
+ * late if run is called on time. Frames stay queued until the
+ * scheduling thread finds room for them in the TX FIFO.
+ */
+class cyclic_tx
+{
+public:
+    enum {
+        MIN_TICK_US = 100,
+        DEFAULT_TICK_US = 1000,
+        DEFAULT_CAPACITY = 4096,
+        MAX_CAPACITY = 0xffff,
+    };
+
+    static uint64_t const NEVER = ~static_cast<uint64_t>(0);
+
+    cyclic_tx();
+
+    /** Allocates room for capacity definitions, returns error code */
+    int init(uint32_t capacity);
+
+    /** Adds a definition, returns error code
+     *
+     * \param owner     opaque owner id < 256, i.e. the COM device index
+     * \param def       definition
+     * \param handle    (out) handle of the definition, never 0
+     */
+    int add(uint8_t owner, cyclic_tx_def const* def, uint32_t* handle);
+
+    /** Removes a definition of owner, returns error code */
+    int remove(uint8_t owner, uint32_t handle);
+
+    /** Removes all definitions of owner */
+    void remove_all(uint8_t owner);
+
+    /** Sets the scheduler granularity, returns error code */
+    int set_tick(uint32_t tick_us);
+
+    /** Takes pending changes from add, remove and set_tick
+     *
+     * \returns true if there were any
+     */
+    bool apply(uint64_t now_us);
+
+    /** Starts all definitions from their phase relative to now_us */
+    void start(uint64_t now_us);
+
+    /** Stops scheduling, the definitions are kept */
+    void stop();
+
+    /** Queues frames due until now_us */
+    void run(uint64_t now_us);
+
+    /** Retrieves the first queued frame, false if there is none
+     *
+     * The frame's track_id is the definition's handle.
+     */
+    bool front(uint8_t* owner, sc_mm_can_tx const** frame) const;
+
+    /** Removes the first queued frame */
+    void pop();
+
+    /** Time at which run must be called next, NEVER if nothing is scheduled */
+    uint64_t next_us() const;
+
+    /** Granularity in effect on the scheduling thread */
+    uint32_t tick_us() const { return m_TickUs; }
+
+    bool started() const { return m_Started; }
+    bool queued() const { return m_QueueHead != NIL; }
+    void stats(cyclic_tx_stats* stats) const { *stats = m_Stats; }
+
+private:
+    cyclic_tx(cyclic_tx const&) = delete;
+    cyclic_tx& operator=(cyclic_tx const&) = delete;
+
+    enum {
+        NIL = 0xffffffff,
+    };
+
+    enum {
+        CHANGE_ADD,
+        CHANGE_REMOVE,
+        CHANGE_TICK,
+    };
+
+    struct change {
+        uint8_t type;
+        uint8_t owner;
+        uint32_t value;         ///< handle, index or tick
+        cyclic_tx_def def;      ///< CHANGE_ADD
+    };
+
+    struct entry {
+        timer_wheel::timer timer;   // must be first
+        sc_mm_can_tx frame;
+        uint64_t due_us;
+        uint32_t period_us;
+        uint32_t phase_us;
+        uint32_t count;
+        uint32_t left;              ///< periods left if count
+        uint32_t queue_next;
+        uint32_t queue_prev;
+        uint8_t owner;
+        bool live;
+        bool queued;
+    };
+
+    static uint32_t make_handle(uint32_t index, uint16_t gen) { return (static_cast<uint32_t>(gen) << 16) | index; }
+    void schedule(entry* e);
+    void expire(entry* e, uint64_t now_us);
+    void enqueue(uint32_t index);
+    void dequeue(uint32_t index);
+    void unschedule(entry* e);
+
+private:
+    // guarded by m_Lock
+    std::mutex m_Lock;
+    std::vector<change> m_Changes;
+    std::vector<uint16_t> m_Gen;        ///< generation per index, 0 if free
+    std::vector<uint8_t> m_Owner;
+    std::vector<uint32_t> m_Free;
+    uint16_t m_NextGen;
+    std::atomic<bool> m_Changed;
+
+    // scheduling thread
+    std::vector<change> m_Applying;
+    std::vector<entry> m_Entries;
+    timer_wheel m_Wheel;
+    cyclic_tx_stats m_Stats;
+    uint32_t m_QueueHead;
+    uint32_t m_QueueTail;
+    uint32_t m_TickUs;
+    bool m_Started;
+};
+
+} // sc
@@ -0,0 +1,51 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020-2025 Jean Gressmann <jean@0x42.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+/* Error codes of the host side library */
+
+#define SC_DLL_ERROR_UNKNOWN                -1
+#define SC_DLL_ERROR_NONE                   0
+#define SC_DLL_ERROR_INVALID_PARAM          1
+#define SC_DLL_ERROR_OUT_OF_MEM             2
+#define SC_DLL_ERROR_DEV_COUNT_CHANGED      4
+#define SC_DLL_ERROR_DEV_UNSUPPORTED        5   ///< not a SuperCAN device
+#define SC_DLL_ERROR_VERSION_UNSUPPORTED    6   ///< unsupported SuperCAN protocol version
+#define SC_DLL_ERROR_IO_PENDING             7   ///< I/O is underway
+#define SC_DLL_ERROR_DEVICE_FAILURE         8   ///< USB related device failure, i.e. unplug
+#define SC_DLL_ERROR_DEVICE_BUSY            9   ///< device not available (already opened)
+#define SC_DLL_ERROR_ABORTED                10  ///< request was aborted / canceled
+#define SC_DLL_ERROR_DEV_NOT_IMPLEMENTED    11  ///< device doesn't implement requested feature
+#define SC_DLL_ERROR_PROTO_VIOLATION        12  ///< malformed data buffer
+#define SC_DLL_ERROR_SEQ_VIOLATION          13  ///< jumbled CAN message sequence
+#define SC_DLL_ERROR_REASSEMBLY_SPACE       14  ///< insufficient message reassembly buffer space
+#define SC_DLL_ERROR_TIMEOUT                15  ///< timeout
+#define SC_DLL_ERROR_AGAIN                  16  ///< try again (later)
+#define SC_DLL_ERROR_BUFFER_TOO_SMALL       17  ///< buffer too small
+#define SC_DLL_ERROR_USER_HANDLE_SIGNALED   18  ///< user provided handle was signaled
+#define SC_DLL_ERROR_ACCESS_DENIED          19  ///< access denied
+#define SC_DLL_ERROR_INVALID_OPERATION      20  ///< operation not possible in current state
+#define SC_DLL_ERROR_DEVICE_GONE            21  ///< device was removed from the system
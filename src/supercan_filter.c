@@ -0,0 +1,405 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Jean Gressmann <jean@0x42.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "supercan_error.h"
+#include "supercan_filter.h"
+
+#define EXT_ID_MASK     0x1fffffffu
+#define LEAF_ID_MASK    ((1u << SC_FILTER_EXT_LEAF_BITS) - 1)
+#define LEAF_REJECT     0
+#define LEAF_ACCEPT     1
+
+/* A rule as seen from within a leaf, two 15 bit values
+ *
+ * range: DESC_RANGE | first << 15 | last
+ * mask:  mask << 15 | match
+ *
+ * Leaves with equal descriptor lists are equal.
+ */
+#define DESC_RANGE      0x80000000u
+
+struct leaf_info {
+    uint32_t hash;
+    uint32_t desc_offset;
+    uint32_t desc_count;
+};
+
+struct build {
+    uint32_t* leaves;
+    struct leaf_info* infos;
+    uint32_t leaf_count;
+    uint32_t leaf_capacity;
+    uint32_t info_capacity;
+    uint32_t* descs;            // of all leaves
+    uint32_t desc_count;
+    uint32_t desc_capacity;
+    uint32_t* table;            // leaf index + 1, 0 is empty
+};
+
+#define TABLE_SIZE (2 * SC_FILTER_EXT_BUCKETS)
+
+
+static inline void set_bits(uint32_t* bits, uint32_t first, uint32_t last)
+{
+    for (uint32_t i = first; i <= last; ) {
+        if (0 == (i & 31) && i + 31 <= last) {
+            bits[i >> 5] = ~UINT32_C(0);
+            i += 32;
+        }
+        else {
+            bits[i >> 5] |= UINT32_C(1) << (i & 31);
+            ++i;
+        }
+    }
+}
+
+static inline void set_mask(uint32_t* bits, uint32_t count, uint32_t mask, uint32_t match)
+{
+    for (uint32_t i = 0; i < count; ++i) {
+        if (0 == ((i ^ match) & mask)) {
+            bits[i >> 5] |= UINT32_C(1) << (i & 31);
+        }
+    }
+}
+
+static uint32_t hash_descs(uint32_t const* descs, uint32_t count)
+{
+    uint32_t h = 2166136261u; // FNV-1a
+
+    for (uint32_t i = 0; i < count; ++i) {
+        h = (h ^ descs[i]) * 16777619u;
+    }
+
+    return h;
+}
+
+static int grow(void** ptr, uint32_t* capacity, uint32_t required, size_t element_size)
+{
+    uint32_t c = *capacity ? *capacity : 16;
+    void* p = NULL;
+
+    if (required <= *capacity) {
+        return SC_DLL_ERROR_NONE;
+    }
+
+    while (c < required) {
+        c *= 2;
+    }
+
+    p = realloc(*ptr, c * element_size);
+    if (!p) {
+        return SC_DLL_ERROR_OUT_OF_MEM;
+    }
+
+    *ptr = p;
+    *capacity = c;
+
+    return SC_DLL_ERROR_NONE;
+}
+
+static int add_leaf(struct build* b, uint32_t const* descs, uint32_t count, uint32_t hash, uint32_t* index)
+{
+    uint32_t* leaf = NULL;
+    int error = SC_DLL_ERROR_NONE;
+
+    error = grow((void**)&b->infos, &b->info_capacity, b->leaf_count + 1, sizeof(*b->infos));
+    if (error) {
+        return error;
+    }
+
+    error = grow((void**)&b->leaves, &b->leaf_capacity, b->leaf_count + 1, SC_FILTER_EXT_LEAF_WORDS * sizeof(*b->leaves));
+    if (error) {
+        return error;
+    }
+
+    error = grow((void**)&b->descs, &b->desc_capacity, b->desc_count + count, sizeof(*b->descs));
+    if (error) {
+        return error;
+    }
+
+    leaf = b->leaves + (size_t)b->leaf_count * SC_FILTER_EXT_LEAF_WORDS;
+    memset(leaf, 0, SC_FILTER_EXT_LEAF_WORDS * sizeof(*leaf));
+
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t const d = descs[i];
+        uint32_t const hi = (d >> SC_FILTER_EXT_LEAF_BITS) & LEAF_ID_MASK;
+        uint32_t const lo = d & LEAF_ID_MASK;
+
+        if (d & DESC_RANGE) {
+            set_bits(leaf, hi, lo);
+        }
+        else if (LEAF_ID_MASK == hi) { // exact id
+            set_bits(leaf, lo, lo);
+        }
+        else {
+            set_mask(leaf, LEAF_ID_MASK + 1, hi, lo);
+        }
+    }
+
+    // the empty leaves are added before any descriptor storage exists
+    if (count) {
+        memcpy(b->descs + b->desc_count, descs, count * sizeof(*descs));
+    }
+
+    b->infos[b->leaf_count].hash = hash;
+    b->infos[b->leaf_count].desc_offset = b->desc_count;
+    b->infos[b->leaf_count].desc_count = count;
+    b->desc_count += count;
+
+    *index = b->leaf_count++;
+
+    return SC_DLL_ERROR_NONE;
+}
+
+static int find_or_add_leaf(struct build* b, uint32_t const* descs, uint32_t count, uint32_t* index)
+{
+    uint32_t const hash = hash_descs(descs, count);
+    uint32_t slot = hash & (TABLE_SIZE - 1);
+    int error = SC_DLL_ERROR_NONE;
+
+    for (;;) {
+        uint32_t const entry = b->table[slot];
+
+        if (!entry) {
+            break;
+        }
+
+        struct leaf_info const* info = &b->infos[entry - 1];
+
+        if (info->hash == hash &&
+            info->desc_count == count &&
+            0 == memcmp(b->descs + info->desc_offset, descs, count * sizeof(*descs))) {
+            *index = entry - 1;
+            return SC_DLL_ERROR_NONE;
+        }
+
+        slot = (slot + 1) & (TABLE_SIZE - 1);
+    }
+
+    error = add_leaf(b, descs, count, hash, index);
+    if (error) {
+        return error;
+    }
+
+    b->table[slot] = *index + 1;
+
+    return SC_DLL_ERROR_NONE;
+}
+
+static int validate(struct sc_filter_rule const* rule)
+{
+    uint32_t const max = (rule->flags & SC_FILTER_RULE_FLAG_EXT) ? EXT_ID_MASK : 0x7ff;
+
+    if (rule->flags & ~(SC_FILTER_RULE_FLAG_EXT | SC_FILTER_RULE_FLAG_RANGE)) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+
+    if (rule->id > max || rule->mask_or_last > max) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+
+    if ((rule->flags & SC_FILTER_RULE_FLAG_RANGE) && rule->id > rule->mask_or_last) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+
+    return SC_DLL_ERROR_NONE;
+}
+
+/* Collects what the extended rules contribute to the leaf of a bucket
+ *
+ * \returns 1 if a rule covers the whole bucket
+ */
+static int bucket_descs(
+    struct sc_filter_rule const* rules,
+    size_t count,
+    uint32_t bucket,
+    uint32_t* descs,
+    uint32_t* desc_count)
+{
+    uint32_t const base = bucket << SC_FILTER_EXT_LEAF_BITS;
+    uint32_t const top = base | LEAF_ID_MASK;
+    uint32_t n = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        struct sc_filter_rule const* r = &rules[i];
+
+        if (!(r->flags & SC_FILTER_RULE_FLAG_EXT)) {
+            continue;
+        }
+
+        if (r->flags & SC_FILTER_RULE_FLAG_RANGE) {
+            uint32_t first = r->id;
+            uint32_t last = r->mask_or_last;
+
+            if (last < base || first > top) {
+                continue;
+            }
+
+            first = first < base ? 0 : first - base;
+            last = last > top ? LEAF_ID_MASK : last - base;
+
+            if (0 == first && LEAF_ID_MASK == last) {
+                return 1;
+            }
+
+            descs[n++] = DESC_RANGE | (first << SC_FILTER_EXT_LEAF_BITS) | last;
+        }
+        else {
+            uint32_t const mask = r->mask_or_last;
+
+            if ((base ^ r->id) & mask & ~LEAF_ID_MASK) {
+                continue;
+            }
+
+            if (0 == (mask & LEAF_ID_MASK)) {
+                return 1;
+            }
+
+            descs[n++] = ((mask & LEAF_ID_MASK) << SC_FILTER_EXT_LEAF_BITS) | (r->id & LEAF_ID_MASK);
+        }
+    }
+
+    *desc_count = n;
+
+    return 0;
+}
+
+void sc_filter_init(sc_filter_t* filter)
+{
+    memset(filter, 0, sizeof(*filter));
+    filter->accept_all = 1;
+}
+
+void sc_filter_uninit(sc_filter_t* filter)
+{
+    free(filter->leaves);
+    sc_filter_init(filter);
+}
+
+int sc_filter_set(sc_filter_t* filter, struct sc_filter_rule const* rules, size_t count)
+{
+    int error = SC_DLL_ERROR_NONE;
+    struct build b;
+    uint32_t std[SC_FILTER_STD_WORDS];
+    uint16_t* ext = NULL;
+    uint32_t* descs = NULL;
+    uint32_t index = 0;
+
+    memset(&b, 0, sizeof(b));
+    memset(std, 0, sizeof(std));
+
+    if (count && !rules) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        error = validate(&rules[i]);
+        if (error) {
+            return error;
+        }
+    }
+
+    if (!count) {
+        sc_filter_uninit(filter);
+        return SC_DLL_ERROR_NONE;
+    }
+
+    ext = (uint16_t*)malloc(SC_FILTER_EXT_BUCKETS * sizeof(*ext));
+    descs = (uint32_t*)malloc(count * sizeof(*descs));
+    b.table = (uint32_t*)calloc(TABLE_SIZE, sizeof(*b.table));
+
+    if (!ext || !descs || !b.table) {
+        error = SC_DLL_ERROR_OUT_OF_MEM;
+        goto exit;
+    }
+
+    // leaves 0 and 1
+    error = add_leaf(&b, NULL, 0, 0, &index);
+    if (error) {
+        goto exit;
+    }
+
+    error = add_leaf(&b, NULL, 0, 0, &index);
+    if (error) {
+        goto exit;
+    }
+
+    memset(b.leaves + SC_FILTER_EXT_LEAF_WORDS, 0xff, SC_FILTER_EXT_LEAF_WORDS * sizeof(*b.leaves));
+
+    for (size_t i = 0; i < count; ++i) {
+        struct sc_filter_rule const* r = &rules[i];
+
+        if (r->flags & SC_FILTER_RULE_FLAG_EXT) {
+            continue;
+        }
+
+        if (r->flags & SC_FILTER_RULE_FLAG_RANGE) {
+            set_bits(std, r->id, r->mask_or_last);
+        }
+        else {
+            set_mask(std, 2048, r->mask_or_last, r->id);
+        }
+    }
+
+    for (uint32_t bucket = 0; bucket < SC_FILTER_EXT_BUCKETS; ++bucket) {
+        uint32_t desc_count = 0;
+
+        if (bucket_descs(rules, count, bucket, descs, &desc_count)) {
+            ext[bucket] = LEAF_ACCEPT;
+        }
+        else if (!desc_count) {
+            ext[bucket] = LEAF_REJECT;
+        }
+        else {
+            error = find_or_add_leaf(&b, descs, desc_count, &index);
+            if (error) {
+                goto exit;
+            }
+
+            ext[bucket] = (uint16_t)index;
+        }
+    }
+
+    free(filter->leaves);
+    memcpy(filter->std, std, sizeof(std));
+    memcpy(filter->ext, ext, SC_FILTER_EXT_BUCKETS * sizeof(*ext));
+    filter->leaves = b.leaves;
+    filter->leaf_count = b.leaf_count;
+    filter->accept_all = 0;
+    b.leaves = NULL;
+
+exit:
+    free(b.leaves);
+    free(b.infos);
+    free(b.descs);
+    free(b.table);
+    free(descs);
+    free(ext);
+
+    return error;
+}
@@ -0,0 +1,109 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Jean Gressmann <jean@0x42.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "supercan_proto.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* CAN ID acceptance filter
+ *
+ * A filter is built from a set of rules. A frame is accepted if any rule
+ * matches. Rules apply to either standard (11 bit) or extended (29 bit)
+ * ids. An empty rule set accepts all frames.
+ *
+ * Lookup is O(1) regardless of the number of rules: standard ids index
+ * a 2048 bit map. Extended ids index a two level bit map. The upper
+ * 14 bits select a leaf covering 2^15 ids. Leaves that come out the same
+ * are shared, in particular the all-reject and all-accept leaves.
+ */
+
+#define SC_FILTER_STD_WORDS         (2048 / 32)
+#define SC_FILTER_EXT_LEAF_BITS     15
+#define SC_FILTER_EXT_LEAF_WORDS    ((1u << SC_FILTER_EXT_LEAF_BITS) / 32)
+#define SC_FILTER_EXT_BUCKETS       (1u << (29 - SC_FILTER_EXT_LEAF_BITS))
+
+enum sc_filter_rule_flags {
+    SC_FILTER_RULE_FLAG_EXT = 0x1,      ///< rule applies to extended ids
+    SC_FILTER_RULE_FLAG_RANGE = 0x2,    ///< rule is a range [id, mask_or_last] as opposed to a mask/match pair
+};
+
+struct sc_filter_rule {
+    uint32_t id;                        ///< id to match (mask) or first id (range)
+    uint32_t mask_or_last;              ///< mask of bits that must match (mask) or last id (range)
+    uint8_t flags;                      ///< SC_FILTER_RULE_FLAG_*
+};
+
+typedef struct sc_filter {
+    uint32_t std[SC_FILTER_STD_WORDS];
+    uint16_t ext[SC_FILTER_EXT_BUCKETS];  ///< leaf index
+    uint32_t* leaves;                   ///< SC_FILTER_EXT_LEAF_WORDS each, 0 rejects all, 1 accepts all
+    uint32_t leaf_count;
+    uint8_t accept_all;
+} sc_filter_t;
+
+/** Initializes the filter to accept all frames */
+void sc_filter_init(sc_filter_t* filter);
+void sc_filter_uninit(sc_filter_t* filter);
+
+/** Replaces the filter's rules
+ *
+ * On error the filter is left unchanged.
+ *
+ * \returns SC_DLL_ERROR_INVALID_PARAM for ids, masks out of range or empty ranges
+ * \returns SC_DLL_ERROR_OUT_OF_MEM
+ */
+int sc_filter_set(sc_filter_t* filter, struct sc_filter_rule const* rules, size_t count);
+
+static inline int sc_filter_accept(sc_filter_t const* filter, uint32_t can_id, uint8_t flags)
+{
+    if (filter->accept_all) {
+        return 1;
+    }
+
+    if (flags & SC_CAN_FRAME_FLAG_EXT) {
+        uint32_t const* leaf = NULL;
+
+        can_id &= 0x1fffffff;
+        leaf = filter->leaves + (size_t)filter->ext[can_id >> SC_FILTER_EXT_LEAF_BITS] * SC_FILTER_EXT_LEAF_WORDS;
+        can_id &= (1u << SC_FILTER_EXT_LEAF_BITS) - 1;
+
+        return (leaf[can_id >> 5] >> (can_id & 31)) & 1;
+    }
+
+    can_id &= 0x7ff;
+
+    return (filter->std[can_id >> 5] >> (can_id & 31)) & 1;
+}
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,385 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Jean Gressmann <jean@0x42.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "usnprintf.h"
+#include "supercan_atomic.h"
+#include "supercan_error.h"
+#include "supercan_log.h"
+
+enum {
+    SC_LOG_ARG_NONE,
+    SC_LOG_ARG_INT,
+    SC_LOG_ARG_LONG,
+    SC_LOG_ARG_LLONG,
+    SC_LOG_ARG_UINT,
+    SC_LOG_ARG_ULONG,
+    SC_LOG_ARG_ULLONG,
+    SC_LOG_ARG_SIZE,
+    SC_LOG_ARG_PTRDIFF,
+    SC_LOG_ARG_STR,
+    SC_LOG_ARG_PTR,
+};
+
+/* Parses the conversion specification following a '%'
+ *
+ * Returns a pointer past the specification or NULL if unsupported.
+ */
+static char const* sc_log_parse_spec(char const* ptr, int* kind)
+{
+    int size = 0;
+    int is_signed = 0;
+
+    while (*ptr && strchr("-+ 0#", *ptr)) {
+        ++ptr;
+    }
+
+    while (*ptr >= '0' && *ptr <= '9') {
+        ++ptr;
+    }
+
+    switch (*ptr) {
+    case 'h':
+        ++ptr;
+        if ('h' == *ptr) {
+            ++ptr;
+        }
+        break;
+    case 'l':
+        ++ptr;
+        size = 1;
+        if ('l' == *ptr) {
+            ++ptr;
+            size = 2;
+        }
+        break;
+    case 'j':
+        ++ptr;
+        size = 2;
+        break;
+    case 'z':
+        ++ptr;
+        size = 3;
+        break;
+    case 't':
+        ++ptr;
+        size = 4;
+        break;
+    }
+
+    switch (*ptr) {
+    case '%':
+        *kind = SC_LOG_ARG_NONE;
+        return ptr + 1;
+    case 's':
+        *kind = SC_LOG_ARG_STR;
+        return ptr + 1;
+    case 'p':
+        *kind = SC_LOG_ARG_PTR;
+        return ptr + 1;
+    case 'c':
+        *kind = SC_LOG_ARG_INT;
+        return ptr + 1;
+    case 'd':
+    case 'i':
+        is_signed = 1;
+        break;
+    case 'u':
+    case 'x':
+    case 'X':
+        break;
+    default:
+        return NULL;
+    }
+
+    switch (size) {
+    case 1:
+        *kind = is_signed ? SC_LOG_ARG_LONG : SC_LOG_ARG_ULONG;
+        break;
+    case 2:
+        *kind = is_signed ? SC_LOG_ARG_LLONG : SC_LOG_ARG_ULLONG;
+        break;
+    case 3:
+        *kind = SC_LOG_ARG_SIZE;
+        break;
+    case 4:
+        *kind = SC_LOG_ARG_PTRDIFF;
+        break;
+    default:
+        *kind = is_signed ? SC_LOG_ARG_INT : SC_LOG_ARG_UINT;
+        break;
+    }
+
+    return ptr + 1;
+}
+
+int sc_log_init(sc_log_t* log, uint32_t capacity)
+{
+    if (!log) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+
+    memset(log, 0, sizeof(*log));
+
+    if (!capacity || (capacity & (capacity - 1))) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+
+    log->records = (sc_log_record_t*)calloc(capacity, sizeof(*log->records));
+    if (!log->records) {
+        return SC_DLL_ERROR_OUT_OF_MEM;
+    }
+
+    log->mask = capacity - 1;
+
+    for (uint32_t i = 0; i < capacity; ++i) {
+        log->records[i].seq = i;
+    }
+
+    return SC_DLL_ERROR_NONE;
+}
+
+void sc_log_uninit(sc_log_t* log)
+{
+    if (log) {
+        free(log->records);
+        memset(log, 0, sizeof(*log));
+    }
+}
+
+int sc_log_vwrite(sc_log_t* log, sc_log_sink sink, void* ctx, int level, char const* fmt, va_list args)
+{
+    sc_log_record_t* r = NULL;
+    uint32_t pos = sc_atomic_load_acquire32(&log->head);
+    char const* ptr = fmt;
+    uint8_t argc = 0;
+
+    // claim a record, see Vyukov's bounded MPMC queue
+    for (;;) {
+        uint32_t seq = 0;
+        int32_t diff = 0;
+
+        r = &log->records[pos & log->mask];
+        seq = sc_atomic_load_acquire32(&r->seq);
+        diff = (int32_t)(seq - pos);
+
+        if (0 == diff) {
+            if (sc_atomic_cas32(&log->head, &pos, pos + 1)) {
+                break;
+            }
+        }
+        else if (diff < 0) {
+            sc_atomic_inc32(&log->dropped);
+            return SC_DLL_ERROR_AGAIN;
+        }
+        else {
+            pos = sc_atomic_load_acquire32(&log->head);
+        }
+    }
+
+    // capture arguments according to the format string
+    while (argc < SC_LOG_MAX_ARGS && (ptr = strchr(ptr, '%')) != NULL) {
+        int kind = SC_LOG_ARG_NONE;
+
+        ptr = sc_log_parse_spec(ptr + 1, &kind);
+        if (!ptr) {
+            break;
+        }
+
+        switch (kind) {
+        case SC_LOG_ARG_NONE:
+            continue;
+        case SC_LOG_ARG_INT:
+            r->args[argc] = (uint64_t)(int64_t)va_arg(args, int);
+            break;
+        case SC_LOG_ARG_LONG:
+            r->args[argc] = (uint64_t)(int64_t)va_arg(args, long);
+            break;
+        case SC_LOG_ARG_LLONG:
+            r->args[argc] = (uint64_t)va_arg(args, long long);
+            break;
+        case SC_LOG_ARG_UINT:
+            r->args[argc] = va_arg(args, unsigned);
+            break;
+        case SC_LOG_ARG_ULONG:
+            r->args[argc] = va_arg(args, unsigned long);
+            break;
+        case SC_LOG_ARG_ULLONG:
+            r->args[argc] = va_arg(args, unsigned long long);
+            break;
+        case SC_LOG_ARG_SIZE:
+            r->args[argc] = va_arg(args, size_t);
+            break;
+        case SC_LOG_ARG_PTRDIFF:
+            r->args[argc] = (uint64_t)(int64_t)va_arg(args, ptrdiff_t);
+            break;
+        default:
+            r->args[argc] = (uintptr_t)va_arg(args, void*);
+            break;
+        }
+
+        ++argc;
+    }
+
+    r->level = level;
+    r->fmt = fmt;
+    r->sink = sink;
+    r->sink_ctx = ctx;
+    r->argc = argc;
+
+    // publish
+    sc_atomic_store_release32(&r->seq, pos + 1);
+
+    return SC_DLL_ERROR_NONE;
+}
+
+int sc_log_write(sc_log_t* log, sc_log_sink sink, void* ctx, int level, char const* fmt, ...)
+{
+    int error = SC_DLL_ERROR_NONE;
+    va_list args;
+
+    va_start(args, fmt);
+    error = sc_log_vwrite(log, sink, ctx, level, fmt, args);
+    va_end(args);
+
+    return error;
+}
+
+int sc_log_format(sc_log_record_t const* r, char* buffer, size_t size)
+{
+    char const* ptr = r->fmt;
+    size_t offset = 0;
+    uint8_t argi = 0;
+
+    if (!size) {
+        return 0;
+    }
+
+    while (*ptr && offset + 1 < size) {
+        char spec[16];
+        char const* end = NULL;
+        size_t spec_len = 0;
+        int kind = SC_LOG_ARG_NONE;
+        int chars = 0;
+        uint64_t arg = 0;
+
+        if ('%' != *ptr) {
+            buffer[offset++] = *ptr++;
+            continue;
+        }
+
+        end = sc_log_parse_spec(ptr + 1, &kind);
+        spec_len = end ? (size_t)(end - ptr) : 0;
+
+        if (!end || spec_len >= sizeof(spec) || (SC_LOG_ARG_NONE != kind && argi == r->argc)) {
+            // print rest of format string verbatim
+            kind = SC_LOG_ARG_NONE;
+            spec_len = strlen(ptr);
+            chars = (int)(spec_len < size - 1 - offset ? spec_len : size - 1 - offset);
+            memcpy(buffer + offset, ptr, (size_t)chars);
+            offset += (size_t)chars;
+            break;
+        }
+
+        if (SC_LOG_ARG_NONE == kind) {
+            buffer[offset++] = '%';
+            ptr = end;
+            continue;
+        }
+
+        memcpy(spec, ptr, spec_len);
+        spec[spec_len] = 0;
+        ptr = end;
+        arg = r->args[argi++];
+
+        switch (kind) {
+        case SC_LOG_ARG_INT:
+            chars = usnprintf(buffer + offset, size - offset, spec, (int)(int64_t)arg);
+            break;
+        case SC_LOG_ARG_LONG:
+            chars = usnprintf(buffer + offset, size - offset, spec, (long)(int64_t)arg);
+            break;
+        case SC_LOG_ARG_LLONG:
+            chars = usnprintf(buffer + offset, size - offset, spec, (long long)arg);
+            break;
+        case SC_LOG_ARG_UINT:
+            chars = usnprintf(buffer + offset, size - offset, spec, (unsigned)arg);
+            break;
+        case SC_LOG_ARG_ULONG:
+            chars = usnprintf(buffer + offset, size - offset, spec, (unsigned long)arg);
+            break;
+        case SC_LOG_ARG_ULLONG:
+            chars = usnprintf(buffer + offset, size - offset, spec, (unsigned long long)arg);
+            break;
+        case SC_LOG_ARG_SIZE:
+            chars = usnprintf(buffer + offset, size - offset, spec, (size_t)arg);
+            break;
+        case SC_LOG_ARG_PTRDIFF:
+            chars = usnprintf(buffer + offset, size - offset, spec, (ptrdiff_t)(int64_t)arg);
+            break;
+        case SC_LOG_ARG_STR:
+            chars = usnprintf(buffer + offset, size - offset, spec, arg ? (char const*)(uintptr_t)arg : "(null)");
+            break;
+        default:
+            chars = usnprintf(buffer + offset, size - offset, spec, (void*)(uintptr_t)arg);
+            break;
+        }
+
+        if (chars > 0) {
+            offset += (size_t)chars;
+        }
+    }
+
+    buffer[offset] = 0;
+
+    return (int)offset;
+}
+
+size_t sc_log_drain(sc_log_t* log, size_t max)
+{
+    char buffer[SC_LOG_LINE_SIZE];
+    size_t count = 0;
+
+    while (!max || count < max) {
+        sc_log_record_t* r = &log->records[log->tail & log->mask];
+        uint32_t seq = sc_atomic_load_acquire32(&r->seq);
+        int chars = 0;
+
+        if (seq != log->tail + 1) {
+            break;
+        }
+
+        chars = sc_log_format(r, buffer, sizeof(buffer));
+        r->sink(r->sink_ctx, r->level, buffer, (size_t)chars);
+
+        sc_atomic_store_release32(&r->seq, log->tail + log->mask + 1);
+        ++log->tail;
+        ++count;
+    }
+
+    return count;
+}
@@ -0,0 +1,121 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Jean Gressmann <jean@0x42.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SC_LOG_MAX_ARGS     8
+#define SC_LOG_LINE_SIZE    256
+
+/** Log sink, same signature as sc_log_callback_t */
+typedef void (*sc_log_sink)(void* ctx, int level, char const* msg, size_t size);
+
+/** Log record
+ *
+ * Holds the format string and the raw arguments. Formatting
+ * happens when the record is consumed.
+ */
+typedef struct sc_log_record {
+    uint32_t volatile seq;      ///< ring sequence number
+    int level;
+    char const* fmt;            ///< format string, must outlive the record
+    sc_log_sink sink;
+    void* sink_ctx;
+    uint64_t args[SC_LOG_MAX_ARGS];
+    uint8_t argc;
+} sc_log_record_t;
+
+/** Deferred logger
+ *
+ * Producers on any thread store compact records in a lock-free ring,
+ * a single consumer formats them with usnprintf and passes the text
+ * on to the record's sink. Records are dropped if the ring is full,
+ * producers never wait.
+ *
+ * Because formatting is deferred, %s arguments must point to strings
+ * that outlive the record, i.e. literals or the result of sc_strerror.
+ * Conversions are limited to those of usnprintf.
+ */
+typedef struct sc_log {
+    sc_log_record_t* records;
+    uint32_t mask;              ///< capacity - 1
+    uint32_t volatile head;     ///< next record to claim, producers
+    uint32_t tail;              ///< next record to consume, consumer
+    uint32_t volatile dropped;  ///< records lost because the ring was full
+} sc_log_t;
+
+/** Initializes the logger
+ *
+ * \param log       logger to initialize
+ * \param capacity  number of records, must be a power of two
+ *
+ * \returns error code
+ */
+int sc_log_init(sc_log_t* log, uint32_t capacity);
+
+/** Frees the logger's resources
+ *
+ * \param log  logger to uninitialize, can be NULL
+ */
+void sc_log_uninit(sc_log_t* log);
+
+/** Stores a record for deferred formatting
+ *
+ * Safe to call from any number of threads.
+ *
+ * \returns SC_DLL_ERROR_AGAIN if the ring is full and the record was dropped
+ */
+int sc_log_write(sc_log_t* log, sc_log_sink sink, void* ctx, int level, char const* fmt, ...);
+
+/** See sc_log_write */
+int sc_log_vwrite(sc_log_t* log, sc_log_sink sink, void* ctx, int level, char const* fmt, va_list args);
+
+/** Formats a record
+ *
+ * \returns number of characters written, excluding the terminating zero
+ */
+int sc_log_format(sc_log_record_t const* record, char* buffer, size_t size);
+
+/** Formats records and passes them to their sinks
+ *
+ * Must only be called from one thread at a time.
+ *
+ * \param log   logger
+ * \param max   maximum number of records to process, 0 for no limit
+ *
+ * \returns number of records processed
+ */
+size_t sc_log_drain(sc_log_t* log, size_t max);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,307 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020-2025 Jean Gressmann <jean@0x42.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "supercan_error.h"
+#include "supercan_loopback.h"
+
+
+int sc_loopback_init(sc_loopback_t* lb, size_t transfer_size, unsigned capacity, unsigned slot_count)
+{
+    if (!lb) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+
+    memset(lb, 0, sizeof(*lb));
+
+    if (!transfer_size || transfer_size > UINT16_MAX || !capacity || !slot_count) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+
+    lb->transfer_size = transfer_size;
+    lb->in_capacity = capacity;
+    lb->slot_count = slot_count;
+
+    lb->in_data = (uint8_t*)malloc(capacity * transfer_size);
+    lb->in_sizes = (uint16_t*)calloc(capacity, sizeof(*lb->in_sizes));
+    lb->reads = (struct sc_loopback_slot*)calloc(slot_count, sizeof(*lb->reads));
+    lb->writes = (struct sc_loopback_slot*)calloc(slot_count, sizeof(*lb->writes));
+    lb->write_queue = (unsigned*)calloc(slot_count, sizeof(*lb->write_queue));
+
+    if (!lb->in_data || !lb->in_sizes || !lb->reads || !lb->writes || !lb->write_queue) {
+        sc_loopback_uninit(lb);
+        return SC_DLL_ERROR_OUT_OF_MEM;
+    }
+
+    return SC_DLL_ERROR_NONE;
+}
+
+void sc_loopback_uninit(sc_loopback_t* lb)
+{
+    if (lb) {
+        free(lb->in_data);
+        free(lb->in_sizes);
+        free(lb->reads);
+        free(lb->writes);
+        free(lb->write_queue);
+        memset(lb, 0, sizeof(*lb));
+    }
+}
+
+void sc_loopback_set_write_callback(sc_loopback_t* lb, void* ctx, sc_loopback_write_callback callback)
+{
+    lb->write_ctx = ctx;
+    lb->write_callback = callback;
+}
+
+int sc_loopback_push(sc_loopback_t* lb, void const* ptr, size_t bytes)
+{
+    unsigned index = 0;
+
+    if (!lb || (!ptr && bytes)) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+
+    if (bytes > lb->transfer_size) {
+        return SC_DLL_ERROR_BUFFER_TOO_SMALL;
+    }
+
+    if (lb->in_count == lb->in_capacity) {
+        return SC_DLL_ERROR_AGAIN;
+    }
+
+    index = (lb->in_head + lb->in_count) % lb->in_capacity;
+    memcpy(lb->in_data + index * lb->transfer_size, ptr, bytes);
+    lb->in_sizes[index] = (uint16_t)bytes;
+    ++lb->in_count;
+
+    return SC_DLL_ERROR_NONE;
+}
+
+/* Delivers queued writes in submission order */
+static void sc_loopback_pump(sc_loopback_t* lb)
+{
+    while (lb->write_count) {
+        unsigned const slot = lb->write_queue[lb->write_head];
+        struct sc_loopback_slot* w = &lb->writes[slot];
+
+        if (w->pending) {
+            int error = SC_DLL_ERROR_NONE;
+
+            if (lb->write_callback) {
+                error = lb->write_callback(lb->write_ctx, w->data, w->bytes);
+            }
+            else {
+                error = sc_loopback_push(lb, w->data, w->bytes);
+            }
+
+            if (SC_DLL_ERROR_AGAIN == error) {
+                break;
+            }
+
+            // errors of the device side are not visible to the host
+            w->done = 1;
+        }
+
+        lb->write_head = (lb->write_head + 1) % lb->slot_count;
+        --lb->write_count;
+    }
+}
+
+static int sc_loopback_submit_read(void* ctx, unsigned slot, uint8_t* buffer, size_t bytes)
+{
+    sc_loopback_t* lb = (sc_loopback_t*)ctx;
+    struct sc_loopback_slot* r = NULL;
+
+    if (slot >= lb->slot_count || !buffer) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+
+    r = &lb->reads[slot];
+
+    if (r->pending) {
+        return SC_DLL_ERROR_INVALID_OPERATION;
+    }
+
+    r->buffer = buffer;
+    r->bytes = bytes;
+    r->seq = lb->read_seq++;
+    r->pending = 1;
+
+    return SC_DLL_ERROR_NONE;
+}
+
+static int sc_loopback_submit_write(void* ctx, unsigned slot, uint8_t const* buffer, size_t bytes)
+{
+    sc_loopback_t* lb = (sc_loopback_t*)ctx;
+    struct sc_loopback_slot* w = NULL;
+
+    if (slot >= lb->slot_count || (!buffer && bytes) || bytes > lb->transfer_size) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+
+    w = &lb->writes[slot];
+
+    if (w->pending) {
+        return SC_DLL_ERROR_INVALID_OPERATION;
+    }
+
+    if (lb->write_count == lb->slot_count) {
+        // queue holds canceled writes not yet skipped
+        return SC_DLL_ERROR_AGAIN;
+    }
+
+    w->data = buffer;
+    w->bytes = bytes;
+    w->pending = 1;
+    w->done = 0;
+
+    lb->write_queue[(lb->write_head + lb->write_count) % lb->slot_count] = slot;
+    ++lb->write_count;
+
+    sc_loopback_pump(lb);
+
+    return SC_DLL_ERROR_NONE;
+}
+
+static int sc_loopback_reap(void* ctx, int dir, unsigned slot, size_t* transferred, uint32_t timeout_ms)
+{
+    sc_loopback_t* lb = (sc_loopback_t*)ctx;
+
+    (void)timeout_ms;
+
+    if (slot >= lb->slot_count || !transferred) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+
+    *transferred = 0;
+
+    if (SC_TRANSPORT_DIR_IN == dir) {
+        struct sc_loopback_slot* r = &lb->reads[slot];
+        size_t bytes = 0;
+
+        if (!r->pending) {
+            return SC_DLL_ERROR_INVALID_OPERATION;
+        }
+
+        sc_loopback_pump(lb);
+
+        if (!lb->in_count) {
+            return SC_DLL_ERROR_TIMEOUT;
+        }
+
+        bytes = lb->in_sizes[lb->in_head];
+        if (bytes > r->bytes) {
+            bytes = r->bytes;
+        }
+
+        memcpy(r->buffer, lb->in_data + lb->in_head * lb->transfer_size, bytes);
+        lb->in_head = (lb->in_head + 1) % lb->in_capacity;
+        --lb->in_count;
+
+        r->pending = 0;
+        *transferred = bytes;
+    }
+    else {
+        struct sc_loopback_slot* w = &lb->writes[slot];
+
+        if (!w->pending) {
+            return SC_DLL_ERROR_INVALID_OPERATION;
+        }
+
+        sc_loopback_pump(lb);
+
+        if (!w->done) {
+            return SC_DLL_ERROR_TIMEOUT;
+        }
+
+        w->pending = 0;
+        *transferred = w->bytes;
+    }
+
+    return SC_DLL_ERROR_NONE;
+}
+
+static int sc_loopback_cancel(void* ctx, int dir, unsigned slot)
+{
+    sc_loopback_t* lb = (sc_loopback_t*)ctx;
+
+    if (slot >= lb->slot_count) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+
+    if (SC_TRANSPORT_DIR_IN == dir) {
+        lb->reads[slot].pending = 0;
+    }
+    else {
+        // undelivered writes are skipped by sc_loopback_pump
+        lb->writes[slot].pending = 0;
+    }
+
+    return SC_DLL_ERROR_NONE;
+}
+
+static int sc_loopback_pending(void* ctx, int dir, unsigned slot)
+{
+    sc_loopback_t* lb = (sc_loopback_t*)ctx;
+
+    if (slot >= lb->slot_count) {
+        return 0;
+    }
+
+    sc_loopback_pump(lb);
+
+    if (SC_TRANSPORT_DIR_IN == dir) {
+        struct sc_loopback_slot* r = &lb->reads[slot];
+        unsigned earlier = 0;
+
+        if (!r->pending) {
+            return 0;
+        }
+
+        // queued transfers complete reads in submission order
+        for (unsigned i = 0; i < lb->slot_count; ++i) {
+            if (lb->reads[i].pending && (int)(lb->reads[i].seq - r->seq) < 0) {
+                ++earlier;
+            }
+        }
+
+        return earlier >= lb->in_count;
+    }
+
+    return lb->writes[slot].pending && !lb->writes[slot].done;
+}
+
+void sc_loopback_transport(sc_loopback_t* lb, sc_transport_t* transport)
+{
+    transport->ctx = lb;
+    transport->submit_read = &sc_loopback_submit_read;
+    transport->submit_write = &sc_loopback_submit_write;
+    transport->reap = &sc_loopback_reap;
+    transport->cancel = &sc_loopback_cancel;
+    transport->pending = &sc_loopback_pending;
+}
@@ -0,0 +1,110 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020-2025 Jean Gressmann <jean@0x42.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "supercan_transport.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Device side handler of host writes
+ *
+ * \returns error code, SC_DLL_ERROR_AGAIN to retry delivery later
+ */
+typedef int (*sc_loopback_write_callback)(void* ctx, uint8_t const* ptr, size_t bytes);
+
+struct sc_loopback_slot {
+    uint8_t* buffer;        ///< read buffer
+    uint8_t const* data;    ///< write data
+    size_t bytes;
+    unsigned seq;           ///< submission order of reads
+    uint8_t pending;        ///< request submitted
+    uint8_t done;           ///< write delivered
+};
+
+/** In-memory transport
+ *
+ * Transfers written by the host are delivered to the write callback,
+ * or, if no callback is set, queued for reading back by the host.
+ * Device to host transfers can also be queued with sc_loopback_push.
+ *
+ * Requests never block, reaping a request which can't complete
+ * yields SC_DLL_ERROR_TIMEOUT immediately. The loopback isn't thread-safe.
+ */
+typedef struct sc_loopback {
+    uint8_t* in_data;           ///< queue of device to host transfers
+    uint16_t* in_sizes;
+    size_t transfer_size;       ///< maximum size of a transfer
+    unsigned in_capacity;
+    unsigned in_head;
+    unsigned in_count;
+    struct sc_loopback_slot* reads;
+    struct sc_loopback_slot* writes;
+    unsigned* write_queue;      ///< write slots in submission order
+    unsigned write_head;
+    unsigned write_count;
+    unsigned slot_count;
+    unsigned read_seq;
+    void* write_ctx;
+    sc_loopback_write_callback write_callback;
+} sc_loopback_t;
+
+/** Initializes the loopback
+ *
+ * \param lb            loopback to initialize
+ * \param transfer_size maximum size of a transfer
+ * \param capacity      number of device to host transfers that can be queued
+ * \param slot_count    number of request slots per direction
+ *
+ * \returns error code
+ */
+int sc_loopback_init(sc_loopback_t* lb, size_t transfer_size, unsigned capacity, unsigned slot_count);
+
+/** Frees the loopback's resources
+ *
+ * \param lb  loopback to uninitialize, can be NULL
+ */
+void sc_loopback_uninit(sc_loopback_t* lb);
+
+/** Sets handler of host writes, pass NULL to loop writes back */
+void sc_loopback_set_write_callback(sc_loopback_t* lb, void* ctx, sc_loopback_write_callback callback);
+
+/** Queues a device to host transfer
+ *
+ * \returns SC_DLL_ERROR_AGAIN if the queue is full
+ */
+int sc_loopback_push(sc_loopback_t* lb, void const* ptr, size_t bytes);
+
+/** Fills in the transport functions for the loopback */
+void sc_loopback_transport(sc_loopback_t* lb, sc_transport_t* transport);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
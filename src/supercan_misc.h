@@ -71,6 +71,66 @@ static inline uint64_t sc_tt_track(sc_dev_time_tracker_t* tracker, uint32_t ts_u
     return ts_us;
 }
 
+#define SC_DEV_CLOCK_WINDOW_US 100000
+
+/** Maps host time to device time
+ *
+ * Device timestamps (sc_tt_track) are observed along with the host time
+ * the message arrived. Since messages are always received after they
+ * were timestamped, the largest device - host difference is the best
+ * estimate of the clock offset. The estimate is taken over windows of
+ * SC_DEV_CLOCK_WINDOW_US to follow drift in both directions.
+ */
+typedef struct sc_dev_clock {
+    int64_t offset_us;
+    int64_t window_max_us;
+    uint64_t window_start_us;
+    uint32_t initialized;
+} sc_dev_clock_t;
+
+static inline void sc_dc_init(sc_dev_clock_t* clock)
+{
+    memset(clock, 0, sizeof(*clock));
+}
+
+static inline void sc_dc_observe(sc_dev_clock_t* clock, uint64_t dev_us, uint64_t host_us)
+{
+    int64_t const offset_us = (int64_t)(dev_us - host_us);
+
+    if (!clock->initialized) {
+        clock->initialized = 1;
+        clock->offset_us = offset_us;
+        clock->window_max_us = offset_us;
+        clock->window_start_us = host_us;
+        return;
+    }
+
+    if (offset_us > clock->offset_us) {
+        clock->offset_us = offset_us;
+    }
+
+    if (host_us - clock->window_start_us >= SC_DEV_CLOCK_WINDOW_US) {
+        clock->offset_us = clock->window_max_us > offset_us ? clock->window_max_us : offset_us;
+        clock->window_max_us = offset_us;
+        clock->window_start_us = host_us;
+    }
+    else if (offset_us > clock->window_max_us) {
+        clock->window_max_us = offset_us;
+    }
+}
+
+/** Device time at host_us, only valid after the first observation */
+static inline uint64_t sc_dc_now(sc_dev_clock_t const* clock, uint64_t host_us)
+{
+    return host_us + (uint64_t)clock->offset_us;
+}
+
+/** Host time of device time dev_us, only valid after the first observation */
+static inline uint64_t sc_dc_host(sc_dev_clock_t const* clock, uint64_t dev_us)
+{
+    return dev_us - (uint64_t)clock->offset_us;
+}
+
 #ifdef __cplusplus
 }
 #endif
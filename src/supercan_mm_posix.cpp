@@ -0,0 +1,178 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Jean Gressmann <jean@0x42.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "supercan_error.h"
+#include "supercan_mm_posix.h"
+
+namespace sc {
+namespace mm {
+
+namespace {
+
+int map_errno(int e)
+{
+    switch (e) {
+    case EACCES:
+    case EPERM:
+        return SC_DLL_ERROR_ACCESS_DENIED;
+    case EEXIST:
+        return SC_DLL_ERROR_DEVICE_BUSY;
+    case EINVAL:
+    case ENAMETOOLONG:
+    case ENOENT:
+        return SC_DLL_ERROR_INVALID_PARAM;
+    case ENOMEM:
+    case ENOSPC:
+    case EMFILE:
+    case ENFILE:
+        return SC_DLL_ERROR_OUT_OF_MEM;
+    default:
+        return SC_DLL_ERROR_UNKNOWN;
+    }
+}
+
+} // anon
+
+posix_ring_mapping::posix_ring_mapping()
+    : m_Name(nullptr)
+    , m_Hdr(nullptr)
+    , m_Bytes(0)
+    , m_Elements(0)
+    , m_Fd(-1)
+    , m_Owner(false)
+{
+}
+
+posix_ring_mapping::~posix_ring_mapping()
+{
+    close();
+}
+
+int posix_ring_mapping::create(char const* name, uint32_t elements)
+{
+    return map(name, elements, true);
+}
+
+int posix_ring_mapping::open(char const* name, uint32_t elements)
+{
+    return map(name, elements, false);
+}
+
+int posix_ring_mapping::map(char const* name, uint32_t elements, bool create)
+{
+    int error = SC_DLL_ERROR_NONE;
+    void* ptr = nullptr;
+
+    if (!name || !elements) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+
+    close();
+
+    m_Name = strdup(name);
+    if (!m_Name) {
+        return SC_DLL_ERROR_OUT_OF_MEM;
+    }
+
+    m_Bytes = bytes(elements);
+    m_Elements = elements;
+    m_Owner = create;
+
+    m_Fd = shm_open(name, create ? O_RDWR | O_CREAT | O_EXCL : O_RDWR, S_IRUSR | S_IWUSR);
+    if (-1 == m_Fd) {
+        m_Owner = false;
+        error = map_errno(errno);
+        goto error_exit;
+    }
+
+    if (create) {
+        // new objects are zero filled
+        if (-1 == ftruncate(m_Fd, (off_t)m_Bytes)) {
+            error = map_errno(errno);
+            goto error_exit;
+        }
+    }
+    else {
+        struct stat st;
+
+        if (-1 == fstat(m_Fd, &st)) {
+            error = map_errno(errno);
+            goto error_exit;
+        }
+
+        if ((size_t)st.st_size < m_Bytes) {
+            error = SC_DLL_ERROR_INVALID_PARAM;
+            goto error_exit;
+        }
+    }
+
+    ptr = mmap(nullptr, m_Bytes, PROT_READ | PROT_WRITE, MAP_SHARED, m_Fd, 0);
+    if (MAP_FAILED == ptr) {
+        error = map_errno(errno);
+        goto error_exit;
+    }
+
+    m_Hdr = static_cast<sc_can_mm_header*>(ptr);
+
+    return SC_DLL_ERROR_NONE;
+
+error_exit:
+    close();
+    return error;
+}
+
+void posix_ring_mapping::close()
+{
+    if (m_Hdr) {
+        munmap(m_Hdr, m_Bytes);
+        m_Hdr = nullptr;
+    }
+
+    if (-1 != m_Fd) {
+        ::close(m_Fd);
+        m_Fd = -1;
+    }
+
+    if (m_Owner) {
+        shm_unlink(m_Name);
+        m_Owner = false;
+    }
+
+    free(m_Name);
+    m_Name = nullptr;
+    m_Bytes = 0;
+    m_Elements = 0;
+}
+
+} // mm
+} // sc
@@ -0,0 +1,97 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Jean Gressmann <jean@0x42.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#ifndef __cplusplus
+#   error "supercan_mm_posix.h requires C++"
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "supercan_srv.h"
+
+namespace sc {
+namespace mm {
+
+/** POSIX shared memory backend for sc_can_mm_header rings
+ *
+ * Maps a ring created with shm_open. This lets the ring protocol be
+ * exercised by separate processes on systems other than Windows,
+ * where the COM server creates the rings with CreateFileMapping.
+ */
+class posix_ring_mapping
+{
+public:
+    posix_ring_mapping();
+    ~posix_ring_mapping();
+
+    /** Bytes required for a ring of the given number of elements */
+    static size_t bytes(uint32_t elements)
+    {
+        return sizeof(sc_can_mm_header) + elements * sizeof(sc_can_mm_slot_t);
+    }
+
+    /** Creates and maps a zeroed ring
+     *
+     * The shared memory object is unlinked once the creator unmaps it.
+     *
+     * \param name      shared memory object name, i.e. "/supercan-rx-0"
+     * \param elements  number of slots
+     *
+     * \returns error code
+     */
+    int create(char const* name, uint32_t elements);
+
+    /** Maps an existing ring
+     *
+     * \returns error code
+     */
+    int open(char const* name, uint32_t elements);
+
+    /** Unmaps the ring */
+    void close();
+
+    sc_can_mm_header* header() const { return m_Hdr; }
+    uint32_t elements() const { return m_Elements; }
+
+private:
+    posix_ring_mapping(posix_ring_mapping const&) = delete;
+    posix_ring_mapping& operator=(posix_ring_mapping const&) = delete;
+
+    int map(char const* name, uint32_t elements, bool create);
+
+private:
+    char* m_Name;
+    sc_can_mm_header* m_Hdr;
+    size_t m_Bytes;
+    uint32_t m_Elements;
+    int m_Fd;
+    bool m_Owner;
+};
+
+} // mm
+} // sc
@@ -0,0 +1,1131 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Jean Gressmann <jean@0x42.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#ifndef __cplusplus
+#   error "supercan_mm_ring.h requires C++"
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "supercan_atomic.h"
+#include "supercan_error.h"
+#include "supercan_proto.h"
+#include "supercan_srv.h"
+
+/* Ring buffers of the COM server's shared memory interface
+ *
+ * A ring is a sc_can_mm_header followed by a number of slots. The
+ * indices in the header are free running counters, the slot of an
+ * index is index % elements. There is one producer and one consumer,
+ * the producer owns put_index, the consumer owns get_index.
+ *
+ * The producer writes slots before it publishes put_index with release
+ * semantics, the consumer reads put_index with acquire semantics
+ * before it reads slots. Likewise for get_index in the opposite
+ * direction, so that slots are never overwritten while being read.
+ *
+ * Since the other side lives in a different process it isn't trusted.
+ * Both classes detect indices they don't own being changed and report
+ * SC_DLL_ERROR_PROTO_VIOLATION.
+ *
+ * Wakeups are coalesced: the producer publishes slots as it goes but
+ * only asks for the consumer to be signaled once it is done with a
+ * batch (see ring_producer::wake). A consumer that is busy reading can
+ * set SC_MM_CLIENT_FLAG_POLLING to suppress signals altogether.
+ *
+ * var_ring_producer and var_ring_consumer implement the variable length
+ * record format (SC_MM_FORMAT_VAR) on top of the same indices, only that
+ * they count 64 bit words instead of slots.
+ */
+
+namespace sc {
+namespace mm {
+
+class ring_base
+{
+public:
+    ring_base()
+        : m_Hdr(nullptr)
+        , m_Elements(0)
+        , m_Index(0)
+    {}
+
+    sc_can_mm_header* header() const { return m_Hdr; }
+    uint32_t elements() const { return m_Elements; }
+
+    /** Free running index of the next slot to write (producer) or read (consumer) */
+    uint32_t index() const { return m_Index; }
+
+protected:
+    sc_can_mm_slot_t* at(uint32_t offset) const
+    {
+        return &m_Hdr->elements[(m_Index + offset) % m_Elements];
+    }
+
+    // number of slots from offset to the end of the slot array
+    uint32_t contiguous(uint32_t offset) const
+    {
+        return m_Elements - (m_Index + offset) % m_Elements;
+    }
+
+protected:
+    sc_can_mm_header* m_Hdr;
+    uint32_t m_Elements;
+    uint32_t m_Index;
+};
+
+/** Producer side of a ring, not thread-safe */
+class ring_producer : public ring_base
+{
+public:
+    ring_producer()
+        : m_Pending(false)
+    {}
+
+    /** Attaches to a ring, continuing at the current put_index */
+    void attach(sc_can_mm_header* hdr, uint32_t elements)
+    {
+        m_Hdr = hdr;
+        m_Elements = elements;
+        m_Index = hdr->put_index;
+        m_Pending = false;
+    }
+
+    /** Empties the ring by resetting both indices to the producer's index */
+    void reset()
+    {
+        sc_atomic_store_release32(&m_Hdr->get_index, m_Index);
+        sc_atomic_store_release32(&m_Hdr->put_index, m_Index);
+        m_Pending = false;
+    }
+
+    /** Marks the consumer as needing a wakeup without publishing slots, e.g. on loss */
+    void notify() { m_Pending = true; }
+
+    /** Checks if the consumer must be signaled
+     *
+     * Call once after a batch of commits. Returns true at most once per
+     * batch and only if the consumer isn't polling.
+     */
+    bool wake()
+    {
+        if (!m_Pending) {
+            return false;
+        }
+
+        m_Pending = false;
+
+        // order put_index store before client_flags load, pairs with ring_consumer::poll
+        sc_atomic_fence();
+
+        return !(sc_atomic_load_acquire32(&m_Hdr->client_flags) & SC_MM_CLIENT_FLAG_POLLING);
+    }
+
+    /** Retrieves the number of slots that can be written
+     *
+     * \returns SC_DLL_ERROR_PROTO_VIOLATION if the consumer corrupted the ring
+     */
+    int writable(uint32_t* count) const
+    {
+        uint32_t const gi = sc_atomic_load_acquire32(&m_Hdr->get_index);
+        uint32_t const pi = m_Hdr->put_index;
+        uint32_t const used = pi - gi;
+
+        *count = 0;
+
+        if (pi != m_Index || used > m_Elements) {
+            return SC_DLL_ERROR_PROTO_VIOLATION;
+        }
+
+        *count = m_Elements - used;
+
+        return SC_DLL_ERROR_NONE;
+    }
+
+    /** Slot offset slots past the producer's index, see writable */
+    sc_can_mm_slot_t* slot(uint32_t offset = 0) const { return at(offset); }
+
+    /** Publishes count slots written with slot() */
+    void commit(uint32_t count = 1)
+    {
+        m_Index += count;
+        sc_atomic_store_release32(&m_Hdr->put_index, m_Index);
+        m_Pending = true;
+    }
+
+    /** Copies slots into the ring and publishes them at once
+     *
+     * \param slots     slots to copy
+     * \param count     number of slots
+     * \param pushed    (out) number of slots copied, less than count if the ring is full
+     *
+     * \returns error code
+     */
+    int push(sc_can_mm_slot_t const* slots, uint32_t count, uint32_t* pushed)
+    {
+        uint32_t available = 0;
+        uint32_t first = 0;
+        int error = writable(&available);
+
+        *pushed = 0;
+
+        if (error) {
+            return error;
+        }
+
+        if (count > available) {
+            count = available;
+        }
+
+        if (!count) {
+            return SC_DLL_ERROR_NONE;
+        }
+
+        first = contiguous(0);
+        if (first > count) {
+            first = count;
+        }
+
+        memcpy(at(0), slots, first * sizeof(*slots));
+        memcpy(at(first), slots + first, (count - first) * sizeof(*slots));
+
+        commit(count);
+        *pushed = count;
+
+        return SC_DLL_ERROR_NONE;
+    }
+
+private:
+    bool m_Pending;
+};
+
+/** Consumer side of a ring, not thread-safe */
+class ring_consumer : public ring_base
+{
+public:
+    /** Attaches to a ring, continuing at the current get_index */
+    void attach(sc_can_mm_header* hdr, uint32_t elements)
+    {
+        m_Hdr = hdr;
+        m_Elements = elements;
+        m_Index = hdr->get_index;
+    }
+
+    /** Advertises whether the consumer is actively reading
+     *
+     * After switching polling off, check readable() once more before
+     * waiting on the event, slots published in between aren't signaled.
+     */
+    void poll(bool on)
+    {
+        sc_atomic_store_release32(&m_Hdr->client_flags, on ? SC_MM_CLIENT_FLAG_POLLING : 0);
+
+        // order client_flags store before put_index load, pairs with ring_producer::wake
+        sc_atomic_fence();
+    }
+
+    /** Discards all slots written so far */
+    void skip_all()
+    {
+        m_Index = sc_atomic_load_acquire32(&m_Hdr->put_index);
+        sc_atomic_store_release32(&m_Hdr->get_index, m_Index);
+    }
+
+    /** Retrieves the number of slots that can be read
+     *
+     * \returns SC_DLL_ERROR_PROTO_VIOLATION if the producer corrupted the ring
+     */
+    int readable(uint32_t* count) const
+    {
+        uint32_t const pi = sc_atomic_load_acquire32(&m_Hdr->put_index);
+        uint32_t const gi = m_Hdr->get_index;
+        uint32_t const used = pi - gi;
+
+        *count = 0;
+
+        if (gi != m_Index || used > m_Elements) {
+            return SC_DLL_ERROR_PROTO_VIOLATION;
+        }
+
+        *count = used;
+
+        return SC_DLL_ERROR_NONE;
+    }
+
+    /** Slot offset slots past the consumer's index, see readable */
+    sc_can_mm_slot_t const* slot(uint32_t offset = 0) const { return at(offset); }
+
+    /** Releases count slots read with slot() to the producer */
+    void consume(uint32_t count = 1)
+    {
+        m_Index += count;
+        sc_atomic_store_release32(&m_Hdr->get_index, m_Index);
+    }
+
+    /** Copies slots out of the ring and releases them at once
+     *
+     * \param slots     destination
+     * \param count     capacity of destination in slots
+     * \param popped    (out) number of slots copied
+     *
+     * \returns error code
+     */
+    int pop(sc_can_mm_slot_t* slots, uint32_t count, uint32_t* popped)
+    {
+        uint32_t available = 0;
+        uint32_t first = 0;
+        int error = readable(&available);
+
+        *popped = 0;
+
+        if (error) {
+            return error;
+        }
+
+        if (count > available) {
+            count = available;
+        }
+
+        if (!count) {
+            return SC_DLL_ERROR_NONE;
+        }
+
+        first = contiguous(0);
+        if (first > count) {
+            first = count;
+        }
+
+        memcpy(slots, at(0), first * sizeof(*slots));
+        memcpy(slots + first, at(first), (count - first) * sizeof(*slots));
+
+        consume(count);
+        *popped = count;
+
+        return SC_DLL_ERROR_NONE;
+    }
+};
+
+inline uint8_t var_dlc_to_len(uint8_t dlc)
+{
+    static const uint8_t map[16] = {
+        0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64
+    };
+    return map[dlc & 0xf];
+}
+
+inline uint8_t var_data_len(uint8_t dlc, uint8_t flags)
+{
+    return (flags & SC_CAN_FRAME_FLAG_RTR) ? 0 : var_dlc_to_len(dlc);
+}
+
+inline uint32_t var_words_of_bytes(uint32_t bytes)
+{
+    return (bytes + SC_MM_VAR_WORD_SIZE - 1) / SC_MM_VAR_WORD_SIZE;
+}
+
+/* Payloads start at 8 byte offsets in both formats and records are
+ * padded to whole words, hence copy whole words. This also keeps
+ * compilers from emitting string instructions for the short copies.
+ */
+inline void var_copy(void* dst, void const* src, uint32_t bytes)
+{
+    uint8_t* d = static_cast<uint8_t*>(dst);
+    uint8_t const* s = static_cast<uint8_t const*>(src);
+
+    for (uint32_t i = 0; i < bytes; i += SC_MM_VAR_WORD_SIZE) {
+        memcpy(d + i, s + i, SC_MM_VAR_WORD_SIZE);
+    }
+}
+
+/** Size of the variable length record for slot in words */
+inline uint32_t var_words(sc_can_mm_slot_t const* slot)
+{
+    switch (slot->hdr.type) {
+    case SC_MM_DATA_TYPE_CAN_RX:
+        return var_words_of_bytes(sizeof(sc_mm_var_can_rx) + var_data_len(slot->rx.dlc, slot->rx.flags));
+    case SC_MM_DATA_TYPE_CAN_TX:
+        return var_words_of_bytes(sizeof(sc_mm_var_can_tx) + var_data_len(slot->tx.dlc, slot->tx.flags));
+    case SC_MM_DATA_TYPE_CAN_STATUS:
+        return var_words_of_bytes(sizeof(sc_mm_var_can_status));
+    case SC_MM_DATA_TYPE_CAN_ERROR:
+        return var_words_of_bytes(sizeof(sc_mm_var_can_error));
+    case SC_MM_DATA_TYPE_LOG_DATA:
+        return var_words_of_bytes(sizeof(sc_mm_var_log_data) + slot->log_data.bytes);
+    default:
+        return 1;
+    }
+}
+
+/** Encodes slot as a variable length record of var_words(slot) words */
+inline void var_encode(sc_can_mm_slot_t const* slot, uint64_t* dst)
+{
+    uint8_t const words = static_cast<uint8_t>(var_words(slot));
+
+    switch (slot->hdr.type) {
+    case SC_MM_DATA_TYPE_CAN_RX: {
+        sc_mm_var_can_rx* rx = reinterpret_cast<sc_mm_var_can_rx*>(dst);
+
+        rx->type = SC_MM_DATA_TYPE_CAN_RX;
+        rx->words = words;
+        rx->dlc = slot->rx.dlc;
+        rx->flags = slot->rx.flags;
+        rx->can_id = slot->rx.can_id;
+        rx->timestamp_us = slot->rx.timestamp_us;
+        var_copy(rx->data, slot->rx.data, var_data_len(slot->rx.dlc, slot->rx.flags));
+    } break;
+    case SC_MM_DATA_TYPE_CAN_TX: {
+        sc_mm_var_can_tx* tx = reinterpret_cast<sc_mm_var_can_tx*>(dst);
+
+        tx->type = SC_MM_DATA_TYPE_CAN_TX;
+        tx->words = words;
+        tx->dlc = slot->tx.dlc;
+        tx->flags = slot->tx.flags;
+        tx->echo = slot->tx.echo;
+        tx->track_id = slot->tx.track_id;
+        tx->can_id = slot->tx.can_id;
+        tx->timestamp_us = slot->tx.timestamp_us;
+        var_copy(tx->data, slot->tx.data, var_data_len(slot->tx.dlc, slot->tx.flags));
+    } break;
+    case SC_MM_DATA_TYPE_CAN_STATUS: {
+        sc_mm_var_can_status* status = reinterpret_cast<sc_mm_var_can_status*>(dst);
+
+        status->type = SC_MM_DATA_TYPE_CAN_STATUS;
+        status->words = words;
+        status->flags = slot->status.flags;
+        status->bus_status = slot->status.bus_status;
+        status->rx_lost = slot->status.rx_lost;
+        status->tx_dropped = slot->status.tx_dropped;
+        status->timestamp_us = slot->status.timestamp_us;
+        status->rx_errors = slot->status.rx_errors;
+        status->tx_errors = slot->status.tx_errors;
+        status->rx_fifo_size = slot->status.rx_fifo_size;
+        status->tx_fifo_size = slot->status.tx_fifo_size;
+    } break;
+    case SC_MM_DATA_TYPE_CAN_ERROR: {
+        sc_mm_var_can_error* error = reinterpret_cast<sc_mm_var_can_error*>(dst);
+
+        error->type = SC_MM_DATA_TYPE_CAN_ERROR;
+        error->words = words;
+        error->error = slot->error.error;
+        error->flags = slot->error.flags;
+        error->timestamp_us = slot->error.timestamp_us;
+    } break;
+    case SC_MM_DATA_TYPE_LOG_DATA: {
+        sc_mm_var_log_data* log = reinterpret_cast<sc_mm_var_log_data*>(dst);
+
+        log->type = SC_MM_DATA_TYPE_LOG_DATA;
+        log->words = words;
+        log->level = slot->log_data.level;
+        log->flags = slot->log_data.flags;
+        log->bytes = slot->log_data.bytes;
+        log->src = slot->log_data.src;
+        var_copy(log->data, slot->log_data.data, slot->log_data.bytes);
+    } break;
+    default: {
+        sc_mm_var_header* hdr = reinterpret_cast<sc_mm_var_header*>(dst);
+
+        hdr->type = SC_MM_DATA_TYPE_NONE;
+        hdr->words = words;
+    } break;
+    }
+}
+
+/** Decodes a variable length record into a fixed size slot
+ *
+ * \param src       record
+ * \param limit     words readable at src
+ * \param slot      (out) decoded record, type SC_MM_DATA_TYPE_NONE for padding and unknown records
+ *
+ * \returns SC_DLL_ERROR_PROTO_VIOLATION if the record is malformed
+ */
+inline int var_decode(uint64_t const* src, uint32_t limit, sc_can_mm_slot_t* slot)
+{
+    sc_mm_var_header const* hdr = reinterpret_cast<sc_mm_var_header const*>(src);
+    uint32_t const words = hdr->words;
+
+    if (!words || words > limit) {
+        return SC_DLL_ERROR_PROTO_VIOLATION;
+    }
+
+    switch (hdr->type) {
+    case SC_MM_DATA_TYPE_CAN_RX: {
+        sc_mm_var_can_rx const* rx = reinterpret_cast<sc_mm_var_can_rx const*>(src);
+        uint32_t len = var_data_len(rx->dlc, rx->flags);
+
+        if (words < var_words_of_bytes(sizeof(*rx) + len)) {
+            return SC_DLL_ERROR_PROTO_VIOLATION;
+        }
+
+        slot->rx.type = SC_MM_DATA_TYPE_CAN_RX;
+        slot->rx.dlc = rx->dlc;
+        slot->rx.flags = rx->flags;
+        slot->rx.reserved = 0;
+        slot->rx.can_id = rx->can_id;
+        slot->rx.timestamp_us = rx->timestamp_us;
+        // no-op, var_dlc_to_len never exceeds the slot payload, but lets the compiler see the bound
+        if (len > sizeof(slot->rx.data)) {
+            len = sizeof(slot->rx.data);
+        }
+
+        var_copy(slot->rx.data, rx->data, len);
+    } break;
+    case SC_MM_DATA_TYPE_CAN_TX: {
+        sc_mm_var_can_tx const* tx = reinterpret_cast<sc_mm_var_can_tx const*>(src);
+        uint32_t len = var_data_len(tx->dlc, tx->flags);
+
+        if (words < var_words_of_bytes(sizeof(*tx) + len)) {
+            return SC_DLL_ERROR_PROTO_VIOLATION;
+        }
+
+        slot->tx.type = SC_MM_DATA_TYPE_CAN_TX;
+        slot->tx.dlc = tx->dlc;
+        slot->tx.flags = tx->flags;
+        slot->tx.echo = tx->echo;
+        slot->tx.track_id = tx->track_id;
+        slot->tx.can_id = tx->can_id;
+        slot->tx.reserved = 0;
+        slot->tx.timestamp_us = tx->timestamp_us;
+        // no-op, var_dlc_to_len never exceeds the slot payload, but lets the compiler see the bound
+        if (len > sizeof(slot->tx.data)) {
+            len = sizeof(slot->tx.data);
+        }
+
+        var_copy(slot->tx.data, tx->data, len);
+    } break;
+    case SC_MM_DATA_TYPE_CAN_STATUS: {
+        sc_mm_var_can_status const* status = reinterpret_cast<sc_mm_var_can_status const*>(src);
+
+        if (words < var_words_of_bytes(sizeof(*status))) {
+            return SC_DLL_ERROR_PROTO_VIOLATION;
+        }
+
+        slot->status.type = SC_MM_DATA_TYPE_CAN_STATUS;
+        slot->status.reserved = 0;
+        slot->status.flags = status->flags;
+        slot->status.bus_status = status->bus_status;
+        slot->status.rx_lost = status->rx_lost;
+        slot->status.tx_dropped = status->tx_dropped;
+        slot->status.timestamp_us = status->timestamp_us;
+        slot->status.rx_errors = status->rx_errors;
+        slot->status.tx_errors = status->tx_errors;
+        slot->status.rx_fifo_size = status->rx_fifo_size;
+        slot->status.tx_fifo_size = status->tx_fifo_size;
+    } break;
+    case SC_MM_DATA_TYPE_CAN_ERROR: {
+        sc_mm_var_can_error const* error = reinterpret_cast<sc_mm_var_can_error const*>(src);
+
+        if (words < var_words_of_bytes(sizeof(*error))) {
+            return SC_DLL_ERROR_PROTO_VIOLATION;
+        }
+
+        memset(&slot->error, 0, sizeof(slot->error));
+        slot->error.type = SC_MM_DATA_TYPE_CAN_ERROR;
+        slot->error.error = error->error;
+        slot->error.flags = error->flags;
+        slot->error.timestamp_us = error->timestamp_us;
+    } break;
+    case SC_MM_DATA_TYPE_LOG_DATA: {
+        sc_mm_var_log_data const* log = reinterpret_cast<sc_mm_var_log_data const*>(src);
+
+        if (log->bytes > sizeof(slot->log_data.data) ||
+            words < var_words_of_bytes(sizeof(*log) + log->bytes)) {
+            return SC_DLL_ERROR_PROTO_VIOLATION;
+        }
+
+        memset(&slot->log_data, 0, offsetof(sc_mm_log_data, data));
+        slot->log_data.type = SC_MM_DATA_TYPE_LOG_DATA;
+        slot->log_data.level = log->level;
+        slot->log_data.flags = log->flags;
+        slot->log_data.bytes = log->bytes;
+        slot->log_data.src = log->src;
+        var_copy(slot->log_data.data, log->data, log->bytes);
+    } break;
+    default:
+        slot->hdr.type = SC_MM_DATA_TYPE_NONE;
+        break;
+    }
+
+    return SC_DLL_ERROR_NONE;
+}
+
+/** Capacity in words of a variable length record ring of elements slots
+ *
+ * The indices run through 2^32 while both sides derive offsets from them
+ * modulo the capacity. Only a power of two keeps those offsets continuous
+ * across the index wrap, hence the slot array is rounded down to one.
+ */
+inline uint32_t var_ring_words(uint32_t elements)
+{
+    uint32_t words = elements * SC_MM_VAR_WORDS_PER_ELEMENT;
+
+    while (words & (words - 1)) {
+        words &= words - 1;
+    }
+
+    return words;
+}
+
+/** Producer side of a variable length record ring, not thread-safe
+ *
+ * Records are published one by one. To keep the consumer's cache line
+ * out of the fast path, the producer remembers the free space and only
+ * reads get_index once that is used up.
+ */
+class var_ring_producer : private ring_producer
+{
+public:
+    var_ring_producer()
+        : m_Available(0)
+        , m_Offset(0)
+    {}
+
+    using ring_producer::header;
+    using ring_producer::index;
+    using ring_producer::notify;
+    using ring_producer::wake;
+
+    /** Capacity of the ring in words */
+    uint32_t words() const { return m_Elements; }
+
+    /** Attaches to a ring of elements slots, continuing at the current put_index */
+    void attach(sc_can_mm_header* hdr, uint32_t elements)
+    {
+        ring_producer::attach(hdr, var_ring_words(elements));
+        m_Available = 0;
+        m_Offset = m_Index % m_Elements;
+    }
+
+    /** See ring_producer::reset */
+    void reset()
+    {
+        ring_producer::reset();
+        m_Available = 0;
+    }
+
+    /** Retrieves the number of words that can be written, see ring_producer::writable */
+    int writable(uint32_t* words) const { return ring_producer::writable(words); }
+
+    /** Encodes slot into the ring and publishes it
+     *
+     * \returns SC_DLL_ERROR_AGAIN if the ring is full
+     */
+    int push(sc_can_mm_slot_t const* slot)
+    {
+        uint32_t const words = var_words(slot);
+        uint32_t pad = m_Elements - m_Offset;
+
+        if (pad >= words) {
+            pad = 0;
+        }
+
+        if (pad + words > m_Available) {
+            int error = writable(&m_Available);
+
+            if (error) {
+                return error;
+            }
+
+            if (pad + words > m_Available) {
+                return SC_DLL_ERROR_AGAIN;
+            }
+        }
+
+        if (pad) {
+            sc_mm_var_header* hdr = reinterpret_cast<sc_mm_var_header*>(word());
+
+            hdr->type = SC_MM_DATA_TYPE_NONE;
+            hdr->words = static_cast<uint8_t>(pad);
+            m_Offset = 0;
+        }
+
+        var_encode(slot, word());
+        commit(pad + words);
+        m_Available -= pad + words;
+
+        m_Offset += words;
+        if (m_Offset == m_Elements) {
+            m_Offset = 0;
+        }
+
+        return SC_DLL_ERROR_NONE;
+    }
+
+private:
+    uint64_t* word() const
+    {
+        return reinterpret_cast<uint64_t*>(m_Hdr->elements) + m_Offset;
+    }
+
+private:
+    uint32_t m_Available;
+    uint32_t m_Offset; // m_Index % m_Elements
+};
+
+/** Consumer side of a variable length record ring, not thread-safe */
+class var_ring_consumer : private ring_consumer
+{
+public:
+    using ring_consumer::header;
+    using ring_consumer::index;
+    using ring_consumer::poll;
+    using ring_consumer::skip_all;
+    using ring_consumer::consume;
+
+    /** Capacity of the ring in words */
+    uint32_t words() const { return m_Elements; }
+
+    /** Attaches to a ring of elements slots, continuing at the current get_index */
+    void attach(sc_can_mm_header* hdr, uint32_t elements)
+    {
+        ring_consumer::attach(hdr, var_ring_words(elements));
+    }
+
+    /** Retrieves the number of words that can be read, see ring_consumer::readable */
+    int readable(uint32_t* words) const { return ring_consumer::readable(words); }
+
+    /** Record offset words past the consumer's index, see readable
+     *
+     * Records never wrap, release them with consume(words).
+     */
+    sc_mm_var_header const* record(uint32_t offset = 0) const
+    {
+        return reinterpret_cast<sc_mm_var_header const*>(word(offset));
+    }
+
+    /** Decodes records into fixed size slots and releases them at once
+     *
+     * Padding and records of unknown type are skipped.
+     *
+     * \param slots     destination
+     * \param count     capacity of destination in slots
+     * \param popped    (out) number of slots decoded
+     *
+     * \returns error code
+     */
+    int pop(sc_can_mm_slot_t* slots, uint32_t count, uint32_t* popped)
+    {
+        uint64_t const* const base = reinterpret_cast<uint64_t const*>(m_Hdr->elements);
+        uint32_t available = 0;
+        uint32_t offset = 0;
+        uint32_t pos = 0;
+        uint32_t n = 0;
+        int error = readable(&available);
+
+        *popped = 0;
+
+        if (error) {
+            return error;
+        }
+
+        pos = m_Index % m_Elements;
+
+        while (offset < available && n < count) {
+            uint32_t limit = m_Elements - pos;
+            uint32_t size = 0;
+
+            if (limit > available - offset) {
+                limit = available - offset;
+            }
+
+            error = var_decode(&base[pos], limit, &slots[n]);
+            if (error) {
+                return error;
+            }
+
+            size = reinterpret_cast<sc_mm_var_header const*>(&base[pos])->words;
+            offset += size;
+            pos += size;
+
+            if (pos == m_Elements) {
+                pos = 0;
+            }
+
+            n += SC_MM_DATA_TYPE_NONE != slots[n].hdr.type;
+        }
+
+        if (offset) {
+            consume(offset);
+        }
+
+        *popped = n;
+
+        return SC_DLL_ERROR_NONE;
+    }
+
+private:
+    uint64_t const* word(uint32_t offset) const
+    {
+        return reinterpret_cast<uint64_t const*>(m_Hdr->elements) + (m_Index + offset) % m_Elements;
+    }
+};
+
+/** Producer side of the broadcast ring, not thread-safe
+ *
+ * The producer keeps a lower bound of the slowest client's cursor.
+ * Only if that bound falls a full ring behind does it look at the
+ * clients' cursors again and, if need be, overrun the slowest ones.
+ */
+class bc_ring_producer
+{
+public:
+    bc_ring_producer()
+        : m_Hdr(nullptr)
+        , m_Elements(0)
+        , m_Index(0)
+        , m_Slowest(0)
+        , m_Clients(0)
+        , m_Pending(0)
+    {}
+
+    sc_can_mm_bc_header* header() const { return m_Hdr; }
+    uint32_t elements() const { return m_Elements; }
+    uint32_t index() const { return m_Index; }
+
+    /** Bitmask of clients reading from the ring */
+    uint32_t clients() const { return m_Clients; }
+
+    sc_can_mm_bc_client* client(uint8_t index) const { return &m_Hdr->clients[index]; }
+
+    /** Attaches to a ring, continuing at the current put_index */
+    void attach(sc_can_mm_bc_header* hdr, uint32_t elements)
+    {
+        m_Hdr = hdr;
+        m_Elements = elements;
+        m_Index = hdr->put_index;
+        m_Slowest = m_Index;
+        m_Clients = 0;
+        m_Pending = 0;
+    }
+
+    /** Adds a client, it starts reading at the next message */
+    void add_client(uint8_t index)
+    {
+        sc_can_mm_bc_client* c = client(index);
+
+        c->can_lost_rx = 0;
+        c->can_lost_status = 0;
+        c->can_lost_tx = 0;
+        c->can_lost_error = 0;
+        c->log_lost = 0;
+        c->client_flags = 0;
+        sc_atomic_store_release32(&c->get_index, m_Index);
+
+        m_Clients |= UINT32_C(1) << index;
+        m_Slowest = m_Index;
+    }
+
+    void remove_client(uint8_t index)
+    {
+        m_Clients &= ~(UINT32_C(1) << index);
+        m_Pending &= ~(UINT32_C(1) << index);
+    }
+
+    /** Cursor of the slowest client */
+    uint32_t slowest() const { return m_Slowest; }
+
+    /** Number of slots the slowest client has yet to read, at most elements()
+     *
+     * Reads all clients' cursors, unlike slowest() which is only a lower
+     * bound refreshed on overrun.
+     */
+    uint32_t backlog() const
+    {
+        uint32_t result = 0;
+
+        for (uint8_t i = 0; i < SC_MM_BC_CLIENTS; ++i) {
+            if (m_Clients & (UINT32_C(1) << i)) {
+                uint32_t const behind = m_Index - sc_atomic_load_acquire32(&client(i)->get_index);
+
+                if (behind > result) {
+                    result = behind;
+                }
+            }
+        }
+
+        return result > m_Elements ? m_Elements : result;
+    }
+
+    /** Retrieves the slot to write next, overruns clients if the ring is full */
+    sc_can_mm_slot_t* claim()
+    {
+        if (m_Index - m_Slowest >= m_Elements) {
+            overrun();
+        }
+
+        return &m_Hdr->elements[m_Index % m_Elements];
+    }
+
+    /** Publishes the slot returned by claim() to all clients */
+    void commit()
+    {
+        ++m_Index;
+        sc_atomic_store_release32(&m_Hdr->put_index, m_Index);
+        m_Pending |= m_Clients;
+    }
+
+    /** Checks which clients must be signaled, see ring_producer::wake
+     *
+     * \returns bitmask of client indices
+     */
+    uint32_t wake()
+    {
+        uint32_t pending = m_Pending;
+        uint32_t result = 0;
+
+        if (!pending) {
+            return 0;
+        }
+
+        m_Pending = 0;
+
+        sc_atomic_fence();
+
+        for (uint8_t i = 0; pending; ++i, pending >>= 1) {
+            if ((pending & 1) && !(sc_atomic_load_acquire32(&client(i)->client_flags) & SC_MM_CLIENT_FLAG_POLLING)) {
+                result |= UINT32_C(1) << i;
+            }
+        }
+
+        return result;
+    }
+
+private:
+    static volatile uint32_t* lost_counter(sc_can_mm_bc_client* c, uint8_t type)
+    {
+        switch (type) {
+        case SC_MM_DATA_TYPE_CAN_RX:
+            return &c->can_lost_rx;
+        case SC_MM_DATA_TYPE_CAN_TX:
+            return &c->can_lost_tx;
+        case SC_MM_DATA_TYPE_CAN_STATUS:
+            return &c->can_lost_status;
+        case SC_MM_DATA_TYPE_CAN_ERROR:
+            return &c->can_lost_error;
+        case SC_MM_DATA_TYPE_LOG_DATA:
+            return &c->log_lost;
+        default:
+            return nullptr;
+        }
+    }
+
+    void overrun()
+    {
+        uint32_t const first = m_Index - m_Elements; // oldest slot, about to be overwritten
+        uint32_t const next = first + 1;
+
+        m_Slowest = m_Index;
+
+        for (uint8_t i = 0; i < SC_MM_BC_CLIENTS; ++i) {
+            if (!(m_Clients & (UINT32_C(1) << i))) {
+                continue;
+            }
+
+            sc_can_mm_bc_client* c = client(i);
+            uint32_t gi = sc_atomic_load_acquire32(&c->get_index);
+
+            // The client may advance its cursor concurrently. Once the
+            // swap succeeds the client will fail to commit what it read.
+            while (m_Index - gi >= m_Elements) {
+                if (sc_atomic_cas32(&c->get_index, &gi, next)) {
+                    // A client that moved its cursor out of the ring only
+                    // gets the oldest slot accounted for.
+                    uint32_t const from = m_Index - gi > m_Elements ? first : gi;
+
+                    for (uint32_t k = from; k != next; ++k) {
+                        volatile uint32_t* counter = lost_counter(c, m_Hdr->elements[k % m_Elements].hdr.type);
+
+                        if (counter) {
+                            sc_atomic_inc32(counter);
+                        }
+                    }
+
+                    m_Pending |= UINT32_C(1) << i;
+                    gi = next;
+                    break;
+                }
+            }
+
+            if (m_Index - gi > m_Index - m_Slowest) {
+                m_Slowest = gi;
+            }
+        }
+    }
+
+private:
+    sc_can_mm_bc_header* m_Hdr;
+    uint32_t m_Elements;
+    uint32_t m_Index;
+    uint32_t m_Slowest;
+    uint32_t m_Clients;
+    uint32_t m_Pending;
+};
+
+/** Client side of the broadcast ring, not thread-safe */
+class bc_ring_consumer
+{
+public:
+    bc_ring_consumer()
+        : m_Hdr(nullptr)
+        , m_Client(nullptr)
+        , m_Elements(0)
+        , m_Index(0)
+    {}
+
+    sc_can_mm_bc_client* client() const { return m_Client; }
+
+    /** Attaches to a ring as client index (see GetBroadcastRingBufferMapping) */
+    void attach(sc_can_mm_bc_header* hdr, uint32_t elements, uint8_t index)
+    {
+        m_Hdr = hdr;
+        m_Client = &hdr->clients[index];
+        m_Elements = elements;
+        m_Index = sc_atomic_load_acquire32(&m_Client->get_index);
+    }
+
+    /** Retrieves the number of slots that can be read
+     *
+     * \returns SC_DLL_ERROR_PROTO_VIOLATION if the ring is corrupted
+     */
+    int readable(uint32_t* count)
+    {
+        uint32_t gi = 0;
+        uint32_t pi = 0;
+        uint32_t used = 0;
+
+        // the server may move the cursor, take a consistent snapshot
+        do {
+            gi = sc_atomic_load_acquire32(&m_Client->get_index);
+            pi = sc_atomic_load_acquire32(&m_Hdr->put_index);
+        } while (gi != sc_atomic_load_acquire32(&m_Client->get_index));
+
+        used = pi - gi;
+        *count = 0;
+        m_Index = gi;
+
+        if (used > m_Elements) {
+            return SC_DLL_ERROR_PROTO_VIOLATION;
+        }
+
+        *count = used;
+
+        return SC_DLL_ERROR_NONE;
+    }
+
+    /** Slot offset slots past the cursor, see readable */
+    sc_can_mm_slot_t const* slot(uint32_t offset = 0) const
+    {
+        return &m_Hdr->elements[(m_Index + offset) % m_Elements];
+    }
+
+    /** Advances the cursor past count slots read with slot()
+     *
+     * \returns SC_DLL_ERROR_AGAIN if the server overran the client meanwhile.
+     *          The slots must be discarded, the lost counters tell how
+     *          many messages were skipped.
+     */
+    int consume(uint32_t count = 1)
+    {
+        uint32_t expected = m_Index;
+
+        if (sc_atomic_cas32(&m_Client->get_index, &expected, m_Index + count)) {
+            m_Index += count;
+            return SC_DLL_ERROR_NONE;
+        }
+
+        m_Index = expected;
+
+        return SC_DLL_ERROR_AGAIN;
+    }
+
+    /** Copies slots out of the ring and advances the cursor
+     *
+     * \param slots     destination
+     * \param count     capacity of destination in slots
+     * \param popped    (out) number of slots copied
+     *
+     * \returns error code
+     */
+    int pop(sc_can_mm_slot_t* slots, uint32_t count, uint32_t* popped)
+    {
+        int error = SC_DLL_ERROR_NONE;
+
+        *popped = 0;
+
+        do {
+            uint32_t available = 0;
+            uint32_t first = 0;
+            uint32_t n = count;
+
+            error = readable(&available);
+            if (error) {
+                return error;
+            }
+
+            if (n > available) {
+                n = available;
+            }
+
+            if (!n) {
+                return SC_DLL_ERROR_NONE;
+            }
+
+            first = m_Elements - m_Index % m_Elements;
+            if (first > n) {
+                first = n;
+            }
+
+            memcpy(slots, slot(0), first * sizeof(*slots));
+            memcpy(slots + first, slot(first), (n - first) * sizeof(*slots));
+
+            error = consume(n);
+
+            if (SC_DLL_ERROR_NONE == error) {
+                *popped = n;
+            }
+        } while (SC_DLL_ERROR_AGAIN == error);
+
+        return error;
+    }
+
+    /** See ring_consumer::poll */
+    void poll(bool on)
+    {
+        sc_atomic_store_release32(&m_Client->client_flags, on ? SC_MM_CLIENT_FLAG_POLLING : 0);
+        sc_atomic_fence();
+    }
+
+private:
+    sc_can_mm_bc_header* m_Hdr;
+    sc_can_mm_bc_client* m_Client;
+    uint32_t m_Elements;
+    uint32_t m_Index;
+};
+
+} // mm
+} // sc
@@ -0,0 +1,253 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Jean Gressmann <jean@0x42.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#ifndef __cplusplus
+#   error "supercan_mpsc_queue.h requires C++"
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <thread>
+
+#include "supercan_error.h"
+
+/* Bounded lock-free multi-producer single-consumer queue
+ *
+ * Producers claim a cell by advancing the head with compare and swap,
+ * fill it in place and publish it through the cell's sequence number,
+ * see Vyukov's bounded MPMC queue (sc_log_t works the same way). A full
+ * queue fails the push, producers never wait.
+ *
+ * Producers pass a gate which the consumer closes to resize the queue.
+ * While closed pushes fail as if the queue was full.
+ */
+
+namespace sc {
+
+template<typename T>
+class mpsc_queue
+{
+public:
+    enum : uint32_t {
+        MAX_CAPACITY = UINT32_C(1) << 16,
+    };
+
+    mpsc_queue()
+        : m_Mask(0)
+        , m_Tail(0)
+        , m_Head(0)
+        , m_Writers(0)
+    {}
+
+    mpsc_queue(mpsc_queue const&) = delete;
+    mpsc_queue& operator=(mpsc_queue const&) = delete;
+
+    /** Allocates capacity cells, drops anything queued
+     *
+     * Not thread-safe.
+     *
+     * \returns SC_DLL_ERROR_INVALID_PARAM unless capacity is a power of two
+     *          up to MAX_CAPACITY
+     */
+    int init(uint32_t capacity)
+    {
+        if (!valid(capacity)) {
+            return SC_DLL_ERROR_INVALID_PARAM;
+        }
+
+        std::unique_ptr<cell[]> cells(new (std::nothrow) cell[capacity]);
+
+        if (!cells) {
+            return SC_DLL_ERROR_OUT_OF_MEM;
+        }
+
+        for (uint32_t i = 0; i < capacity; ++i) {
+            cells[i].seq.store(i, std::memory_order_relaxed);
+        }
+
+        m_Cells = std::move(cells);
+        m_Mask = capacity - 1;
+        m_Tail = 0;
+        m_Head.store(0, std::memory_order_relaxed);
+        m_Writers.store(0, std::memory_order_release);
+
+        return SC_DLL_ERROR_NONE;
+    }
+
+    uint32_t capacity() const { return m_Cells ? m_Mask + 1 : 0; }
+
+    /** Claims a cell and has fill(T*) write the entry
+     *
+     * Safe to call from any number of threads.
+     *
+     * \returns false if the queue is full, closed or not initialized
+     */
+    template<typename F>
+    bool push(F&& fill)
+    {
+        bool pushed = false;
+
+        if (m_Writers.fetch_add(1, std::memory_order_acquire) & CLOSED) {
+            goto exit;
+        }
+
+        if (m_Cells) {
+            uint32_t pos = m_Head.load(std::memory_order_relaxed);
+            cell* c = nullptr;
+
+            for (;;) {
+                c = &m_Cells[pos & m_Mask];
+
+                int32_t const diff = static_cast<int32_t>(c->seq.load(std::memory_order_acquire) - pos);
+
+                if (0 == diff) {
+                    if (m_Head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                }
+                else if (diff < 0) {
+                    goto exit;
+                }
+                else {
+                    pos = m_Head.load(std::memory_order_relaxed);
+                }
+            }
+
+            fill(&c->value);
+            c->seq.store(pos + 1, std::memory_order_release);
+            pushed = true;
+        }
+
+exit:
+        m_Writers.fetch_sub(1, std::memory_order_release);
+
+        return pushed;
+    }
+
+    /** Hands up to max entries in order to f(T const*), consumer only
+     *
+     * An entry that is claimed but not yet filled ends the call.
+     *
+     * \returns number of entries consumed
+     */
+    template<typename F>
+    size_t drain(F&& f, size_t max)
+    {
+        size_t count = 0;
+
+        for (; count < max && m_Cells; ++count) {
+            cell* c = &m_Cells[m_Tail & m_Mask];
+
+            if (c->seq.load(std::memory_order_acquire) != m_Tail + 1) {
+                break;
+            }
+
+            f(&c->value);
+            c->seq.store(m_Tail + m_Mask + 1, std::memory_order_release);
+            ++m_Tail;
+        }
+
+        return count;
+    }
+
+    /** Checks for a published entry, consumer only */
+    bool empty() const
+    {
+        return !m_Cells || m_Cells[m_Tail & m_Mask].seq.load(std::memory_order_acquire) != m_Tail + 1;
+    }
+
+    /** Changes the capacity, consumer only
+     *
+     * Closes the gate, waits for pushes in progress to finish and moves
+     * the queued entries over. Entries that don't fit are dropped.
+     *
+     * \param capacity  see init
+     * \param dropped   (out) number of entries dropped
+     *
+     * \returns error code, the queue is left as it was on error
+     */
+    int resize(uint32_t capacity, uint32_t* dropped)
+    {
+        mpsc_queue next;
+        int error = next.init(capacity);
+
+        *dropped = 0;
+
+        if (error) {
+            return error;
+        }
+
+        m_Writers.fetch_or(CLOSED, std::memory_order_acq_rel);
+
+        while (m_Writers.load(std::memory_order_acquire) & ~CLOSED) {
+            std::this_thread::yield();
+        }
+
+        // ends at a claimed but unfilled cell only if a producer died mid-push
+        drain([&](T const* value) {
+            if (!next.push([=](T* copy) { *copy = *value; })) {
+                ++*dropped;
+            }
+        }, ~static_cast<size_t>(0));
+
+        m_Cells = std::move(next.m_Cells);
+        m_Mask = next.m_Mask;
+        m_Tail = next.m_Tail;
+        m_Head.store(next.m_Head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        m_Writers.fetch_and(~CLOSED, std::memory_order_release);
+
+        return SC_DLL_ERROR_NONE;
+    }
+
+    static bool valid(uint32_t capacity)
+    {
+        return capacity && capacity <= MAX_CAPACITY && !(capacity & (capacity - 1));
+    }
+
+private:
+    enum : uint32_t {
+        CLOSED = UINT32_C(1) << 31,
+    };
+
+    struct cell {
+        std::atomic<uint32_t> seq;
+        T value;
+    };
+
+private:
+    std::unique_ptr<cell[]> m_Cells;
+    uint32_t m_Mask;
+    uint32_t m_Tail; // consumer
+    std::atomic<uint32_t> m_Head;
+    std::atomic<uint32_t> m_Writers; // pushes in progress | CLOSED
+};
+
+} // sc
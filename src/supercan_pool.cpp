@@ -0,0 +1,300 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Jean Gressmann <jean@0x42.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "supercan_pool.h"
+
+#if defined(_WIN32)
+#   define WIN32_LEAN_AND_MEAN
+#   include <Windows.h>
+#else
+#   include <pthread.h>
+#   include <sched.h>
+#endif
+
+#include "supercan_error.h"
+
+namespace sc {
+
+namespace {
+
+enum {
+    TASK_IDLE,
+    TASK_QUEUED,
+    TASK_RUNNING,
+    TASK_RUNNING_POSTED, // posted while running, run again
+};
+
+int set_affinity(std::thread* t, uint64_t mask)
+{
+#if defined(_WIN32)
+    if (!SetThreadAffinityMask(t->native_handle(), static_cast<DWORD_PTR>(mask))) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+#else
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+
+    for (unsigned i = 0; i < 64 && i < CPU_SETSIZE; ++i) {
+        if (mask & (UINT64_C(1) << i)) {
+            CPU_SET(i, &set);
+        }
+    }
+
+    if (pthread_setaffinity_np(t->native_handle(), sizeof(set), &set)) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+#endif
+
+    return SC_DLL_ERROR_NONE;
+}
+
+} // anon
+
+worker_pool::worker_pool()
+    : m_Pending(0)
+    , m_Sleepers(0)
+    , m_Steals(0)
+    , m_Stop(false)
+{
+}
+
+worker_pool::~worker_pool()
+{
+    stop();
+}
+
+int worker_pool::start(uint32_t workers, uint64_t const* affinity)
+{
+    int error = SC_DLL_ERROR_NONE;
+
+    if (!workers) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+
+    if (!m_Workers.empty()) {
+        return SC_DLL_ERROR_INVALID_OPERATION;
+    }
+
+    m_Stop = false;
+
+    try {
+        for (uint32_t i = 0; i < workers; ++i) {
+            m_Workers.push_back(new worker());
+        }
+
+        for (uint32_t i = 0; i < workers; ++i) {
+            m_Workers[i]->thread = std::thread([this, i] { run(i); });
+
+            if (affinity && affinity[i]) {
+                error = set_affinity(&m_Workers[i]->thread, affinity[i]);
+
+                if (error) {
+                    goto error_exit;
+                }
+            }
+        }
+    }
+    catch (std::bad_alloc const&) {
+        error = SC_DLL_ERROR_OUT_OF_MEM;
+        goto error_exit;
+    }
+    catch (std::system_error const&) {
+        error = SC_DLL_ERROR_OUT_OF_MEM;
+        goto error_exit;
+    }
+
+success_exit:
+    return error;
+
+error_exit:
+    stop();
+    goto success_exit;
+}
+
+void worker_pool::stop()
+{
+    {
+        std::lock_guard<std::mutex> g(m_SleepLock);
+
+        m_Stop = true;
+    }
+
+    m_SleepCv.notify_all();
+
+    // join all before freeing any, running workers steal from the other queues
+    for (size_t i = 0; i < m_Workers.size(); ++i) {
+        worker* w = m_Workers[i];
+
+        if (w->thread.joinable()) {
+            w->thread.join();
+        }
+    }
+
+    for (size_t i = 0; i < m_Workers.size(); ++i) {
+        worker* w = m_Workers[i];
+
+        for (size_t j = 0; j < w->queue.size(); ++j) {
+            w->queue[j]->state.store(TASK_IDLE, std::memory_order_relaxed);
+        }
+
+        delete w;
+    }
+
+    m_Workers.clear();
+    m_Pending.store(0, std::memory_order_relaxed);
+}
+
+void worker_pool::post(pool_task* task)
+{
+    uint32_t state = task->state.load(std::memory_order_acquire);
+
+    for (;;) {
+        switch (state) {
+        case TASK_IDLE:
+            if (task->state.compare_exchange_weak(state, TASK_QUEUED, std::memory_order_acq_rel)) {
+                push(task);
+                return;
+            }
+            break;
+        case TASK_RUNNING:
+            if (task->state.compare_exchange_weak(state, TASK_RUNNING_POSTED, std::memory_order_acq_rel)) {
+                return;
+            }
+            break;
+        default:
+            // will run
+            return;
+        }
+    }
+}
+
+void worker_pool::wait(pool_task const* task) const
+{
+    while (TASK_IDLE != task->state.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+}
+
+void worker_pool::push(pool_task* task)
+{
+    worker* w = m_Workers[task->home % m_Workers.size()];
+
+    {
+        std::lock_guard<std::mutex> g(w->lock);
+
+        w->queue.push_back(task);
+    }
+
+    // pairs with the sleeper count increment in run
+    m_Pending.fetch_add(1);
+
+    if (m_Sleepers.load()) {
+        std::lock_guard<std::mutex> g(m_SleepLock);
+
+        m_SleepCv.notify_one();
+    }
+}
+
+pool_task* worker_pool::pop(uint32_t index)
+{
+    uint32_t const count = static_cast<uint32_t>(m_Workers.size());
+
+    // own queue first, then steal starting with the next worker
+    for (uint32_t i = 0; i < count; ++i) {
+        worker* w = m_Workers[(index + i) % count];
+        pool_task* task = nullptr;
+
+        {
+            std::lock_guard<std::mutex> g(w->lock);
+
+            if (w->queue.empty()) {
+                continue;
+            }
+
+            task = w->queue.front();
+            w->queue.pop_front();
+        }
+
+        if (i) {
+            m_Steals.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        m_Pending.fetch_sub(1, std::memory_order_relaxed);
+
+        return task;
+    }
+
+    return nullptr;
+}
+
+void worker_pool::run(uint32_t index)
+{
+    for (;;) {
+        pool_task* task = pop(index);
+
+        if (task) {
+            uint32_t state = TASK_QUEUED;
+
+            task->state.store(TASK_RUNNING, std::memory_order_release);
+
+            for (;;) {
+                task->run(task->ctx);
+
+                state = TASK_RUNNING;
+
+                if (task->state.compare_exchange_strong(state, TASK_IDLE, std::memory_order_acq_rel)) {
+                    break;
+                }
+
+                // posted while running
+                task->state.store(TASK_RUNNING, std::memory_order_release);
+            }
+
+            continue;
+        }
+
+        std::unique_lock<std::mutex> g(m_SleepLock);
+
+        if (m_Stop) {
+            break;
+        }
+
+        // pairs with the pending count increment in push
+        m_Sleepers.fetch_add(1);
+
+        while (!m_Stop && !m_Pending.load()) {
+            m_SleepCv.wait(g);
+        }
+
+        m_Sleepers.fetch_sub(1, std::memory_order_relaxed);
+
+        if (m_Stop) {
+            break;
+        }
+    }
+}
+
+} // sc
@@ -0,0 +1,145 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Jean Gressmann <jean@0x42.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#ifndef __cplusplus
+#   error "supercan_pool.h requires C++"
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sc {
+
+/** Task serviced by a worker_pool
+ *
+ * A task stands for one unit of I/O, i.e. a device's stream or a
+ * client's TX ring. Posting a task that is already queued is a no-op,
+ * posting a running task makes it run once more afterwards. Thus a task
+ * never runs on two workers at the same time.
+ */
+struct pool_task
+{
+    typedef void (*run_fn)(void* ctx);
+
+    pool_task()
+        : run(nullptr)
+        , ctx(nullptr)
+        , home(0)
+        , state(0)
+    {}
+
+    pool_task(run_fn _run, void* _ctx, uint32_t _home)
+        : run(_run)
+        , ctx(_ctx)
+        , home(_home)
+        , state(0)
+    {}
+
+    run_fn run;
+    void* ctx;
+    uint32_t home;              ///< worker the task is queued on, others steal it when idle
+    std::atomic<uint32_t> state; ///< pool private
+};
+
+/** Small set of I/O workers shared by many devices
+ *
+ * Each worker has its own queue. Tasks are queued on their home worker
+ * so a device tends to stay on one core. Workers that run out of tasks
+ * steal from the other queues before they go to sleep.
+ */
+class worker_pool
+{
+public:
+    worker_pool();
+    ~worker_pool();
+
+    /** Starts the workers
+     *
+     * \param workers   number of worker threads, at least 1
+     * \param affinity  per worker CPU mask, bit n selects CPU n, 0 for no affinity, can be NULL
+     *
+     * \returns error code
+     */
+    int start(uint32_t workers, uint64_t const* affinity);
+
+    /** Stops the workers, queued tasks are discarded */
+    void stop();
+
+    /** Queues the task on its home worker, thread-safe
+     *
+     * The pool must be started.
+     */
+    void post(pool_task* task);
+
+    /** Waits for the task to be neither queued nor running
+     *
+     * The caller must make sure the task is no longer posted, afterwards
+     * the task may be freed.
+     */
+    void wait(pool_task const* task) const;
+
+    uint32_t workers() const { return static_cast<uint32_t>(m_Workers.size()); }
+
+    /** Native handle of a worker's thread, e.g. to set its priority */
+    std::thread::native_handle_type native_handle(uint32_t index) { return m_Workers[index]->thread.native_handle(); }
+
+    /** Number of tasks run by a worker that were queued on another */
+    uint64_t steals() const { return m_Steals.load(std::memory_order_relaxed); }
+
+private:
+    worker_pool(worker_pool const&) = delete;
+    worker_pool& operator=(worker_pool const&) = delete;
+
+    struct worker
+    {
+        std::mutex lock;
+        std::deque<pool_task*> queue;
+        std::thread thread;
+    };
+
+    void push(pool_task* task);
+    pool_task* pop(uint32_t index);
+    void run(uint32_t index);
+
+private:
+    std::vector<worker*> m_Workers;
+    std::mutex m_SleepLock;
+    std::condition_variable m_SleepCv;
+    std::atomic<uint32_t> m_Pending;    ///< queued tasks
+    std::atomic<uint32_t> m_Sleepers;   ///< workers waiting on m_SleepCv
+    std::atomic<uint64_t> m_Steals;
+    bool m_Stop;                        ///< protected by m_SleepLock
+};
+
+} // sc
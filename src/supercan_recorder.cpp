@@ -0,0 +1,691 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Jean Gressmann <jean@0x42.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "supercan_recorder.h"
+
+#if defined(_WIN32)
+#   define WIN32_LEAN_AND_MEAN
+#   include <Windows.h>
+#else
+#   include <errno.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#endif
+
+#include <new>
+
+#include "supercan_error.h"
+
+namespace sc {
+
+#if defined(_WIN32)
+record_file_sink::record_file_sink()
+    : m_File(INVALID_HANDLE_VALUE)
+{
+}
+
+int record_file_sink::open(char const* path)
+{
+    close();
+
+    m_File = CreateFileA(path, GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (INVALID_HANDLE_VALUE == m_File) {
+        return SC_DLL_ERROR_ACCESS_DENIED;
+    }
+
+    return SC_DLL_ERROR_NONE;
+}
+
+int record_file_sink::open(wchar_t const* path)
+{
+    close();
+
+    m_File = CreateFileW(path, GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (INVALID_HANDLE_VALUE == m_File) {
+        return SC_DLL_ERROR_ACCESS_DENIED;
+    }
+
+    return SC_DLL_ERROR_NONE;
+}
+
+void record_file_sink::close()
+{
+    if (INVALID_HANDLE_VALUE != m_File) {
+        CloseHandle(m_File);
+        m_File = INVALID_HANDLE_VALUE;
+    }
+}
+
+int record_file_sink::write(void const* ptr, size_t bytes)
+{
+    uint8_t const* p = static_cast<uint8_t const*>(ptr);
+
+    while (bytes) {
+        DWORD chunk = bytes > 0x40000000 ? 0x40000000 : static_cast<DWORD>(bytes);
+        DWORD written = 0;
+
+        if (!WriteFile(m_File, p, chunk, &written, nullptr)) {
+            return SC_DLL_ERROR_UNKNOWN;
+        }
+
+        p += written;
+        bytes -= written;
+    }
+
+    return SC_DLL_ERROR_NONE;
+}
+
+int record_file_sink::sync()
+{
+    if (!FlushFileBuffers(m_File)) {
+        return SC_DLL_ERROR_UNKNOWN;
+    }
+
+    return SC_DLL_ERROR_NONE;
+}
+
+record_file_source::record_file_source()
+    : m_File(INVALID_HANDLE_VALUE)
+{
+}
+
+int record_file_source::open(char const* path)
+{
+    close();
+
+    m_File = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (INVALID_HANDLE_VALUE == m_File) {
+        return SC_DLL_ERROR_ACCESS_DENIED;
+    }
+
+    return SC_DLL_ERROR_NONE;
+}
+
+int record_file_source::open(wchar_t const* path)
+{
+    close();
+
+    m_File = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (INVALID_HANDLE_VALUE == m_File) {
+        return SC_DLL_ERROR_ACCESS_DENIED;
+    }
+
+    return SC_DLL_ERROR_NONE;
+}
+
+void record_file_source::close()
+{
+    if (INVALID_HANDLE_VALUE != m_File) {
+        CloseHandle(m_File);
+        m_File = INVALID_HANDLE_VALUE;
+    }
+}
+
+int record_file_source::read(void* ptr, size_t bytes, size_t* got)
+{
+    DWORD chunk = bytes > 0x40000000 ? 0x40000000 : static_cast<DWORD>(bytes);
+    DWORD r = 0;
+
+    *got = 0;
+
+    if (!ReadFile(m_File, ptr, chunk, &r, nullptr)) {
+        return SC_DLL_ERROR_UNKNOWN;
+    }
+
+    *got = r;
+
+    return SC_DLL_ERROR_NONE;
+}
+#else
+record_file_sink::record_file_sink()
+    : m_Fd(-1)
+{
+}
+
+int record_file_sink::open(char const* path)
+{
+    close();
+
+    m_Fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (-1 == m_Fd) {
+        return SC_DLL_ERROR_ACCESS_DENIED;
+    }
+
+    return SC_DLL_ERROR_NONE;
+}
+
+void record_file_sink::close()
+{
+    if (-1 != m_Fd) {
+        ::close(m_Fd);
+        m_Fd = -1;
+    }
+}
+
+int record_file_sink::write(void const* ptr, size_t bytes)
+{
+    uint8_t const* p = static_cast<uint8_t const*>(ptr);
+
+    while (bytes) {
+        ssize_t written = ::write(m_Fd, p, bytes);
+
+        if (written < 0) {
+            if (EINTR == errno) {
+                continue;
+            }
+
+            return SC_DLL_ERROR_UNKNOWN;
+        }
+
+        p += written;
+        bytes -= static_cast<size_t>(written);
+    }
+
+    return SC_DLL_ERROR_NONE;
+}
+
+int record_file_sink::sync()
+{
+    if (-1 == ::fsync(m_Fd)) {
+        return SC_DLL_ERROR_UNKNOWN;
+    }
+
+    return SC_DLL_ERROR_NONE;
+}
+
+record_file_source::record_file_source()
+    : m_Fd(-1)
+{
+}
+
+int record_file_source::open(char const* path)
+{
+    close();
+
+    m_Fd = ::open(path, O_RDONLY);
+    if (-1 == m_Fd) {
+        return SC_DLL_ERROR_ACCESS_DENIED;
+    }
+
+    return SC_DLL_ERROR_NONE;
+}
+
+void record_file_source::close()
+{
+    if (-1 != m_Fd) {
+        ::close(m_Fd);
+        m_Fd = -1;
+    }
+}
+
+int record_file_source::read(void* ptr, size_t bytes, size_t* got)
+{
+    ssize_t r = 0;
+
+    *got = 0;
+
+    do {
+        r = ::read(m_Fd, ptr, bytes);
+    } while (r < 0 && EINTR == errno);
+
+    if (r < 0) {
+        return SC_DLL_ERROR_UNKNOWN;
+    }
+
+    *got = static_cast<size_t>(r);
+
+    return SC_DLL_ERROR_NONE;
+}
+#endif
+
+record_file_sink::~record_file_sink()
+{
+    close();
+}
+
+record_file_source::~record_file_source()
+{
+    close();
+}
+
+recorder::recorder()
+    : m_Sink(nullptr)
+    , m_Words(nullptr)
+    , m_Capacity(0)
+    , m_Used(0)
+    , m_Records(0)
+    , m_Fill(0)
+    , m_Seq(0)
+    , m_ChunkWords(0)
+    , m_SyncChunks(0)
+    , m_Stop(false)
+    , m_RecordCount(0)
+    , m_Dropped(0)
+    , m_Chunks(0)
+    , m_Bytes(0)
+    , m_Syncs(0)
+    , m_Error(SC_DLL_ERROR_NONE)
+{
+    for (auto& b : m_Buffers) {
+        b.words = nullptr;
+        b.state = BUFFER_FREE;
+    }
+}
+
+recorder::~recorder()
+{
+    stop();
+}
+
+int recorder::start(record_sink* sink, uint32_t chunk_bytes, uint32_t sync_chunks)
+{
+    sc_rec_file_header hdr;
+    int error = SC_DLL_ERROR_NONE;
+
+    if (!sink) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+
+    if (m_Sink) {
+        return SC_DLL_ERROR_INVALID_OPERATION;
+    }
+
+    if (!chunk_bytes) {
+        chunk_bytes = DEFAULT_CHUNK_BYTES;
+    }
+
+    if (chunk_bytes < MIN_CHUNK_BYTES) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+
+    m_ChunkWords = chunk_bytes / SC_MM_VAR_WORD_SIZE;
+    m_SyncChunks = sync_chunks;
+
+    // preallocate so the producer never allocates
+    for (auto& b : m_Buffers) {
+        b.words = new (std::nothrow) uint64_t[m_ChunkWords];
+        if (!b.words) {
+            error = SC_DLL_ERROR_OUT_OF_MEM;
+            goto error_exit;
+        }
+
+        b.state.store(BUFFER_FREE, std::memory_order_relaxed);
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, SC_REC_FILE_MAGIC, sizeof(hdr.magic));
+    hdr.version = SC_REC_FILE_VERSION;
+    hdr.chunk_bytes = m_ChunkWords * SC_MM_VAR_WORD_SIZE;
+
+    error = sink->write(&hdr, sizeof(hdr));
+    if (error) {
+        goto error_exit;
+    }
+
+    m_Sink = sink;
+    m_Words = nullptr;
+    m_Capacity = 0;
+    m_Used = 0;
+    m_Records = 0;
+    m_Fill = 0;
+    m_Seq = 0;
+    m_Stop = false;
+    m_RecordCount = 0;
+    m_Dropped = 0;
+    m_Chunks = 0;
+    m_Bytes = sizeof(hdr);
+    m_Syncs = 0;
+    m_Error = SC_DLL_ERROR_NONE;
+
+    try {
+        m_Thread = std::thread([this] { run(); });
+    } catch (...) {
+        m_Sink = nullptr;
+        error = SC_DLL_ERROR_OUT_OF_MEM;
+        goto error_exit;
+    }
+
+success_exit:
+    return error;
+
+error_exit:
+    for (auto& b : m_Buffers) {
+        delete [] b.words;
+        b.words = nullptr;
+    }
+    goto success_exit;
+}
+
+void recorder::stop()
+{
+    if (!m_Sink) {
+        return;
+    }
+
+    submit();
+
+    {
+        std::lock_guard<std::mutex> g(m_Lock);
+        m_Stop = true;
+    }
+
+    m_Cv.notify_one();
+    m_Thread.join();
+
+    for (auto& b : m_Buffers) {
+        delete [] b.words;
+        b.words = nullptr;
+    }
+
+    m_Sink = nullptr;
+    m_Words = nullptr;
+    m_Capacity = 0;
+}
+
+void recorder::flush()
+{
+    submit();
+}
+
+void recorder::stats(recorder_stats* stats) const
+{
+    stats->records = m_RecordCount.load(std::memory_order_relaxed);
+    stats->dropped = m_Dropped.load(std::memory_order_relaxed);
+    stats->chunks = m_Chunks.load(std::memory_order_relaxed);
+    stats->bytes = m_Bytes.load(std::memory_order_relaxed);
+    stats->syncs = m_Syncs.load(std::memory_order_relaxed);
+    stats->error = m_Error.load(std::memory_order_relaxed);
+}
+
+/* Hands the current buffer to the I/O thread, if any, and tries to
+ * claim the next one.
+ */
+bool recorder::next()
+{
+    buffer* b = nullptr;
+
+    if (!m_Sink) {
+        return false;
+    }
+
+    submit();
+
+    b = &m_Buffers[m_Fill];
+
+    if (BUFFER_FREE != b->state.load(std::memory_order_acquire)) {
+        return false;
+    }
+
+    b->state.store(BUFFER_FILLING, std::memory_order_relaxed);
+    m_Words = b->words + 2;
+    m_Capacity = m_ChunkWords - 2;
+    m_Used = 0;
+    m_Records = 0;
+
+    return true;
+}
+
+void recorder::submit()
+{
+    buffer* b = nullptr;
+    sc_rec_chunk_header* hdr = nullptr;
+
+    if (!m_Words) {
+        return;
+    }
+
+    b = &m_Buffers[m_Fill];
+    m_Fill ^= 1;
+    m_Words = nullptr;
+    m_Capacity = 0;
+
+    if (!m_Records) {
+        b->state.store(BUFFER_FREE, std::memory_order_relaxed);
+        return;
+    }
+
+    hdr = reinterpret_cast<sc_rec_chunk_header*>(b->words);
+    hdr->magic = SC_REC_CHUNK_MAGIC;
+    hdr->seq = m_Seq++;
+    hdr->words = m_Used;
+    hdr->records = m_Records;
+
+    // The I/O thread only sleeps with the lock held after finding no
+    // full buffer, so a store under the lock can't be missed.
+    {
+        std::lock_guard<std::mutex> g(m_Lock);
+        b->state.store(BUFFER_FULL, std::memory_order_release);
+    }
+
+    m_Cv.notify_one();
+}
+
+void recorder::run()
+{
+    uint32_t index = 0;
+    uint32_t unsynced = 0;
+
+    for (;;) {
+        buffer* b = &m_Buffers[index];
+        bool stop = false;
+
+        {
+            std::unique_lock<std::mutex> g(m_Lock);
+
+            while (BUFFER_FULL != b->state.load(std::memory_order_acquire) && !m_Stop) {
+                m_Cv.wait(g);
+            }
+
+            stop = BUFFER_FULL != b->state.load(std::memory_order_acquire);
+        }
+
+        if (stop) {
+            break;
+        }
+
+        if (SC_DLL_ERROR_NONE == m_Error.load(std::memory_order_relaxed)) {
+            sc_rec_chunk_header const* hdr = reinterpret_cast<sc_rec_chunk_header const*>(b->words);
+            size_t const bytes = (2 + static_cast<size_t>(hdr->words)) * SC_MM_VAR_WORD_SIZE;
+            int error = m_Sink->write(b->words, bytes);
+
+            if (error) {
+                m_Error.store(error, std::memory_order_relaxed);
+            } else {
+                m_Chunks.fetch_add(1, std::memory_order_relaxed);
+                m_Bytes.fetch_add(bytes, std::memory_order_relaxed);
+
+                if (m_SyncChunks && ++unsynced == m_SyncChunks) {
+                    unsynced = 0;
+                    error = m_Sink->sync();
+
+                    if (error) {
+                        m_Error.store(error, std::memory_order_relaxed);
+                    } else {
+                        m_Syncs.fetch_add(1, std::memory_order_relaxed);
+                    }
+                }
+            }
+        }
+
+        b->state.store(BUFFER_FREE, std::memory_order_release);
+        index ^= 1;
+    }
+
+    if (unsynced && SC_DLL_ERROR_NONE == m_Error.load(std::memory_order_relaxed)) {
+        int error = m_Sink->sync();
+
+        if (error) {
+            m_Error.store(error, std::memory_order_relaxed);
+        } else {
+            m_Syncs.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+record_reader::record_reader()
+    : m_Source(nullptr)
+    , m_Words(nullptr)
+    , m_ChunkWords(0)
+    , m_Used(0)
+    , m_Offset(0)
+    , m_Records(0)
+    , m_Seq(0)
+    , m_End(false)
+{
+}
+
+record_reader::~record_reader()
+{
+    delete [] m_Words;
+}
+
+/* Reads exactly bytes, sets *end if the data ends before */
+int record_reader::fill(void* ptr, size_t bytes, bool* end)
+{
+    uint8_t* p = static_cast<uint8_t*>(ptr);
+
+    *end = false;
+
+    while (bytes) {
+        size_t got = 0;
+        int error = m_Source->read(p, bytes, &got);
+
+        if (error) {
+            return error;
+        }
+
+        if (!got) {
+            *end = true;
+            break;
+        }
+
+        p += got;
+        bytes -= got;
+    }
+
+    return SC_DLL_ERROR_NONE;
+}
+
+int record_reader::open(record_source* source)
+{
+    sc_rec_file_header hdr;
+    bool end = false;
+    int error = SC_DLL_ERROR_NONE;
+
+    if (!source) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+
+    m_Source = source;
+
+    error = fill(&hdr, sizeof(hdr), &end);
+    if (error) {
+        return error;
+    }
+
+    if (end ||
+        0 != memcmp(hdr.magic, SC_REC_FILE_MAGIC, sizeof(hdr.magic)) ||
+        SC_REC_FILE_VERSION != hdr.version ||
+        hdr.chunk_bytes < recorder::MIN_CHUNK_BYTES) {
+        return SC_DLL_ERROR_PROTO_VIOLATION;
+    }
+
+    delete [] m_Words;
+    m_ChunkWords = hdr.chunk_bytes / SC_MM_VAR_WORD_SIZE;
+    m_Words = new (std::nothrow) uint64_t[m_ChunkWords];
+    if (!m_Words) {
+        return SC_DLL_ERROR_OUT_OF_MEM;
+    }
+
+    m_Used = 0;
+    m_Offset = 0;
+    m_Records = 0;
+    m_Seq = 0;
+    m_End = false;
+
+    return SC_DLL_ERROR_NONE;
+}
+
+int record_reader::next(sc_can_mm_slot_t* slot, bool* end)
+{
+    int error = SC_DLL_ERROR_NONE;
+
+    *end = false;
+
+    while (!m_Records) {
+        sc_rec_chunk_header hdr;
+
+        if (m_End) {
+            *end = true;
+            return SC_DLL_ERROR_NONE;
+        }
+
+        error = fill(&hdr, sizeof(hdr), &m_End);
+        if (error) {
+            return error;
+        }
+
+        if (m_End) {
+            continue;
+        }
+
+        if (SC_REC_CHUNK_MAGIC != hdr.magic ||
+            m_Seq != hdr.seq ||
+            hdr.words > m_ChunkWords - 2) {
+            return SC_DLL_ERROR_PROTO_VIOLATION;
+        }
+
+        error = fill(m_Words, hdr.words * SC_MM_VAR_WORD_SIZE, &m_End);
+        if (error) {
+            return error;
+        }
+
+        if (m_End) {
+            continue;
+        }
+
+        ++m_Seq;
+        m_Used = hdr.words;
+        m_Offset = 0;
+        m_Records = hdr.records;
+    }
+
+    if (m_Offset >= m_Used) {
+        return SC_DLL_ERROR_PROTO_VIOLATION;
+    }
+
+    error = mm::var_decode(&m_Words[m_Offset], m_Used - m_Offset, slot);
+    if (error) {
+        return error;
+    }
+
+    // unknown records decode as SC_MM_DATA_TYPE_NONE, skip by header
+    m_Offset += reinterpret_cast<sc_mm_var_header const*>(&m_Words[m_Offset])->words;
+    --m_Records;
+
+    return SC_DLL_ERROR_NONE;
+}
+
+} // sc
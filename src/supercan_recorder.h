@@ -0,0 +1,305 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Jean Gressmann <jean@0x42.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#ifndef __cplusplus
+#   error "supercan_recorder.h requires C++"
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "supercan_mm_ring.h"
+
+/* Recording file format
+ *
+ * A file starts with a sc_rec_file_header followed by chunks. Each chunk
+ * is a sc_rec_chunk_header and the chunk's records in the variable length
+ * RX ring format (SC_MM_FORMAT_VAR, see sc_mm_var_header). All values
+ * are in host byte order.
+ */
+
+#define SC_REC_FILE_MAGIC       "SCREC\0\0\0"
+#define SC_REC_FILE_VERSION     1
+#define SC_REC_CHUNK_MAGIC      UINT32_C(0x48435353) // "SSCH"
+
+struct sc_rec_file_header {
+    char magic[8];              ///< SC_REC_FILE_MAGIC
+    uint32_t version;           ///< SC_REC_FILE_VERSION
+    uint32_t chunk_bytes;       ///< maximum size of a chunk including its header
+};
+
+struct sc_rec_chunk_header {
+    uint32_t magic;             ///< SC_REC_CHUNK_MAGIC
+    uint32_t seq;               ///< chunk sequence number, starts at 0
+    uint32_t words;             ///< record words following the header
+    uint32_t records;           ///< number of records
+};
+
+static_assert(sizeof(sc_rec_file_header) == 16, "structure size mismatch");
+static_assert(sizeof(sc_rec_chunk_header) == 2 * SC_MM_VAR_WORD_SIZE, "structure size mismatch");
+
+namespace sc {
+
+/** Destination of recorded data, called on the recorder's I/O thread */
+class record_sink
+{
+public:
+    virtual ~record_sink() {}
+
+    /** Writes all bytes, returns error code */
+    virtual int write(void const* ptr, size_t bytes) = 0;
+
+    /** Commits written data to stable storage, returns error code */
+    virtual int sync() = 0;
+};
+
+/** Appends to a file */
+class record_file_sink : public record_sink
+{
+public:
+    record_file_sink();
+    ~record_file_sink();
+
+    /** Creates or truncates the file, returns error code */
+    int open(char const* path);
+#if defined(_WIN32)
+    int open(wchar_t const* path);
+#endif
+    void close();
+
+    int write(void const* ptr, size_t bytes) override;
+    int sync() override;
+
+private:
+    record_file_sink(record_file_sink const&) = delete;
+    record_file_sink& operator=(record_file_sink const&) = delete;
+
+private:
+#if defined(_WIN32)
+    void* m_File;
+#else
+    int m_Fd;
+#endif
+};
+
+struct recorder_stats {
+    uint64_t records;           ///< records stored
+    uint64_t dropped;           ///< records dropped because both buffers were busy
+    uint64_t chunks;            ///< chunks written
+    uint64_t bytes;             ///< bytes written
+    uint64_t syncs;             ///< sink syncs
+    int error;                  ///< first sink error
+};
+
+/** Double buffered binary recorder
+ *
+ * One thread stores records into the current chunk buffer. A full
+ * buffer is handed to the recorder's I/O thread, which writes it to the
+ * sink in one piece and syncs the sink every few chunks. Storing never
+ * blocks: if the I/O thread hasn't finished the other buffer yet, records
+ * are dropped and counted.
+ */
+class recorder
+{
+public:
+    enum {
+        DEFAULT_CHUNK_BYTES = 1u << 20,
+        DEFAULT_SYNC_CHUNKS = 8,
+        MIN_CHUNK_BYTES = 1u << 10,
+    };
+
+    recorder();
+    ~recorder();
+
+    /** Writes the file header and starts the I/O thread
+     *
+     * \param sink          destination, must outlive the recording
+     * \param chunk_bytes   chunk buffer size, 0 for DEFAULT_CHUNK_BYTES
+     * \param sync_chunks   sync the sink after this many chunks, 0 to only sync on stop
+     *
+     * \returns error code
+     */
+    int start(record_sink* sink, uint32_t chunk_bytes, uint32_t sync_chunks);
+
+    /** Writes the partially filled chunk, syncs the sink and stops the I/O thread
+     *
+     * Must not run concurrently to record or flush.
+     */
+    void stop();
+
+    bool started() const { return nullptr != m_Sink; }
+
+    /** Stores a record, single producer thread */
+    void record(sc_can_mm_slot_t const* slot)
+    {
+        uint32_t const words = mm::var_words(slot);
+
+        if (m_Used + words > m_Capacity && (!next() || words > m_Capacity)) {
+            m_Dropped.store(m_Dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return;
+        }
+
+        mm::var_encode(slot, m_Words + m_Used);
+        m_Used += words;
+        ++m_Records;
+        m_RecordCount.store(m_RecordCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    /** Hands the partially filled chunk to the I/O thread, producer thread */
+    void flush();
+
+    void stats(recorder_stats* stats) const;
+
+private:
+    recorder(recorder const&) = delete;
+    recorder& operator=(recorder const&) = delete;
+
+    bool next();
+    void submit();
+    void run();
+
+private:
+    enum {
+        BUFFER_FREE,
+        BUFFER_FILLING,
+        BUFFER_FULL,
+    };
+
+    struct buffer
+    {
+        uint64_t* words;
+        std::atomic<uint32_t> state;
+    };
+
+    buffer m_Buffers[2];
+    record_sink* m_Sink;
+    std::thread m_Thread;
+    std::mutex m_Lock;
+    std::condition_variable m_Cv;
+    // producer
+    uint64_t* m_Words;          ///< record area of the buffer being filled, NULL if none
+    uint32_t m_Capacity;        ///< words in record area, 0 if no buffer
+    uint32_t m_Used;
+    uint32_t m_Records;
+    uint32_t m_Fill;            ///< index of buffer being filled or to be filled next
+    uint32_t m_Seq;
+    // shared
+    uint32_t m_ChunkWords;
+    uint32_t m_SyncChunks;
+    bool m_Stop;                ///< protected by m_Lock
+    std::atomic<uint64_t> m_RecordCount;
+    std::atomic<uint64_t> m_Dropped;
+    std::atomic<uint64_t> m_Chunks;
+    std::atomic<uint64_t> m_Bytes;
+    std::atomic<uint64_t> m_Syncs;
+    std::atomic<int> m_Error;
+};
+
+/** Origin of recorded data */
+class record_source
+{
+public:
+    virtual ~record_source() {}
+
+    /** Reads up to bytes, *got is 0 at the end of data, returns error code */
+    virtual int read(void* ptr, size_t bytes, size_t* got) = 0;
+};
+
+/** Reads from a file */
+class record_file_source : public record_source
+{
+public:
+    record_file_source();
+    ~record_file_source();
+
+    /** Opens the file for reading, returns error code */
+    int open(char const* path);
+#if defined(_WIN32)
+    int open(wchar_t const* path);
+#endif
+    void close();
+
+    int read(void* ptr, size_t bytes, size_t* got) override;
+
+private:
+    record_file_source(record_file_source const&) = delete;
+    record_file_source& operator=(record_file_source const&) = delete;
+
+private:
+#if defined(_WIN32)
+    void* m_File;
+#else
+    int m_Fd;
+#endif
+};
+
+/** Decodes a recording written by recorder
+ *
+ * A truncated final chunk, i.e. from a recording that wasn't stopped,
+ * ends the recording.
+ */
+class record_reader
+{
+public:
+    record_reader();
+    ~record_reader();
+
+    /** Reads and validates the file header, returns error code */
+    int open(record_source* source);
+
+    /** Retrieves the next record
+     *
+     * \param slot    (out) record, type SC_MM_DATA_TYPE_NONE for unknown records
+     * \param end     (out) true if there are no more records, slot is untouched
+     *
+     * \returns error code
+     */
+    int next(sc_can_mm_slot_t* slot, bool* end);
+
+private:
+    record_reader(record_reader const&) = delete;
+    record_reader& operator=(record_reader const&) = delete;
+
+    int fill(void* ptr, size_t bytes, bool* end);
+
+private:
+    record_source* m_Source;
+    uint64_t* m_Words;
+    uint32_t m_ChunkWords;
+    uint32_t m_Used;            ///< record words of the current chunk
+    uint32_t m_Offset;          ///< words consumed of the current chunk
+    uint32_t m_Records;         ///< records left in the current chunk
+    uint32_t m_Seq;             ///< sequence number of the next chunk
+    bool m_End;
+};
+
+} // sc
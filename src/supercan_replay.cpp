@@ -0,0 +1,186 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Jean Gressmann <jean@0x42.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "supercan_replay.h"
+
+#include "supercan_error.h"
+
+namespace sc {
+
+replay::replay()
+    : m_Reader(nullptr)
+    , m_StartUs(0)
+    , m_BaseUs(0)
+    , m_LeadUs(0)
+    , m_Flags(0)
+    , m_Pending(false)
+    , m_Based(false)
+    , m_End(true)
+{
+    memset(&m_Next, 0, sizeof(m_Next));
+    memset(&m_Stats, 0, sizeof(m_Stats));
+}
+
+int replay::start(record_reader* reader, uint64_t start_us, uint32_t lead_us, uint32_t flags)
+{
+    if (!reader || !(flags & (FLAG_RX | FLAG_TX))) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+
+    m_Reader = reader;
+    m_StartUs = start_us;
+    m_BaseUs = 0;
+    m_LeadUs = lead_us;
+    m_Flags = flags;
+    m_Pending = false;
+    m_Based = false;
+    m_End = false;
+    memset(&m_Stats, 0, sizeof(m_Stats));
+
+    return peek();
+}
+
+/* Loads the next frame to replay into m_Next */
+int replay::peek()
+{
+    while (!m_Pending && !m_End) {
+        sc_can_mm_slot_t slot;
+        int error = m_Reader->next(&slot, &m_End);
+
+        if (error) {
+            return error;
+        }
+
+        if (m_End) {
+            break;
+        }
+
+        switch (slot.hdr.type) {
+        case SC_MM_DATA_TYPE_CAN_RX:
+            if (!(m_Flags & FLAG_RX)) {
+                continue;
+            }
+
+            m_Next.can_id = slot.rx.can_id;
+            m_Next.dlc = slot.rx.dlc;
+            m_Next.flags = slot.rx.flags;
+            m_Next.timestamp_us = slot.rx.timestamp_us;
+            memcpy(m_Next.data, slot.rx.data, sizeof(m_Next.data));
+            break;
+        case SC_MM_DATA_TYPE_CAN_TX:
+            // dropped frames never made it onto the bus
+            if (!(m_Flags & FLAG_TX) || (slot.tx.flags & SC_CAN_FRAME_FLAG_DRP)) {
+                continue;
+            }
+
+            m_Next.can_id = slot.tx.can_id;
+            m_Next.dlc = slot.tx.dlc;
+            m_Next.flags = slot.tx.flags;
+            m_Next.timestamp_us = slot.tx.timestamp_us;
+            memcpy(m_Next.data, slot.tx.data, sizeof(m_Next.data));
+            break;
+        default:
+            continue;
+        }
+
+        if (!m_Based) {
+            m_Based = true;
+            m_BaseUs = m_Next.timestamp_us;
+        }
+
+        m_Next.type = SC_MM_DATA_TYPE_CAN_TX;
+        m_Next.flags &= SC_CAN_FRAME_FLAG_EXT | SC_CAN_FRAME_FLAG_RTR | SC_CAN_FRAME_FLAG_FDF | SC_CAN_FRAME_FLAG_BRS | SC_CAN_FRAME_FLAG_ESI;
+        m_Next.echo = 0;
+        m_Next.track_id = 0;
+        m_Next.reserved = 0;
+        m_Next.timestamp_us = m_StartUs + (m_Next.timestamp_us - m_BaseUs);
+        m_Pending = true;
+    }
+
+    return SC_DLL_ERROR_NONE;
+}
+
+int replay::next(uint64_t now_us, sc_mm_can_tx* frames, uint32_t count, uint32_t* taken, uint32_t* wait_us)
+{
+    int error = SC_DLL_ERROR_NONE;
+    uint64_t const horizon_us = now_us + m_LeadUs;
+
+    *taken = 0;
+    *wait_us = UINT32_MAX;
+
+    for (;;) {
+        error = peek();
+        if (error) {
+            return error;
+        }
+
+        if (!m_Pending) {
+            break;
+        }
+
+        if (m_Next.timestamp_us > horizon_us) {
+            uint64_t const wait = m_Next.timestamp_us - horizon_us;
+
+            *wait_us = wait < UINT32_MAX ? static_cast<uint32_t>(wait) : UINT32_MAX - 1;
+            break;
+        }
+
+        if (*taken == count) {
+            *wait_us = 0;
+            break;
+        }
+
+        if (m_Next.timestamp_us < now_us) {
+            ++m_Stats.late;
+        }
+
+        frames[(*taken)++] = m_Next;
+        ++m_Stats.queued;
+        m_Pending = false;
+    }
+
+    return SC_DLL_ERROR_NONE;
+}
+
+void replay::sent(uint64_t target_us, uint64_t ts_us)
+{
+    int64_t const error_us = static_cast<int64_t>(ts_us - target_us);
+
+    if (!m_Stats.sent) {
+        m_Stats.error_min_us = error_us;
+        m_Stats.error_max_us = error_us;
+    }
+    else if (error_us < m_Stats.error_min_us) {
+        m_Stats.error_min_us = error_us;
+    }
+    else if (error_us > m_Stats.error_max_us) {
+        m_Stats.error_max_us = error_us;
+    }
+
+    m_Stats.error_abs_sum_us += static_cast<uint64_t>(error_us < 0 ? -error_us : error_us);
+    ++m_Stats.sent;
+}
+
+} // sc
@@ -0,0 +1,119 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Jean Gressmann <jean@0x42.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#ifndef __cplusplus
+#   error "supercan_replay.h requires C++"
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "supercan_recorder.h"
+
+namespace sc {
+
+struct replay_stats {
+    uint64_t queued;            ///< frames handed out by replay::next
+    uint64_t late;              ///< frames handed out after their target time
+    uint64_t sent;              ///< frames reported through replay::sent
+    int64_t error_min_us;       ///< smallest TX time - target time, valid if sent
+    int64_t error_max_us;       ///< largest TX time - target time, valid if sent
+    uint64_t error_abs_sum_us;  ///< sum of absolute errors, divide by sent for the mean
+};
+
+/** Replays a recording with its original frame timing
+ *
+ * Frames keep their recorded spacing relative to a start time in the
+ * device's time domain (sc_tt_track, sc_dc_now). They are handed out
+ * a lead time ahead of their target so the caller can batch them and
+ * the device's TX FIFO never runs dry under full bus load. The TX
+ * timestamps reported back yield the achieved timing error.
+ *
+ * Not thread-safe.
+ */
+class replay
+{
+public:
+    enum {
+        FLAG_RX = 0x1,          ///< replay received frames
+        FLAG_TX = 0x2,          ///< replay transmitted frames (TX echoes)
+        DEFAULT_LEAD_US = 1000,
+    };
+
+    replay();
+
+    /** Begins replaying
+     *
+     * \param reader    recording, positioned at the first record
+     * \param start_us  device time at which the first frame is due
+     * \param lead_us   hand out frames this long before they are due
+     * \param flags     FLAG_*
+     *
+     * \returns error code
+     */
+    int start(record_reader* reader, uint64_t start_us, uint32_t lead_us, uint32_t flags);
+
+    /** Retrieves frames due until now_us + lead_us in recording order
+     *
+     * \param now_us    current device time
+     * \param frames    (out) frames, timestamp_us is the target time, track_id is unset
+     * \param count     capacity of frames, i.e. the free TX FIFO entries
+     * \param taken     (out) number of frames stored
+     * \param wait_us   (out) time until more frames are due, UINT32_MAX at the end of the recording
+     *
+     * \returns error code
+     */
+    int next(uint64_t now_us, sc_mm_can_tx* frames, uint32_t count, uint32_t* taken, uint32_t* wait_us);
+
+    /** Accounts the device's TX timestamp of a frame with target time target_us */
+    void sent(uint64_t target_us, uint64_t ts_us);
+
+    /** True once all frames have been handed out */
+    bool end() const { return m_End && !m_Pending; }
+
+    void stats(replay_stats* stats) const { *stats = m_Stats; }
+
+private:
+    replay(replay const&) = delete;
+    replay& operator=(replay const&) = delete;
+
+    int peek();
+
+private:
+    record_reader* m_Reader;
+    sc_mm_can_tx m_Next;        ///< next frame if m_Pending
+    replay_stats m_Stats;
+    uint64_t m_StartUs;
+    uint64_t m_BaseUs;          ///< recorded time of the first frame
+    uint32_t m_LeadUs;
+    uint32_t m_Flags;
+    bool m_Pending;
+    bool m_Based;
+    bool m_End;
+};
+
+} // sc
@@ -0,0 +1,358 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020-2025 Jean Gressmann <jean@0x42.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "supercan_proto.h"
+#include "supercan_error.h"
+#include "supercan_rx.h"
+
+#ifdef _MSC_VER
+#   include <stdlib.h>
+#   define sc_bswap16(x) _byteswap_ushort(x)
+#   define sc_bswap32(x) _byteswap_ulong(x)
+#else
+#   define sc_bswap16(x) __builtin_bswap16(x)
+#   define sc_bswap32(x) __builtin_bswap32(x)
+#endif
+
+#ifdef _MSC_VER
+#   define SC_RX_FORCE_INLINE __forceinline
+#else
+#   define SC_RX_FORCE_INLINE inline __attribute__((always_inline))
+#endif
+
+static const uint8_t dlc_to_len[16] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64
+};
+
+static inline uint16_t dev_to_host16(int swap, uint16_t value)
+{
+    return swap ? sc_bswap16(value) : value;
+}
+
+static inline uint32_t dev_to_host32(int swap, uint32_t value)
+{
+    return swap ? sc_bswap32(value) : value;
+}
+
+void sc_rx_reassembly_init(sc_rx_reassembly_t* r, int enable)
+{
+    r->size = 0;
+    r->index = 0;
+    r->enabled = enable != 0;
+}
+
+int sc_rx_reassembly_complete(
+    sc_rx_reassembly_t* r,
+    uint8_t const** _ptr,
+    uint8_t const* end,
+    uint8_t const** msg)
+{
+    uint8_t* buffer = r->buffers[r->index];
+    uint8_t const* ptr = *_ptr;
+    size_t len = 0;
+    size_t chunk = 0;
+
+    *msg = NULL;
+
+    if (!r->size) {
+        return SC_DLL_ERROR_NONE;
+    }
+
+    // header first, it may itself be split
+    while (r->size < SC_MSG_CAN_LEN_MULTIPLE && ptr < end) {
+        buffer[r->size++] = *ptr++;
+    }
+
+    if (r->size >= SC_MSG_CAN_LEN_MULTIPLE) {
+        len = buffer[1];
+
+        if (len < SC_MSG_CAN_LEN_MULTIPLE) {
+            r->size = 0;
+            *_ptr = ptr;
+            return SC_DLL_ERROR_PROTO_VIOLATION;
+        }
+
+        if (len > SC_RX_REASSEMBLY_SIZE) {
+            r->size = 0;
+            *_ptr = ptr;
+            return SC_DLL_ERROR_REASSEMBLY_SPACE;
+        }
+
+        chunk = len - r->size;
+        if (chunk > (size_t)(end - ptr)) {
+            chunk = (size_t)(end - ptr);
+        }
+
+        memcpy(buffer + r->size, ptr, chunk);
+        r->size += (uint16_t)chunk;
+        ptr += chunk;
+
+        if (r->size == len) {
+            *msg = buffer;
+            r->size = 0;
+            r->index ^= 1;
+        }
+    }
+
+    *_ptr = ptr;
+
+    return SC_DLL_ERROR_NONE;
+}
+
+int sc_rx_reassembly_carry(sc_rx_reassembly_t* r, uint8_t const* ptr, uint8_t const* end)
+{
+    size_t left = (size_t)(end - ptr);
+
+    if (!r->enabled) {
+        // trailing bytes short of a message header have always been ignored
+        return left < SC_MSG_CAN_LEN_MULTIPLE ? SC_DLL_ERROR_NONE : SC_DLL_ERROR_PROTO_VIOLATION;
+    }
+
+    if (!left || !ptr[0] || (left > 1 && !ptr[1])) {
+        // end-of-input message
+        return SC_DLL_ERROR_NONE;
+    }
+
+    if (left > 1) {
+        size_t const len = ptr[1];
+
+        if (len < SC_MSG_CAN_LEN_MULTIPLE) {
+            return SC_DLL_ERROR_PROTO_VIOLATION;
+        }
+
+        if (len > SC_RX_REASSEMBLY_SIZE) {
+            return SC_DLL_ERROR_REASSEMBLY_SPACE;
+        }
+    }
+
+    memcpy(r->buffers[r->index], ptr, left);
+    r->size = (uint16_t)left;
+
+    return SC_DLL_ERROR_NONE;
+}
+
+void sc_rx_decoder_init(sc_rx_decoder_t* dec, int swap)
+{
+    memset(dec, 0, sizeof(*dec));
+    sc_tt_init(&dec->tt);
+    dec->swap = swap != 0;
+}
+
+void sc_rx_decoder_set_reassembly(sc_rx_decoder_t* dec, int enable)
+{
+    sc_rx_reassembly_init(&dec->reassembly, enable);
+}
+
+/* The decode loop is instantiated once per byte order so that
+ * the byte order test is resolved at compile time. The loop
+ * works on pointers and a local copy of the time tracker to
+ * keep register pressure low, byte stores to the frame records
+ * would otherwise force reloads of the decoder state.
+ */
+static SC_RX_FORCE_INLINE int decode(
+    sc_dev_time_tracker_t* _tt,
+    int const swap,
+    uint8_t const** _ptr,
+    uint8_t const* const end,
+    sc_can_frame_t** _frame,
+    sc_can_frame_t* const frame_end)
+{
+    sc_dev_time_tracker_t tt = *_tt;
+    uint8_t const* ptr = *_ptr;
+    sc_can_frame_t* f = *_frame;
+    int error = SC_DLL_ERROR_NONE;
+
+    while (ptr + SC_MSG_CAN_LEN_MULTIPLE <= end && f < frame_end) {
+        struct sc_msg_header const* msg = (struct sc_msg_header const*)ptr;
+        uint8_t const id = msg->id;
+        uint8_t const len = msg->len;
+
+        if (!id || !len) {
+            // Allow end-of-input message to work around need to send ZLP
+            ptr = end;
+            break;
+        }
+
+        if (len < SC_MSG_CAN_LEN_MULTIPLE) {
+            error = SC_DLL_ERROR_PROTO_VIOLATION;
+            break;
+        }
+
+        if (len > end - ptr) {
+            // incomplete, left to the caller
+            break;
+        }
+
+        switch (id) {
+        case SC_MSG_CAN_RX: {
+            struct sc_msg_can_rx const* rx = (struct sc_msg_can_rx const*)msg;
+            uint8_t const flags = rx->flags;
+            uint8_t const dlc = rx->dlc & 0xf;
+
+            if (len < sizeof(*rx) + ((flags & SC_CAN_FRAME_FLAG_RTR) ? 0 : dlc_to_len[dlc])) {
+                error = SC_DLL_ERROR_PROTO_VIOLATION;
+                goto exit;
+            }
+
+            f->timestamp_us = sc_tt_track(&tt, dev_to_host32(swap, rx->timestamp_us));
+            f->data = (flags & SC_CAN_FRAME_FLAG_RTR) ? NULL : rx->data;
+            f->can_id = dev_to_host32(swap, rx->can_id);
+            f->type = SC_MSG_CAN_RX;
+            f->flags = flags;
+            f->dlc = dlc;
+            ++f;
+        } break;
+        case SC_MSG_CAN_TXR: {
+            struct sc_msg_can_txr const* txr = (struct sc_msg_can_txr const*)msg;
+
+            if (len < sizeof(*txr)) {
+                error = SC_DLL_ERROR_PROTO_VIOLATION;
+                goto exit;
+            }
+
+            f->timestamp_us = sc_tt_track(&tt, dev_to_host32(swap, txr->timestamp_us));
+            f->data = NULL;
+            f->type = SC_MSG_CAN_TXR;
+            f->flags = txr->flags;
+            f->track_id = txr->track_id;
+            ++f;
+        } break;
+        case SC_MSG_CAN_STATUS: {
+            struct sc_msg_can_status const* status = (struct sc_msg_can_status const*)msg;
+
+            if (len < sizeof(*status)) {
+                error = SC_DLL_ERROR_PROTO_VIOLATION;
+                goto exit;
+            }
+
+            f->timestamp_us = sc_tt_track(&tt, dev_to_host32(swap, status->timestamp_us));
+            f->data = NULL;
+            f->rx_lost = dev_to_host16(swap, status->rx_lost);
+            f->tx_dropped = dev_to_host16(swap, status->tx_dropped);
+            f->type = SC_MSG_CAN_STATUS;
+            f->flags = status->flags;
+            f->bus_status = status->bus_status;
+            f->rx_errors = status->rx_errors;
+            f->tx_errors = status->tx_errors;
+            f->rx_fifo_size = status->rx_fifo_size;
+            f->tx_fifo_size = status->tx_fifo_size;
+            ++f;
+        } break;
+        case SC_MSG_CAN_ERROR: {
+            struct sc_msg_can_error const* e = (struct sc_msg_can_error const*)msg;
+
+            if (len < sizeof(*e)) {
+                error = SC_DLL_ERROR_PROTO_VIOLATION;
+                goto exit;
+            }
+
+            f->timestamp_us = sc_tt_track(&tt, dev_to_host32(swap, e->timestamp_us));
+            f->data = NULL;
+            f->type = SC_MSG_CAN_ERROR;
+            f->flags = e->flags;
+            f->error = e->error;
+            ++f;
+        } break;
+        default:
+            // skip
+            break;
+        }
+
+        ptr += len;
+    }
+
+exit:
+    *_tt = tt;
+    *_ptr = ptr;
+    *_frame = f;
+
+    return error;
+}
+
+int sc_rx_decode(
+    sc_rx_decoder_t* dec,
+    uint8_t const* ptr,
+    size_t bytes,
+    size_t* offset,
+    sc_can_frame_t* frames,
+    size_t capacity,
+    size_t* count)
+{
+    uint8_t const* start = ptr + *offset;
+    uint8_t const* end = ptr + bytes;
+    sc_can_frame_t* f = frames;
+    sc_can_frame_t* const frame_end = frames + capacity;
+    int error = SC_DLL_ERROR_NONE;
+
+    if (!capacity) {
+        *count = 0;
+        return SC_DLL_ERROR_NONE;
+    }
+
+    if (!*offset && dec->reassembly.size) {
+        uint8_t const* msg = NULL;
+
+        error = sc_rx_reassembly_complete(&dec->reassembly, &start, end, &msg);
+
+        if (!error && msg) {
+            uint8_t const* msg_ptr = msg;
+
+            if (dec->swap) {
+                error = decode(&dec->tt, 1, &msg_ptr, msg + msg[1], &f, frame_end);
+            }
+            else {
+                error = decode(&dec->tt, 0, &msg_ptr, msg + msg[1], &f, frame_end);
+            }
+        }
+
+        if (error) {
+            goto exit;
+        }
+    }
+
+    if (dec->swap) {
+        error = decode(&dec->tt, 1, &start, end, &f, frame_end);
+    }
+    else {
+        error = decode(&dec->tt, 0, &start, end, &f, frame_end);
+    }
+
+    if (!error && start < end && f < frame_end) {
+        // decoding stopped short of the end at an incomplete message
+        error = sc_rx_reassembly_carry(&dec->reassembly, start, end);
+        if (!error) {
+            start = end;
+        }
+    }
+
+exit:
+    *offset = (size_t)(start - ptr);
+    *count = (size_t)(f - frames);
+
+    return error;
+}
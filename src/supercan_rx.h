@@ -0,0 +1,168 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020-2025 Jean Gressmann <jean@0x42.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "supercan_misc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Decoded CAN stream message in host byte order
+ *
+ * Which fields are valid depends on the message type.
+ */
+typedef struct sc_can_frame {
+    uint64_t timestamp_us;      ///< device timestamp extended to 64 bit
+    uint8_t const* data;        ///< SC_MSG_CAN_RX: payload (NULL for RTR), points into the transfer buffer
+    uint32_t can_id;            ///< SC_MSG_CAN_RX
+    uint8_t type;               ///< SC_MSG_CAN_RX, SC_MSG_CAN_TXR, SC_MSG_CAN_STATUS, SC_MSG_CAN_ERROR
+    uint8_t flags;              ///< frame flags (RX, TXR), status flags (STATUS), error flags (ERROR)
+    uint8_t dlc;                ///< SC_MSG_CAN_RX
+    uint8_t track_id;           ///< SC_MSG_CAN_TXR
+    uint16_t rx_lost;           ///< SC_MSG_CAN_STATUS
+    uint16_t tx_dropped;        ///< SC_MSG_CAN_STATUS
+    uint8_t bus_status;         ///< SC_MSG_CAN_STATUS
+    uint8_t rx_errors;          ///< SC_MSG_CAN_STATUS
+    uint8_t tx_errors;          ///< SC_MSG_CAN_STATUS
+    uint8_t rx_fifo_size;       ///< SC_MSG_CAN_STATUS
+    uint8_t tx_fifo_size;       ///< SC_MSG_CAN_STATUS
+    uint8_t error;              ///< SC_MSG_CAN_ERROR
+    uint8_t reserved[2];
+} sc_can_frame_t;
+
+/** Smallest CAN stream message in bytes (TXR, ERROR) */
+#define SC_CAN_FRAME_MSG_MIN_SIZE 8
+
+/** Number of frame records required to decode a transfer of the given size in one go */
+#define SC_CAN_FRAME_COUNT(buffer_size) (((buffer_size) + SC_CAN_FRAME_MSG_MIN_SIZE - 1) / SC_CAN_FRAME_MSG_MIN_SIZE)
+
+/** Size of a reassembly buffer, must hold the largest message */
+#ifndef SC_RX_REASSEMBLY_SIZE
+#   define SC_RX_REASSEMBLY_SIZE 256
+#endif
+
+/** Reassembles messages that cross transfer boundaries
+ *
+ * The tail of a transfer that doesn't form a complete message is
+ * carried over and completed from the start of the next transfer.
+ * Completed messages alternate between two buffers so that frames
+ * decoded from a reassembled message stay valid while the next transfer
+ * carries over a new partial message.
+ */
+typedef struct sc_rx_reassembly {
+    uint8_t buffers[2][SC_RX_REASSEMBLY_SIZE];
+    uint16_t size;              ///< bytes of partial message buffered
+    uint8_t index;              ///< buffer holding the partial message
+    uint8_t enabled;            ///< if zero, partial messages are protocol violations
+} sc_rx_reassembly_t;
+
+/** Initializes reassembly, reassembly is disabled by default */
+void sc_rx_reassembly_init(sc_rx_reassembly_t* r, int enable);
+
+/** Completes a partial message from the start of a transfer
+ *
+ * \param r         reassembly state
+ * \param ptr       (inout) position in the transfer, advanced past the consumed bytes
+ * \param end       end of the transfer
+ * \param msg       (out) complete message or NULL if none is pending or more input is required
+ *
+ * \returns error code
+ */
+int sc_rx_reassembly_complete(
+    sc_rx_reassembly_t* r,
+    uint8_t const** ptr,
+    uint8_t const* end,
+    uint8_t const** msg);
+
+/** Carries over the tail of a transfer
+ *
+ * \param r         reassembly state
+ * \param ptr       start of the incomplete message
+ * \param end       end of the transfer
+ *
+ * \returns SC_DLL_ERROR_PROTO_VIOLATION if reassembly is disabled or the header is invalid,
+ *          SC_DLL_ERROR_REASSEMBLY_SPACE if the message doesn't fit the reassembly buffer.
+ */
+int sc_rx_reassembly_carry(sc_rx_reassembly_t* r, uint8_t const* ptr, uint8_t const* end);
+
+typedef struct sc_rx_decoder {
+    sc_dev_time_tracker_t tt;
+    uint8_t swap;               ///< non-zero if device byte order differs from host byte order
+    sc_rx_reassembly_t reassembly;
+} sc_rx_decoder_t;
+
+/** Initializes the decoder
+ *
+ * \param swap  non-zero if the device byte order differs from host byte order
+ */
+void sc_rx_decoder_init(sc_rx_decoder_t* dec, int swap);
+
+/** Enables or disables reassembly of messages that cross transfer boundaries
+ *
+ * Discards any partial message.
+ */
+void sc_rx_decoder_set_reassembly(sc_rx_decoder_t* dec, int enable);
+
+/** Decodes CAN stream messages in a transfer buffer
+ *
+ * Decoding starts at *offset and stops at the end of the buffer or once
+ * all frame records are used up. In the latter case *offset is less than bytes
+ * and the function can be called again to resume decoding.
+ *
+ * With reassembly enabled, a call with *offset of zero first completes
+ * the message carried over from the previous transfer. Frames of a
+ * reassembled message point into the decoder and remain valid
+ * until the next transfer is decoded.
+ *
+ * Messages other than SC_MSG_CAN_RX, SC_MSG_CAN_TXR, SC_MSG_CAN_STATUS,
+ * and SC_MSG_CAN_ERROR are skipped.
+ *
+ * \param dec       decoder
+ * \param ptr       transfer buffer
+ * \param bytes     bytes in transfer buffer
+ * \param offset    (inout) decode position in buffer
+ * \param frames    frame records to fill
+ * \param capacity  number of frame records
+ * \param count     (out) number of frame records filled
+ *
+ * \returns error code
+ */
+int sc_rx_decode(
+    sc_rx_decoder_t* dec,
+    uint8_t const* ptr,
+    size_t bytes,
+    size_t* offset,
+    sc_can_frame_t* frames,
+    size_t capacity,
+    size_t* count);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,787 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020-2025 Jean Gressmann <jean@0x42.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "supercan_proto.h"
+#include "supercan_error.h"
+#include "supercan_sim.h"
+
+#define SC_SIM_NMBT_BRP_MIN     1
+#define SC_SIM_NMBT_BRP_MAX     512
+#define SC_SIM_NMBT_TSEG1_MIN   2
+#define SC_SIM_NMBT_TSEG1_MAX   256
+#define SC_SIM_NMBT_TSEG2_MIN   2
+#define SC_SIM_NMBT_TSEG2_MAX   128
+#define SC_SIM_NMBT_SJW_MAX     128
+#define SC_SIM_DTBT_BRP_MIN     1
+#define SC_SIM_DTBT_BRP_MAX     32
+#define SC_SIM_DTBT_TSEG1_MIN   1
+#define SC_SIM_DTBT_TSEG1_MAX   32
+#define SC_SIM_DTBT_TSEG2_MIN   1
+#define SC_SIM_DTBT_TSEG2_MAX   16
+#define SC_SIM_DTBT_SJW_MAX     16
+
+static const uint8_t dlc_to_len[16] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64
+};
+
+static inline uint16_t sc_sim_u16(sc_sim_t const* sim, uint16_t value)
+{
+    return sim->swap ? (uint16_t)((value >> 8) | (value << 8)) : value;
+}
+
+static inline uint32_t sc_sim_u32(sc_sim_t const* sim, uint32_t value)
+{
+    if (sim->swap) {
+        value =
+            (value >> 24) |
+            ((value >> 8) & 0x0000ff00) |
+            ((value << 8) & 0x00ff0000) |
+            (value << 24);
+    }
+
+    return value;
+}
+
+static inline void sc_sim_gen_start(struct sc_sim_gen* gen, uint64_t now_us, uint32_t num, uint32_t den)
+{
+    gen->start_us = now_us;
+    gen->count = 0;
+    gen->num = num;
+    gen->den = den;
+}
+
+static inline uint64_t sc_sim_gen_due(struct sc_sim_gen const* gen)
+{
+    return gen->start_us + ((gen->count + 1) * gen->num) / gen->den;
+}
+
+void sc_sim_config_init(sc_sim_config_t* config)
+{
+    memset(config, 0, sizeof(*config));
+
+    config->can_clk_hz = 80000000;
+    config->cmd_buffer_size = 64;
+    config->msg_buffer_size = 512;
+    config->feat_perm = SC_FEATURE_FLAG_TXR;
+    config->feat_conf =
+        SC_FEATURE_FLAG_FDF |
+        SC_FEATURE_FLAG_EHD |
+        SC_FEATURE_FLAG_DAR |
+        SC_FEATURE_FLAG_MON_MODE |
+        SC_FEATURE_FLAG_RES_MODE |
+        SC_FEATURE_FLAG_EXT_LOOP_MODE;
+    config->tx_fifo_size = 32;
+    config->rx_fifo_size = 32;
+    config->byte_order = SC_BYTE_ORDER_LE;
+    config->rx_dlc = 8;
+    config->echo = 1;
+    config->in_transfers = 16;
+    config->request_slots = 16;
+}
+
+static void sc_sim_reset(sc_sim_t* sim)
+{
+    sim->bus_on = 0;
+    sim->features = sim->config.feat_perm;
+    sim->can_size = 0;
+    sim->tx_head = 0;
+    sim->tx_count = 0;
+    sim->rx_lost = 0;
+    sim->tx_dropped = 0;
+    sim->status_flags = 0;
+    sim->nm_brp = 1;
+    sim->nm_tseg1 = 63;
+    sim->nm_tseg2 = 16;
+    sim->nm_sjw = 16;
+    sim->dt_brp = 1;
+    sim->dt_tseg1 = 15;
+    sim->dt_tseg2 = 4;
+    sim->dt_sjw = 4;
+}
+
+static int sc_sim_can_flush(sc_sim_t* sim)
+{
+    int error = SC_DLL_ERROR_NONE;
+
+    if (sim->can_size) {
+        error = sc_loopback_push(&sim->can, sim->can_buf, sim->can_size);
+        if (!error) {
+            sim->can_size = 0;
+        }
+    }
+
+    return error;
+}
+
+/* Returns space for a message in the current device to host transfer
+ * or NULL if the host isn't keeping up.
+ */
+static void* sc_sim_can_alloc(sc_sim_t* sim, size_t bytes)
+{
+    void* ptr = NULL;
+
+    if (sim->can_size + bytes > sim->config.msg_buffer_size) {
+        if (sc_sim_can_flush(sim)) {
+            return NULL;
+        }
+    }
+
+    ptr = sim->can_buf + sim->can_size;
+    sim->can_size += (uint16_t)bytes;
+
+    return ptr;
+}
+
+static void sc_sim_lost(sc_sim_t* sim)
+{
+    ++sim->stats.rx_lost;
+
+    if (sim->rx_lost < UINT16_MAX) {
+        ++sim->rx_lost;
+    }
+}
+
+static void sc_sim_can_rx(
+    sc_sim_t* sim,
+    uint32_t can_id,
+    uint8_t flags,
+    uint8_t dlc,
+    uint8_t const* data)
+{
+    struct sc_msg_can_rx* rx = NULL;
+    uint8_t const len = (flags & SC_CAN_FRAME_FLAG_RTR) ? 0 : dlc_to_len[dlc & 0xf];
+    size_t const bytes = (sizeof(*rx) + len + SC_MSG_CAN_LEN_MULTIPLE - 1) & ~(size_t)(SC_MSG_CAN_LEN_MULTIPLE - 1);
+
+    rx = (struct sc_msg_can_rx*)sc_sim_can_alloc(sim, bytes);
+    if (!rx) {
+        sc_sim_lost(sim);
+        return;
+    }
+
+    memset(rx, 0, bytes);
+    rx->id = SC_MSG_CAN_RX;
+    rx->len = (uint8_t)bytes;
+    rx->dlc = dlc;
+    rx->flags = flags;
+    rx->can_id = sc_sim_u32(sim, can_id);
+    rx->timestamp_us = sc_sim_u32(sim, (uint32_t)sim->now_us);
+
+    if (len) {
+        memcpy(rx->data, data, len);
+    }
+
+    ++sim->stats.rx;
+}
+
+static void sc_sim_can_txr(sc_sim_t* sim, uint8_t track_id, uint8_t flags)
+{
+    struct sc_msg_can_txr* txr = (struct sc_msg_can_txr*)sc_sim_can_alloc(sim, sizeof(*txr));
+
+    if (!txr) {
+        ++sim->stats.txr_lost;
+        sim->status_flags |= SC_CAN_STATUS_FLAG_TXR_DESYNC;
+        return;
+    }
+
+    txr->id = SC_MSG_CAN_TXR;
+    txr->len = sizeof(*txr);
+    txr->flags = flags;
+    txr->track_id = track_id;
+    txr->timestamp_us = sc_sim_u32(sim, (uint32_t)sim->now_us);
+
+    ++sim->stats.txr;
+}
+
+static void sc_sim_tx_send(sc_sim_t* sim)
+{
+    struct sc_sim_tx const* tx = &sim->tx_fifo[sim->tx_head];
+
+    sc_sim_can_txr(sim, tx->track_id, tx->flags);
+
+    if (sim->config.echo) {
+        sc_sim_can_rx(sim, tx->can_id, tx->flags, tx->dlc, tx->data);
+    }
+
+    sim->tx_head = (uint8_t)((sim->tx_head + 1) % sim->config.tx_fifo_size);
+    --sim->tx_count;
+}
+
+static void sc_sim_can_tx(sc_sim_t* sim, uint8_t const* ptr, uint8_t len)
+{
+    struct sc_msg_can_tx const* msg = (struct sc_msg_can_tx const*)ptr;
+    struct sc_sim_tx* tx = NULL;
+    uint8_t flags = 0;
+    uint8_t data_len = 0;
+    size_t data_offset = 0;
+
+    if (len < sizeof(*msg)) {
+        return;
+    }
+
+    flags = msg->flags;
+    data_len = (flags & SC_CAN_FRAME_FLAG_RTR) ? 0 : dlc_to_len[msg->dlc & 0xf];
+    data_offset =
+        (SC_MSG_CAN_TX4 == msg->id || (flags & SC_CAN_FRAME_FLAG_TX4))
+        ? sizeof(struct sc_msg_can_tx4)
+        : sizeof(struct sc_msg_can_tx);
+
+    if (data_offset + data_len > len) {
+        return;
+    }
+
+    ++sim->stats.tx;
+
+    flags &= SC_CAN_FRAME_FLAG_EXT | SC_CAN_FRAME_FLAG_RTR | SC_CAN_FRAME_FLAG_FDF | SC_CAN_FRAME_FLAG_BRS | SC_CAN_FRAME_FLAG_ESI;
+
+    if (sim->tx_count == sim->config.tx_fifo_size) {
+        ++sim->stats.tx_dropped;
+
+        if (sim->tx_dropped < UINT16_MAX) {
+            ++sim->tx_dropped;
+        }
+
+        sc_sim_can_txr(sim, msg->track_id, flags | SC_CAN_FRAME_FLAG_DRP);
+        return;
+    }
+
+    tx = &sim->tx_fifo[(sim->tx_head + sim->tx_count) % sim->config.tx_fifo_size];
+    tx->can_id = sc_sim_u32(sim, msg->can_id);
+    tx->flags = flags;
+    tx->dlc = msg->dlc & 0xf;
+    tx->track_id = msg->track_id;
+    memcpy(tx->data, ptr + data_offset, data_len);
+
+    if (!sim->tx_count++ && sim->config.tx_rate_hz) {
+        sc_sim_gen_start(&sim->tx_gen, sim->now_us, 1000000, sim->config.tx_rate_hz);
+    }
+
+    if (!sim->config.tx_rate_hz) {
+        sc_sim_tx_send(sim);
+    }
+}
+
+static int sc_sim_can_write(void* ctx, uint8_t const* ptr, size_t bytes)
+{
+    sc_sim_t* sim = (sc_sim_t*)ctx;
+    size_t offset = 0;
+
+    // apply back pressure until the host reads
+    if (sim->can.in_count == sim->can.in_capacity) {
+        return SC_DLL_ERROR_AGAIN;
+    }
+
+    while (offset + SC_MSG_HEADER_LEN <= bytes) {
+        struct sc_msg_header const* hdr = (struct sc_msg_header const*)(ptr + offset);
+
+        if (SC_MSG_EOF == hdr->id || !hdr->len || offset + hdr->len > bytes) {
+            break;
+        }
+
+        switch (hdr->id) {
+        case SC_MSG_CAN_TX:
+        case SC_MSG_CAN_TX4:
+            sc_sim_can_tx(sim, ptr + offset, hdr->len);
+            break;
+        default:
+            break;
+        }
+
+        offset += hdr->len;
+    }
+
+    sc_sim_can_flush(sim);
+
+    return SC_DLL_ERROR_NONE;
+}
+
+static inline size_t sc_sim_cmd_error(uint8_t* rsp, int8_t error)
+{
+    struct sc_msg_error* msg = (struct sc_msg_error*)rsp;
+
+    msg->id = SC_MSG_ERROR;
+    msg->len = sizeof(*msg);
+    msg->unused = 0;
+    msg->error = error;
+
+    return sizeof(*msg);
+}
+
+static int8_t sc_sim_bittiming(sc_sim_t* sim, struct sc_msg_bittiming const* msg)
+{
+    uint16_t const brp = sc_sim_u16(sim, msg->brp);
+    uint16_t const tseg1 = sc_sim_u16(sim, msg->tseg1);
+
+    if (sim->bus_on) {
+        return SC_ERROR_BUSY;
+    }
+
+    if (SC_MSG_NM_BITTIMING == msg->id) {
+        if (brp < SC_SIM_NMBT_BRP_MIN || brp > SC_SIM_NMBT_BRP_MAX ||
+            tseg1 < SC_SIM_NMBT_TSEG1_MIN || tseg1 > SC_SIM_NMBT_TSEG1_MAX ||
+            msg->tseg2 < SC_SIM_NMBT_TSEG2_MIN || msg->tseg2 > SC_SIM_NMBT_TSEG2_MAX ||
+            !msg->sjw || msg->sjw > SC_SIM_NMBT_SJW_MAX) {
+            return SC_ERROR_PARAM;
+        }
+
+        sim->nm_brp = brp;
+        sim->nm_tseg1 = tseg1;
+        sim->nm_tseg2 = msg->tseg2;
+        sim->nm_sjw = msg->sjw;
+    }
+    else {
+        if (!((sim->config.feat_perm | sim->config.feat_conf) & SC_FEATURE_FLAG_FDF)) {
+            return SC_ERROR_UNSUPPORTED;
+        }
+
+        if (brp < SC_SIM_DTBT_BRP_MIN || brp > SC_SIM_DTBT_BRP_MAX ||
+            tseg1 < SC_SIM_DTBT_TSEG1_MIN || tseg1 > SC_SIM_DTBT_TSEG1_MAX ||
+            msg->tseg2 < SC_SIM_DTBT_TSEG2_MIN || msg->tseg2 > SC_SIM_DTBT_TSEG2_MAX ||
+            !msg->sjw || msg->sjw > SC_SIM_DTBT_SJW_MAX) {
+            return SC_ERROR_PARAM;
+        }
+
+        sim->dt_brp = (uint8_t)brp;
+        sim->dt_tseg1 = (uint8_t)tseg1;
+        sim->dt_tseg2 = msg->tseg2;
+        sim->dt_sjw = msg->sjw;
+    }
+
+    return SC_ERROR_NONE;
+}
+
+static int8_t sc_sim_features(sc_sim_t* sim, struct sc_msg_features const* msg)
+{
+    uint32_t const arg = sc_sim_u32(sim, msg->arg);
+
+    if (sim->bus_on) {
+        return SC_ERROR_BUSY;
+    }
+
+    switch (msg->op) {
+    case SC_FEAT_OP_CLEAR:
+        sim->features = sim->config.feat_perm;
+        break;
+    case SC_FEAT_OP_OR:
+        if (arg & ~(uint32_t)(sim->config.feat_perm | sim->config.feat_conf)) {
+            return SC_ERROR_UNSUPPORTED;
+        }
+
+        sim->features |= (uint16_t)arg;
+        break;
+    default:
+        return SC_ERROR_PARAM;
+    }
+
+    return SC_ERROR_NONE;
+}
+
+static void sc_sim_bus(sc_sim_t* sim, int on)
+{
+    if (on == sim->bus_on) {
+        return;
+    }
+
+    sim->bus_on = (uint8_t)on;
+
+    if (on) {
+        if (sim->config.rx_rate_hz) {
+            sc_sim_gen_start(&sim->rx_gen, sim->now_us, 1000000, sim->config.rx_rate_hz);
+        }
+
+        if (sim->config.error_rate_hz) {
+            sc_sim_gen_start(&sim->error_gen, sim->now_us, 1000000, sim->config.error_rate_hz);
+        }
+
+        if (sim->config.status_interval_us) {
+            sc_sim_gen_start(&sim->status_gen, sim->now_us, sim->config.status_interval_us, 1);
+        }
+    }
+    else {
+        // queued frames are discarded when going off bus
+        sim->tx_count = 0;
+    }
+}
+
+/* Handles a single command, returns the size of the reply or 0 if it doesn't fit */
+static size_t sc_sim_cmd(sc_sim_t* sim, uint8_t const* ptr, uint8_t len, uint8_t* rsp, size_t capacity)
+{
+    struct sc_msg_header const* hdr = (struct sc_msg_header const*)ptr;
+
+    if (capacity < sizeof(struct sc_msg_error)) {
+        return 0;
+    }
+
+    ++sim->stats.commands;
+
+    switch (hdr->id) {
+    case SC_MSG_HELLO_DEVICE: {
+        struct sc_msg_hello* msg = (struct sc_msg_hello*)rsp;
+
+        if (capacity < sizeof(*msg)) {
+            return 0;
+        }
+
+        sc_sim_reset(sim);
+
+        memset(msg, 0, sizeof(*msg));
+        msg->id = SC_MSG_HELLO_HOST;
+        msg->len = sizeof(*msg);
+        msg->proto_version = SC_VERSION;
+        msg->byte_order = sim->config.byte_order;
+        // always big endian
+        ((uint8_t*)&msg->cmd_buffer_size)[0] = (uint8_t)(sim->config.cmd_buffer_size >> 8);
+        ((uint8_t*)&msg->cmd_buffer_size)[1] = (uint8_t)(sim->config.cmd_buffer_size & 0xff);
+
+        return sizeof(*msg);
+    }
+    case SC_MSG_DEVICE_INFO: {
+        static const uint8_t sn[] = { 0x51, 0x11, 0x00, 0x01 };
+        static const char name[] = "SuperCAN simulator";
+        struct sc_msg_dev_info* msg = (struct sc_msg_dev_info*)rsp;
+
+        if (capacity < sizeof(*msg)) {
+            return 0;
+        }
+
+        memset(msg, 0, sizeof(*msg));
+        msg->id = SC_MSG_DEVICE_INFO;
+        msg->len = sizeof(*msg);
+        msg->feat_perm = sc_sim_u16(sim, sim->config.feat_perm);
+        msg->feat_conf = sc_sim_u16(sim, sim->config.feat_conf);
+        msg->sn_len = sizeof(sn);
+        memcpy(msg->sn_bytes, sn, sizeof(sn));
+        msg->name_len = sizeof(name) - 1;
+        memcpy(msg->name_bytes, name, sizeof(name) - 1);
+
+        return sizeof(*msg);
+    }
+    case SC_MSG_CAN_INFO: {
+        struct sc_msg_can_info* msg = (struct sc_msg_can_info*)rsp;
+
+        if (capacity < sizeof(*msg)) {
+            return 0;
+        }
+
+        memset(msg, 0, sizeof(*msg));
+        msg->id = SC_MSG_CAN_INFO;
+        msg->len = sizeof(*msg);
+        msg->msg_buffer_size = sc_sim_u16(sim, sim->config.msg_buffer_size);
+        msg->can_clk_hz = sc_sim_u32(sim, sim->config.can_clk_hz);
+        msg->nmbt_brp_min = SC_SIM_NMBT_BRP_MIN;
+        msg->nmbt_brp_max = sc_sim_u16(sim, SC_SIM_NMBT_BRP_MAX);
+        msg->nmbt_tseg1_min = SC_SIM_NMBT_TSEG1_MIN;
+        msg->nmbt_tseg1_max = sc_sim_u16(sim, SC_SIM_NMBT_TSEG1_MAX);
+        msg->nmbt_tseg2_min = SC_SIM_NMBT_TSEG2_MIN;
+        msg->nmbt_tseg2_max = SC_SIM_NMBT_TSEG2_MAX;
+        msg->nmbt_sjw_max = SC_SIM_NMBT_SJW_MAX;
+        msg->dtbt_brp_min = SC_SIM_DTBT_BRP_MIN;
+        msg->dtbt_brp_max = SC_SIM_DTBT_BRP_MAX;
+        msg->dtbt_tseg1_min = SC_SIM_DTBT_TSEG1_MIN;
+        msg->dtbt_tseg1_max = SC_SIM_DTBT_TSEG1_MAX;
+        msg->dtbt_tseg2_min = SC_SIM_DTBT_TSEG2_MIN;
+        msg->dtbt_tseg2_max = SC_SIM_DTBT_TSEG2_MAX;
+        msg->dtbt_sjw_max = SC_SIM_DTBT_SJW_MAX;
+        msg->tx_fifo_size = sim->config.tx_fifo_size;
+        msg->rx_fifo_size = sim->config.rx_fifo_size;
+
+        return sizeof(*msg);
+    }
+    case SC_MSG_NM_BITTIMING:
+    case SC_MSG_DT_BITTIMING:
+        if (len < sizeof(struct sc_msg_bittiming)) {
+            return sc_sim_cmd_error(rsp, SC_ERROR_SHORT);
+        }
+
+        return sc_sim_cmd_error(rsp, sc_sim_bittiming(sim, (struct sc_msg_bittiming const*)ptr));
+    case SC_MSG_FEATURES:
+        if (len < sizeof(struct sc_msg_features)) {
+            return sc_sim_cmd_error(rsp, SC_ERROR_SHORT);
+        }
+
+        return sc_sim_cmd_error(rsp, sc_sim_features(sim, (struct sc_msg_features const*)ptr));
+    case SC_MSG_BUS:
+        if (len < sizeof(struct sc_msg_config)) {
+            return sc_sim_cmd_error(rsp, SC_ERROR_SHORT);
+        }
+
+        sc_sim_bus(sim, 0 != ((struct sc_msg_config const*)ptr)->arg);
+
+        return sc_sim_cmd_error(rsp, SC_ERROR_NONE);
+    default:
+        return sc_sim_cmd_error(rsp, SC_ERROR_UNSUPPORTED);
+    }
+}
+
+static int sc_sim_cmd_write(void* ctx, uint8_t const* ptr, size_t bytes)
+{
+    sc_sim_t* sim = (sc_sim_t*)ctx;
+    size_t offset = 0;
+    size_t size = 0;
+
+    if (sim->cmd.in_count == sim->cmd.in_capacity) {
+        return SC_DLL_ERROR_AGAIN;
+    }
+
+    while (offset + SC_MSG_HEADER_LEN <= bytes) {
+        struct sc_msg_header const* hdr = (struct sc_msg_header const*)(ptr + offset);
+        size_t r = 0;
+
+        if (SC_MSG_EOF == hdr->id || !hdr->len) {
+            break;
+        }
+
+        if (offset + hdr->len > bytes) {
+            // message extends past end of buffer
+            r = sc_sim_cmd_error(sim->cmd_rsp + size, SC_ERROR_SHORT);
+            size += r;
+            break;
+        }
+
+        r = sc_sim_cmd(sim, ptr + offset, hdr->len, sim->cmd_rsp + size, sim->config.cmd_buffer_size - size);
+        if (!r) {
+            break;
+        }
+
+        size += r;
+        offset += hdr->len;
+    }
+
+    if (size) {
+        sc_loopback_push(&sim->cmd, sim->cmd_rsp, size);
+    }
+
+    return SC_DLL_ERROR_NONE;
+}
+
+int sc_sim_init(sc_sim_t* sim, sc_sim_config_t const* config)
+{
+    int error = SC_DLL_ERROR_NONE;
+
+    if (!sim) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+
+    memset(sim, 0, sizeof(*sim));
+
+    if (config) {
+        sim->config = *config;
+    }
+    else {
+        sc_sim_config_init(&sim->config);
+    }
+
+    if (sim->config.cmd_buffer_size < sizeof(struct sc_msg_dev_info) ||
+        sim->config.msg_buffer_size < 64 ||
+        (sim->config.msg_buffer_size & (SC_MSG_CAN_LEN_MULTIPLE - 1)) ||
+        !sim->config.tx_fifo_size ||
+        !sim->config.in_transfers ||
+        !sim->config.request_slots ||
+        sim->config.rx_dlc > 15 ||
+        (sim->config.byte_order != SC_BYTE_ORDER_LE && sim->config.byte_order != SC_BYTE_ORDER_BE)) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+
+    {
+        uint16_t const one = 1;
+        uint8_t const host_le = *(uint8_t const*)&one;
+
+        sim->swap = (SC_BYTE_ORDER_LE == sim->config.byte_order) != host_le;
+    }
+
+    sim->cmd_rsp = (uint8_t*)malloc(sim->config.cmd_buffer_size);
+    sim->can_buf = (uint8_t*)malloc(sim->config.msg_buffer_size);
+    sim->tx_fifo = (struct sc_sim_tx*)calloc(sim->config.tx_fifo_size, sizeof(*sim->tx_fifo));
+
+    if (!sim->cmd_rsp || !sim->can_buf || !sim->tx_fifo) {
+        error = SC_DLL_ERROR_OUT_OF_MEM;
+        goto error_exit;
+    }
+
+    error = sc_loopback_init(&sim->cmd, sim->config.cmd_buffer_size, 1, 1);
+    if (error) {
+        goto error_exit;
+    }
+
+    error = sc_loopback_init(&sim->can, sim->config.msg_buffer_size, sim->config.in_transfers, sim->config.request_slots);
+    if (error) {
+        goto error_exit;
+    }
+
+    sc_loopback_set_write_callback(&sim->cmd, sim, &sc_sim_cmd_write);
+    sc_loopback_set_write_callback(&sim->can, sim, &sc_sim_can_write);
+
+    sc_sim_reset(sim);
+
+success_exit:
+    return error;
+
+error_exit:
+    sc_sim_uninit(sim);
+    goto success_exit;
+}
+
+void sc_sim_uninit(sc_sim_t* sim)
+{
+    if (sim) {
+        sc_loopback_uninit(&sim->cmd);
+        sc_loopback_uninit(&sim->can);
+        free(sim->cmd_rsp);
+        free(sim->can_buf);
+        free(sim->tx_fifo);
+        memset(sim, 0, sizeof(*sim));
+    }
+}
+
+void sc_sim_cmd_transport(sc_sim_t* sim, sc_transport_t* transport)
+{
+    sc_loopback_transport(&sim->cmd, transport);
+}
+
+void sc_sim_can_transport(sc_sim_t* sim, sc_transport_t* transport)
+{
+    sc_loopback_transport(&sim->can, transport);
+}
+
+static void sc_sim_gen_rx(sc_sim_t* sim)
+{
+    uint8_t data[64];
+    uint8_t const dlc = sim->config.rx_dlc;
+    uint8_t flags = 0;
+
+    for (unsigned i = 0; i < dlc_to_len[dlc]; ++i) {
+        data[i] = (uint8_t)(sim->rx_seq + i);
+    }
+
+    if (dlc > 8) {
+        flags = SC_CAN_FRAME_FLAG_FDF | SC_CAN_FRAME_FLAG_BRS;
+    }
+
+    sc_sim_can_rx(sim, sim->rx_seq & 0x7ff, flags, dlc, data);
+    ++sim->rx_seq;
+}
+
+static void sc_sim_gen_error(sc_sim_t* sim)
+{
+    struct sc_msg_can_error* msg = (struct sc_msg_can_error*)sc_sim_can_alloc(sim, sizeof(*msg));
+
+    if (!msg) {
+        return;
+    }
+
+    msg->id = SC_MSG_CAN_ERROR;
+    msg->len = sizeof(*msg);
+    msg->error = (uint8_t)(SC_CAN_ERROR_STUFF + sim->error_seq % SC_CAN_ERROR_CRC);
+    msg->flags = (sim->error_seq & 1) ? SC_CAN_ERROR_FLAG_RXTX_TX : 0;
+    msg->timestamp_us = sc_sim_u32(sim, (uint32_t)sim->now_us);
+
+    ++sim->error_seq;
+    ++sim->stats.errors;
+}
+
+static void sc_sim_gen_status(sc_sim_t* sim)
+{
+    struct sc_msg_can_status* msg = (struct sc_msg_can_status*)sc_sim_can_alloc(sim, sizeof(*msg));
+
+    if (!msg) {
+        return;
+    }
+
+    msg->id = SC_MSG_CAN_STATUS;
+    msg->len = sizeof(*msg);
+    msg->flags = sim->status_flags;
+    msg->bus_status = SC_CAN_STATUS_ERROR_ACTIVE;
+    msg->timestamp_us = sc_sim_u32(sim, (uint32_t)sim->now_us);
+    msg->rx_lost = sc_sim_u16(sim, sim->rx_lost);
+    msg->tx_dropped = sc_sim_u16(sim, sim->tx_dropped);
+    msg->rx_errors = 0;
+    msg->tx_errors = 0;
+    msg->rx_fifo_size = 0;
+    msg->tx_fifo_size = sim->tx_count;
+
+    sim->status_flags = 0;
+    sim->rx_lost = 0;
+    sim->tx_dropped = 0;
+
+    ++sim->stats.status;
+}
+
+void sc_sim_advance(sc_sim_t* sim, uint32_t us)
+{
+    uint64_t const end_us = sim->now_us + us;
+
+    for (;;) {
+        struct sc_sim_gen* next = NULL;
+        uint64_t next_us = end_us + 1;
+
+        if (sim->bus_on) {
+            if (sim->config.rx_rate_hz && sc_sim_gen_due(&sim->rx_gen) < next_us) {
+                next = &sim->rx_gen;
+                next_us = sc_sim_gen_due(next);
+            }
+
+            if (sim->config.error_rate_hz && sc_sim_gen_due(&sim->error_gen) < next_us) {
+                next = &sim->error_gen;
+                next_us = sc_sim_gen_due(next);
+            }
+
+            if (sim->config.status_interval_us && sc_sim_gen_due(&sim->status_gen) < next_us) {
+                next = &sim->status_gen;
+                next_us = sc_sim_gen_due(next);
+            }
+        }
+
+        if (sim->tx_count && sim->config.tx_rate_hz && sc_sim_gen_due(&sim->tx_gen) < next_us) {
+            next = &sim->tx_gen;
+            next_us = sc_sim_gen_due(next);
+        }
+
+        if (!next) {
+            break;
+        }
+
+        sim->now_us = next_us;
+        ++next->count;
+
+        if (next == &sim->rx_gen) {
+            sc_sim_gen_rx(sim);
+        }
+        else if (next == &sim->error_gen) {
+            sc_sim_gen_error(sim);
+        }
+        else if (next == &sim->status_gen) {
+            sc_sim_gen_status(sim);
+        }
+        else {
+            sc_sim_tx_send(sim);
+        }
+    }
+
+    sim->now_us = end_us;
+
+    sc_sim_can_flush(sim);
+}
@@ -0,0 +1,158 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020-2025 Jean Gressmann <jean@0x42.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "supercan_loopback.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Simulated device configuration, see sc_sim_config_init for defaults */
+typedef struct sc_sim_config {
+    uint32_t can_clk_hz;
+    uint32_t rx_rate_hz;            ///< rate of generated CAN frames, 0 to disable
+    uint32_t error_rate_hz;         ///< rate of generated CAN errors, 0 to disable
+    uint32_t status_interval_us;    ///< interval of CAN status messages, 0 to disable
+    uint32_t tx_rate_hz;            ///< rate at which the tx fifo drains, 0 to send immediately
+    uint16_t cmd_buffer_size;
+    uint16_t msg_buffer_size;
+    uint16_t feat_perm;             ///< features permanently enabled
+    uint16_t feat_conf;             ///< features which can be enabled through SC_MSG_FEATURES
+    uint8_t tx_fifo_size;
+    uint8_t rx_fifo_size;
+    uint8_t byte_order;             ///< SC_BYTE_ORDER_LE or SC_BYTE_ORDER_BE
+    uint8_t rx_dlc;                 ///< dlc of generated CAN frames, > 8 generates CAN-FD frames
+    uint8_t echo;                   ///< echo transmitted frames as received frames
+    uint8_t in_transfers;           ///< device to host transfers queued before messages are lost
+    uint8_t request_slots;          ///< request slots per direction of each pipe
+} sc_sim_config_t;
+
+/** Cumulative counters of the simulated device */
+typedef struct sc_sim_stats {
+    uint64_t commands;
+    uint64_t rx;                    ///< CAN frames generated or echoed
+    uint64_t rx_lost;               ///< CAN frames lost due to full device to host queue
+    uint64_t tx;                    ///< CAN frames received from the host
+    uint64_t tx_dropped;            ///< CAN frames dropped due to full tx fifo
+    uint64_t txr;
+    uint64_t txr_lost;              ///< receipts lost due to full device to host queue
+    uint64_t errors;
+    uint64_t status;
+} sc_sim_stats_t;
+
+struct sc_sim_gen {
+    uint64_t start_us;
+    uint64_t count;
+    uint32_t num;                   ///< period is num / den microseconds
+    uint32_t den;
+};
+
+struct sc_sim_tx {
+    uint32_t can_id;
+    uint8_t flags;
+    uint8_t dlc;
+    uint8_t track_id;
+    uint8_t data[64];
+};
+
+/** In-process SuperCAN device
+ *
+ * Implements the device side of the command and CAN pipes on top of
+ * in-memory transports. Time is simulated and only advances through
+ * sc_sim_advance, which makes runs reproducible. Like the loopback
+ * the simulator isn't thread-safe.
+ */
+typedef struct sc_sim {
+    sc_sim_config_t config;
+    sc_sim_stats_t stats;
+    sc_loopback_t cmd;
+    sc_loopback_t can;
+    uint8_t* cmd_rsp;
+    uint8_t* can_buf;               ///< device to host transfer being assembled
+    struct sc_sim_tx* tx_fifo;
+    struct sc_sim_gen rx_gen;
+    struct sc_sim_gen error_gen;
+    struct sc_sim_gen status_gen;
+    struct sc_sim_gen tx_gen;
+    uint64_t now_us;
+    uint32_t rx_seq;
+    uint32_t error_seq;
+    uint16_t can_size;
+    uint16_t features;
+    uint16_t rx_lost;               ///< since last status
+    uint16_t tx_dropped;            ///< since last status
+    uint16_t nm_brp;
+    uint16_t nm_tseg1;
+    uint8_t nm_tseg2;
+    uint8_t nm_sjw;
+    uint8_t dt_brp;
+    uint8_t dt_tseg1;
+    uint8_t dt_tseg2;
+    uint8_t dt_sjw;
+    uint8_t status_flags;
+    uint8_t tx_head;
+    uint8_t tx_count;
+    uint8_t bus_on;
+    uint8_t swap;
+} sc_sim_t;
+
+/** Sets defaults: no generated traffic, TXR always on, echo on */
+void sc_sim_config_init(sc_sim_config_t* config);
+
+/** Initializes the simulated device
+ *
+ * \param sim       device to initialize
+ * \param config    configuration, NULL for defaults
+ *
+ * \returns error code
+ */
+int sc_sim_init(sc_sim_t* sim, sc_sim_config_t const* config);
+
+/** Frees the device's resources
+ *
+ * \param sim  device to uninitialize, can be NULL
+ */
+void sc_sim_uninit(sc_sim_t* sim);
+
+/** Fills in the transport of the command pipe */
+void sc_sim_cmd_transport(sc_sim_t* sim, sc_transport_t* transport);
+
+/** Fills in the transport of the CAN pipe */
+void sc_sim_can_transport(sc_sim_t* sim, sc_transport_t* transport);
+
+/** Advances simulated time
+ *
+ * Generates all messages due until then. Messages are queued
+ * for the host in the order of their timestamps.
+ */
+void sc_sim_advance(sc_sim_t* sim, uint32_t us);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
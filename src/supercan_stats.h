@@ -0,0 +1,129 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Jean Gressmann <jean@0x42.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "supercan_atomic.h"
+
+#if defined(_MSC_VER)
+#   include <intrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SC_STATS_LOG2_BUCKETS 32
+
+/** Histogram with power of two buckets
+ *
+ * Bucket 0 counts zeros, bucket i > 0 counts values in [2^(i-1), 2^i).
+ * The last bucket also counts all larger values.
+ */
+typedef struct sc_stats_log2 {
+    uint64_t buckets[SC_STATS_LOG2_BUCKETS];
+} sc_stats_log2_t;
+
+static inline unsigned sc_stats_log2_bucket(uint32_t value)
+{
+    unsigned bucket = 0;
+
+    if (value) {
+#if defined(_MSC_VER)
+        unsigned long index = 0;
+        _BitScanReverse(&index, value);
+        bucket = (unsigned)index + 1;
+#elif defined(__GNUC__)
+        bucket = 32 - (unsigned)__builtin_clz(value);
+#else
+        for (; value; value >>= 1, ++bucket);
+#endif
+    }
+
+    return bucket < SC_STATS_LOG2_BUCKETS ? bucket : SC_STATS_LOG2_BUCKETS - 1;
+}
+
+/** Adds value to a counter
+ *
+ * Counters have a single writer. Other threads read them with
+ * sc_atomic_load_relaxed64.
+ */
+static inline void sc_stats_add(uint64_t* counter, uint64_t value)
+{
+    sc_atomic_store_relaxed64(counter, sc_atomic_load_relaxed64(counter) + value);
+}
+
+static inline void sc_stats_log2_add(sc_stats_log2_t* h, uint64_t value)
+{
+    sc_stats_add(&h->buckets[sc_stats_log2_bucket(value > UINT32_MAX ? UINT32_MAX : (uint32_t)value)], 1);
+}
+
+/** Copies a histogram another thread adds to */
+static inline void sc_stats_log2_load(sc_stats_log2_t* dst, sc_stats_log2_t const* src)
+{
+    for (unsigned i = 0; i < SC_STATS_LOG2_BUCKETS; ++i) {
+        dst->buckets[i] = sc_atomic_load_relaxed64((uint64_t volatile*)&src->buckets[i]);
+    }
+}
+
+/** Clears a histogram, writer only */
+static inline void sc_stats_log2_clear(sc_stats_log2_t* h)
+{
+    for (unsigned i = 0; i < SC_STATS_LOG2_BUCKETS; ++i) {
+        sc_atomic_store_relaxed64(&h->buckets[i], 0);
+    }
+}
+
+/** Lower bound of values counted in bucket */
+static inline uint64_t sc_stats_log2_bucket_min(unsigned bucket)
+{
+    return bucket ? UINT64_C(1) << (bucket - 1) : 0;
+}
+
+/** Number of values in the histogram */
+static inline uint64_t sc_stats_log2_count(sc_stats_log2_t const* h)
+{
+    uint64_t count = 0;
+
+    for (unsigned i = 0; i < SC_STATS_LOG2_BUCKETS; ++i) {
+        count += h->buckets[i];
+    }
+
+    return count;
+}
+
+/** Subtracts base from h, bucket by bucket */
+static inline void sc_stats_log2_sub(sc_stats_log2_t* h, sc_stats_log2_t const* base)
+{
+    for (unsigned i = 0; i < SC_STATS_LOG2_BUCKETS; ++i) {
+        h->buckets[i] -= base->buckets[i];
+    }
+}
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,831 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020-2025 Jean Gressmann <jean@0x42.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "supercan_atomic.h"
+#include "supercan_proto.h"
+#include "supercan_error.h"
+#include "supercan_stream.h"
+
+
+static int sc_stream_core_rx_process_batch(
+    sc_stream_core_t* core,
+    uint8_t const* ptr,
+    uint16_t bytes)
+{
+    size_t offset = 0;
+    int error = SC_DLL_ERROR_NONE;
+
+    while (offset < bytes) {
+        size_t count = 0;
+
+        error = sc_rx_decode(
+            &core->rx_decoder,
+            ptr,
+            bytes,
+            &offset,
+            core->rx_frames,
+            core->rx_frame_count,
+            &count);
+
+        if (count) {
+            int user_error = SC_DLL_ERROR_NONE;
+
+            core->rx_messages += (uint32_t)count;
+            user_error = core->rx_batch_callback(core->ctx, core->rx_frames, count);
+            if (user_error) {
+                return user_error;
+            }
+        }
+
+        if (error || !count) {
+            break;
+        }
+    }
+
+    return error;
+}
+
+int sc_stream_core_rx_process(
+    sc_stream_core_t* core,
+    uint8_t const* ptr,
+    uint16_t bytes)
+{
+    uint8_t const* const in_beg = ptr;
+    uint8_t const* const in_end = in_beg + bytes;
+    uint8_t const* in_ptr = in_beg;
+    sc_rx_reassembly_t* const r = &core->rx_decoder.reassembly;
+    int error = SC_DLL_ERROR_NONE;
+
+    if (core->rx_batch_callback) {
+        return sc_stream_core_rx_process_batch(core, ptr, bytes);
+    }
+
+    if (r->size) {
+        uint8_t const* msg = NULL;
+
+        error = sc_rx_reassembly_complete(r, &in_ptr, in_end, &msg);
+        if (error) {
+            return error;
+        }
+
+        if (msg) {
+            ++core->rx_messages;
+            error = core->rx_callback(core->ctx, msg, msg[1]);
+            if (error) {
+                return error;
+            }
+        }
+    }
+
+    while (in_ptr + SC_MSG_CAN_LEN_MULTIPLE <= in_end) {
+        struct sc_msg_header const* msg = (struct sc_msg_header const*)in_ptr;
+
+        if (!msg->id || !msg->len) {
+            // Allow end-of-input message to work around need to send ZLP
+            return SC_DLL_ERROR_NONE;
+        }
+
+        if (msg->len < SC_MSG_CAN_LEN_MULTIPLE) {
+            return SC_DLL_ERROR_PROTO_VIOLATION;
+        }
+
+        if (in_ptr + msg->len > in_end) {
+            break;
+        }
+
+        ++core->rx_messages;
+        error = core->rx_callback(core->ctx, msg, msg->len);
+        if (error) {
+            return error;
+        }
+
+        in_ptr += msg->len;
+    }
+
+    return sc_rx_reassembly_carry(r, in_ptr, in_end);
+}
+
+int sc_stream_core_init(
+    sc_stream_core_t* core,
+    sc_transport_t const* transport,
+    size_t buffer_size,
+    uint16_t epp_size,
+    uint8_t rx_count,
+    int swap)
+{
+    if (!core) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+
+    memset(core, 0, sizeof(*core));
+
+    if (!transport ||
+        !transport->submit_read ||
+        !transport->submit_write ||
+        !transport->reap ||
+        !transport->cancel ||
+        !buffer_size ||
+        buffer_size > UINT16_MAX ||
+        (buffer_size & (SC_MSG_CAN_LEN_MULTIPLE - 1)) ||
+        !epp_size ||
+        !rx_count) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+
+    core->transport = *transport;
+    core->buffer_size = buffer_size;
+    core->epp_size = epp_size;
+    core->rx_count = rx_count;
+    core->tx_capacity = (uint16_t)buffer_size;
+    core->tx_count = SC_STREAM_TX_BUFFERS;
+    core->stats.rx_pending_min = UINT32_MAX;
+
+    sc_rx_decoder_init(&core->rx_decoder, swap);
+
+    core->rx_buffers = (uint8_t*)calloc(rx_count, buffer_size);
+    if (!core->rx_buffers) {
+        goto error_out_of_mem;
+    }
+
+    core->tx_buffers = (uint8_t*)calloc(core->tx_count, buffer_size);
+    if (!core->tx_buffers) {
+        goto error_out_of_mem;
+    }
+
+    return SC_DLL_ERROR_NONE;
+
+error_out_of_mem:
+    sc_stream_core_uninit(core);
+    return SC_DLL_ERROR_OUT_OF_MEM;
+}
+
+void sc_stream_core_uninit(sc_stream_core_t* core)
+{
+    if (core) {
+        for (unsigned i = 0; i < core->rx_submitted; ++i) {
+            core->transport.cancel(core->transport.ctx, SC_TRANSPORT_DIR_IN, i);
+        }
+
+        for (unsigned i = 0; i < core->tx_inflight; ++i) {
+            core->transport.cancel(core->transport.ctx, SC_TRANSPORT_DIR_OUT, (core->tx_head + i) % core->tx_count);
+        }
+
+        free(core->rx_frames);
+        free(core->rx_buffers);
+        free(core->tx_buffers);
+
+        memset(core, 0, sizeof(*core));
+    }
+}
+
+int sc_stream_core_set_tx_count(sc_stream_core_t* core, unsigned count)
+{
+    uint8_t* buffers = NULL;
+
+    if (!count) {
+        count = SC_STREAM_TX_BUFFERS;
+    }
+
+    if (count < 2 || count > SC_STREAM_TX_MAX_BUFFERS) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+
+    if (core->tx_inflight || core->tx_size) {
+        return SC_DLL_ERROR_INVALID_OPERATION;
+    }
+
+    buffers = (uint8_t*)calloc(count, core->buffer_size);
+    if (!buffers) {
+        return SC_DLL_ERROR_OUT_OF_MEM;
+    }
+
+    free(core->tx_buffers);
+
+    core->tx_buffers = buffers;
+    core->tx_count = (uint8_t)count;
+    core->tx_head = 0;
+    core->tx_index = 0;
+
+    return SC_DLL_ERROR_NONE;
+}
+
+void sc_stream_core_set_rx_callback(
+    sc_stream_core_t* core,
+    void* ctx,
+    sc_can_stream_rx_callback callback)
+{
+    core->ctx = ctx;
+    core->rx_callback = callback;
+}
+
+int sc_stream_core_set_rx_batch_callback(
+    sc_stream_core_t* core,
+    void* ctx,
+    sc_can_stream_rx_batch_callback callback,
+    size_t frame_count)
+{
+    sc_can_frame_t* frames = NULL;
+
+    // one more for a message reassembled at the start of the transfer
+    if (!frame_count || frame_count > SC_CAN_FRAME_COUNT(core->buffer_size) + 1) {
+        frame_count = SC_CAN_FRAME_COUNT(core->buffer_size) + 1;
+    }
+
+    frames = (sc_can_frame_t*)calloc(frame_count, sizeof(*frames));
+    if (!frames) {
+        return SC_DLL_ERROR_OUT_OF_MEM;
+    }
+
+    free(core->rx_frames);
+
+    core->ctx = ctx;
+    core->rx_batch_callback = callback;
+    core->rx_frames = frames;
+    core->rx_frame_count = frame_count;
+
+    return SC_DLL_ERROR_NONE;
+}
+
+void sc_stream_core_set_rx_reassembly(sc_stream_core_t* core, int enable)
+{
+    sc_rx_decoder_set_reassembly(&core->rx_decoder, enable);
+}
+
+int sc_stream_core_start(sc_stream_core_t* core)
+{
+    if (!core->rx_callback && !core->rx_batch_callback) {
+        return SC_DLL_ERROR_INVALID_OPERATION;
+    }
+
+    for (; core->rx_submitted < core->rx_count; ++core->rx_submitted) {
+        unsigned const slot = core->rx_submitted;
+        int error = core->transport.submit_read(
+            core->transport.ctx,
+            slot,
+            core->rx_buffers + slot * core->buffer_size,
+            core->buffer_size);
+
+        if (error) {
+            core->error = error;
+            return error;
+        }
+    }
+
+    return SC_DLL_ERROR_NONE;
+}
+
+static inline uint64_t sc_stream_core_clock(sc_stream_core_t const* core)
+{
+    return core->clock ? core->clock(core->clock_ctx) : 0;
+}
+
+/* Carries out a requested reset of the receive counters, receive path only */
+static void sc_stream_core_rx_stats_sync(sc_stream_core_t* core)
+{
+    uint32_t const epoch = sc_atomic_load_acquire32(&core->stats_epoch);
+    sc_stream_stats_t* const s = &core->stats;
+
+    if (epoch == core->rx_stats_epoch) {
+        return;
+    }
+
+    sc_atomic_store_relaxed64(&s->rx_transfers, 0);
+    sc_atomic_store_relaxed64(&s->rx_bytes, 0);
+    sc_atomic_store_relaxed64(&s->rx_messages, 0);
+    sc_atomic_store_relaxed64(&s->rx_callback_us, 0);
+    sc_atomic_store_release32(&s->rx_pending_min, UINT32_MAX);
+    sc_stats_log2_clear(&s->rx_transfer_bytes);
+    sc_stats_log2_clear(&s->rx_transfer_messages);
+    sc_stats_log2_clear(&s->rx_transfer_callback_us);
+
+    // publishes the cleared counters
+    sc_atomic_store_release32(&core->rx_stats_epoch, epoch);
+}
+
+/* Carries out a requested reset of the transmit counters, transmit path only */
+static void sc_stream_core_tx_stats_sync(sc_stream_core_t* core)
+{
+    uint32_t const epoch = sc_atomic_load_acquire32(&core->stats_epoch);
+    sc_stream_stats_t* const s = &core->stats;
+
+    if (epoch == core->tx_stats_epoch) {
+        return;
+    }
+
+    sc_atomic_store_relaxed64(&s->tx_transfers, 0);
+    sc_atomic_store_relaxed64(&s->tx_bytes, 0);
+    sc_atomic_store_relaxed64(&s->tx_messages, 0);
+    sc_atomic_store_relaxed64(&s->tx_waits, 0);
+    sc_atomic_store_relaxed64(&s->tx_wait_us, 0);
+    sc_stats_log2_clear(&s->tx_transfer_bytes);
+    sc_stats_log2_clear(&s->tx_transfer_messages);
+    sc_stats_log2_clear(&s->tx_wait_us_hist);
+
+    sc_atomic_store_release32(&core->tx_stats_epoch, epoch);
+}
+
+/* Updates the low-water mark of read requests in flight after slot has completed */
+static void sc_stream_core_rx_track_pending(sc_stream_core_t* core, unsigned slot)
+{
+    uint32_t pending = core->rx_submitted - 1;
+
+    if (!core->transport.pending) {
+        return;
+    }
+
+    // requests complete in order, stop at the first one still in flight
+    for (unsigned i = 1; i < core->rx_submitted; ++i) {
+        if (core->transport.pending(core->transport.ctx, SC_TRANSPORT_DIR_IN, (slot + i) % core->rx_count)) {
+            break;
+        }
+
+        --pending;
+    }
+
+    if (pending < core->stats.rx_pending_min) {
+        sc_atomic_store_release32(&core->stats.rx_pending_min, pending);
+    }
+}
+
+int sc_stream_core_rx(sc_stream_core_t* core, uint32_t timeout_ms)
+{
+    int error = SC_DLL_ERROR_NONE;
+    int user_error = SC_DLL_ERROR_NONE;
+    size_t transferred = 0;
+    unsigned const slot = core->rx_next;
+    uint8_t* const ptr = core->rx_buffers + slot * core->buffer_size;
+
+    if (core->error) {
+        return core->error;
+    }
+
+    error = core->transport.reap(core->transport.ctx, SC_TRANSPORT_DIR_IN, slot, &transferred, timeout_ms);
+    if (error) {
+        if (SC_DLL_ERROR_TIMEOUT != error) {
+            core->error = error;
+        }
+
+        return error;
+    }
+
+    sc_stream_core_rx_stats_sync(core);
+    sc_stream_core_rx_track_pending(core, slot);
+
+    if (transferred) {
+        uint64_t const start = sc_stream_core_clock(core);
+
+        core->rx_messages = 0;
+        user_error = sc_stream_core_rx_process(core, ptr, (uint16_t)transferred);
+
+        if (core->clock) {
+            uint64_t const elapsed = sc_stream_core_clock(core) - start;
+
+            sc_stats_add(&core->stats.rx_callback_us, elapsed);
+            sc_stats_log2_add(&core->stats.rx_transfer_callback_us, elapsed);
+        }
+
+        sc_stats_add(&core->stats.rx_messages, core->rx_messages);
+        sc_stats_log2_add(&core->stats.rx_transfer_messages, core->rx_messages);
+    }
+
+    sc_stats_add(&core->stats.rx_transfers, 1);
+    sc_stats_add(&core->stats.rx_bytes, transferred);
+    sc_stats_log2_add(&core->stats.rx_transfer_bytes, transferred);
+
+    /* Keep stream processing, return user error later on. */
+    error = core->transport.submit_read(core->transport.ctx, slot, ptr, core->buffer_size);
+    if (error) {
+        core->error = error;
+        return error;
+    }
+
+    core->rx_next = (uint8_t)((slot + 1) % core->rx_count);
+
+    return user_error;
+}
+
+/* Reaps the oldest write request in flight */
+static int sc_stream_core_tx_reap(sc_stream_core_t* core, uint32_t timeout_ms)
+{
+    size_t transferred = 0;
+    int error = core->transport.reap(
+        core->transport.ctx,
+        SC_TRANSPORT_DIR_OUT,
+        core->tx_head,
+        &transferred,
+        timeout_ms);
+
+    if (error) {
+        return error;
+    }
+
+    core->tx_head = (uint8_t)((core->tx_head + 1) % core->tx_count);
+    --core->tx_inflight;
+
+    return SC_DLL_ERROR_NONE;
+}
+
+static int sc_stream_core_tx_send_buffer(sc_stream_core_t* core, uint32_t timeout_ms)
+{
+    int error = SC_DLL_ERROR_NONE;
+    unsigned const index = core->tx_index;
+
+    sc_stream_core_tx_stats_sync(core);
+
+    // keep a buffer to assemble the next batch in
+    if (core->tx_inflight + 1 == core->tx_count) {
+        uint64_t const start = timeout_ms ? sc_stream_core_clock(core) : 0;
+
+        error = sc_stream_core_tx_reap(core, timeout_ms);
+
+        if (timeout_ms) {
+            sc_stats_add(&core->stats.tx_waits, 1);
+
+            if (core->clock) {
+                uint64_t const elapsed = sc_stream_core_clock(core) - start;
+
+                sc_stats_add(&core->stats.tx_wait_us, elapsed);
+                sc_stats_log2_add(&core->stats.tx_wait_us_hist, elapsed);
+            }
+        }
+
+        if (error) {
+            if (SC_DLL_ERROR_TIMEOUT == error && !timeout_ms) {
+                return SC_DLL_ERROR_AGAIN;
+            }
+
+            goto exit_error;
+        }
+    }
+
+    error = core->transport.submit_write(
+        core->transport.ctx,
+        index,
+        core->tx_buffers + index * core->buffer_size,
+        core->tx_size);
+    if (error) {
+        goto exit_error;
+    }
+
+    ++core->tx_inflight;
+
+    core->tx_index = (uint8_t)((index + 1) % core->tx_count);
+
+exit:
+    return error;
+
+exit_error:
+    core->error = error;
+    goto exit;
+}
+
+int sc_stream_core_tx_batch_begin(sc_stream_core_t* core)
+{
+    if (core->tx_size && !core->tx_auto_flush) {
+        return SC_DLL_ERROR_INVALID_OPERATION;
+    }
+
+    return SC_DLL_ERROR_NONE;
+}
+
+static int sc_stream_core_tx_send(sc_stream_core_t* core, uint32_t timeout_ms, uint64_t* counter);
+
+static inline uint64_t sc_stream_core_now(sc_stream_core_t const* core)
+{
+    return core->tx_flush.clock(core->tx_flush.clock_ctx);
+}
+
+static inline void sc_stream_core_tx_added(sc_stream_core_t* core, size_t count)
+{
+    if (!core->tx_messages && core->tx_flush.latency_us) {
+        core->tx_batch_us = sc_stream_core_now(core);
+    }
+
+    core->tx_messages += (uint32_t)count;
+}
+
+/* Sends the current batch if the byte threshold or latency budget has been reached */
+static int sc_stream_core_tx_auto_flush(sc_stream_core_t* core)
+{
+    if (core->tx_flush.bytes && core->tx_size >= core->tx_flush.bytes) {
+        return sc_stream_core_tx_send(core, SC_STREAM_TX_TIMEOUT_MS, &core->tx_flush_stats.bytes);
+    }
+
+    if (core->tx_flush.latency_us &&
+        core->tx_size &&
+        sc_stream_core_now(core) - core->tx_batch_us >= core->tx_flush.latency_us) {
+        return sc_stream_core_tx_send(core, SC_STREAM_TX_TIMEOUT_MS, &core->tx_flush_stats.latency);
+    }
+
+    return SC_DLL_ERROR_NONE;
+}
+
+int sc_stream_core_tx_batch_add(
+    sc_stream_core_t* core,
+    uint8_t const** buffers,
+    uint16_t const* sizes,
+    size_t count,
+    size_t* added)
+{
+    size_t total = 0;
+
+    *added = 0;
+
+    for (;;) {
+        uint8_t* const tx_buffer = core->tx_buffers + core->tx_index * core->buffer_size;
+        size_t buffers_to_add = 0;
+        size_t bytes = core->tx_size;
+        int error = SC_DLL_ERROR_NONE;
+
+        for (; total + buffers_to_add < count; ++buffers_to_add) {
+            size_t new_bytes = bytes + sizes[total + buffers_to_add];
+            if (new_bytes > core->tx_capacity) {
+                break;
+            }
+
+            if (core->tx_auto_flush && core->tx_flush.bytes && bytes >= core->tx_flush.bytes) {
+                break;
+            }
+
+            bytes = new_bytes;
+        }
+
+        if (buffers_to_add) {
+            sc_stream_core_tx_added(core, buffers_to_add);
+        }
+
+        for (size_t i = total; i < total + buffers_to_add; ++i) {
+            memcpy(tx_buffer + core->tx_size, buffers[i], sizes[i]);
+            core->tx_size += sizes[i];
+        }
+
+        total += buffers_to_add;
+        *added = total;
+
+        if (!core->tx_auto_flush) {
+            break;
+        }
+
+        if (total == count || !core->tx_size) {
+            // all done or message exceeds capacity
+            return sc_stream_core_tx_auto_flush(core);
+        }
+
+        error = sc_stream_core_tx_send(
+            core,
+            SC_STREAM_TX_TIMEOUT_MS,
+            core->tx_flush.bytes && core->tx_size >= core->tx_flush.bytes
+                ? &core->tx_flush_stats.bytes
+                : &core->tx_flush_stats.capacity);
+        if (error) {
+            return error;
+        }
+    }
+
+    return SC_DLL_ERROR_NONE;
+}
+
+int sc_stream_core_tx_reserve(sc_stream_core_t* core, uint16_t bytes, uint8_t** ptr)
+{
+    if (!bytes || bytes > core->tx_capacity) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+
+    if (core->tx_size + bytes > core->tx_capacity) {
+        int error = SC_DLL_ERROR_NONE;
+
+        if (!core->tx_auto_flush) {
+            return SC_DLL_ERROR_BUFFER_TOO_SMALL;
+        }
+
+        error = sc_stream_core_tx_send(core, SC_STREAM_TX_TIMEOUT_MS, &core->tx_flush_stats.capacity);
+        if (error) {
+            return error;
+        }
+    }
+
+    core->tx_reserved = bytes;
+    *ptr = core->tx_buffers + core->tx_index * core->buffer_size + core->tx_size;
+
+    return SC_DLL_ERROR_NONE;
+}
+
+int sc_stream_core_tx_commit(sc_stream_core_t* core, uint16_t bytes)
+{
+    if (bytes > core->tx_reserved) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+
+    core->tx_size += bytes;
+    core->tx_reserved = 0;
+
+    if (!bytes) {
+        return SC_DLL_ERROR_NONE;
+    }
+
+    sc_stream_core_tx_added(core, 1);
+
+    if (core->tx_auto_flush) {
+        return sc_stream_core_tx_auto_flush(core);
+    }
+
+    return SC_DLL_ERROR_NONE;
+}
+
+static int sc_stream_core_tx_send(sc_stream_core_t* core, uint32_t timeout_ms, uint64_t* counter)
+{
+    if (core->error) {
+        return core->error;
+    }
+
+    if (core->tx_size) {
+        int error = SC_DLL_ERROR_NONE;
+        uint8_t* const tx_buffer = core->tx_buffers + core->tx_index * core->buffer_size;
+        uint16_t eof = 0;
+
+        if (core->tx_size & (SC_MSG_CAN_LEN_MULTIPLE - 1)) {
+            return SC_DLL_ERROR_PROTO_VIOLATION;
+        }
+
+        // Check if we need to work around having to send a ZLP
+        if (core->epp_size < core->buffer_size &&
+            core->tx_size < core->buffer_size &&
+            (core->tx_size % core->epp_size) == 0) {
+            eof = SC_MSG_CAN_LEN_MULTIPLE;
+            memset(tx_buffer + core->tx_size, 0, eof);
+            core->tx_size += eof;
+        }
+
+        error = sc_stream_core_tx_send_buffer(core, timeout_ms);
+        if (error) {
+            // batch is kept, frames added later must not end up behind the EOF marker
+            core->tx_size -= eof;
+            return error;
+        }
+
+        sc_stats_add(&core->stats.tx_transfers, 1);
+        sc_stats_add(&core->stats.tx_bytes, core->tx_size);
+        sc_stats_add(&core->stats.tx_messages, core->tx_messages);
+        sc_stats_log2_add(&core->stats.tx_transfer_bytes, core->tx_size);
+        sc_stats_log2_add(&core->stats.tx_transfer_messages, core->tx_messages);
+
+        core->tx_size = 0;
+        core->tx_flush_stats.messages += core->tx_messages;
+        core->tx_messages = 0;
+        ++*counter;
+    }
+
+    core->tx_reserved = 0;
+
+    return SC_DLL_ERROR_NONE;
+}
+
+int sc_stream_core_tx_batch_end(sc_stream_core_t* core)
+{
+    return sc_stream_core_tx_send(core, SC_STREAM_TX_TIMEOUT_MS, &core->tx_flush_stats.manual);
+}
+
+int sc_stream_core_tx_batch_submit(sc_stream_core_t* core)
+{
+    return sc_stream_core_tx_send(core, 0, &core->tx_flush_stats.manual);
+}
+
+int sc_stream_core_set_tx_auto_flush(sc_stream_core_t* core, sc_stream_tx_flush_t const* policy)
+{
+    if (!policy) {
+        core->tx_auto_flush = 0;
+        memset(&core->tx_flush, 0, sizeof(core->tx_flush));
+        return SC_DLL_ERROR_NONE;
+    }
+
+    if (policy->latency_us && !policy->clock) {
+        return SC_DLL_ERROR_INVALID_PARAM;
+    }
+
+    core->tx_flush = *policy;
+    core->tx_auto_flush = 1;
+
+    if (core->tx_messages && core->tx_flush.latency_us) {
+        // start latency budget of open batch now
+        core->tx_batch_us = sc_stream_core_now(core);
+    }
+
+    return SC_DLL_ERROR_NONE;
+}
+
+int sc_stream_core_tx_flush_if_due(sc_stream_core_t* core, uint32_t* wait_us)
+{
+    uint64_t elapsed = 0;
+
+    *wait_us = UINT32_MAX;
+
+    if (!core->tx_size || !core->tx_flush.latency_us) {
+        return SC_DLL_ERROR_NONE;
+    }
+
+    elapsed = sc_stream_core_now(core) - core->tx_batch_us;
+    if (elapsed < core->tx_flush.latency_us) {
+        *wait_us = (uint32_t)(core->tx_flush.latency_us - elapsed);
+        return SC_DLL_ERROR_NONE;
+    }
+
+    return sc_stream_core_tx_send(core, SC_STREAM_TX_TIMEOUT_MS, &core->tx_flush_stats.latency);
+}
+
+int sc_stream_core_tx_poll(sc_stream_core_t* core, uint32_t timeout_ms)
+{
+    int error = SC_DLL_ERROR_NONE;
+
+    if (core->error) {
+        return core->error;
+    }
+
+    if (!core->tx_inflight) {
+        return SC_DLL_ERROR_NONE;
+    }
+
+    error = sc_stream_core_tx_reap(core, timeout_ms);
+
+    // reap whatever else has completed
+    while (!error && core->tx_inflight) {
+        error = sc_stream_core_tx_reap(core, 0);
+        if (SC_DLL_ERROR_TIMEOUT == error) {
+            return SC_DLL_ERROR_NONE;
+        }
+    }
+
+    if (error && SC_DLL_ERROR_TIMEOUT != error) {
+        core->error = error;
+    }
+
+    return error;
+}
+
+void sc_stream_core_set_clock(sc_stream_core_t* core, sc_stream_clock_us clock, void* ctx)
+{
+    core->clock = clock;
+    core->clock_ctx = ctx;
+}
+
+void sc_stream_core_stats(sc_stream_core_t* core, sc_stream_stats_t* stats, int reset)
+{
+    if (stats) {
+        uint32_t const epoch = sc_atomic_load_acquire32(&core->stats_epoch);
+        sc_stream_stats_t* const s = &core->stats;
+
+        memset(stats, 0, sizeof(*stats));
+        stats->rx_pending_min = UINT32_MAX;
+
+        // counters of a path that has yet to carry out a reset read as zero
+        if (epoch == sc_atomic_load_acquire32(&core->rx_stats_epoch)) {
+            stats->rx_transfers = sc_atomic_load_relaxed64(&s->rx_transfers);
+            stats->rx_bytes = sc_atomic_load_relaxed64(&s->rx_bytes);
+            stats->rx_messages = sc_atomic_load_relaxed64(&s->rx_messages);
+            stats->rx_callback_us = sc_atomic_load_relaxed64(&s->rx_callback_us);
+            stats->rx_pending_min = sc_atomic_load_acquire32(&s->rx_pending_min);
+            sc_stats_log2_load(&stats->rx_transfer_bytes, &s->rx_transfer_bytes);
+            sc_stats_log2_load(&stats->rx_transfer_messages, &s->rx_transfer_messages);
+            sc_stats_log2_load(&stats->rx_transfer_callback_us, &s->rx_transfer_callback_us);
+        }
+
+        if (epoch == sc_atomic_load_acquire32(&core->tx_stats_epoch)) {
+            stats->tx_transfers = sc_atomic_load_relaxed64(&s->tx_transfers);
+            stats->tx_bytes = sc_atomic_load_relaxed64(&s->tx_bytes);
+            stats->tx_messages = sc_atomic_load_relaxed64(&s->tx_messages);
+            stats->tx_waits = sc_atomic_load_relaxed64(&s->tx_waits);
+            stats->tx_wait_us = sc_atomic_load_relaxed64(&s->tx_wait_us);
+            sc_stats_log2_load(&stats->tx_transfer_bytes, &s->tx_transfer_bytes);
+            sc_stats_log2_load(&stats->tx_transfer_messages, &s->tx_transfer_messages);
+            sc_stats_log2_load(&stats->tx_wait_us_hist, &s->tx_wait_us_hist);
+        }
+    }
+
+    if (reset) {
+        sc_atomic_inc32(&core->stats_epoch);
+    }
+}
@@ -0,0 +1,339 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020-2025 Jean Gressmann <jean@0x42.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "supercan_rx.h"
+#include "supercan_stats.h"
+#include "supercan_transport.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Receive callback prototype
+ *
+ * Invoked once per message with the message in device byte order.
+ *
+ * \returns error code, a non-zero value stops processing of the current transfer
+ */
+typedef int (*sc_can_stream_rx_callback)(void* ctx, void const* ptr, uint16_t bytes);
+
+/** Batch receive callback prototype
+ *
+ * Frames are decoded into host byte order and timestamps are extended to 64 bit.
+ *
+ * NOTE: frame data pointers point into the transfer buffer and are
+ * only valid for the duration of the callback.
+ *
+ * \param ctx       context passed to sc_can_stream_init_batch
+ * \param frames    decoded frames
+ * \param count     number of frames, at least 1
+ *
+ * \returns error code, a non-zero value stops processing of the current transfer
+ */
+typedef int (*sc_can_stream_rx_batch_callback)(void* ctx, sc_can_frame_t const* frames, size_t count);
+
+#define SC_STREAM_TX_BUFFERS        2   ///< default number of transmit buffers
+#define SC_STREAM_TX_MAX_BUFFERS    64
+#define SC_STREAM_TX_TIMEOUT_MS     5000
+
+/** Monotonic clock in microseconds */
+typedef uint64_t (*sc_stream_clock_us)(void* ctx);
+
+/** Automatic transmit flush policy
+ *
+ * A batch is sent when it no longer fits the next message, when
+ * it reaches the byte threshold, or when its oldest message
+ * exceeds the latency budget.
+ */
+typedef struct sc_stream_tx_flush {
+    sc_stream_clock_us clock;   ///< required for latency budget
+    void* clock_ctx;
+    uint32_t latency_us;        ///< latency budget, 0 to disable
+    uint16_t bytes;             ///< byte threshold, 0 to disable
+} sc_stream_tx_flush_t;
+
+/** Transmit flush counters */
+typedef struct sc_stream_tx_flush_stats {
+    uint64_t manual;            ///< batches sent by the caller
+    uint64_t capacity;          ///< batches sent because the buffer was full
+    uint64_t bytes;             ///< batches sent because of the byte threshold
+    uint64_t latency;           ///< batches sent because of the latency budget
+    uint64_t messages;          ///< messages sent
+} sc_stream_tx_flush_stats_t;
+
+/** Stream counters
+ *
+ * Receive counters are updated by the thread calling sc_stream_core_rx,
+ * transmit counters by the thread sending batches. Timing counters
+ * require a clock, see sc_stream_core_set_clock.
+ *
+ * In the engine each counter has a single writer and is accessed
+ * with relaxed atomics, see sc_stream_core_stats.
+ */
+typedef struct sc_stream_stats {
+    uint64_t rx_transfers;          ///< read requests completed
+    uint64_t rx_bytes;              ///< bytes received
+    uint64_t rx_messages;           ///< messages passed to the receive callback
+    uint64_t rx_callback_us;        ///< time spent processing transfers, including receive callbacks
+    uint64_t tx_transfers;          ///< batches sent
+    uint64_t tx_bytes;              ///< bytes sent
+    uint64_t tx_messages;           ///< messages sent
+    uint64_t tx_waits;              ///< number of times a batch had to wait for a free transmit buffer
+    uint64_t tx_wait_us;            ///< time spent waiting for a free transmit buffer
+    uint32_t rx_pending_min;        ///< low-water mark of read requests in flight, UINT32_MAX if unknown
+    sc_stats_log2_t rx_transfer_bytes;      ///< bytes per read request
+    sc_stats_log2_t rx_transfer_messages;   ///< messages per read request
+    sc_stats_log2_t rx_transfer_callback_us;///< processing time per read request
+    sc_stats_log2_t tx_transfer_bytes;      ///< bytes per batch
+    sc_stats_log2_t tx_transfer_messages;   ///< messages per batch
+    sc_stats_log2_t tx_wait_us_hist;        ///< time per wait for a free transmit buffer
+} sc_stream_stats_t;
+
+/** Transport neutral CAN stream engine
+ *
+ * Owns the transfer buffers, processes received transfers, and batches
+ * transmit messages. All I/O goes through the transport.
+ *
+ * The engine isn't thread-safe. Receive and transmit functions may
+ * be called from different threads.
+ */
+typedef struct sc_stream_core {
+    sc_transport_t transport;
+    void* ctx;
+    sc_can_stream_rx_callback rx_callback;
+    sc_can_stream_rx_batch_callback rx_batch_callback;
+    sc_can_frame_t* rx_frames;
+    size_t rx_frame_count;
+    sc_rx_decoder_t rx_decoder;
+    uint8_t* rx_buffers;
+    uint8_t* tx_buffers;
+    size_t buffer_size;
+    int error;                  ///< sticky transport error
+    uint16_t epp_size;          ///< endpoint packet size, used for ZLP avoidance
+    uint16_t tx_capacity;       ///< capacity of transmit buffer
+    uint16_t tx_size;           ///< bytes in current transmit buffer
+    uint16_t tx_reserved;       ///< bytes reserved by sc_stream_core_tx_reserve
+    uint8_t rx_count;           ///< number of read requests
+    uint8_t rx_next;            ///< slot of next read request to complete
+    uint8_t rx_submitted;       ///< number of read requests submitted
+    uint8_t tx_count;           ///< number of transmit buffers
+    uint8_t tx_head;            ///< slot of oldest write request in flight
+    uint8_t tx_inflight;        ///< number of write requests in flight
+    uint8_t tx_index;           ///< slot of current transmit buffer
+    uint8_t tx_auto_flush;      ///< non-zero if tx_flush is active
+    uint32_t tx_messages;       ///< messages in current batch
+    uint64_t tx_batch_us;       ///< time the first message was added to the current batch
+    sc_stream_tx_flush_t tx_flush;
+    sc_stream_tx_flush_stats_t tx_flush_stats;
+    sc_stream_clock_us clock;   ///< clock for timing statistics, can be NULL
+    void* clock_ctx;
+    uint32_t rx_messages;       ///< messages of the transfer being processed
+    uint32_t volatile stats_epoch;      ///< incremented to request a reset of statistics
+    uint32_t volatile rx_stats_epoch;   ///< stats_epoch the receive counters were last reset for
+    uint32_t volatile tx_stats_epoch;   ///< stats_epoch the transmit counters were last reset for
+    sc_stream_stats_t stats;
+} sc_stream_core_t;
+
+/** Initializes the stream engine
+ *
+ * \param core          engine to initialize
+ * \param transport     transport backend, copied
+ * \param buffer_size   size of the device buffer as retrieved through sc_msg_can_info
+ * \param epp_size      CAN endpoint packet size
+ * \param rx_count      number of read requests to keep in flight
+ * \param swap          non-zero if device byte order differs from host byte order
+ *
+ * \returns error code
+ */
+int sc_stream_core_init(
+    sc_stream_core_t* core,
+    sc_transport_t const* transport,
+    size_t buffer_size,
+    uint16_t epp_size,
+    uint8_t rx_count,
+    int swap);
+
+/** Sets the number of transmit buffers
+ *
+ * Transmit buffers form a ring, up to count - 1 buffers are in flight
+ * while the next batch is assembled in the remaining one.
+ *
+ * \param count   number of buffers, pass 0 for SC_STREAM_TX_BUFFERS
+ *
+ * \returns SC_DLL_ERROR_INVALID_OPERATION if a transmit is in progress
+ */
+int sc_stream_core_set_tx_count(sc_stream_core_t* core, unsigned count);
+
+/** Cancels all requests in flight and frees the engine's resources
+ *
+ * \param core  engine to uninitialize, can be NULL
+ */
+void sc_stream_core_uninit(sc_stream_core_t* core);
+
+/** Sets per message receive callback */
+void sc_stream_core_set_rx_callback(
+    sc_stream_core_t* core,
+    void* ctx,
+    sc_can_stream_rx_callback callback);
+
+/** Sets batched receive callback
+ *
+ * \param frame_count   maximum number of frames per callback,
+ *      pass 0 to deliver all frames of a transfer at once.
+ *
+ * \returns error code
+ */
+int sc_stream_core_set_rx_batch_callback(
+    sc_stream_core_t* core,
+    void* ctx,
+    sc_can_stream_rx_batch_callback callback,
+    size_t frame_count);
+
+/** Enables or disables reassembly of messages that cross transfer boundaries
+ *
+ * Disabled by default, in which case such messages are protocol violations.
+ * Must not be called while receive processing is in progress.
+ */
+void sc_stream_core_set_rx_reassembly(sc_stream_core_t* core, int enable);
+
+/** Submits all read requests
+ *
+ * \returns error code
+ */
+int sc_stream_core_start(sc_stream_core_t* core);
+
+/** Processes the next completed read request and resubmits it
+ *
+ * \param core          engine
+ * \param timeout_ms    time to wait for the read request to complete
+ *
+ * \returns SC_DLL_ERROR_TIMEOUT if the next read request hasn't
+ *      completed in time, the callback's error if any, otherwise
+ *      the transport error.
+ */
+int sc_stream_core_rx(sc_stream_core_t* core, uint32_t timeout_ms);
+
+/** Processes a transfer in the configured callback mode */
+int sc_stream_core_rx_process(sc_stream_core_t* core, uint8_t const* ptr, uint16_t bytes);
+
+/** Starts a new batched transmit */
+int sc_stream_core_tx_batch_begin(sc_stream_core_t* core);
+
+/** Adds messages to the current batch, see sc_can_stream_tx_batch_add */
+int sc_stream_core_tx_batch_add(
+    sc_stream_core_t* core,
+    uint8_t const** buffers,
+    uint16_t const* sizes,
+    size_t count,
+    size_t* added);
+
+/** Reserves space for messages in the current batch
+ *
+ * Messages are encoded in place, call sc_stream_core_tx_commit
+ * to add them to the batch.
+ *
+ * \returns SC_DLL_ERROR_BUFFER_TOO_SMALL if the current batch doesn't
+ *      have enough space left, end the batch and try again.
+ */
+int sc_stream_core_tx_reserve(sc_stream_core_t* core, uint16_t bytes, uint8_t** ptr);
+
+/** Adds bytes of the last reservation to the current batch */
+int sc_stream_core_tx_commit(sc_stream_core_t* core, uint16_t bytes);
+
+/** Sets the automatic flush policy
+ *
+ * With automatic flushing on, batches are sent as needed by
+ * sc_stream_core_tx_batch_add, sc_stream_core_tx_commit, and
+ * sc_stream_core_tx_flush_if_due. A batch may stay open across
+ * calls to sc_stream_core_tx_batch_begin.
+ *
+ * \param policy    flush policy, copied. Pass NULL to turn automatic flushing off.
+ *
+ * \returns error code
+ */
+int sc_stream_core_set_tx_auto_flush(sc_stream_core_t* core, sc_stream_tx_flush_t const* policy);
+
+/** Sends the current batch if its latency budget is exhausted
+ *
+ * \param core      engine
+ * \param wait_us   time until the current batch is due, UINT32_MAX if there is no deadline
+ *
+ * \returns error code
+ */
+int sc_stream_core_tx_flush_if_due(sc_stream_core_t* core, uint32_t* wait_us);
+
+/** Sends the current batch, if any
+ *
+ * Waits for the oldest write request to complete if all
+ * transmit buffers are in flight.
+ */
+int sc_stream_core_tx_batch_end(sc_stream_core_t* core);
+
+/** Sends the current batch, if any, without waiting
+ *
+ * \returns SC_DLL_ERROR_AGAIN if all transmit buffers are in flight,
+ *      the batch is kept and can be submitted again later.
+ */
+int sc_stream_core_tx_batch_submit(sc_stream_core_t* core);
+
+/** Sets the clock used for timing statistics
+ *
+ * \param clock   monotonic clock, pass NULL to turn timing statistics off
+ */
+void sc_stream_core_set_clock(sc_stream_core_t* core, sc_stream_clock_us clock, void* ctx);
+
+/** Retrieves statistics since the last reset
+ *
+ * Counters are read with relaxed atomics, hence this function may be
+ * called from any thread. The snapshot isn't atomic as a whole though.
+ *
+ * A reset is a request the receive and transmit paths carry out the
+ * next time they update their counters. Until then the counters of the
+ * respective path read as zero.
+ *
+ * \param core      engine
+ * \param stats     (out) counters since the last reset, can be NULL
+ * \param reset     non-zero to start a new measurement period
+ */
+void sc_stream_core_stats(sc_stream_core_t* core, sc_stream_stats_t* stats, int reset);
+
+/** Reaps completed write requests
+ *
+ * \param core          engine
+ * \param timeout_ms    time to wait for the oldest write request to complete
+ *
+ * \returns SC_DLL_ERROR_TIMEOUT if none of the write requests in flight
+ *      completed in time, otherwise the transport error.
+ */
+int sc_stream_core_tx_poll(sc_stream_core_t* core, uint32_t timeout_ms);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,315 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Jean Gressmann <jean@0x42.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#ifndef __cplusplus
+#   error "supercan_timer_wheel.h requires C++"
+#endif
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "supercan_track.h"
+
+/* Hierarchical timer wheel
+ *
+ * Timers expire at a tick, an abstract unsigned time unit chosen by
+ * the user. Level 0 has one slot per tick, each higher level has one
+ * slot per lap of the level below. A timer is placed in the lowest
+ * level whose slot covers its tick together with the current tick.
+ * Whenever the lower bits of the current tick wrap to zero, the slot
+ * of the next level that is now current is cascaded, i.e. its timers
+ * are placed again and thus move down towards level 0.
+ *
+ * Timers further out than the wheel spans are parked in the top level
+ * and placed again until due.
+ *
+ * Insertion and removal are O(1). One bit per slot tracks occupancy so
+ * that idle ticks can be skipped without visiting them.
+ *
+ * Not thread-safe.
+ */
+
+namespace sc {
+
+class timer_wheel
+{
+public:
+    enum {
+        SLOT_BITS = 6,
+        SLOTS = 1 << SLOT_BITS,
+        LEVELS = 4,
+    };
+
+    static uint64_t const NEVER = ~static_cast<uint64_t>(0);
+
+    /** Intrusive timer, owned by the user */
+    struct timer
+    {
+        timer()
+            : next(nullptr)
+            , pprev(nullptr)
+            , due(0)
+            , slot(0)
+        {}
+
+        bool linked() const { return pprev != nullptr; }
+
+        timer* next;
+        timer** pprev;
+        uint64_t due;           ///< tick at which the timer expires
+        uint32_t slot;          ///< level * SLOTS + slot index while linked
+    };
+
+    timer_wheel()
+    {
+        reset(0);
+    }
+
+    /** Forgets all timers and sets the next tick to process to now */
+    void reset(uint64_t now)
+    {
+        for (unsigned i = 0; i < LEVELS * SLOTS; ++i) {
+            m_Slots[i] = nullptr;
+        }
+
+        for (unsigned i = 0; i < LEVELS; ++i) {
+            m_Occupied[i] = 0;
+        }
+
+        m_Now = now;
+        m_Count = 0;
+    }
+
+    /** Next tick to be processed by advance */
+    uint64_t now() const { return m_Now; }
+
+    size_t size() const { return m_Count; }
+
+    /** Adds a timer, t->due in the past expires on the next tick */
+    void insert(timer* t)
+    {
+        assert(!t->linked());
+
+        place(t);
+        ++m_Count;
+    }
+
+    void remove(timer* t)
+    {
+        assert(t->linked());
+
+        unlink(t);
+        --m_Count;
+    }
+
+    /** Tick at which the next timer may expire, NEVER if there are none
+     *
+     * The result can be earlier than the due tick of any timer if a
+     * cascade comes first. Waking up at the returned tick is always
+     * sufficient to not miss a timer.
+     */
+    uint64_t next() const
+    {
+        uint64_t result = NEVER;
+
+        if (!m_Count) {
+            return result;
+        }
+
+        for (unsigned level = 0; level < LEVELS; ++level) {
+            unsigned const shift = SLOT_BITS * level;
+            unsigned const index = static_cast<unsigned>((m_Now >> shift) & (SLOTS - 1));
+            uint64_t const pending = m_Occupied[level] >> index;
+
+            if (pending) {
+                // slots at or behind index are never occupied, except for a cascade due at m_Now
+                uint64_t const lap = (m_Now >> (shift + SLOT_BITS)) << (shift + SLOT_BITS);
+                uint64_t tick = lap | (static_cast<uint64_t>(index + ctz64(pending)) << shift);
+
+                if (tick < m_Now) {
+                    tick = m_Now;
+                }
+
+                if (tick < result) {
+                    result = tick;
+                }
+            }
+        }
+
+        return result;
+    }
+
+    /** Expires timers with a due tick up to and including now
+     *
+     * expire is called with each expired timer after it has been removed
+     * from the wheel. It may insert timers, including the one passed in.
+     */
+    template<typename F>
+    void advance(uint64_t now, F&& expire)
+    {
+        while (m_Now <= now) {
+            uint64_t const tick = next();
+
+            if (tick > now) {
+                m_Now = now + 1;
+                break;
+            }
+
+            m_Now = tick;
+
+            if ((m_Now & (SLOTS - 1)) == 0) {
+                cascade();
+            }
+
+            timer** head = &m_Slots[m_Now & (SLOTS - 1)];
+            timer* t = *head;
+
+            *head = nullptr;
+            m_Occupied[0] &= ~(static_cast<uint64_t>(1) << (m_Now & (SLOTS - 1)));
+
+            // timers inserted by expire go to later ticks
+            ++m_Now;
+
+            while (t) {
+                timer* next = t->next;
+
+                t->next = nullptr;
+                t->pprev = nullptr;
+                --m_Count;
+
+                if (t->due >= m_Now) {
+                    // parked in the top level, not yet due
+                    insert(t);
+                }
+                else {
+                    expire(t);
+                }
+
+                t = next;
+            }
+        }
+    }
+
+private:
+    timer_wheel(timer_wheel const&) = delete;
+    timer_wheel& operator=(timer_wheel const&) = delete;
+
+    static unsigned ctz64(uint64_t x)
+    {
+        uint32_t const lo = static_cast<uint32_t>(x);
+
+        if (lo) {
+            return sc_track_ctz32(lo);
+        }
+
+        return 32 + sc_track_ctz32(static_cast<uint32_t>(x >> 32));
+    }
+
+    void place(timer* t)
+    {
+        uint64_t due = t->due < m_Now ? m_Now : t->due;
+        unsigned level = 0;
+
+        if ((due ^ m_Now) >> (SLOT_BITS * LEVELS)) {
+            // beyond the span, park at the end of the current top level lap
+            due = m_Now | ((static_cast<uint64_t>(1) << (SLOT_BITS * LEVELS)) - 1);
+        }
+
+        while (level < LEVELS - 1 && ((due ^ m_Now) >> (SLOT_BITS * (level + 1)))) {
+            ++level;
+        }
+
+        unsigned const index = static_cast<unsigned>((due >> (SLOT_BITS * level)) & (SLOTS - 1));
+        timer** head = &m_Slots[level * SLOTS + index];
+
+        t->slot = level * SLOTS + index;
+        t->next = *head;
+        t->pprev = head;
+
+        if (*head) {
+            (*head)->pprev = &t->next;
+        }
+
+        *head = t;
+        m_Occupied[level] |= static_cast<uint64_t>(1) << index;
+    }
+
+    void unlink(timer* t)
+    {
+        *t->pprev = t->next;
+
+        if (t->next) {
+            t->next->pprev = t->pprev;
+        }
+
+        if (!m_Slots[t->slot]) {
+            m_Occupied[t->slot / SLOTS] &= ~(static_cast<uint64_t>(1) << (t->slot & (SLOTS - 1)));
+        }
+
+        t->next = nullptr;
+        t->pprev = nullptr;
+    }
+
+    /* Moves the timers of the higher level slots that became current at
+     * m_Now down, top level first so that they can cascade further.
+     */
+    void cascade()
+    {
+        unsigned levels = 1;
+
+        while (levels < LEVELS && ((m_Now >> (SLOT_BITS * levels)) & (SLOTS - 1)) == 0) {
+            ++levels;
+        }
+
+        for (unsigned level = levels < LEVELS ? levels : LEVELS - 1; level > 0; --level) {
+            unsigned const index = static_cast<unsigned>((m_Now >> (SLOT_BITS * level)) & (SLOTS - 1));
+            timer** head = &m_Slots[level * SLOTS + index];
+            timer* t = *head;
+
+            *head = nullptr;
+            m_Occupied[level] &= ~(static_cast<uint64_t>(1) << index);
+
+            while (t) {
+                timer* next = t->next;
+
+                t->next = nullptr;
+                t->pprev = nullptr;
+                place(t);
+                t = next;
+            }
+        }
+    }
+
+private:
+    timer* m_Slots[LEVELS * SLOTS];
+    uint64_t m_Occupied[LEVELS];
+    uint64_t m_Now;             ///< next tick to process
+    size_t m_Count;
+};
+
+} // sc
@@ -0,0 +1,185 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Jean Gressmann <jean@0x42.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "supercan_atomic.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* TX track id allocator
+ *
+ * Track ids identify TX frames in flight, the device reports each back
+ * in a SC_MSG_CAN_TXR message. Only as many ids as there are TX FIFO
+ * entries are handed out, so holding an id also means holding a TX
+ * FIFO credit.
+ *
+ * Free ids are kept in a bitmap. One thread allocates, any thread may
+ * free. The allocator takes all free ids of a bitmap word at once
+ * with a single atomic exchange and hands them out from a private
+ * cache. Ids are returned to the bitmap with an atomic or.
+ *
+ * An allocator that ran out of ids marks itself waiting before it
+ * checks the bitmap once more. sc_track_id_free tells the caller if the
+ * allocator must be woken up, which is only the case once a quarter of
+ * the ids are free again. Thus the allocator acquires credits in bulk
+ * rather than waking up for every frame the device is done with.
+ */
+
+#define SC_TRACK_IDS        256
+#define SC_TRACK_ID_WORDS   (SC_TRACK_IDS / 32)
+
+typedef struct sc_track_ids {
+    uint32_t volatile free[SC_TRACK_ID_WORDS];  ///< shared, a set bit marks a free id
+    uint32_t volatile waiting;                  ///< shared, allocator waits for ids
+    uint32_t wake_count;                        ///< free ids required to wake the allocator
+    uint32_t cache;                             ///< allocator only, ids taken from free[cache_word]
+    uint32_t cache_word;                        ///< allocator only
+} sc_track_ids_t;
+
+static inline uint32_t sc_track_ctz32(uint32_t x)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+
+    _BitScanForward(&index, x);
+
+    return (uint32_t)index;
+#else
+    return (uint32_t)__builtin_ctz(x);
+#endif
+}
+
+static inline uint32_t sc_track_popcount32(uint32_t x)
+{
+    x = x - ((x >> 1) & UINT32_C(0x55555555));
+    x = (x & UINT32_C(0x33333333)) + ((x >> 2) & UINT32_C(0x33333333));
+    x = (x + (x >> 4)) & UINT32_C(0x0f0f0f0f);
+
+    return (x * UINT32_C(0x01010101)) >> 24;
+}
+
+/* Makes ids [0, count) available, not thread-safe */
+static inline void sc_track_ids_init(sc_track_ids_t* t, uint32_t count)
+{
+    if (count > SC_TRACK_IDS) {
+        count = SC_TRACK_IDS;
+    }
+
+    t->wake_count = (count + 3) / 4;
+
+    for (uint32_t i = 0; i < SC_TRACK_ID_WORDS; ++i, count = count > 32 ? count - 32 : 0) {
+        t->free[i] = count >= 32 ? UINT32_C(0xffffffff) : ((UINT32_C(1) << count) - 1);
+    }
+
+    t->waiting = 0;
+    t->cache = 0;
+    t->cache_word = 0;
+}
+
+/* Allocates an id, allocator thread only
+ *
+ * \returns id or -1 if all ids are in use
+ */
+static inline int sc_track_id_alloc(sc_track_ids_t* t)
+{
+    uint32_t bit = 0;
+
+    if (!t->cache) {
+        // start with the word after the last one to spread ids evenly
+        for (uint32_t i = 1; i <= SC_TRACK_ID_WORDS; ++i) {
+            uint32_t const w = (t->cache_word + i) % SC_TRACK_ID_WORDS;
+
+            if (sc_atomic_load_acquire32(&t->free[w])) {
+                t->cache = sc_atomic_exchange32(&t->free[w], 0);
+                t->cache_word = w;
+
+                if (t->cache) {
+                    break;
+                }
+            }
+        }
+
+        if (!t->cache) {
+            return -1;
+        }
+    }
+
+    bit = sc_track_ctz32(t->cache);
+    t->cache &= t->cache - 1;
+
+    return (int)(t->cache_word * 32 + bit);
+}
+
+/* Marks the allocator as waiting, allocator thread only
+ *
+ * Call sc_track_id_alloc once more afterwards, ids freed in between
+ * don't trigger a wakeup.
+ */
+static inline void sc_track_ids_wait(sc_track_ids_t* t)
+{
+    sc_atomic_store_release32(&t->waiting, 1);
+
+    // order waiting store before bitmap loads, pairs with sc_track_id_free
+    sc_atomic_fence();
+}
+
+/* Returns an id to the allocator, thread-safe
+ *
+ * \returns non-zero if the allocator needs to be woken up
+ */
+static inline int sc_track_id_free(sc_track_ids_t* t, uint32_t id)
+{
+    sc_atomic_or32(&t->free[id / 32], UINT32_C(1) << (id % 32));
+
+    // order bitmap store before waiting load, pairs with sc_track_ids_wait
+    sc_atomic_fence();
+
+    if (!sc_atomic_load_acquire32(&t->waiting)) {
+        return 0;
+    }
+
+    if (t->wake_count > 1) {
+        uint32_t count = 0;
+
+        for (uint32_t i = 0; i < SC_TRACK_ID_WORDS; ++i) {
+            count += sc_track_popcount32(sc_atomic_load_acquire32(&t->free[i]));
+        }
+
+        if (count < t->wake_count) {
+            return 0;
+        }
+    }
+
+    return sc_atomic_exchange32(&t->waiting, 0) != 0;
+}
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
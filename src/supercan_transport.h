@@ -0,0 +1,90 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020-2025 Jean Gressmann <jean@0x42.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Backend interface of the CAN stream engine
+ *
+ * A transport moves transfers between host and device. Requests are
+ * identified by direction and slot index. Each slot has at most one
+ * request in flight. Completions are reaped per slot which lets the
+ * stream engine process transfers in submission order.
+ *
+ * All functions return SC_DLL_ERROR_* codes.
+ */
+
+#define SC_TRANSPORT_DIR_IN     0   ///< device -> host
+#define SC_TRANSPORT_DIR_OUT    1   ///< host -> device
+
+typedef struct sc_transport {
+    void* ctx;  ///< passed as first argument to all functions
+
+    /** Submits a read request into slot
+     *
+     * The buffer must stay valid until the request has been reaped or canceled.
+     */
+    int (*submit_read)(void* ctx, unsigned slot, uint8_t* buffer, size_t bytes);
+
+    /** Submits a write request from slot
+     *
+     * The buffer must stay valid until the request has been reaped or canceled.
+     */
+    int (*submit_write)(void* ctx, unsigned slot, uint8_t const* buffer, size_t bytes);
+
+    /** Waits for the request in slot to complete
+     *
+     * \param ctx           transport context
+     * \param dir           SC_TRANSPORT_DIR_IN or SC_TRANSPORT_DIR_OUT
+     * \param slot          request slot
+     * \param transferred   (out) bytes transferred
+     * \param timeout_ms    time to wait, 0 to poll
+     *
+     * \returns SC_DLL_ERROR_NONE on completion, SC_DLL_ERROR_TIMEOUT if
+     *      the request hasn't completed, other error codes on failure.
+     */
+    int (*reap)(void* ctx, int dir, unsigned slot, size_t* transferred, uint32_t timeout_ms);
+
+    /** Cancels the request in slot and waits for the cancelation to finish */
+    int (*cancel)(void* ctx, int dir, unsigned slot);
+
+    /** Checks if the request in slot is still in flight, without reaping it
+     *
+     * Optional, the stream engine uses it for statistics only.
+     *
+     * \returns non-zero if the request hasn't completed yet
+     */
+    int (*pending)(void* ctx, int dir, unsigned slot);
+} sc_transport_t;
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,134 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Jean Gressmann <jean@0x42.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "supercan_proto.h"
+#include "supercan_track.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* CAN ID priority TX scheduling
+ *
+ * In FIFO order a client that keeps its TX ring full occupies the device
+ * TX FIFO and frames of other clients queue up behind its frames no
+ * matter their CAN ID.
+ *
+ * The priority scheduler looks at the next frame of each source (client
+ * TX ring) and picks the one that would win bus arbitration. Frames of
+ * a single source keep their order. Each source may only have a share of
+ * the TX FIFO in flight so there is always room for frames of other
+ * sources.
+ *
+ * With at most a handful of sources a linear scan over the head frames
+ * beats maintaining a heap.
+ */
+
+#define SC_TX_PRIO_MAX_SOURCES 32
+
+typedef struct sc_tx_prio {
+    uint32_t key[SC_TX_PRIO_MAX_SOURCES];   ///< arbitration key of the source's next frame
+    uint32_t pending;                       ///< bitmask of sources with a valid key
+} sc_tx_prio_t;
+
+/* Computes a key that orders frames like bus arbitration, lower wins
+ *
+ * Arbitration compares the base (11 bit) identifier first. On a tie a
+ * standard frame wins over an extended one since its RTR/IDE bits are
+ * sent where the extended frame has its recessive SRR/IDE bits.
+ * Data frames win over remote frames with the same identifier.
+ */
+static inline uint32_t sc_tx_prio_key(uint32_t can_id, uint8_t flags)
+{
+    uint32_t const rtr = (flags & SC_CAN_FRAME_FLAG_RTR) ? 1 : 0;
+
+    if (flags & SC_CAN_FRAME_FLAG_EXT) {
+        can_id &= UINT32_C(0x1fffffff);
+
+        return ((can_id >> 18) << 21) | (UINT32_C(3) << 19) | ((can_id & UINT32_C(0x3ffff)) << 1) | rtr;
+    }
+
+    return ((can_id & UINT32_C(0x7ff)) << 21) | (rtr << 20);
+}
+
+/* Number of frames a source may have in flight, at least one */
+static inline uint32_t sc_tx_prio_credits(uint32_t fifo_size, uint32_t sources)
+{
+    uint32_t credits = sources ? fifo_size / sources : fifo_size;
+
+    return credits ? credits : 1;
+}
+
+static inline void sc_tx_prio_init(sc_tx_prio_t* p)
+{
+    p->pending = 0;
+}
+
+/* Sets the key of the source's next frame */
+static inline void sc_tx_prio_set(sc_tx_prio_t* p, uint32_t source, uint32_t key)
+{
+    p->key[source] = key;
+    p->pending |= UINT32_C(1) << source;
+}
+
+/* Removes the source from the selection */
+static inline void sc_tx_prio_clear(sc_tx_prio_t* p, uint32_t source)
+{
+    p->pending &= ~(UINT32_C(1) << source);
+}
+
+/* Picks the source whose next frame wins arbitration
+ *
+ * Ties go to the lower source index.
+ *
+ * \returns source or -1 if no source is pending
+ */
+static inline int sc_tx_prio_pick(sc_tx_prio_t const* p)
+{
+    uint32_t pending = p->pending;
+    int best = -1;
+    uint32_t best_key = 0;
+
+    while (pending) {
+        uint32_t const source = sc_track_ctz32(pending);
+
+        pending &= pending - 1;
+
+        if (best < 0 || p->key[source] < best_key) {
+            best = (int)source;
+            best_key = p->key[source];
+        }
+    }
+
+    return best;
+}
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
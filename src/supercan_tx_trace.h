@@ -0,0 +1,201 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2025 Jean Gressmann <jean@0x42.de>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "supercan_atomic.h"
+#include "supercan_error.h"
+#include "supercan_srv.h"
+#include "supercan_stats.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* TX latency accounting for sc_mm_tx_latency pages
+ *
+ * The server updates a page for each frame reported back by the device.
+ * It is the only writer, readers in other processes copy the page under
+ * the sequence lock.
+ */
+
+enum {
+    sc_static_assert_tx_latency_buckets_match_log2_histogram = sizeof(int[SC_MM_TX_LATENCY_BUCKETS == SC_STATS_LOG2_BUCKETS ? 1 : -1]),
+};
+
+#define SC_TX_LATENCY_READ_RETRIES 1024
+
+/* Fields behind the sequence lock are accessed with relaxed atomics, the
+ * fences around the sequence number updates and reads order them.
+ */
+static inline void sc_tx_latency_stage_add(struct sc_mm_tx_latency_stage* stage, uint64_t us)
+{
+    sc_stats_add(&stage->buckets[sc_stats_log2_bucket(us > UINT32_MAX ? UINT32_MAX : (uint32_t)us)], 1);
+    sc_stats_add(&stage->sum_us, us);
+
+    if (us > sc_atomic_load_relaxed64(&stage->max_us)) {
+        sc_atomic_store_relaxed64(&stage->max_us, us);
+    }
+}
+
+static inline void sc_tx_latency_stage_clear(struct sc_mm_tx_latency_stage* stage)
+{
+    sc_atomic_store_relaxed64(&stage->max_us, 0);
+    sc_atomic_store_relaxed64(&stage->sum_us, 0);
+
+    for (unsigned i = 0; i < SC_MM_TX_LATENCY_BUCKETS; ++i) {
+        sc_atomic_store_relaxed64(&stage->buckets[i], 0);
+    }
+}
+
+static inline void sc_tx_latency_stage_load(struct sc_mm_tx_latency_stage* dst, struct sc_mm_tx_latency_stage* src)
+{
+    dst->max_us = sc_atomic_load_relaxed64(&src->max_us);
+    dst->sum_us = sc_atomic_load_relaxed64(&src->sum_us);
+
+    for (unsigned i = 0; i < SC_MM_TX_LATENCY_BUCKETS; ++i) {
+        dst->buckets[i] = sc_atomic_load_relaxed64(&src->buckets[i]);
+    }
+}
+
+/* Accounts a frame
+ *
+ * All times are host times in microseconds. A submit_us of 0 means the
+ * device reported the frame before the server got to stamp the submit,
+ * the frame is then accounted as if it had gone out right on submit.
+ * Inconsistent times, e.g. from a bus time estimated a bit early, are
+ * clamped so no stage turns negative.
+ */
+static inline void sc_tx_latency_add(
+    struct sc_mm_tx_latency* page,
+    uint64_t dequeue_us,
+    uint64_t submit_us,
+    uint64_t bus_us)
+{
+    uint32_t const seq = page->seq;
+
+    if (bus_us < dequeue_us) {
+        bus_us = dequeue_us;
+    }
+
+    if (!submit_us || submit_us > bus_us) {
+        submit_us = bus_us;
+    }
+
+    if (submit_us < dequeue_us) {
+        submit_us = dequeue_us;
+    }
+
+    sc_atomic_store_release32(&page->seq, seq + 1);
+    sc_atomic_fence();
+
+    sc_stats_add(&page->frames, 1);
+    sc_tx_latency_stage_add(&page->server, submit_us - dequeue_us);
+    sc_tx_latency_stage_add(&page->device, bus_us - submit_us);
+    sc_tx_latency_stage_add(&page->total, bus_us - dequeue_us);
+
+    sc_atomic_store_release32(&page->seq, seq + 2);
+}
+
+/* Clears all counters, writer only */
+static inline void sc_tx_latency_reset(struct sc_mm_tx_latency* page)
+{
+    uint32_t const seq = page->seq;
+
+    sc_atomic_store_release32(&page->seq, seq + 1);
+    sc_atomic_fence();
+
+    sc_atomic_store_relaxed64(&page->frames, 0);
+    sc_tx_latency_stage_clear(&page->server);
+    sc_tx_latency_stage_clear(&page->device);
+    sc_tx_latency_stage_clear(&page->total);
+
+    sc_atomic_store_release32(&page->seq, seq + 2);
+}
+
+/* Copies a consistent snapshot of page
+ *
+ * \returns SC_DLL_ERROR_NONE or SC_DLL_ERROR_AGAIN if the writer kept
+ *          updating the page (or died doing so)
+ */
+static inline int sc_tx_latency_read(struct sc_mm_tx_latency* page, struct sc_mm_tx_latency* copy)
+{
+    for (unsigned i = 0; i < SC_TX_LATENCY_READ_RETRIES; ++i) {
+        uint32_t const seq = sc_atomic_load_acquire32(&page->seq);
+
+        if (seq & 1) {
+            continue;
+        }
+
+        copy->reserved = 0;
+        copy->frames = sc_atomic_load_relaxed64(&page->frames);
+        sc_tx_latency_stage_load(&copy->server, &page->server);
+        sc_tx_latency_stage_load(&copy->device, &page->device);
+        sc_tx_latency_stage_load(&copy->total, &page->total);
+        sc_atomic_fence();
+
+        if (seq == sc_atomic_load_acquire32(&page->seq)) {
+            copy->seq = seq;
+            return SC_DLL_ERROR_NONE;
+        }
+    }
+
+    return SC_DLL_ERROR_AGAIN;
+}
+
+/* Latency at or below which permille of the frames went out
+ *
+ * The result is the upper bound of the histogram bucket the percentile
+ * falls into, but never above the largest latency seen.
+ */
+static inline uint64_t sc_tx_latency_percentile(
+    struct sc_mm_tx_latency_stage const* stage,
+    uint64_t frames,
+    unsigned permille)
+{
+    uint64_t count = 0;
+
+    if (!frames) {
+        return 0;
+    }
+
+    for (unsigned i = 0; i < SC_MM_TX_LATENCY_BUCKETS; ++i) {
+        count += stage->buckets[i];
+
+        if (count * 1000 >= frames * permille) {
+            uint64_t const upper = i ? (UINT64_C(1) << i) - 1 : 0;
+
+            return upper < stage->max_us ? upper : stage->max_us;
+        }
+    }
+
+    return stage->max_us;
+}
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
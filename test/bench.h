@@ -0,0 +1,42 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/* Minimal benchmark registry
+ *
+ * Benchmarks register with BENCH(name) and are run by supercan-bench.
+ * Each benchmark receives an iteration count and returns the number
+ * of items processed which is used to compute throughput.
+ */
+
+namespace bench
+{
+
+typedef uint64_t (*bench_fn)(uint64_t iterations);
+
+struct registration
+{
+    registration(char const* name, bench_fn fn);
+
+    char const* name;
+    bench_fn fn;
+    registration* next;
+};
+
+// prevents the compiler from optimizing away a computed value
+void keep(uint64_t value);
+
+inline uint64_t now_ns()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // bench
+
+#define BENCH(name) \
+    static uint64_t bench_##name(uint64_t iterations); \
+    static bench::registration bench_##name##_reg(#name, &bench_##name); \
+    static uint64_t bench_##name(uint64_t iterations)
@@ -0,0 +1,196 @@
+#include "bench.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "supercan_proto.h"
+#include "supercan_error.h"
+#include "supercan_cmd.h"
+#include "supercan_sim.h"
+#include "supercan_stream.h"
+
+/* Bus on / off round trip as done by the COM server
+ *
+ * The server used to create the CAN stream and its RX / TX threads on
+ * each bus on and tear them down on bus off. Now the workers stay
+ * alive and bus on / off are notifications the workers acknowledge.
+ */
+
+namespace
+{
+
+enum {
+    EPP_SIZE = 64,
+    RX_COUNT = 8,
+    WORKERS = 2,
+};
+
+enum {
+    NOTIFICATION_NONE,
+    NOTIFICATION_SHUTDOWN,
+    NOTIFICATION_SET,
+    NOTIFICATION_BUS_OFF,
+};
+
+// notify / acknowledge like ScDev::Notify
+struct workers
+{
+    std::mutex lock;
+    std::condition_variable cv;
+    std::thread threads[WORKERS];
+    uint32_t generation;
+    uint32_t acks;
+    int code;
+    uint64_t on_bus;
+
+    workers()
+        : generation(0)
+        , acks(0)
+        , code(NOTIFICATION_NONE)
+        , on_bus(0)
+    {
+        for (size_t i = 0; i < WORKERS; ++i) {
+            threads[i] = std::thread([this] { run(); });
+        }
+    }
+
+    ~workers()
+    {
+        notify(NOTIFICATION_SHUTDOWN);
+
+        for (size_t i = 0; i < WORKERS; ++i) {
+            threads[i].join();
+        }
+    }
+
+    void run()
+    {
+        uint32_t seen = 0;
+
+        for (bool done = false; !done; ) {
+            std::unique_lock<std::mutex> g(lock);
+
+            cv.wait(g, [&] { return generation != seen; });
+            seen = generation;
+
+            switch (code) {
+            case NOTIFICATION_SHUTDOWN:
+                done = true;
+                break;
+            case NOTIFICATION_SET:
+                ++on_bus;
+                break;
+            }
+
+            ++acks;
+            cv.notify_all();
+        }
+    }
+
+    void notify(int c)
+    {
+        std::unique_lock<std::mutex> g(lock);
+
+        code = c;
+        acks = 0;
+        ++generation;
+        cv.notify_all();
+        cv.wait(g, [&] { return WORKERS == acks; });
+    }
+};
+
+struct device
+{
+    sc_sim_config_t config;
+    sc_sim_t sim;
+    sc_transport_t can;
+    sc_transport_t cmd;
+
+    device()
+    {
+        sc_sim_config_init(&config);
+        config.rx_rate_hz = 0;
+        config.in_transfers = RX_COUNT;
+        sc_sim_init(&sim, &config);
+        sc_sim_can_transport(&sim, &can);
+        sc_sim_cmd_transport(&sim, &cmd);
+    }
+
+    ~device()
+    {
+        sc_sim_uninit(&sim);
+    }
+
+    void bus(uint8_t on)
+    {
+        struct sc_msg_config msg;
+        uint8_t rsp[64];
+
+        msg.id = SC_MSG_BUS;
+        msg.len = sizeof(msg);
+        msg.arg = on;
+
+        sc_cmd_exchange(&cmd, (uint8_t const*)&msg, sizeof(msg), rsp, sizeof(rsp), nullptr, 0);
+    }
+
+    void stream_init(sc_stream_core_t* core)
+    {
+        sc_stream_core_init(core, &can, config.msg_buffer_size, EPP_SIZE, RX_COUNT, 0);
+        sc_stream_core_start(core);
+    }
+};
+
+BENCH(bus_toggle_restart_workers)
+{
+    device d;
+    uint64_t on_bus = 0;
+
+    for (uint64_t i = 0; i < iterations; ++i) {
+        sc_stream_core_t core;
+
+        d.stream_init(&core);
+
+        {
+            workers w;
+
+            d.bus(1);
+            w.notify(NOTIFICATION_SET);
+            d.bus(0);
+            on_bus += w.on_bus;
+        }
+
+        sc_stream_core_uninit(&core);
+    }
+
+    bench::keep(on_bus);
+
+    return iterations;
+}
+
+BENCH(bus_toggle_persistent_workers)
+{
+    device d;
+    sc_stream_core_t core;
+
+    d.stream_init(&core);
+
+    {
+        workers w;
+
+        for (uint64_t i = 0; i < iterations; ++i) {
+            d.bus(1);
+            w.notify(NOTIFICATION_SET);
+            d.bus(0);
+            w.notify(NOTIFICATION_BUS_OFF);
+        }
+
+        bench::keep(w.on_bus);
+    }
+
+    sc_stream_core_uninit(&core);
+
+    return iterations;
+}
+
+} // anon
@@ -0,0 +1,74 @@
+#include "bench.h"
+
+#include <string.h>
+
+#include "supercan_cyclic.h"
+
+/* Cyclic TX scheduling as done by the COM server's TX thread
+ *
+ * Thousands of definitions with periods of 1 to 20 ms on a 100 us tick.
+ * The scheduling thread wakes up at next_us only and takes all due
+ * frames. Reports time per frame, including the idle wakeups.
+ */
+
+namespace
+{
+
+enum {
+    DEFS = 4096,
+    TICK_US = 100,
+};
+
+uint64_t run(uint64_t iterations)
+{
+    static uint32_t const periods[] = { 1000, 2000, 5000, 10000, 20000 };
+    sc::cyclic_tx cyclic;
+    uint64_t frames = 0;
+    uint64_t now = 0;
+    uint64_t sum = 0;
+
+    cyclic.init(DEFS);
+    cyclic.set_tick(TICK_US);
+
+    for (uint32_t i = 0; i < DEFS; ++i) {
+        sc::cyclic_tx_def def;
+        uint32_t handle = 0;
+
+        memset(&def, 0, sizeof(def));
+        def.can_id = i & 0x7ff;
+        def.period_us = periods[i % 5];
+        def.phase_us = (i * 37) % def.period_us;
+        def.dlc = 8;
+
+        cyclic.add(0, &def, &handle);
+    }
+
+    cyclic.apply(0);
+    cyclic.start(0);
+
+    while (frames < iterations) {
+        sc_mm_can_tx const* frame = nullptr;
+        uint8_t owner = 0;
+
+        cyclic.run(now);
+
+        while (cyclic.front(&owner, &frame)) {
+            sum += frame->can_id;
+            ++frames;
+            cyclic.pop();
+        }
+
+        now = cyclic.next_us();
+    }
+
+    bench::keep(sum);
+
+    return frames;
+}
+
+} // anon
+
+BENCH(cyclic_tx_4096_defs)
+{
+    return run(iterations);
+}
@@ -0,0 +1,97 @@
+#include "bench.h"
+
+#include <cstdlib>
+#include <vector>
+
+#include "supercan_error.h"
+#include "supercan_filter.h"
+
+namespace
+{
+
+// a few hundred exact ids and ranges, as used to pick signals off a busy bus
+struct filter_setup
+{
+    sc_filter_t filter;
+    std::vector<uint32_t> ids;
+
+    filter_setup()
+        : ids(4096)
+    {
+        std::vector<sc_filter_rule> rules;
+
+        srand(1);
+
+        for (size_t i = 0; i < 500; ++i) {
+            sc_filter_rule r;
+            bool const ext = i & 1;
+
+            r.id = (((uint32_t)rand() << 16) ^ (uint32_t)rand()) & (ext ? 0x1fffffff : 0x7ff);
+            r.mask_or_last = ext ? 0x1fffffff : 0x7ff;
+            r.flags = ext ? SC_FILTER_RULE_FLAG_EXT : 0;
+
+            if (i % 5 == 0) {
+                r.flags |= SC_FILTER_RULE_FLAG_RANGE;
+                r.mask_or_last = r.id + 16 > r.mask_or_last ? r.mask_or_last : r.id + 16;
+            }
+
+            rules.push_back(r);
+        }
+
+        sc_filter_init(&filter);
+        sc_filter_set(&filter, rules.data(), rules.size());
+
+        for (auto& id : ids) {
+            id = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+        }
+    }
+
+    ~filter_setup()
+    {
+        sc_filter_uninit(&filter);
+    }
+};
+
+} // anon
+
+BENCH(filter_accept_500_rules)
+{
+    static filter_setup setup;
+    uint64_t accepted = 0;
+
+    for (uint64_t i = 0; i < iterations; ++i) {
+        uint32_t const id = setup.ids[i & 4095];
+
+        accepted += sc_filter_accept(&setup.filter, id, (id & 0x80000000) ? SC_CAN_FRAME_FLAG_EXT : 0);
+    }
+
+    bench::keep(accepted);
+
+    return iterations;
+}
+
+BENCH(filter_set_500_rules)
+{
+    static filter_setup setup;
+    std::vector<sc_filter_rule> rules;
+    sc_filter_t filter;
+
+    for (uint32_t i = 0; i < 500; ++i) {
+        sc_filter_rule r;
+
+        r.id = (i * 2654435761u) & 0x1fffffff;
+        r.mask_or_last = 0x1fffffff;
+        r.flags = SC_FILTER_RULE_FLAG_EXT;
+        rules.push_back(r);
+    }
+
+    sc_filter_init(&filter);
+
+    for (uint64_t i = 0; i < iterations; ++i) {
+        sc_filter_set(&filter, rules.data(), rules.size());
+    }
+
+    sc_filter_uninit(&filter);
+
+    return iterations;
+}
@@ -0,0 +1,72 @@
+#include "bench.h"
+
+#include <atomic>
+#include <cstdio>
+#include <thread>
+
+#include "supercan_log.h"
+
+namespace
+{
+
+enum {
+    RECORDS = 4096,
+};
+
+void nop_sink(void* ctx, int level, char const* msg, size_t size)
+{
+    (void)level;
+    (void)msg;
+    *static_cast<uint64_t*>(ctx) += size;
+}
+
+} // anon
+
+// what LOG_DEV used to do on the I/O thread
+BENCH(log_snprintf_per_call)
+{
+    char buffer[SC_LOG_LINE_SIZE];
+    uint64_t sum = 0;
+
+    for (uint64_t i = 0; i < iterations; ++i) {
+        int chars = snprintf(buffer, sizeof(buffer), "ch%u rx %u msgs, ts=%lu error %d (%s)\n", 0u, (unsigned)i, (unsigned long)i * 100, -3, "SC_DLL_ERROR_AGAIN");
+
+        nop_sink(&sum, 0, buffer, (size_t)chars);
+    }
+
+    bench::keep(sum);
+
+    return iterations;
+}
+
+// cost of a deferred log call on the I/O thread, consumer formats concurrently
+BENCH(log_deferred_per_call)
+{
+    sc_log_t log;
+    uint64_t sum = 0;
+    std::atomic<bool> done(false);
+
+    sc_log_init(&log, RECORDS);
+
+    std::thread consumer([&] {
+        while (!done.load(std::memory_order_relaxed)) {
+            if (!sc_log_drain(&log, 0)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    for (uint64_t i = 0; i < iterations; ++i) {
+        sc_log_write(&log, &nop_sink, &sum, 0, "ch%u rx %u msgs, ts=%lu error %d (%s)\n", 0u, (unsigned)i, (unsigned long)i * 100, -3, "SC_DLL_ERROR_AGAIN");
+    }
+
+    done = true;
+    consumer.join();
+    sc_log_drain(&log, 0);
+
+    bench::keep(sum + log.dropped);
+
+    sc_log_uninit(&log);
+
+    return iterations;
+}
@@ -0,0 +1,88 @@
+#include "bench.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace bench
+{
+
+static registration* s_head;
+static registration* s_tail;
+static volatile uint64_t s_sink;
+
+void keep(uint64_t value)
+{
+    s_sink = value;
+}
+
+registration::registration(char const* _name, bench_fn _fn)
+    : name(_name)
+    , fn(_fn)
+    , next(nullptr)
+{
+    if (s_tail) {
+        s_tail->next = this;
+    }
+    else {
+        s_head = this;
+    }
+
+    s_tail = this;
+}
+
+} // bench
+
+static void usage(char const* self)
+{
+    fprintf(stdout, "%s [--iterations N] [FILTER]\n", self);
+    fprintf(stdout, "\n");
+    fprintf(stdout, "Runs all benchmarks whose name contains FILTER.\n");
+}
+
+int main(int argc, char** argv)
+{
+    uint64_t iterations = 1000;
+    char const* filter = nullptr;
+
+    for (int i = 1; i < argc; ++i) {
+        if (0 == strcmp("--iterations", argv[i]) && i + 1 < argc) {
+            iterations = strtoull(argv[++i], nullptr, 10);
+        }
+        else if (0 == strcmp("-h", argv[i]) || 0 == strcmp("--help", argv[i])) {
+            usage(argv[0]);
+            return 0;
+        }
+        else {
+            filter = argv[i];
+        }
+    }
+
+    fprintf(stdout, "%-40s %14s %12s %14s\n", "benchmark", "items", "ns/item", "items/s");
+
+    for (bench::registration* r = bench::s_head; r; r = r->next) {
+        if (filter && !strstr(r->name, filter)) {
+            continue;
+        }
+
+        // warm up
+        r->fn(iterations / 10 + 1);
+
+        uint64_t start = bench::now_ns();
+        uint64_t items = r->fn(iterations);
+        uint64_t ns = bench::now_ns() - start;
+
+        if (!ns) {
+            ns = 1;
+        }
+
+        fprintf(
+            stdout, "%-40s %14llu %12.2f %14.0f\n",
+            r->name,
+            (unsigned long long)items,
+            items ? (double)ns / (double)items : 0.0,
+            (double)items * 1e9 / (double)ns);
+    }
+
+    return 0;
+}
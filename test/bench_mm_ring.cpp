@@ -0,0 +1,221 @@
+#include "bench.h"
+
+#ifndef _WIN32
+
+#include <cstdio>
+#include <cstring>
+
+#include <sched.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "supercan_mm_ring.h"
+#include "supercan_mm_posix.h"
+
+namespace
+{
+
+enum {
+    ELEMENTS = 4096,
+    BATCH = 32,
+};
+
+// producer in a child process, consumer in this one
+uint64_t run(uint64_t iterations, uint32_t batch)
+{
+    char name[64];
+    sc::mm::posix_ring_mapping mapping;
+    sc::mm::ring_consumer consumer;
+    sc_can_mm_slot_t out[BATCH];
+    uint64_t received = 0;
+    uint64_t sum = 0;
+    pid_t pid = -1;
+
+    snprintf(name, sizeof(name), "/supercan-bench-%d", (int)getpid());
+
+    if (mapping.create(name, ELEMENTS)) {
+        return 0;
+    }
+
+    pid = fork();
+    if (pid < 0) {
+        return 0;
+    }
+
+    if (0 == pid) {
+        sc::mm::posix_ring_mapping child;
+        sc::mm::ring_producer producer;
+        uint64_t sent = 0;
+
+        if (child.open(name, ELEMENTS)) {
+            _exit(1);
+        }
+
+        producer.attach(child.header(), child.elements());
+
+        while (sent < iterations) {
+            uint32_t available = 0;
+
+            if (producer.writable(&available)) {
+                _exit(2);
+            }
+
+            if (available > batch) {
+                available = batch;
+            }
+
+            if (available > iterations - sent) {
+                available = (uint32_t)(iterations - sent);
+            }
+
+            if (!available) {
+                sched_yield();
+                continue;
+            }
+
+            // encode in place, publish once per batch
+            for (uint32_t i = 0; i < available; ++i) {
+                sc_can_mm_slot_t* slot = producer.slot(i);
+
+                slot->rx.type = SC_MM_DATA_TYPE_CAN_RX;
+                slot->rx.can_id = (uint32_t)(sent + i);
+                slot->rx.dlc = 8;
+                memset(slot->rx.data, 0x55, 8);
+            }
+
+            producer.commit(available);
+            sent += available;
+        }
+
+        _exit(0);
+    }
+
+    consumer.attach(mapping.header(), mapping.elements());
+
+    while (received < iterations) {
+        uint32_t popped = 0;
+
+        if (consumer.pop(out, batch, &popped)) {
+            break;
+        }
+
+        if (!popped) {
+            sched_yield();
+            continue;
+        }
+
+        for (uint32_t i = 0; i < popped; ++i) {
+            sum += out[i].rx.can_id;
+        }
+
+        received += popped;
+    }
+
+    waitpid(pid, nullptr, 0);
+    bench::keep(sum);
+
+    return received;
+}
+
+// same as run() for the variable length format, the producer pushes as the COM server does
+uint64_t run_var(uint64_t iterations)
+{
+    char name[64];
+    sc::mm::posix_ring_mapping mapping;
+    sc::mm::var_ring_consumer consumer;
+    sc_can_mm_slot_t out[BATCH];
+    uint64_t received = 0;
+    uint64_t sum = 0;
+    pid_t pid = -1;
+
+    snprintf(name, sizeof(name), "/supercan-bench-%d", (int)getpid());
+
+    if (mapping.create(name, ELEMENTS)) {
+        return 0;
+    }
+
+    pid = fork();
+    if (pid < 0) {
+        return 0;
+    }
+
+    if (0 == pid) {
+        sc::mm::posix_ring_mapping child;
+        sc::mm::var_ring_producer producer;
+        sc_can_mm_slot_t slot;
+        uint64_t sent = 0;
+
+        if (child.open(name, ELEMENTS)) {
+            _exit(1);
+        }
+
+        producer.attach(child.header(), child.elements());
+
+        memset(&slot, 0, sizeof(slot));
+        slot.rx.type = SC_MM_DATA_TYPE_CAN_RX;
+        slot.rx.dlc = 8;
+        memset(slot.rx.data, 0x55, 8);
+
+        while (sent < iterations) {
+            slot.rx.can_id = (uint32_t)sent;
+
+            switch (producer.push(&slot)) {
+            case SC_DLL_ERROR_NONE:
+                ++sent;
+                break;
+            case SC_DLL_ERROR_AGAIN:
+                sched_yield();
+                break;
+            default:
+                _exit(2);
+            }
+        }
+
+        _exit(0);
+    }
+
+    consumer.attach(mapping.header(), mapping.elements());
+
+    while (received < iterations) {
+        uint32_t popped = 0;
+
+        if (consumer.pop(out, BATCH, &popped)) {
+            break;
+        }
+
+        if (!popped) {
+            sched_yield();
+            continue;
+        }
+
+        for (uint32_t i = 0; i < popped; ++i) {
+            sum += out[i].rx.can_id;
+        }
+
+        received += popped;
+    }
+
+    waitpid(pid, nullptr, 0);
+    bench::keep(sum);
+
+    return received;
+}
+
+} // anon
+
+BENCH(mm_ring_process_single)
+{
+    return run(iterations, 1);
+}
+
+BENCH(mm_ring_process_batch)
+{
+    return run(iterations, BATCH);
+}
+
+BENCH(mm_var_ring_process)
+{
+    return run_var(iterations);
+}
+
+#endif // !_WIN32
@@ -0,0 +1,130 @@
+#include "bench.h"
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#include "supercan_mpsc_queue.h"
+
+namespace
+{
+
+enum {
+    ENTRIES = 256,
+    PRODUCERS = 2,
+};
+
+// same size as the server's log entries
+struct entry {
+    int8_t level;
+    uint8_t src;
+    uint8_t bytes;
+    uint8_t reserved;
+    char data[116];
+};
+
+char const MESSAGE[] = "sc_can_stream_tx_batch_end failed: SC_DLL_ERROR_DEVICE_FAILURE (8)\n";
+
+// what the server's log queue used to be, a ring behind a lock
+struct locked_ring {
+    std::mutex lock;
+    unsigned get_index;
+    unsigned put_index;
+    entry entries[ENTRIES];
+};
+
+} // anon
+
+BENCH(log_queue_locked_per_entry)
+{
+    locked_ring ring;
+    std::atomic<bool> done(false);
+    uint64_t sum = 0;
+
+    ring.get_index = 0;
+    ring.put_index = 0;
+
+    std::thread consumer([&] {
+        for (bool last = false; !last; ) {
+            last = done.load(std::memory_order_acquire);
+
+            std::lock_guard<std::mutex> g(ring.lock);
+
+            for (; ring.get_index != ring.put_index; ++ring.get_index) {
+                sum += ring.entries[ring.get_index % ENTRIES].bytes;
+            }
+        }
+    });
+
+    std::thread producers[PRODUCERS];
+
+    for (unsigned p = 0; p < PRODUCERS; ++p) {
+        producers[p] = std::thread([&] {
+            for (uint64_t i = 0; i < iterations / PRODUCERS; ++i) {
+                std::lock_guard<std::mutex> g(ring.lock);
+
+                if (ring.put_index - ring.get_index < ENTRIES) {
+                    entry* e = &ring.entries[ring.put_index++ % ENTRIES];
+
+                    e->level = 0;
+                    e->src = 0;
+                    e->bytes = sizeof(MESSAGE) - 1;
+                    memcpy(e->data, MESSAGE, sizeof(MESSAGE));
+                }
+            }
+        });
+    }
+
+    for (auto& t : producers) {
+        t.join();
+    }
+
+    done = true;
+    consumer.join();
+    bench::keep(sum);
+
+    return iterations / PRODUCERS * PRODUCERS;
+}
+
+BENCH(log_queue_lock_free_per_entry)
+{
+    sc::mpsc_queue<entry> queue;
+    std::atomic<bool> done(false);
+    uint64_t sum = 0;
+
+    queue.init(ENTRIES);
+
+    std::thread consumer([&] {
+        for (bool last = false; !last; ) {
+            last = done.load(std::memory_order_acquire);
+
+            queue.drain([&](entry const* e) { sum += e->bytes; }, ENTRIES);
+        }
+    });
+
+    std::thread producers[PRODUCERS];
+
+    for (unsigned p = 0; p < PRODUCERS; ++p) {
+        producers[p] = std::thread([&] {
+            for (uint64_t i = 0; i < iterations / PRODUCERS; ++i) {
+                queue.push([](entry* e) {
+                    e->level = 0;
+                    e->src = 0;
+                    e->bytes = sizeof(MESSAGE) - 1;
+                    memcpy(e->data, MESSAGE, sizeof(MESSAGE));
+                });
+            }
+        });
+    }
+
+    for (auto& t : producers) {
+        t.join();
+    }
+
+    done = true;
+    consumer.join();
+    bench::keep(sum);
+
+    return iterations / PRODUCERS * PRODUCERS;
+}
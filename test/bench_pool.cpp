@@ -0,0 +1,241 @@
+#include "bench.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "supercan_proto.h"
+#include "supercan_error.h"
+#include "supercan_cmd.h"
+#include "supercan_pool.h"
+#include "supercan_sim.h"
+#include "supercan_stream.h"
+
+/* Many simulated channels serviced by dedicated threads or a pool
+ *
+ * Each round every device's simulation advances by a USB frame's worth
+ * of time and its stream is drained by whoever services the device:
+ * a thread per device, as in the COM server, or a small worker pool.
+ */
+
+namespace
+{
+
+enum {
+    DEVICES = 16,
+    POOL_WORKERS = 2,
+    EPP_SIZE = 64,
+    RX_COUNT = 8,
+    ADVANCE_US = 1000,
+    RX_RATE_HZ = 8000,
+};
+
+struct device
+{
+    sc_sim_config_t config;
+    sc_sim_t sim;
+    sc_transport_t can;
+    sc_stream_core_t core;
+    uint64_t frames;
+
+    device()
+        : frames(0)
+    {
+        sc_transport_t cmd;
+        struct sc_msg_config msg;
+        uint8_t rsp[64];
+
+        sc_sim_config_init(&config);
+        config.rx_rate_hz = RX_RATE_HZ;
+        config.in_transfers = RX_COUNT;
+        sc_sim_init(&sim, &config);
+        sc_sim_can_transport(&sim, &can);
+        sc_stream_core_init(&core, &can, config.msg_buffer_size, EPP_SIZE, RX_COUNT, 0);
+        sc_stream_core_set_rx_batch_callback(&core, this, &device::on_rx_batch, 0);
+        sc_stream_core_start(&core);
+
+        msg.id = SC_MSG_BUS;
+        msg.len = sizeof(msg);
+        msg.arg = 1;
+
+        sc_sim_cmd_transport(&sim, &cmd);
+        sc_cmd_exchange(&cmd, (uint8_t const*)&msg, sizeof(msg), rsp, sizeof(rsp), nullptr, 0);
+    }
+
+    ~device()
+    {
+        sc_stream_core_uninit(&core);
+        sc_sim_uninit(&sim);
+    }
+
+    static int on_rx_batch(void* ctx, sc_can_frame_t const* frames, size_t count)
+    {
+        (void)frames;
+        static_cast<device*>(ctx)->frames += count;
+        return SC_DLL_ERROR_NONE;
+    }
+
+    void service()
+    {
+        sc_sim_advance(&sim, ADVANCE_US);
+
+        while (SC_DLL_ERROR_NONE == sc_stream_core_rx(&core, 0));
+    }
+};
+
+// counts devices serviced in the current round
+struct service_round
+{
+    std::mutex lock;
+    std::condition_variable cv;
+    uint32_t done;
+
+    service_round() : done(0) {}
+
+    void finish()
+    {
+        std::lock_guard<std::mutex> g(lock);
+
+        if (DEVICES == ++done) {
+            cv.notify_all();
+        }
+    }
+
+    void wait()
+    {
+        std::unique_lock<std::mutex> g(lock);
+
+        cv.wait(g, [this] { return DEVICES == done; });
+        done = 0;
+    }
+};
+
+struct pooled_device
+{
+    device dev;
+    service_round* r;
+
+    static void run(void* ctx)
+    {
+        pooled_device* self = static_cast<pooled_device*>(ctx);
+
+        self->dev.service();
+        self->r->finish();
+    }
+};
+
+struct dedicated_device
+{
+    device dev;
+    service_round* r;
+    std::mutex lock;
+    std::condition_variable cv;
+    uint32_t rounds;
+    bool stop;
+    std::thread thread;
+
+    dedicated_device() : r(nullptr), rounds(0), stop(false) {}
+
+    void run()
+    {
+        uint32_t seen = 0;
+
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> g(lock);
+
+                cv.wait(g, [&] { return stop || rounds != seen; });
+
+                if (stop) {
+                    break;
+                }
+
+                seen = rounds;
+            }
+
+            dev.service();
+            r->finish();
+        }
+    }
+
+    void kick()
+    {
+        std::lock_guard<std::mutex> g(lock);
+
+        ++rounds;
+        cv.notify_one();
+    }
+};
+
+BENCH(pool_16_devices_dedicated_threads)
+{
+    service_round r;
+    std::vector<dedicated_device> devs(DEVICES);
+    uint64_t frames = 0;
+
+    for (size_t i = 0; i < DEVICES; ++i) {
+        devs[i].r = &r;
+        devs[i].thread = std::thread([&devs, i] { devs[i].run(); });
+    }
+
+    for (uint64_t i = 0; i < iterations; ++i) {
+        for (size_t j = 0; j < DEVICES; ++j) {
+            devs[j].kick();
+        }
+
+        r.wait();
+    }
+
+    for (size_t i = 0; i < DEVICES; ++i) {
+        {
+            std::lock_guard<std::mutex> g(devs[i].lock);
+
+            devs[i].stop = true;
+            devs[i].cv.notify_one();
+        }
+
+        devs[i].thread.join();
+        frames += devs[i].dev.frames;
+    }
+
+    return frames;
+}
+
+BENCH(pool_16_devices_2_workers)
+{
+    service_round r;
+    sc::worker_pool pool;
+    std::vector<pooled_device> devs(DEVICES);
+    std::vector<sc::pool_task> tasks(DEVICES);
+    uint64_t frames = 0;
+
+    for (uint32_t i = 0; i < DEVICES; ++i) {
+        devs[i].r = &r;
+        tasks[i].run = &pooled_device::run;
+        tasks[i].ctx = &devs[i];
+        tasks[i].home = i;
+    }
+
+    pool.start(POOL_WORKERS, nullptr);
+
+    for (uint64_t i = 0; i < iterations; ++i) {
+        for (size_t j = 0; j < DEVICES; ++j) {
+            pool.post(&tasks[j]);
+        }
+
+        r.wait();
+    }
+
+    pool.stop();
+
+    for (size_t i = 0; i < DEVICES; ++i) {
+        frames += devs[i].dev.frames;
+    }
+
+    bench::keep(pool.steals());
+
+    return frames;
+}
+
+} // anon
@@ -0,0 +1,194 @@
+#include "bench.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include "supercan_proto.h"
+#include "supercan_error.h"
+#include "supercan_cmd.h"
+#include "supercan_recorder.h"
+#include "supercan_sim.h"
+#include "supercan_stream.h"
+
+namespace
+{
+
+enum {
+    EPP_SIZE = 64,
+    RX_COUNT = 8,
+};
+
+enum mode {
+    MODE_NONE,
+    MODE_RECORDER,
+    MODE_CANDUMP,
+};
+
+char const PATH[] = "supercan-bench-recording.bin";
+
+/* Sustained RX from the simulated device, each frame stored the way
+ * ScDev::OnRx would.
+ */
+struct recorder_bench
+{
+    sc_sim_config_t config;
+    sc_sim_t sim;
+    sc_transport_t can;
+    sc_stream_core_t core;
+    sc::record_file_sink sink;
+    sc::recorder rec;
+    FILE* file;
+    uint64_t sum;
+    mode m;
+
+    explicit recorder_bench(mode m_)
+        : file(nullptr)
+        , sum(0)
+        , m(m_)
+    {
+        sc_sim_config_init(&config);
+        config.rx_rate_hz = 1000000;
+        config.echo = 0;
+        config.in_transfers = RX_COUNT;
+        sc_sim_init(&sim, &config);
+        sc_sim_can_transport(&sim, &can);
+        sc_stream_core_init(&core, &can, config.msg_buffer_size, EPP_SIZE, RX_COUNT, 0);
+        sc_stream_core_set_rx_batch_callback(&core, this, &recorder_bench::on_rx_batch, 0);
+        sc_stream_core_start(&core);
+        go_on_bus();
+
+        switch (m) {
+        case MODE_RECORDER:
+            sink.open(PATH);
+            rec.start(&sink, 0, sc::recorder::DEFAULT_SYNC_CHUNKS);
+            break;
+        case MODE_CANDUMP:
+            file = fopen(PATH, "w");
+            break;
+        default:
+            break;
+        }
+    }
+
+    ~recorder_bench()
+    {
+        rec.stop();
+        sink.close();
+
+        if (file) {
+            fclose(file);
+        }
+
+        remove(PATH);
+        sc_stream_core_uninit(&core);
+        sc_sim_uninit(&sim);
+    }
+
+    void go_on_bus()
+    {
+        sc_transport_t cmd;
+        struct sc_msg_config msg;
+        uint8_t rsp[64];
+
+        msg.id = SC_MSG_BUS;
+        msg.len = sizeof(msg);
+        msg.arg = 1;
+
+        sc_sim_cmd_transport(&sim, &cmd);
+        sc_cmd_exchange(&cmd, (uint8_t const*)&msg, sizeof(msg), rsp, sizeof(rsp), nullptr, 0);
+    }
+
+    void candump(sc_can_frame_t const* f)
+    {
+        uint64_t s = f->timestamp_us / 1000000u;
+
+        fprintf(file, "(%010lu.%06lu) can0 %03X#", (unsigned long)s, (unsigned long)(f->timestamp_us - s * 1000000u), f->can_id);
+
+        for (unsigned i = 0, len = sc::mm::var_dlc_to_len(f->dlc); i < len; ++i) {
+            fprintf(file, "%02X", f->data[i]);
+        }
+
+        fputc('\n', file);
+    }
+
+    static int on_rx_batch(void* ctx, sc_can_frame_t const* frames, size_t count)
+    {
+        recorder_bench* self = static_cast<recorder_bench*>(ctx);
+
+        for (size_t i = 0; i < count; ++i) {
+            sc_can_frame_t const* f = &frames[i];
+
+            self->sum += f->can_id;
+
+            if (SC_MSG_CAN_RX != f->type) {
+                continue;
+            }
+
+            switch (self->m) {
+            case MODE_RECORDER: {
+                sc_can_mm_slot_t slot;
+
+                slot.rx.type = SC_MM_DATA_TYPE_CAN_RX;
+                slot.rx.can_id = f->can_id;
+                slot.rx.dlc = f->dlc;
+                slot.rx.flags = f->flags;
+                slot.rx.timestamp_us = f->timestamp_us;
+
+                if (f->data) {
+                    memcpy(slot.rx.data, f->data, sc::mm::var_dlc_to_len(f->dlc));
+                }
+
+                self->rec.record(&slot);
+            } break;
+            case MODE_CANDUMP:
+                self->candump(f);
+                break;
+            default:
+                break;
+            }
+        }
+
+        return SC_DLL_ERROR_NONE;
+    }
+
+    uint64_t run(uint64_t iterations)
+    {
+        for (uint64_t i = 0; i < iterations; ++i) {
+            sc_sim_advance(&sim, 20);
+
+            while (SC_DLL_ERROR_NONE == sc_stream_core_rx(&core, 0));
+        }
+
+        bench::keep(sum);
+
+        return sim.stats.rx;
+    }
+};
+
+BENCH(recorder_sim_rx_baseline)
+{
+    recorder_bench b(MODE_NONE);
+
+    return b.run(iterations);
+}
+
+BENCH(recorder_sim_rx_recorded)
+{
+    recorder_bench b(MODE_RECORDER);
+    uint64_t frames = b.run(iterations);
+    sc::recorder_stats stats;
+
+    b.rec.stats(&stats);
+    bench::keep(stats.dropped);
+
+    return frames;
+}
+
+BENCH(recorder_sim_rx_candump)
+{
+    recorder_bench b(MODE_CANDUMP);
+
+    return b.run(iterations);
+}
+
+} // anon
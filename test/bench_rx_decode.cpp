@@ -0,0 +1,154 @@
+#include "bench.h"
+
+#include <cstring>
+#include <vector>
+
+#include "supercan_proto.h"
+#include "supercan_error.h"
+#include "supercan_rx.h"
+
+namespace
+{
+
+enum {
+    BUFFER_SIZE = 512,
+};
+
+struct rx_buffer
+{
+    std::vector<uint8_t> data;
+
+    // fills a transfer with classic CAN frames of 8 bytes, as received under full bus load
+    rx_buffer()
+        : data(BUFFER_SIZE)
+    {
+        size_t offset = 0;
+        uint32_t ts = 0;
+        const size_t len = sizeof(struct sc_msg_can_rx) + 8;
+
+        while (offset + len <= data.size()) {
+            struct sc_msg_can_rx* rx = (struct sc_msg_can_rx*)&data[offset];
+            rx->id = SC_MSG_CAN_RX;
+            rx->len = (uint8_t)len;
+            rx->dlc = 8;
+            rx->flags = 0;
+            rx->can_id = 0x100 + (ts & 0x7f);
+            rx->timestamp_us = ts;
+            memset(rx->data, (int)ts, 8);
+            ts += 130;
+            offset += len;
+        }
+    }
+};
+
+static rx_buffer s_buffer;
+
+static uint32_t nop32(uint32_t value)
+{
+    return value;
+}
+
+struct sink
+{
+    sc_dev_time_tracker_t tt;
+    uint32_t (*dev_to_host32)(uint32_t);
+    uint64_t sum;
+};
+
+// per message callback as written against sc_can_stream_init
+static int on_rx(void* ctx, void const* ptr, uint16_t bytes)
+{
+    struct sink* s = static_cast<struct sink*>(ctx);
+    struct sc_msg_header const* msg = static_cast<struct sc_msg_header const*>(ptr);
+
+    (void)bytes;
+
+    switch (msg->id) {
+    case SC_MSG_CAN_RX: {
+        struct sc_msg_can_rx const* rx = static_cast<struct sc_msg_can_rx const*>(ptr);
+        uint32_t can_id = s->dev_to_host32(rx->can_id);
+        uint64_t ts = sc_tt_track(&s->tt, s->dev_to_host32(rx->timestamp_us));
+
+        s->sum += can_id + ts + rx->data[0];
+    } break;
+    default:
+        break;
+    }
+
+    return 0;
+}
+
+// mirrors the per message loop of the DLL
+static int dispatch_per_message(uint8_t const* ptr, size_t bytes, struct sink* s, int (*callback)(void*, void const*, uint16_t))
+{
+    for (size_t offset = 0; offset + SC_MSG_CAN_LEN_MULTIPLE <= bytes; ) {
+        struct sc_msg_header const* msg = (struct sc_msg_header const*)(ptr + offset);
+
+        if (!msg->id || !msg->len) {
+            break;
+        }
+
+        if (msg->len < SC_MSG_CAN_LEN_MULTIPLE || offset + msg->len > bytes) {
+            return SC_DLL_ERROR_PROTO_VIOLATION;
+        }
+
+        int error = callback(s, msg, msg->len);
+        if (error) {
+            return error;
+        }
+
+        offset += msg->len;
+    }
+
+    return SC_DLL_ERROR_NONE;
+}
+
+BENCH(rx_decode_per_message_callback)
+{
+    struct sink s;
+    uint64_t items = 0;
+    int (* volatile callback)(void*, void const*, uint16_t) = on_rx;
+    uint32_t (* volatile swap)(uint32_t) = nop32;
+
+    sc_tt_init(&s.tt);
+    s.dev_to_host32 = swap;
+    s.sum = 0;
+
+    for (uint64_t i = 0; i < iterations; ++i) {
+        dispatch_per_message(s_buffer.data.data(), s_buffer.data.size(), &s, callback);
+        items += s_buffer.data.size() / (sizeof(struct sc_msg_can_rx) + 8);
+    }
+
+    bench::keep(s.sum);
+
+    return items;
+}
+
+BENCH(rx_decode_batch)
+{
+    sc_rx_decoder_t dec;
+    sc_can_frame_t frames[SC_CAN_FRAME_COUNT(BUFFER_SIZE)];
+    uint64_t sum = 0;
+    uint64_t items = 0;
+
+    sc_rx_decoder_init(&dec, 0);
+
+    for (uint64_t i = 0; i < iterations; ++i) {
+        size_t offset = 0;
+        size_t count = 0;
+
+        sc_rx_decode(&dec, s_buffer.data.data(), s_buffer.data.size(), &offset, frames, sizeof(frames) / sizeof(frames[0]), &count);
+
+        for (size_t j = 0; j < count; ++j) {
+            sum += frames[j].can_id + frames[j].timestamp_us + frames[j].data[0];
+        }
+
+        items += count;
+    }
+
+    bench::keep(sum);
+
+    return items;
+}
+
+} // anon
@@ -0,0 +1,119 @@
+#include "bench.h"
+
+#include <cstring>
+
+#include "supercan_proto.h"
+#include "supercan_error.h"
+#include "supercan_cmd.h"
+#include "supercan_sim.h"
+#include "supercan_stream.h"
+
+namespace
+{
+
+enum {
+    EPP_SIZE = 64,
+    RX_COUNT = 8,
+};
+
+struct sim_bench
+{
+    sc_sim_config_t config;
+    sc_sim_t sim;
+    sc_transport_t can;
+    sc_stream_core_t core;
+    uint64_t sum;
+    uint64_t txr;
+
+    explicit sim_bench(uint32_t rx_rate_hz)
+        : sum(0)
+        , txr(0)
+    {
+        sc_sim_config_init(&config);
+        config.rx_rate_hz = rx_rate_hz;
+        config.echo = 0;
+        config.in_transfers = RX_COUNT;
+        sc_sim_init(&sim, &config);
+        sc_sim_can_transport(&sim, &can);
+        sc_stream_core_init(&core, &can, config.msg_buffer_size, EPP_SIZE, RX_COUNT, 0);
+        sc_stream_core_set_rx_batch_callback(&core, this, &sim_bench::on_rx_batch, 0);
+        sc_stream_core_start(&core);
+        go_on_bus();
+    }
+
+    ~sim_bench()
+    {
+        sc_stream_core_uninit(&core);
+        sc_sim_uninit(&sim);
+    }
+
+    void go_on_bus()
+    {
+        sc_transport_t cmd;
+        struct sc_msg_config msg;
+        uint8_t rsp[64];
+
+        msg.id = SC_MSG_BUS;
+        msg.len = sizeof(msg);
+        msg.arg = 1;
+
+        sc_sim_cmd_transport(&sim, &cmd);
+        sc_cmd_exchange(&cmd, (uint8_t const*)&msg, sizeof(msg), rsp, sizeof(rsp), nullptr, 0);
+    }
+
+    static int on_rx_batch(void* ctx, sc_can_frame_t const* frames, size_t count)
+    {
+        sim_bench* self = static_cast<sim_bench*>(ctx);
+
+        for (size_t i = 0; i < count; ++i) {
+            self->sum += frames[i].can_id;
+            self->txr += frames[i].type == SC_MSG_CAN_TXR;
+        }
+
+        return SC_DLL_ERROR_NONE;
+    }
+
+    void drain()
+    {
+        while (SC_DLL_ERROR_NONE == sc_stream_core_rx(&core, 0));
+    }
+};
+
+/* 1 MHz frame rate fills about one transfer per advance */
+BENCH(sim_stream_rx)
+{
+    sim_bench b(1000000);
+
+    for (uint64_t i = 0; i < iterations; ++i) {
+        sc_sim_advance(&b.sim, 20);
+        b.drain();
+    }
+
+    bench::keep(b.sum);
+
+    return b.sim.stats.rx;
+}
+
+BENCH(sim_stream_tx_txr_round_trip)
+{
+    sim_bench b(0);
+    uint8_t msg[sizeof(struct sc_msg_can_tx4) + 8] = { SC_MSG_CAN_TX4, sizeof(msg), 8, SC_CAN_FRAME_FLAG_TX4 };
+    uint8_t const* buffers[] = { msg };
+    uint16_t const sizes[] = { sizeof(msg) };
+
+    for (uint64_t i = 0; i < iterations; ++i) {
+        size_t added = 0;
+
+        msg[8] = (uint8_t)i; // track id
+        sc_stream_core_tx_batch_begin(&b.core);
+        sc_stream_core_tx_batch_add(&b.core, buffers, sizes, 1, &added);
+        sc_stream_core_tx_batch_end(&b.core);
+        b.drain();
+    }
+
+    bench::keep(b.sum);
+
+    return b.txr;
+}
+
+} // anon
@@ -0,0 +1,278 @@
+#include "bench.h"
+
+#include <cstring>
+#include <vector>
+
+#include "supercan_proto.h"
+#include "supercan_error.h"
+#include "supercan_loopback.h"
+#include "supercan_stream.h"
+
+namespace
+{
+
+enum {
+    BUFFER_SIZE = 512,
+    EPP_SIZE = 64,
+    RX_COUNT = 8,
+    MSG_SIZE = sizeof(struct sc_msg_can_rx) + 8,
+    MSGS_PER_TRANSFER = BUFFER_SIZE / MSG_SIZE,
+};
+
+struct stream_bench
+{
+    sc_loopback_t lb;
+    sc_transport_t t;
+    sc_stream_core_t core;
+    std::vector<uint8_t> transfer;
+    uint64_t sum;
+
+    stream_bench()
+        : transfer(BUFFER_SIZE)
+        , sum(0)
+    {
+        sc_loopback_init(&lb, BUFFER_SIZE, RX_COUNT, RX_COUNT);
+        sc_loopback_set_write_callback(&lb, this, &stream_bench::on_write);
+        sc_loopback_transport(&lb, &t);
+        sc_stream_core_init(&core, &t, BUFFER_SIZE, EPP_SIZE, RX_COUNT, 0);
+
+        for (size_t i = 0; i < MSGS_PER_TRANSFER; ++i) {
+            struct sc_msg_can_rx* rx = (struct sc_msg_can_rx*)&transfer[i * MSG_SIZE];
+            rx->id = SC_MSG_CAN_RX;
+            rx->len = MSG_SIZE;
+            rx->dlc = 8;
+            rx->flags = 0;
+            rx->can_id = (uint32_t)i;
+            rx->timestamp_us = (uint32_t)i * 130;
+            memset(rx->data, (int)i, 8);
+        }
+    }
+
+    ~stream_bench()
+    {
+        sc_stream_core_uninit(&core);
+        sc_loopback_uninit(&lb);
+    }
+
+    static int on_write(void* ctx, uint8_t const* ptr, size_t bytes)
+    {
+        stream_bench* self = static_cast<stream_bench*>(ctx);
+        self->sum += ptr[0] + bytes;
+        return SC_DLL_ERROR_NONE;
+    }
+
+    static int on_rx(void* ctx, void const* ptr, uint16_t bytes)
+    {
+        stream_bench* self = static_cast<stream_bench*>(ctx);
+        struct sc_msg_can_rx const* rx = static_cast<struct sc_msg_can_rx const*>(ptr);
+        self->sum += rx->can_id + rx->data[0] + bytes;
+        return SC_DLL_ERROR_NONE;
+    }
+
+    static int on_rx_batch(void* ctx, sc_can_frame_t const* frames, size_t count)
+    {
+        stream_bench* self = static_cast<stream_bench*>(ctx);
+        for (size_t i = 0; i < count; ++i) {
+            self->sum += frames[i].can_id + frames[i].data[0];
+        }
+        return SC_DLL_ERROR_NONE;
+    }
+
+    uint64_t rx(uint64_t iterations)
+    {
+        sc_stream_core_start(&core);
+
+        for (uint64_t i = 0; i < iterations; ++i) {
+            sc_loopback_push(&lb, transfer.data(), transfer.size());
+            sc_stream_core_rx(&core, 0);
+        }
+
+        bench::keep(sum);
+
+        return iterations * MSGS_PER_TRANSFER;
+    }
+};
+
+BENCH(stream_rx_loopback_per_message)
+{
+    stream_bench b;
+    sc_stream_core_set_rx_callback(&b.core, &b, &stream_bench::on_rx);
+    return b.rx(iterations);
+}
+
+BENCH(stream_rx_loopback_batch)
+{
+    stream_bench b;
+    sc_stream_core_set_rx_batch_callback(&b.core, &b, &stream_bench::on_rx_batch, 0);
+    return b.rx(iterations);
+}
+
+BENCH(stream_tx_loopback_batch_add)
+{
+    stream_bench b;
+    uint8_t msg[sizeof(struct sc_msg_can_tx4) + 8] = { SC_MSG_CAN_TX4, sizeof(msg) };
+    uint8_t const* buffers[MSGS_PER_TRANSFER];
+    uint16_t sizes[MSGS_PER_TRANSFER];
+    uint64_t items = 0;
+
+    for (size_t i = 0; i < MSGS_PER_TRANSFER; ++i) {
+        buffers[i] = msg;
+        sizes[i] = sizeof(msg);
+    }
+
+    for (uint64_t i = 0; i < iterations; ++i) {
+        size_t added = 0;
+
+        sc_stream_core_tx_batch_begin(&b.core);
+        sc_stream_core_tx_batch_add(&b.core, buffers, sizes, MSGS_PER_TRANSFER, &added);
+        sc_stream_core_tx_batch_end(&b.core);
+        items += added;
+    }
+
+    bench::keep(b.sum);
+
+    return items;
+}
+
+/* Encoding of a TX4 message per frame as done by the COM server */
+struct tx_frame
+{
+    uint32_t can_id;
+    uint8_t dlc;
+    uint8_t flags;
+    uint8_t track_id;
+    uint8_t data[64];
+};
+
+enum {
+    TX4_SIZE = sizeof(struct sc_msg_can_tx4) + 8,
+    TX4_PER_TRANSFER = BUFFER_SIZE / TX4_SIZE,
+};
+
+static inline void encode_tx4(uint8_t* ptr, tx_frame const& f)
+{
+    struct sc_msg_can_tx4* tx = (struct sc_msg_can_tx4*)ptr;
+
+    tx->id = SC_MSG_CAN_TX4;
+    tx->len = TX4_SIZE;
+    tx->dlc = f.dlc;
+    tx->flags = f.flags;
+    tx->can_id = f.can_id;
+    tx->track_id = f.track_id;
+    memset(tx->reserved, 0, sizeof(tx->reserved));
+    memcpy(tx->data, f.data, 8);
+}
+
+BENCH(stream_tx_encode_batch_add)
+{
+    stream_bench b;
+    uint32_t msg[TX4_SIZE / 4];
+    tx_frame f;
+
+    memset(&f, 0x5a, sizeof(f));
+    f.dlc = 8;
+    f.flags = 0;
+
+    for (uint64_t i = 0; i < iterations; ++i) {
+        sc_stream_core_tx_batch_begin(&b.core);
+
+        for (size_t j = 0; j < TX4_PER_TRANSFER; ++j) {
+            uint8_t const* buffer = (uint8_t const*)msg;
+            uint16_t size = TX4_SIZE;
+            size_t added = 0;
+
+            f.track_id = (uint8_t)j;
+            encode_tx4((uint8_t*)msg, f);
+            sc_stream_core_tx_batch_add(&b.core, &buffer, &size, 1, &added);
+        }
+
+        sc_stream_core_tx_batch_end(&b.core);
+    }
+
+    bench::keep(b.sum);
+
+    return iterations * TX4_PER_TRANSFER;
+}
+
+BENCH(stream_tx_encode_reserve_commit)
+{
+    stream_bench b;
+    tx_frame f;
+
+    memset(&f, 0x5a, sizeof(f));
+    f.dlc = 8;
+    f.flags = 0;
+
+    for (uint64_t i = 0; i < iterations; ++i) {
+        sc_stream_core_tx_batch_begin(&b.core);
+
+        for (size_t j = 0; j < TX4_PER_TRANSFER; ++j) {
+            uint8_t* ptr = nullptr;
+
+            f.track_id = (uint8_t)j;
+            sc_stream_core_tx_reserve(&b.core, TX4_SIZE, &ptr);
+            encode_tx4(ptr, f);
+            sc_stream_core_tx_commit(&b.core, TX4_SIZE);
+        }
+
+        sc_stream_core_tx_batch_end(&b.core);
+    }
+
+    bench::keep(b.sum);
+
+    return iterations * TX4_PER_TRANSFER;
+}
+
+/* Flush after each frame as done by callers on every wake-up */
+BENCH(stream_tx_flush_per_frame)
+{
+    stream_bench b;
+    tx_frame f;
+
+    memset(&f, 0x5a, sizeof(f));
+    f.dlc = 8;
+    f.flags = 0;
+
+    for (uint64_t i = 0; i < iterations; ++i) {
+        uint8_t* ptr = nullptr;
+
+        sc_stream_core_tx_batch_begin(&b.core);
+        sc_stream_core_tx_reserve(&b.core, TX4_SIZE, &ptr);
+        encode_tx4(ptr, f);
+        sc_stream_core_tx_commit(&b.core, TX4_SIZE);
+        sc_stream_core_tx_batch_end(&b.core);
+    }
+
+    bench::keep(b.sum);
+
+    return iterations;
+}
+
+BENCH(stream_tx_auto_flush)
+{
+    stream_bench b;
+    sc_stream_tx_flush_t policy;
+    tx_frame f;
+
+    memset(&policy, 0, sizeof(policy));
+    memset(&f, 0x5a, sizeof(f));
+    f.dlc = 8;
+    f.flags = 0;
+
+    sc_stream_core_set_tx_auto_flush(&b.core, &policy);
+
+    for (uint64_t i = 0; i < iterations; ++i) {
+        uint8_t* ptr = nullptr;
+
+        sc_stream_core_tx_reserve(&b.core, TX4_SIZE, &ptr);
+        encode_tx4(ptr, f);
+        sc_stream_core_tx_commit(&b.core, TX4_SIZE);
+    }
+
+    sc_stream_core_tx_batch_end(&b.core);
+    bench::keep(b.sum);
+
+    return iterations;
+}
+
+} // anon
@@ -0,0 +1,173 @@
+#include "bench.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+#include "supercan_track.h"
+
+/* Track id allocation as done by the COM server's TX thread
+ *
+ * The device is modeled in the same thread: the TX side fills the TX
+ * FIFO, then the device reports a USB transfer's worth of frames as
+ * transmitted. This measures allocator overhead without depending on
+ * the scheduler.
+ */
+
+namespace
+{
+
+enum {
+    FIFO = 32,
+    TXR_BATCH = 8,
+    FREE = 0xff, // map entry marker of a free slot, like MAX_COM_DEVICES_PER_SC_DEVICE
+};
+
+// frames in the device's TX FIFO
+struct device_fifo
+{
+    uint32_t ids[SC_TRACK_IDS];
+    uint32_t put;
+    uint32_t get;
+
+    device_fifo()
+        : put(0)
+        , get(0)
+    {}
+
+    uint32_t size() const { return put - get; }
+    void push(uint32_t id) { ids[put++ % SC_TRACK_IDS] = id; }
+    uint32_t pop() { return ids[get++ % SC_TRACK_IDS]; }
+};
+
+// portable stand-in for the Win32 semaphore
+class semaphore
+{
+public:
+    explicit semaphore(uint32_t count)
+        : m_Count(count)
+    {}
+
+    void acquire()
+    {
+        std::unique_lock<std::mutex> g(m_Lock);
+
+        m_Cond.wait(g, [this] { return m_Count > 0; });
+        --m_Count;
+    }
+
+    void release()
+    {
+        {
+            std::lock_guard<std::mutex> g(m_Lock);
+            ++m_Count;
+        }
+
+        m_Cond.notify_one();
+    }
+
+private:
+    std::mutex m_Lock;
+    std::condition_variable m_Cond;
+    uint32_t m_Count;
+};
+
+// one semaphore wait per frame plus a linear scan of the TXR map
+uint64_t run_scan(uint64_t iterations)
+{
+    std::atomic<uint32_t> map[SC_TRACK_IDS];
+    semaphore credits(FIFO);
+    device_fifo fifo;
+    uint64_t sent = 0;
+    uint64_t sum = 0;
+
+    for (size_t i = 0; i < SC_TRACK_IDS; ++i) {
+        map[i].store(FREE, std::memory_order_relaxed);
+    }
+
+    while (sent < iterations) {
+        while (fifo.size() < FIFO && sent < iterations) {
+            size_t slot = SC_TRACK_IDS;
+
+            credits.acquire();
+
+            for (size_t j = 0; j < SC_TRACK_IDS; ++j) {
+                if (FREE == map[j].load(std::memory_order_acquire)) {
+                    slot = j;
+                    break;
+                }
+            }
+
+            map[slot].store(0, std::memory_order_release);
+            fifo.push((uint32_t)slot);
+            ++sent;
+        }
+
+        for (uint32_t k = 0; k < TXR_BATCH && fifo.size(); ++k) {
+            uint32_t const id = fifo.pop();
+
+            sum += id;
+            map[id].store(FREE, std::memory_order_release);
+            credits.release();
+        }
+    }
+
+    bench::keep(sum);
+
+    return sent;
+}
+
+// bitmap allocator, credits come with the ids
+uint64_t run_bitmap(uint64_t iterations)
+{
+    std::atomic<uint32_t> map[SC_TRACK_IDS];
+    sc_track_ids_t ids;
+    device_fifo fifo;
+    uint64_t sent = 0;
+    uint64_t sum = 0;
+
+    sc_track_ids_init(&ids, FIFO);
+
+    for (size_t i = 0; i < SC_TRACK_IDS; ++i) {
+        map[i].store(FREE, std::memory_order_relaxed);
+    }
+
+    while (sent < iterations) {
+        while (sent < iterations) {
+            int const id = sc_track_id_alloc(&ids);
+
+            if (id < 0) {
+                sc_track_ids_wait(&ids);
+                break;
+            }
+
+            map[id].store(0, std::memory_order_release);
+            fifo.push((uint32_t)id);
+            ++sent;
+        }
+
+        for (uint32_t k = 0; k < TXR_BATCH && fifo.size(); ++k) {
+            uint32_t const id = fifo.pop();
+
+            sum += id;
+            map[id].store(FREE, std::memory_order_release);
+            sum += (uint64_t)sc_track_id_free(&ids, id);
+        }
+    }
+
+    bench::keep(sum);
+
+    return sent;
+}
+
+} // anon
+
+BENCH(track_id_scan_semaphore)
+{
+    return run_scan(iterations);
+}
+
+BENCH(track_id_bitmap)
+{
+    return run_bitmap(iterations);
+}
@@ -0,0 +1,286 @@
+#include <CppUnitLite2.h>
+#include <cstring>
+
+#include "supercan_proto.h"
+#include "supercan_error.h"
+#include "supercan_loopback.h"
+#include "supercan_cmd.h"
+#include "supercan_sim.h"
+
+namespace
+{
+
+struct cmd_fixture
+{
+    sc_loopback_t lb;
+    sc_transport_t t;
+    uint8_t tx[64];
+    uint8_t rx[64];
+    int write_error;
+
+    cmd_fixture()
+        : write_error(SC_DLL_ERROR_NONE)
+    {
+        sc_loopback_init(&lb, sizeof(rx), 1, 1);
+        sc_loopback_transport(&lb, &t);
+        memset(tx, 0, sizeof(tx));
+        memset(rx, 0, sizeof(rx));
+    }
+
+    ~cmd_fixture()
+    {
+        sc_loopback_uninit(&lb);
+    }
+
+    static int on_write(void* ctx, uint8_t const* ptr, size_t bytes)
+    {
+        cmd_fixture* self = static_cast<cmd_fixture*>(ctx);
+        (void)ptr;
+        (void)bytes;
+        return self->write_error;
+    }
+};
+
+TEST_F(cmd_fixture, exchange_rejects_invalid_params)
+{
+    uint16_t size = 0;
+
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, sc_cmd_exchange(nullptr, tx, 4, rx, sizeof(rx), &size, 0));
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, sc_cmd_exchange(&t, tx, 0, rx, sizeof(rx), &size, 0));
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, sc_cmd_exchange(&t, tx, 4, rx, 0, &size, 0));
+}
+
+TEST_F(cmd_fixture, exchange_returns_response)
+{
+    uint16_t size = 0;
+
+    // loopback without write callback echos the request
+    tx[0] = 0x42;
+    tx[7] = 0x17;
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_cmd_exchange(&t, tx, 8, rx, sizeof(rx), &size, 0));
+    CHECK_EQUAL(8, size);
+    CHECK_EQUAL(0x42, rx[0]);
+    CHECK_EQUAL(0x17, rx[7]);
+
+    // request slots are free again
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_cmd_exchange(&t, tx, 4, rx, sizeof(rx), nullptr, 0));
+}
+
+TEST_F(cmd_fixture, exchange_times_out_without_response)
+{
+    uint16_t size = 1;
+
+    sc_loopback_set_write_callback(&lb, this, &cmd_fixture::on_write);
+    CHECK_EQUAL(SC_DLL_ERROR_TIMEOUT, sc_cmd_exchange(&t, tx, 4, rx, sizeof(rx), &size, 0));
+    CHECK_EQUAL(0, size);
+    CHECK_EQUAL(0, lb.reads[0].pending);
+}
+
+TEST_F(cmd_fixture, exchange_cancels_write_on_timeout)
+{
+    sc_loopback_set_write_callback(&lb, this, &cmd_fixture::on_write);
+    write_error = SC_DLL_ERROR_AGAIN;
+    CHECK_EQUAL(SC_DLL_ERROR_TIMEOUT, sc_cmd_exchange(&t, tx, 4, rx, sizeof(rx), nullptr, 0));
+    CHECK_EQUAL(0, lb.writes[0].pending);
+    CHECK_EQUAL(0, lb.reads[0].pending);
+}
+
+struct batch_fixture
+{
+    sc_sim_t sim;
+    sc_transport_t t;
+    sc_cmd_batch_t batch;
+    sc_cmd_reply_t replies[16];
+    uint8_t tx[64];
+    uint8_t rx[64];
+
+    batch_fixture()
+    {
+        sc_sim_init(&sim, nullptr);
+        sc_sim_cmd_transport(&sim, &t);
+        sc_cmd_batch_init(&batch, tx, sizeof(tx));
+        memset(replies, 0, sizeof(replies));
+    }
+
+    ~batch_fixture()
+    {
+        sc_sim_uninit(&sim);
+    }
+
+    int features(uint8_t op, uint32_t arg)
+    {
+        struct sc_msg_features* msg = nullptr;
+
+        int error = sc_cmd_batch_add(&batch, sizeof(*msg), reinterpret_cast<void**>(&msg));
+
+        if (error) {
+            return error;
+        }
+
+        msg->id = SC_MSG_FEATURES;
+        msg->op = op;
+        msg->arg = arg;
+
+        return SC_DLL_ERROR_NONE;
+    }
+
+    int bittiming(uint8_t id, uint16_t brp, uint16_t tseg1, uint8_t tseg2, uint8_t sjw)
+    {
+        struct sc_msg_bittiming* msg = nullptr;
+
+        int error = sc_cmd_batch_add(&batch, sizeof(*msg), reinterpret_cast<void**>(&msg));
+
+        if (error) {
+            return error;
+        }
+
+        msg->id = id;
+        msg->brp = brp;
+        msg->tseg1 = tseg1;
+        msg->tseg2 = tseg2;
+        msg->sjw = sjw;
+
+        return SC_DLL_ERROR_NONE;
+    }
+
+    int bus(bool on)
+    {
+        struct sc_msg_config* msg = nullptr;
+
+        int error = sc_cmd_batch_add(&batch, sizeof(*msg), reinterpret_cast<void**>(&msg));
+
+        if (error) {
+            return error;
+        }
+
+        msg->id = SC_MSG_BUS;
+        msg->arg = on;
+
+        return SC_DLL_ERROR_NONE;
+    }
+
+    int run()
+    {
+        return sc_cmd_batch_run(&t, &batch, rx, sizeof(rx), replies, 0);
+    }
+};
+
+TEST_F(batch_fixture, batch_add_pads_and_zeroes_requests)
+{
+    void* msg = nullptr;
+
+    memset(tx, 0xff, sizeof(tx));
+
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, sc_cmd_batch_add(&batch, 1, &msg));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_cmd_batch_add(&batch, 5, &msg));
+    CHECK(msg == tx);
+    CHECK_EQUAL(8, batch.size);
+    CHECK_EQUAL(1, batch.count);
+    CHECK_EQUAL(0, tx[0]);
+    CHECK_EQUAL(8, tx[1]);
+
+    for (size_t i = 2; i < 8; ++i) {
+        CHECK_EQUAL(0, tx[i]);
+    }
+
+    CHECK_EQUAL(0xff, tx[8]);
+}
+
+TEST_F(batch_fixture, batch_add_fails_when_buffer_is_full)
+{
+    void* msg = nullptr;
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_cmd_batch_add(&batch, 56, &msg));
+    CHECK_EQUAL(SC_DLL_ERROR_BUFFER_TOO_SMALL, sc_cmd_batch_add(&batch, 12, &msg));
+    CHECK_EQUAL(56, batch.size);
+    CHECK_EQUAL(1, batch.count);
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_cmd_batch_add(&batch, 8, &msg));
+    CHECK_EQUAL(64, batch.size);
+    CHECK_EQUAL(SC_DLL_ERROR_BUFFER_TOO_SMALL, sc_cmd_batch_add(&batch, 4, &msg));
+}
+
+TEST_F(batch_fixture, batch_run_configures_device_in_one_round_trip)
+{
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, features(SC_FEAT_OP_CLEAR, 0));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, features(SC_FEAT_OP_OR, SC_FEATURE_FLAG_FDF));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, bittiming(SC_MSG_NM_BITTIMING, 4, 31, 8, 8));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, bittiming(SC_MSG_DT_BITTIMING, 2, 7, 2, 2));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, bus(true));
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, run());
+    CHECK_EQUAL(5u, sim.stats.commands);
+
+    for (unsigned i = 0; i < 5; ++i) {
+        CHECK_EQUAL(SC_MSG_ERROR, replies[i].msg[0]);
+        CHECK_EQUAL(SC_ERROR_NONE, replies[i].error);
+    }
+
+    CHECK_EQUAL(SC_FEATURE_FLAG_FDF, sim.features & SC_FEATURE_FLAG_FDF);
+    CHECK_EQUAL(4, sim.nm_brp);
+    CHECK_EQUAL(31, sim.nm_tseg1);
+    CHECK_EQUAL(2, sim.dt_brp);
+    CHECK_EQUAL(7, sim.dt_tseg1);
+    CHECK_EQUAL(1, sim.bus_on);
+}
+
+TEST_F(batch_fixture, batch_run_reports_errors_per_request)
+{
+    struct sc_msg_header* msg = nullptr;
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, bittiming(SC_MSG_NM_BITTIMING, 0, 31, 8, 8));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, bus(true));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_cmd_batch_add(&batch, 4, reinterpret_cast<void**>(&msg)));
+    msg->id = 0xfe;
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, run());
+    CHECK_EQUAL(SC_ERROR_PARAM, replies[0].error);
+    CHECK_EQUAL(SC_ERROR_NONE, replies[1].error);
+    CHECK_EQUAL(SC_ERROR_UNSUPPORTED, replies[2].error);
+}
+
+TEST_F(batch_fixture, batch_run_returns_info_replies)
+{
+    struct sc_msg_req* req = nullptr;
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_cmd_batch_add(&batch, sizeof(*req), reinterpret_cast<void**>(&req)));
+    req->id = SC_MSG_DEVICE_INFO;
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, bus(true));
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, run());
+    CHECK_EQUAL(SC_MSG_DEVICE_INFO, replies[0].msg[0]);
+    CHECK_EQUAL(SC_ERROR_NONE, replies[0].error);
+    CHECK(replies[1].msg == replies[0].msg + replies[0].msg[1]);
+    CHECK_EQUAL(SC_MSG_ERROR, replies[1].msg[0]);
+}
+
+TEST_F(batch_fixture, batch_parse_rejects_missing_replies)
+{
+    struct sc_msg_error* e = reinterpret_cast<struct sc_msg_error*>(rx);
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, bus(false));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, bus(true));
+
+    memset(rx, 0, sizeof(rx));
+    e->id = SC_MSG_ERROR;
+    e->len = sizeof(*e);
+
+    CHECK_EQUAL(SC_DLL_ERROR_PROTO_VIOLATION, sc_cmd_batch_parse(&batch, rx, sizeof(*e), replies));
+    CHECK_EQUAL(SC_DLL_ERROR_PROTO_VIOLATION, sc_cmd_batch_parse(&batch, rx, sizeof(rx), replies));
+
+    e[1] = e[0];
+    e[1].len = 2 * sizeof(*e);
+    CHECK_EQUAL(SC_DLL_ERROR_PROTO_VIOLATION, sc_cmd_batch_parse(&batch, rx, 2 * sizeof(*e), replies));
+
+    e[1].len = sizeof(*e);
+    e[1].error = SC_ERROR_BUSY;
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_cmd_batch_parse(&batch, rx, 2 * sizeof(*e), replies));
+    CHECK_EQUAL(SC_ERROR_BUSY, replies[1].error);
+}
+
+TEST_F(batch_fixture, batch_run_rejects_empty_batch)
+{
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, run());
+    CHECK_EQUAL(0u, sim.stats.commands);
+}
+
+} // anon
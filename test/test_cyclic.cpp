@@ -0,0 +1,327 @@
+#include <CppUnitLite2.h>
+
+#include <string.h>
+
+#include <vector>
+
+#include "supercan_error.h"
+#include "supercan_cyclic.h"
+
+namespace
+{
+
+sc::cyclic_tx_def make_def(uint32_t can_id, uint32_t period_us, uint32_t phase_us, uint32_t count)
+{
+    sc::cyclic_tx_def def;
+
+    memset(&def, 0, sizeof(def));
+    def.can_id = can_id;
+    def.period_us = period_us;
+    def.phase_us = phase_us;
+    def.count = count;
+    def.dlc = 2;
+    def.data[0] = static_cast<uint8_t>(can_id);
+    def.data[1] = static_cast<uint8_t>(can_id >> 8);
+
+    return def;
+}
+
+struct sent_frame
+{
+    uint64_t at_us;
+    uint32_t can_id;
+    uint32_t track_id;
+    uint8_t owner;
+};
+
+// takes all queued frames
+void drain(sc::cyclic_tx* cyclic, uint64_t now_us, std::vector<sent_frame>* sent)
+{
+    sc_mm_can_tx const* frame = nullptr;
+    uint8_t owner = 0;
+
+    while (cyclic->front(&owner, &frame)) {
+        sent_frame f;
+
+        f.at_us = now_us;
+        f.can_id = frame->can_id;
+        f.track_id = frame->track_id;
+        f.owner = owner;
+        sent->push_back(f);
+        cyclic->pop();
+    }
+}
+
+TEST (cyclic_tx_validates_definitions)
+{
+    sc::cyclic_tx cyclic;
+    sc::cyclic_tx_def def;
+    uint32_t handle = 0;
+    uint32_t handles[2];
+
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, cyclic.init(0));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, cyclic.init(2));
+
+    def = make_def(0x100, sc::cyclic_tx::MIN_TICK_US - 1, 0, 0);
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, cyclic.add(0, &def, &handle));
+
+    def = make_def(0x800, 1000, 0, 0);
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, cyclic.add(0, &def, &handle));
+    def.flags = SC_CAN_FRAME_FLAG_EXT;
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, cyclic.add(0, &def, &handles[0]));
+
+    def = make_def(0x100, 1000, 0, 0);
+    def.dlc = 9;
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, cyclic.add(0, &def, &handle));
+    def.flags = SC_CAN_FRAME_FLAG_FDF | SC_CAN_FRAME_FLAG_RTR;
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, cyclic.add(0, &def, &handle));
+    def.flags = SC_CAN_FRAME_FLAG_FDF | SC_CAN_FRAME_FLAG_BRS;
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, cyclic.add(0, &def, &handles[1]));
+    CHECK(handles[0] != 0);
+    CHECK(handles[1] != 0);
+    CHECK(handles[0] != handles[1]);
+
+    // full
+    CHECK_EQUAL(SC_DLL_ERROR_OUT_OF_MEM, cyclic.add(0, &def, &handle));
+
+    // wrong owner, unknown handle
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, cyclic.remove(1, handles[0]));
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, cyclic.remove(0, 0));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, cyclic.remove(0, handles[0]));
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, cyclic.remove(0, handles[0]));
+
+    // slot is reused with a new handle
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, cyclic.add(0, &def, &handle));
+    CHECK(handle != handles[0]);
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, cyclic.remove(0, handles[0]));
+
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, cyclic.set_tick(sc::cyclic_tx::MIN_TICK_US - 1));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, cyclic.set_tick(sc::cyclic_tx::MIN_TICK_US));
+}
+
+TEST (cyclic_tx_keeps_phase_and_period)
+{
+    std::vector<sent_frame> sent;
+    sc::cyclic_tx cyclic;
+    sc::cyclic_tx_def def = make_def(0x123, 1000, 250, 0);
+    uint32_t handle = 0;
+    uint64_t const start_us = 1000000;
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, cyclic.init(16));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, cyclic.set_tick(100));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, cyclic.add(3, &def, &handle));
+    CHECK(cyclic.apply(start_us));
+    CHECK(!cyclic.apply(start_us));
+    CHECK_EQUAL(100u, cyclic.tick_us());
+
+    // nothing happens before the start
+    cyclic.run(start_us + 10000);
+    CHECK(!cyclic.queued());
+    CHECK_EQUAL(uint64_t(sc::cyclic_tx::NEVER), cyclic.next_us());
+
+    cyclic.start(start_us);
+
+    for (uint64_t now = start_us; now < start_us + 10000; now += 10) {
+        cyclic.run(now);
+        drain(&cyclic, now, &sent);
+    }
+
+    CHECK_EQUAL(10u, sent.size());
+
+    for (size_t i = 0; i < sent.size(); ++i) {
+        uint64_t const due = start_us + 250 + i * 1000;
+
+        // rounded up to the next tick
+        CHECK_EQUAL(due + 50, sent[i].at_us);
+        CHECK_EQUAL(0x123u, sent[i].can_id);
+        CHECK_EQUAL(handle, sent[i].track_id);
+        CHECK_EQUAL(3u, sent[i].owner);
+    }
+}
+
+TEST (cyclic_tx_stops_after_count)
+{
+    std::vector<sent_frame> sent;
+    sc::cyclic_tx cyclic;
+    sc::cyclic_tx_def def = make_def(0x10, 5000, 0, 3);
+    uint32_t handle = 0;
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, cyclic.init(16));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, cyclic.add(0, &def, &handle));
+    cyclic.start(0);
+    cyclic.apply(0);
+
+    for (uint64_t now = 0; now < 100000; now += 100) {
+        cyclic.run(now);
+        drain(&cyclic, now, &sent);
+    }
+
+    CHECK_EQUAL(3u, sent.size());
+    CHECK_EQUAL(uint64_t(sc::cyclic_tx::NEVER), cyclic.next_us());
+
+    // bus on starts over
+    cyclic.start(200000);
+    cyclic.run(200000);
+    drain(&cyclic, 200000, &sent);
+    CHECK_EQUAL(4u, sent.size());
+}
+
+TEST (cyclic_tx_counts_overruns_and_skips)
+{
+    sc::cyclic_tx_stats stats;
+    sc::cyclic_tx cyclic;
+    sc::cyclic_tx_def def = make_def(0x10, 1000, 0, 0);
+    std::vector<sent_frame> sent;
+    uint32_t handle = 0;
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, cyclic.init(16));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, cyclic.add(0, &def, &handle));
+    cyclic.apply(0);
+    cyclic.start(0);
+
+    // TX FIFO full, frame stays queued
+    cyclic.run(0);
+    cyclic.run(1000);
+    cyclic.run(2000);
+    cyclic.stats(&stats);
+    CHECK_EQUAL(1u, stats.queued);
+    CHECK_EQUAL(2u, stats.overruns);
+    CHECK_EQUAL(0u, stats.skipped);
+
+    drain(&cyclic, 2000, &sent);
+    CHECK_EQUAL(1u, sent.size());
+
+    // late by several periods, stays on the grid
+    cyclic.run(5500);
+    cyclic.stats(&stats);
+    CHECK_EQUAL(2u, stats.queued);
+    CHECK_EQUAL(2u, stats.skipped);
+    CHECK_EQUAL(6000u, cyclic.next_us());
+}
+
+TEST (cyclic_tx_remove_drops_queued_frames)
+{
+    std::vector<sent_frame> sent;
+    sc::cyclic_tx cyclic;
+    sc::cyclic_tx_def def;
+    uint32_t handles[3];
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, cyclic.init(16));
+
+    for (uint32_t i = 0; i < 3; ++i) {
+        def = make_def(0x100 + i, 1000, 0, 0);
+        CHECK_EQUAL(SC_DLL_ERROR_NONE, cyclic.add(i == 2 ? 1 : 0, &def, &handles[i]));
+    }
+
+    cyclic.start(0);
+    cyclic.apply(0);
+    cyclic.run(0);
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, cyclic.remove(0, handles[1]));
+    cyclic.remove_all(1);
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, cyclic.remove(1, handles[2]));
+    CHECK(cyclic.apply(0));
+
+    drain(&cyclic, 0, &sent);
+    CHECK_EQUAL(1u, sent.size());
+    CHECK_EQUAL(0x100u, sent[0].can_id);
+
+    cyclic.run(10000);
+    drain(&cyclic, 10000, &sent);
+    CHECK_EQUAL(2u, sent.size());
+    CHECK_EQUAL(0x100u, sent[1].can_id);
+}
+
+TEST (cyclic_tx_tick_change_keeps_schedule)
+{
+    std::vector<sent_frame> sent;
+    sc::cyclic_tx cyclic;
+    sc::cyclic_tx_def def = make_def(0x10, 2000, 0, 0);
+    uint32_t handle = 0;
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, cyclic.init(16));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, cyclic.add(0, &def, &handle));
+    cyclic.apply(0);
+    cyclic.start(0);
+    cyclic.run(0);
+    drain(&cyclic, 0, &sent);
+
+    CHECK_EQUAL(2000u, cyclic.next_us());
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, cyclic.set_tick(300));
+    cyclic.apply(500);
+    CHECK_EQUAL(300u, cyclic.tick_us());
+
+    // 2000 rounded up to the new tick
+    CHECK_EQUAL(2100u, cyclic.next_us());
+    cyclic.run(2099);
+    CHECK(!cyclic.queued());
+    cyclic.run(2100);
+    CHECK(cyclic.queued());
+}
+
+/* Thousands of definitions with the scheduling thread only waking up
+ * at next_us, like the COM server's TX thread does.
+ */
+TEST (cyclic_tx_scales_with_one_wakeup_per_tick)
+{
+    uint32_t const defs = 4000;
+    uint32_t const tick_us = 100;
+    uint64_t const end_us = 1000000;
+    std::vector<uint32_t> frames(defs, 0);
+    sc::cyclic_tx cyclic;
+    uint64_t now = 0;
+    uint32_t wakeups = 0;
+    uint64_t max_late_us = 0;
+    uint64_t total = 0;
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, cyclic.init(defs));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, cyclic.set_tick(tick_us));
+
+    for (uint32_t i = 0; i < defs; ++i) {
+        // periods of 1, 2, 5, 10, 20 ms, phases spread evenly
+        static uint32_t const periods[] = { 1000, 2000, 5000, 10000, 20000 };
+        sc::cyclic_tx_def def = make_def(i & 0x7ff, periods[i % 5], (i * 37) % periods[i % 5], 0);
+        uint32_t handle = 0;
+
+        CHECK_EQUAL(SC_DLL_ERROR_NONE, cyclic.add(0, &def, &handle));
+    }
+
+    cyclic.apply(0);
+    cyclic.start(0);
+
+    while (now < end_us) {
+        sc_mm_can_tx const* frame = nullptr;
+        uint8_t owner = 0;
+
+        cyclic.run(now);
+        ++wakeups;
+
+        while (cyclic.front(&owner, &frame)) {
+            uint32_t const index = frame->track_id & 0xffff;
+            static uint32_t const periods[] = { 1000, 2000, 5000, 10000, 20000 };
+            uint64_t const due = (index * 37) % periods[index % 5] + uint64_t(frames[index]) * periods[index % 5];
+
+            if (now - due > max_late_us) {
+                max_late_us = now - due;
+            }
+
+            ++frames[index];
+            ++total;
+            cyclic.pop();
+        }
+
+        now = cyclic.next_us();
+    }
+
+    sc::cyclic_tx_stats stats;
+
+    cyclic.stats(&stats);
+
+    CHECK_EQUAL(0u, stats.skipped);
+    CHECK_EQUAL(0u, stats.overruns);
+    CHECK(max_late_us < tick_us);
+    CHECK(total > 1400000u);
+    CHECK(wakeups <= end_us / tick_us + 1);
+}
+
+} // anon
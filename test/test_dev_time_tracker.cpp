@@ -72,5 +72,48 @@ TEST_F(ts_fixture, negative_laps_decrement_high)
 
 }
 
+struct clock_fixture
+{
+    sc_dev_clock_t c;
+
+    clock_fixture()
+    {
+        sc_dc_init(&c);
+    }
+};
+
+TEST_F(clock_fixture, offset_is_largest_observed_difference)
+{
+    // device runs 5000 us ahead, messages arrive 20..300 us late
+    sc_dc_observe(&c, 5000 + 1000 - 300, 1000);
+    CHECK_EQUAL(5700u, sc_dc_now(&c, 1000));
+
+    sc_dc_observe(&c, 5000 + 2000 - 20, 2000);
+    CHECK_EQUAL(5000 + 3000 - 20, sc_dc_now(&c, 3000));
+
+    // a late message doesn't pull the estimate back
+    sc_dc_observe(&c, 5000 + 4000 - 500, 4000);
+    CHECK_EQUAL(5000 + 5000 - 20, sc_dc_now(&c, 5000));
+}
+
+TEST_F(clock_fixture, host_is_inverse_of_now)
+{
+    sc_dc_observe(&c, 5000 + 1000 - 20, 1000);
+    CHECK_EQUAL(1000u, sc_dc_host(&c, 5000 + 1000 - 20));
+    CHECK_EQUAL(UINT64_C(123456), sc_dc_host(&c, sc_dc_now(&c, 123456)));
+}
+
+TEST_F(clock_fixture, estimate_follows_slower_device_clock)
+{
+    sc_dc_observe(&c, 10000, 0);
+
+    // device clock falls behind by 100 us
+    sc_dc_observe(&c, 10000 + SC_DEV_CLOCK_WINDOW_US / 2 - 100, SC_DEV_CLOCK_WINDOW_US / 2);
+    CHECK_EQUAL(10000 + SC_DEV_CLOCK_WINDOW_US, sc_dc_now(&c, SC_DEV_CLOCK_WINDOW_US));
+
+    sc_dc_observe(&c, 10000 + SC_DEV_CLOCK_WINDOW_US - 100, SC_DEV_CLOCK_WINDOW_US);
+    sc_dc_observe(&c, 10000 + 2 * SC_DEV_CLOCK_WINDOW_US - 100, 2 * SC_DEV_CLOCK_WINDOW_US);
+    CHECK_EQUAL(10000 + 3 * SC_DEV_CLOCK_WINDOW_US - 100, sc_dc_now(&c, 3 * SC_DEV_CLOCK_WINDOW_US));
+}
 
 } // anon
@@ -0,0 +1,216 @@
+#include <CppUnitLite2.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "supercan_error.h"
+#include "supercan_filter.h"
+
+namespace
+{
+
+struct filter_fixture
+{
+    sc_filter_t filter;
+
+    filter_fixture()
+    {
+        sc_filter_init(&filter);
+    }
+
+    ~filter_fixture()
+    {
+        sc_filter_uninit(&filter);
+    }
+
+    static sc_filter_rule mask(uint32_t id, uint32_t mask, bool ext = false)
+    {
+        sc_filter_rule r;
+
+        r.id = id;
+        r.mask_or_last = mask;
+        r.flags = ext ? SC_FILTER_RULE_FLAG_EXT : 0;
+
+        return r;
+    }
+
+    static sc_filter_rule range(uint32_t first, uint32_t last, bool ext = false)
+    {
+        sc_filter_rule r;
+
+        r.id = first;
+        r.mask_or_last = last;
+        r.flags = SC_FILTER_RULE_FLAG_RANGE | (ext ? SC_FILTER_RULE_FLAG_EXT : 0);
+
+        return r;
+    }
+
+    // reference implementation
+    static bool naive(std::vector<sc_filter_rule> const& rules, uint32_t can_id, uint8_t flags)
+    {
+        bool const ext = (flags & SC_CAN_FRAME_FLAG_EXT) != 0;
+
+        if (rules.empty()) {
+            return true;
+        }
+
+        for (auto const& r : rules) {
+            if (ext != ((r.flags & SC_FILTER_RULE_FLAG_EXT) != 0)) {
+                continue;
+            }
+
+            if (r.flags & SC_FILTER_RULE_FLAG_RANGE) {
+                if (can_id >= r.id && can_id <= r.mask_or_last) {
+                    return true;
+                }
+            }
+            else if (0 == ((can_id ^ r.id) & r.mask_or_last)) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+};
+
+uint32_t rand32()
+{
+    return ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+}
+
+TEST_F(filter_fixture, filter_accepts_all_without_rules)
+{
+    CHECK(sc_filter_accept(&filter, 0x123, 0));
+    CHECK(sc_filter_accept(&filter, 0x1fffffff, SC_CAN_FRAME_FLAG_EXT));
+
+    sc_filter_rule r = mask(0x100, 0x7ff);
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_filter_set(&filter, &r, 1));
+    CHECK(!sc_filter_accept(&filter, 0x123, 0));
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_filter_set(&filter, nullptr, 0));
+    CHECK(sc_filter_accept(&filter, 0x123, 0));
+}
+
+TEST_F(filter_fixture, filter_std_mask_and_range)
+{
+    sc_filter_rule rules[] = {
+        mask(0x100, 0x7f0),
+        range(0x700, 0x7ff),
+    };
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_filter_set(&filter, rules, 2));
+
+    CHECK(sc_filter_accept(&filter, 0x100, 0));
+    CHECK(sc_filter_accept(&filter, 0x10f, 0));
+    CHECK(!sc_filter_accept(&filter, 0x110, 0));
+    CHECK(!sc_filter_accept(&filter, 0x6ff, 0));
+    CHECK(sc_filter_accept(&filter, 0x700, 0));
+    CHECK(sc_filter_accept(&filter, 0x7ff, 0));
+
+    // std rules don't apply to extended frames
+    CHECK(!sc_filter_accept(&filter, 0x100, SC_CAN_FRAME_FLAG_EXT));
+}
+
+TEST_F(filter_fixture, filter_ext_range_across_leaves)
+{
+    uint32_t const first = 0x12345678 - 3;
+    uint32_t const last = first + (3u << SC_FILTER_EXT_LEAF_BITS);
+    sc_filter_rule r = range(first, last, true);
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_filter_set(&filter, &r, 1));
+
+    CHECK(!sc_filter_accept(&filter, first - 1, SC_CAN_FRAME_FLAG_EXT));
+    CHECK(sc_filter_accept(&filter, first, SC_CAN_FRAME_FLAG_EXT));
+    CHECK(sc_filter_accept(&filter, first + (1u << SC_FILTER_EXT_LEAF_BITS), SC_CAN_FRAME_FLAG_EXT));
+    CHECK(sc_filter_accept(&filter, last, SC_CAN_FRAME_FLAG_EXT));
+    CHECK(!sc_filter_accept(&filter, last + 1, SC_CAN_FRAME_FLAG_EXT));
+    CHECK(!sc_filter_accept(&filter, first & 0x7ff, 0));
+
+    // two edge leaves plus reject and accept
+    CHECK_EQUAL(4u, filter.leaf_count);
+}
+
+TEST_F(filter_fixture, filter_ext_mask_shares_leaves)
+{
+    // J1939 style PGN filter, ignores priority and source address
+    sc_filter_rule r = mask(0x00fef100, 0x03ffff00, true);
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_filter_set(&filter, &r, 1));
+
+    CHECK(sc_filter_accept(&filter, 0x18fef100, SC_CAN_FRAME_FLAG_EXT));
+    CHECK(sc_filter_accept(&filter, 0x0cfef1fe, SC_CAN_FRAME_FLAG_EXT));
+    CHECK(!sc_filter_accept(&filter, 0x18fef200, SC_CAN_FRAME_FLAG_EXT));
+
+    // one leaf for all buckets the rule touches
+    CHECK_EQUAL(3u, filter.leaf_count);
+}
+
+TEST_F(filter_fixture, filter_invalid_rules_leave_filter_unchanged)
+{
+    sc_filter_rule r = mask(0x100, 0x7ff);
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_filter_set(&filter, &r, 1));
+
+    sc_filter_rule bad[] = {
+        mask(0x800, 0x7ff),
+        range(0x20, 0x10),
+        range(0, 0x20000000, true),
+    };
+
+    for (auto const& b : bad) {
+        CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, sc_filter_set(&filter, &b, 1));
+        CHECK(sc_filter_accept(&filter, 0x100, 0));
+        CHECK(!sc_filter_accept(&filter, 0x101, 0));
+    }
+}
+
+TEST_F(filter_fixture, filter_matches_naive_evaluation)
+{
+    std::vector<sc_filter_rule> rules;
+
+    srand(42);
+
+    for (size_t i = 0; i < 300; ++i) {
+        bool const ext = i & 1;
+        uint32_t const max = ext ? 0x1fffffff : 0x7ff;
+        uint32_t const id = rand32() & max;
+
+        switch (rand() % 3) {
+        case 0:
+            rules.push_back(mask(id, rand32() & max, ext));
+            break;
+        case 1: {
+            uint32_t const span = rand32() & (ext ? 0x3ffff : 0x1f);
+            rules.push_back(range(id, id + span > max ? max : id + span, ext));
+        } break;
+        default:
+            // mostly exact ids
+            rules.push_back(mask(id, max, ext));
+            break;
+        }
+    }
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_filter_set(&filter, rules.data(), rules.size()));
+
+    bool equal = true;
+
+    for (uint32_t id = 0; id < 2048; ++id) {
+        equal = equal && (naive(rules, id, 0) == (sc_filter_accept(&filter, id, 0) != 0));
+    }
+
+    for (size_t i = 0; i < 200000; ++i) {
+        // half near rule ids to hit partial leaves
+        uint32_t id = rand32() & 0x1fffffff;
+
+        if (i & 1) {
+            id = (rules[(i % rules.size()) | 1].id + (rand() % 64) - 32) & 0x1fffffff;
+        }
+
+        equal = equal && (naive(rules, id, SC_CAN_FRAME_FLAG_EXT) == (sc_filter_accept(&filter, id, SC_CAN_FRAME_FLAG_EXT) != 0));
+    }
+
+    CHECK(equal);
+}
+
+} // anon
@@ -0,0 +1,186 @@
+#include <CppUnitLite2.h>
+
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "supercan_error.h"
+#include "supercan_log.h"
+
+namespace
+{
+
+struct log_sink
+{
+    std::vector<std::string> lines;
+    std::vector<int> levels;
+
+    static void on_log(void* ctx, int level, char const* msg, size_t size)
+    {
+        log_sink* self = static_cast<log_sink*>(ctx);
+
+        self->lines.push_back(std::string(msg, size));
+        self->levels.push_back(level);
+    }
+};
+
+struct log_fixture
+{
+    sc_log_t log;
+    log_sink sink;
+    int error;
+
+    log_fixture()
+    {
+        error = sc_log_init(&log, 8);
+    }
+
+    ~log_fixture()
+    {
+        sc_log_uninit(&log);
+    }
+};
+
+TEST (log_init_requires_power_of_two_capacity)
+{
+    sc_log_t log;
+
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, sc_log_init(&log, 0));
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, sc_log_init(&log, 3));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_log_init(&log, 4));
+    sc_log_uninit(&log);
+}
+
+TEST_F (log_fixture, log_formats_when_drained)
+{
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, error);
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_log_write(&log, &log_sink::on_log, &sink, 3, "ch%u %s failed: %d (%x) 100%%", 2u, "tx", -5, 0xbeefu));
+    CHECK_EQUAL(0u, sink.lines.size());
+
+    CHECK_EQUAL(1u, sc_log_drain(&log, 0));
+    CHECK_EQUAL(1u, sink.lines.size());
+    CHECK_EQUAL(0, strcmp("ch2 tx failed: -5 (beef) 100%", sink.lines[0].c_str()));
+    CHECK_EQUAL(3, sink.levels[0]);
+}
+
+TEST_F (log_fixture, log_formats_sized_arguments)
+{
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, error);
+    sc_log_write(&log, &log_sink::on_log, &sink, 0, "%ld %lu %zu %08X", -70000L, 4000000000UL, (size_t)12345, 0xabcu);
+    sc_log_write(&log, &log_sink::on_log, &sink, 0, "%s", (char const*)NULL);
+
+    CHECK_EQUAL(2u, sc_log_drain(&log, 0));
+    CHECK_EQUAL(0, strcmp("-70000 4000000000 12345 00000ABC", sink.lines[0].c_str()));
+    CHECK_EQUAL(0, strcmp("(null)", sink.lines[1].c_str()));
+}
+
+TEST_F (log_fixture, log_prints_unsupported_conversion_verbatim)
+{
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, error);
+    sc_log_write(&log, &log_sink::on_log, &sink, 0, "value %u %f end", 1u, 2.0);
+
+    CHECK_EQUAL(1u, sc_log_drain(&log, 0));
+    CHECK_EQUAL(0, strcmp("value 1 %f end", sink.lines[0].c_str()));
+}
+
+TEST_F (log_fixture, log_truncates_to_line_size)
+{
+    std::string big(SC_LOG_LINE_SIZE * 2, 'x');
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, error);
+    sc_log_write(&log, &log_sink::on_log, &sink, 0, "%s", big.c_str());
+
+    CHECK_EQUAL(1u, sc_log_drain(&log, 0));
+    CHECK_EQUAL((size_t)SC_LOG_LINE_SIZE - 1, sink.lines[0].size());
+}
+
+TEST_F (log_fixture, log_drops_records_when_full)
+{
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, error);
+
+    for (unsigned i = 0; i < 8; ++i) {
+        CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_log_write(&log, &log_sink::on_log, &sink, 0, "%u", i));
+    }
+
+    CHECK_EQUAL(SC_DLL_ERROR_AGAIN, sc_log_write(&log, &log_sink::on_log, &sink, 0, "%u", 8u));
+    CHECK_EQUAL(1u, log.dropped);
+
+    CHECK_EQUAL(3u, sc_log_drain(&log, 3));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_log_write(&log, &log_sink::on_log, &sink, 0, "%u", 9u));
+    CHECK_EQUAL(6u, sc_log_drain(&log, 0));
+
+    CHECK_EQUAL(9u, sink.lines.size());
+    CHECK_EQUAL(0, strcmp("0", sink.lines[0].c_str()));
+    CHECK_EQUAL(0, strcmp("7", sink.lines[7].c_str()));
+    CHECK_EQUAL(0, strcmp("9", sink.lines[8].c_str()));
+}
+
+TEST (log_keeps_per_producer_order_with_concurrent_producers)
+{
+    enum {
+        PRODUCERS = 4,
+        RECORDS = 20000,
+    };
+
+    sc_log_t log;
+    log_sink sink;
+    std::vector<std::thread> threads;
+    uint32_t accepted[PRODUCERS] = {};
+    unsigned next[PRODUCERS] = {};
+    bool ordered = true;
+    size_t total = 0;
+    std::atomic<bool> done(false);
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_log_init(&log, 256));
+
+    for (unsigned p = 0; p < PRODUCERS; ++p) {
+        threads.emplace_back([&, p] {
+            for (unsigned i = 0; i < RECORDS; ++i) {
+                if (SC_DLL_ERROR_NONE == sc_log_write(&log, &log_sink::on_log, &sink, (int)p, "%u", i)) {
+                    ++accepted[p];
+                }
+            }
+        });
+    }
+
+    std::thread consumer([&] {
+        while (!done) {
+            sc_log_drain(&log, 0);
+        }
+
+        sc_log_drain(&log, 0);
+    });
+
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    done = true;
+    consumer.join();
+
+    for (size_t i = 0; i < sink.lines.size(); ++i) {
+        unsigned p = (unsigned)sink.levels[i];
+        unsigned value = (unsigned)std::stoul(sink.lines[i]);
+
+        // records may be dropped, but never reordered
+        if (value < next[p]) {
+            ordered = false;
+        }
+
+        next[p] = value + 1;
+    }
+
+    for (unsigned p = 0; p < PRODUCERS; ++p) {
+        total += accepted[p];
+    }
+
+    CHECK(ordered);
+    CHECK_EQUAL(total, sink.lines.size());
+    CHECK_EQUAL((uint32_t)(PRODUCERS * RECORDS), (uint32_t)(total + log.dropped));
+
+    sc_log_uninit(&log);
+}
+
+} // anon
@@ -0,0 +1,198 @@
+#include <CppUnitLite2.h>
+#include <cstring>
+#include <vector>
+
+#include "supercan_error.h"
+#include "supercan_loopback.h"
+
+namespace
+{
+
+struct loopback_fixture
+{
+    sc_loopback_t lb;
+    sc_transport_t t;
+
+    loopback_fixture()
+    {
+        sc_loopback_init(&lb, 64, 4, 2);
+        sc_loopback_transport(&lb, &t);
+    }
+
+    ~loopback_fixture()
+    {
+        sc_loopback_uninit(&lb);
+    }
+};
+
+struct write_sink
+{
+    std::vector<uint8_t> data;
+    int result;
+
+    write_sink()
+        : result(SC_DLL_ERROR_NONE)
+    {}
+
+    static int on_write(void* ctx, uint8_t const* ptr, size_t bytes)
+    {
+        write_sink* self = static_cast<write_sink*>(ctx);
+
+        if (SC_DLL_ERROR_NONE == self->result) {
+            self->data.insert(self->data.end(), ptr, ptr + bytes);
+        }
+
+        return self->result;
+    }
+};
+
+TEST (loopback_init_rejects_invalid_params)
+{
+    sc_loopback_t lb;
+
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, sc_loopback_init(&lb, 0, 1, 1));
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, sc_loopback_init(&lb, 64, 0, 1));
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, sc_loopback_init(&lb, 64, 1, 0));
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, sc_loopback_init(nullptr, 64, 1, 1));
+}
+
+TEST_F(loopback_fixture, read_without_data_times_out)
+{
+    uint8_t buf[64];
+    size_t transferred = 1;
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, t.submit_read(t.ctx, 0, buf, sizeof(buf)));
+    CHECK_EQUAL(SC_DLL_ERROR_TIMEOUT, t.reap(t.ctx, SC_TRANSPORT_DIR_IN, 0, &transferred, 100));
+    CHECK_EQUAL(0u, transferred);
+}
+
+TEST_F(loopback_fixture, pushed_transfers_complete_reads_in_order)
+{
+    uint8_t buf[2][64];
+    size_t transferred = 0;
+    uint8_t const a[] = { 1, 2, 3, 4 };
+    uint8_t const b[] = { 5, 6, 7, 8, 9, 10, 11, 12 };
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_loopback_push(&lb, a, sizeof(a)));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_loopback_push(&lb, b, sizeof(b)));
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, t.submit_read(t.ctx, 0, buf[0], sizeof(buf[0])));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, t.submit_read(t.ctx, 1, buf[1], sizeof(buf[1])));
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, t.reap(t.ctx, SC_TRANSPORT_DIR_IN, 0, &transferred, 0));
+    CHECK_EQUAL(sizeof(a), transferred);
+    CHECK_EQUAL(0, memcmp(a, buf[0], sizeof(a)));
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, t.reap(t.ctx, SC_TRANSPORT_DIR_IN, 1, &transferred, 0));
+    CHECK_EQUAL(sizeof(b), transferred);
+    CHECK_EQUAL(0, memcmp(b, buf[1], sizeof(b)));
+}
+
+TEST_F(loopback_fixture, push_fails_when_full_or_too_large)
+{
+    uint8_t data[65] = { 0 };
+
+    CHECK_EQUAL(SC_DLL_ERROR_BUFFER_TOO_SMALL, sc_loopback_push(&lb, data, sizeof(data)));
+
+    for (unsigned i = 0; i < 4; ++i) {
+        CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_loopback_push(&lb, data, 4));
+    }
+
+    CHECK_EQUAL(SC_DLL_ERROR_AGAIN, sc_loopback_push(&lb, data, 4));
+}
+
+TEST_F(loopback_fixture, writes_are_looped_back)
+{
+    uint8_t buf[64];
+    size_t transferred = 0;
+    uint8_t const data[] = { 0xde, 0xad, 0xbe, 0xef };
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, t.submit_write(t.ctx, 0, data, sizeof(data)));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, t.reap(t.ctx, SC_TRANSPORT_DIR_OUT, 0, &transferred, 0));
+    CHECK_EQUAL(sizeof(data), transferred);
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, t.submit_read(t.ctx, 0, buf, sizeof(buf)));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, t.reap(t.ctx, SC_TRANSPORT_DIR_IN, 0, &transferred, 0));
+    CHECK_EQUAL(sizeof(data), transferred);
+    CHECK_EQUAL(0, memcmp(data, buf, sizeof(data)));
+}
+
+TEST_F(loopback_fixture, writes_are_delivered_to_callback)
+{
+    write_sink sink;
+    size_t transferred = 0;
+    uint8_t const data[] = { 1, 2, 3, 4 };
+
+    sc_loopback_set_write_callback(&lb, &sink, &write_sink::on_write);
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, t.submit_write(t.ctx, 0, data, sizeof(data)));
+    CHECK_EQUAL(sizeof(data), sink.data.size());
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, t.reap(t.ctx, SC_TRANSPORT_DIR_OUT, 0, &transferred, 0));
+}
+
+TEST_F(loopback_fixture, writes_stay_pending_while_device_is_busy)
+{
+    write_sink sink;
+    size_t transferred = 0;
+    uint8_t const a[] = { 1, 2, 3, 4 };
+    uint8_t const b[] = { 5, 6, 7, 8 };
+
+    sink.result = SC_DLL_ERROR_AGAIN;
+    sc_loopback_set_write_callback(&lb, &sink, &write_sink::on_write);
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, t.submit_write(t.ctx, 0, a, sizeof(a)));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, t.submit_write(t.ctx, 1, b, sizeof(b)));
+    CHECK_EQUAL(SC_DLL_ERROR_TIMEOUT, t.reap(t.ctx, SC_TRANSPORT_DIR_OUT, 1, &transferred, 0));
+
+    sink.result = SC_DLL_ERROR_NONE;
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, t.reap(t.ctx, SC_TRANSPORT_DIR_OUT, 1, &transferred, 0));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, t.reap(t.ctx, SC_TRANSPORT_DIR_OUT, 0, &transferred, 0));
+
+    // delivered in submission order
+    CHECK_EQUAL(8u, sink.data.size());
+    CHECK_EQUAL(1, sink.data[0]);
+    CHECK_EQUAL(5, sink.data[4]);
+}
+
+TEST_F(loopback_fixture, requests_must_be_submitted_before_reaping)
+{
+    uint8_t buf[64];
+    size_t transferred = 0;
+
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_OPERATION, t.reap(t.ctx, SC_TRANSPORT_DIR_IN, 0, &transferred, 0));
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_OPERATION, t.reap(t.ctx, SC_TRANSPORT_DIR_OUT, 0, &transferred, 0));
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, t.submit_read(t.ctx, 2, buf, sizeof(buf)));
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, t.submit_read(t.ctx, 0, buf, sizeof(buf)));
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_OPERATION, t.submit_read(t.ctx, 0, buf, sizeof(buf)));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, t.cancel(t.ctx, SC_TRANSPORT_DIR_IN, 0));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, t.submit_read(t.ctx, 0, buf, sizeof(buf)));
+}
+
+TEST_F(loopback_fixture, pending_reflects_completion_without_reaping)
+{
+    uint8_t buf[2][64];
+    uint8_t const data[4] = { 1, 2, 3, 4 };
+    size_t transferred = 0;
+
+    CHECK_EQUAL(0, t.pending(t.ctx, SC_TRANSPORT_DIR_IN, 0));
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, t.submit_read(t.ctx, 1, buf[1], sizeof(buf[1])));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, t.submit_read(t.ctx, 0, buf[0], sizeof(buf[0])));
+    CHECK(t.pending(t.ctx, SC_TRANSPORT_DIR_IN, 1));
+    CHECK(t.pending(t.ctx, SC_TRANSPORT_DIR_IN, 0));
+
+    // first transfer completes the read submitted first
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_loopback_push(&lb, data, sizeof(data)));
+    CHECK_EQUAL(0, t.pending(t.ctx, SC_TRANSPORT_DIR_IN, 1));
+    CHECK(t.pending(t.ctx, SC_TRANSPORT_DIR_IN, 0));
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, t.reap(t.ctx, SC_TRANSPORT_DIR_IN, 1, &transferred, 0));
+    CHECK(t.pending(t.ctx, SC_TRANSPORT_DIR_IN, 0));
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, t.submit_write(t.ctx, 0, data, sizeof(data)));
+    CHECK_EQUAL(0, t.pending(t.ctx, SC_TRANSPORT_DIR_OUT, 0));
+    CHECK_EQUAL(0, t.pending(t.ctx, SC_TRANSPORT_DIR_IN, 0));
+}
+
+} // anon
@@ -0,0 +1,767 @@
+#include <CppUnitLite2.h>
+
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#   include <sched.h>
+#   include <sys/wait.h>
+#   include <unistd.h>
+#endif
+
+#include "supercan_error.h"
+#include "supercan_mm_ring.h"
+
+#ifndef _WIN32
+#   include "supercan_mm_posix.h"
+#endif
+
+namespace
+{
+
+struct ring_fixture
+{
+    enum {
+        ELEMENTS = 8,
+    };
+
+    std::vector<uint64_t> mem;
+    sc_can_mm_header* hdr;
+    sc::mm::ring_producer producer;
+    sc::mm::ring_consumer consumer;
+
+    ring_fixture()
+        : mem((sizeof(sc_can_mm_header) + ELEMENTS * sizeof(sc_can_mm_slot_t) + 7) / 8)
+    {
+        hdr = reinterpret_cast<sc_can_mm_header*>(mem.data());
+        producer.attach(hdr, ELEMENTS);
+        consumer.attach(hdr, ELEMENTS);
+    }
+
+    static sc_can_mm_slot_t make(uint32_t seq)
+    {
+        sc_can_mm_slot_t slot;
+
+        memset(&slot, 0, sizeof(slot));
+        slot.rx.type = SC_MM_DATA_TYPE_CAN_RX;
+        slot.rx.can_id = seq;
+
+        return slot;
+    }
+};
+
+TEST_F(ring_fixture, mm_ring_starts_empty)
+{
+    uint32_t count = 1;
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, consumer.readable(&count));
+    CHECK_EQUAL(0u, count);
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, producer.writable(&count));
+    CHECK_EQUAL((uint32_t)ELEMENTS, count);
+}
+
+TEST_F(ring_fixture, mm_ring_commit_publishes_slots)
+{
+    uint32_t count = 0;
+
+    producer.slot(0)->rx.can_id = 1;
+    producer.slot(1)->rx.can_id = 2;
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, consumer.readable(&count));
+    CHECK_EQUAL(0u, count);
+
+    producer.commit(2);
+    CHECK_EQUAL(2u, hdr->put_index);
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, consumer.readable(&count));
+    CHECK_EQUAL(2u, count);
+    CHECK_EQUAL(1u, consumer.slot(0)->rx.can_id);
+    CHECK_EQUAL(2u, consumer.slot(1)->rx.can_id);
+
+    consumer.consume(2);
+    CHECK_EQUAL(2u, hdr->get_index);
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, producer.writable(&count));
+    CHECK_EQUAL((uint32_t)ELEMENTS, count);
+}
+
+TEST_F(ring_fixture, mm_ring_batches_wrap_around)
+{
+    sc_can_mm_slot_t in[ELEMENTS];
+    sc_can_mm_slot_t out[ELEMENTS];
+    uint32_t seq_in = 0;
+    uint32_t seq_out = 0;
+    uint32_t count = 0;
+
+    // batch sizes chosen so that copies straddle the end of the slot array
+    for (uint32_t round = 0; round < 50; ++round) {
+        uint32_t n = 1 + round % 5;
+
+        for (uint32_t i = 0; i < n; ++i) {
+            in[i] = make(seq_in + i);
+        }
+
+        CHECK_EQUAL(SC_DLL_ERROR_NONE, producer.push(in, n, &count));
+        CHECK_EQUAL(n, count);
+        seq_in += n;
+
+        CHECK_EQUAL(SC_DLL_ERROR_NONE, consumer.pop(out, ELEMENTS, &count));
+        CHECK_EQUAL(n, count);
+
+        for (uint32_t i = 0; i < count; ++i) {
+            CHECK_EQUAL(seq_out++, out[i].rx.can_id);
+        }
+    }
+}
+
+TEST_F(ring_fixture, mm_ring_push_stops_when_full)
+{
+    sc_can_mm_slot_t in[ELEMENTS + 2];
+    uint32_t count = 0;
+
+    for (uint32_t i = 0; i < ELEMENTS + 2; ++i) {
+        in[i] = make(i);
+    }
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, producer.push(in, ELEMENTS + 2, &count));
+    CHECK_EQUAL((uint32_t)ELEMENTS, count);
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, producer.writable(&count));
+    CHECK_EQUAL(0u, count);
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, producer.push(in, 1, &count));
+    CHECK_EQUAL(0u, count);
+}
+
+TEST_F(ring_fixture, mm_ring_detects_foreign_index_changes)
+{
+    uint32_t count = 0;
+
+    // consumer moves put_index
+    hdr->put_index = 3;
+    CHECK_EQUAL(SC_DLL_ERROR_PROTO_VIOLATION, producer.writable(&count));
+
+    // producer moves get_index
+    hdr->put_index = 0;
+    hdr->get_index = 5;
+    CHECK_EQUAL(SC_DLL_ERROR_PROTO_VIOLATION, consumer.readable(&count));
+
+    // more slots in use than there are
+    hdr->get_index = 0;
+    hdr->put_index = ELEMENTS + 1;
+    CHECK_EQUAL(SC_DLL_ERROR_PROTO_VIOLATION, consumer.readable(&count));
+
+    // recover
+    consumer.skip_all();
+    producer.attach(hdr, ELEMENTS);
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, producer.writable(&count));
+    CHECK_EQUAL((uint32_t)ELEMENTS, count);
+}
+
+TEST_F(ring_fixture, mm_ring_producer_reset_empties_ring)
+{
+    uint32_t count = 0;
+
+    producer.commit(3);
+    producer.reset();
+
+    CHECK_EQUAL(3u, hdr->get_index);
+    consumer.attach(hdr, ELEMENTS);
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, consumer.readable(&count));
+    CHECK_EQUAL(0u, count);
+}
+
+TEST_F(ring_fixture, mm_ring_wake_is_coalesced)
+{
+    CHECK(!producer.wake());
+
+    for (uint32_t i = 0; i < 5; ++i) {
+        producer.commit();
+    }
+
+    CHECK(producer.wake());
+    CHECK(!producer.wake());
+
+    producer.notify();
+    CHECK(producer.wake());
+    CHECK(!producer.wake());
+}
+
+TEST_F(ring_fixture, mm_ring_wake_skipped_while_polling)
+{
+    consumer.poll(true);
+    CHECK_EQUAL((uint32_t)SC_MM_CLIENT_FLAG_POLLING, hdr->client_flags);
+
+    producer.commit();
+    CHECK(!producer.wake());
+
+    consumer.poll(false);
+    CHECK_EQUAL(0u, hdr->client_flags);
+
+    producer.commit();
+    CHECK(producer.wake());
+}
+
+struct var_ring_fixture
+{
+    enum {
+        ELEMENTS = 8,
+    };
+
+    std::vector<uint64_t> mem;
+    sc_can_mm_header* hdr;
+    sc::mm::var_ring_producer producer;
+    sc::mm::var_ring_consumer consumer;
+    uint32_t const words;
+
+    var_ring_fixture()
+        : mem((sizeof(sc_can_mm_header) + ELEMENTS * sizeof(sc_can_mm_slot_t) + 7) / 8)
+        , words(sc::mm::var_ring_words(ELEMENTS))
+    {
+        hdr = reinterpret_cast<sc_can_mm_header*>(mem.data());
+        producer.attach(hdr, ELEMENTS);
+        consumer.attach(hdr, ELEMENTS);
+    }
+
+    static sc_can_mm_slot_t make_rx(uint32_t seq, uint8_t dlc, uint8_t flags)
+    {
+        sc_can_mm_slot_t slot;
+
+        memset(&slot, 0, sizeof(slot));
+        slot.rx.type = SC_MM_DATA_TYPE_CAN_RX;
+        slot.rx.can_id = seq;
+        slot.rx.dlc = dlc;
+        slot.rx.flags = flags;
+        slot.rx.timestamp_us = seq * 10;
+
+        for (uint8_t i = 0; i < sizeof(slot.rx.data); ++i) {
+            slot.rx.data[i] = static_cast<uint8_t>(seq + i);
+        }
+
+        return slot;
+    }
+};
+
+TEST_F(var_ring_fixture, mm_var_ring_round_trips_all_types)
+{
+    sc_can_mm_slot_t in[7];
+    sc_can_mm_slot_t out[8];
+    uint32_t count = 0;
+
+    memset(in, 0, sizeof(in));
+    memset(out, 0xff, sizeof(out));
+
+    in[0] = make_rx(0x123, 8, 0);
+    in[1] = make_rx(0x1abcdef, 15, SC_CAN_FRAME_FLAG_EXT | SC_CAN_FRAME_FLAG_FDF | SC_CAN_FRAME_FLAG_BRS);
+    in[2] = make_rx(0x7ff, 4, SC_CAN_FRAME_FLAG_RTR);
+
+    in[3].tx.type = SC_MM_DATA_TYPE_CAN_TX;
+    in[3].tx.dlc = 3;
+    in[3].tx.flags = SC_CAN_FRAME_FLAG_DRP;
+    in[3].tx.echo = 1;
+    in[3].tx.track_id = 42;
+    in[3].tx.can_id = 0x321;
+    in[3].tx.timestamp_us = 12345;
+    in[3].tx.data[0] = 1;
+    in[3].tx.data[1] = 2;
+    in[3].tx.data[2] = 3;
+
+    in[4].status.type = SC_MM_DATA_TYPE_CAN_STATUS;
+    in[4].status.flags = 1;
+    in[4].status.bus_status = 2;
+    in[4].status.rx_lost = 3;
+    in[4].status.tx_dropped = 4;
+    in[4].status.timestamp_us = 5;
+    in[4].status.rx_errors = 6;
+    in[4].status.tx_errors = 7;
+    in[4].status.rx_fifo_size = 8;
+    in[4].status.tx_fifo_size = 9;
+
+    in[5].error.type = SC_MM_DATA_TYPE_CAN_ERROR;
+    in[5].error.error = 3;
+    in[5].error.flags = 1;
+    in[5].error.timestamp_us = 99;
+
+    in[6].log_data.type = SC_MM_DATA_TYPE_LOG_DATA;
+    in[6].log_data.level = 2;
+    in[6].log_data.src = SC_LOG_DATA_SRC_SRV;
+    in[6].log_data.flags = SC_LOG_DATA_FLAG_MORE;
+    in[6].log_data.bytes = 5;
+    memcpy(in[6].log_data.data, "hello", 5);
+
+    // classic frames take 3 words, maximum CAN-FD frames 10 and 11 words
+    CHECK_EQUAL(3u, sc::mm::var_words(&in[0]));
+    CHECK_EQUAL(10u, sc::mm::var_words(&in[1]));
+    CHECK_EQUAL(2u, sc::mm::var_words(&in[2]));
+    CHECK_EQUAL(4u, sc::mm::var_words(&in[3]));
+    CHECK_EQUAL(3u, sc::mm::var_words(&in[4]));
+    CHECK_EQUAL(2u, sc::mm::var_words(&in[5]));
+    CHECK_EQUAL(2u, sc::mm::var_words(&in[6]));
+
+    for (size_t i = 0; i < sizeof(in) / sizeof(in[0]); ++i) {
+        CHECK_EQUAL(SC_DLL_ERROR_NONE, producer.push(&in[i]));
+    }
+
+    CHECK_EQUAL(26u, hdr->put_index);
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, consumer.pop(out, 8, &count));
+    CHECK_EQUAL(7u, count);
+    CHECK_EQUAL(26u, hdr->get_index);
+
+    CHECK_EQUAL(0, memcmp(&in[0], &out[0], offsetof(sc_mm_can_rx, data) + 8));
+    CHECK_EQUAL(0, memcmp(&in[1], &out[1], sizeof(sc_mm_can_rx)));
+    CHECK_EQUAL(0, memcmp(&in[2], &out[2], offsetof(sc_mm_can_rx, data)));
+    CHECK_EQUAL(0, memcmp(&in[3], &out[3], offsetof(sc_mm_can_tx, data) + 3));
+    CHECK_EQUAL(0, memcmp(&in[4], &out[4], offsetof(sc_mm_can_status, tx_fifo_size) + 1));
+    CHECK_EQUAL(0, memcmp(&in[5], &out[5], sizeof(sc_mm_can_error)));
+    CHECK_EQUAL(0, memcmp(&in[6], &out[6], offsetof(sc_mm_log_data, data) + 5));
+}
+
+TEST_F(var_ring_fixture, mm_var_ring_holds_more_classic_frames)
+{
+    sc_can_mm_slot_t slot = make_rx(0, 8, 0);
+    uint32_t count = 0;
+
+    while (SC_DLL_ERROR_NONE == producer.push(&slot)) {
+        ++count;
+    }
+
+    CHECK_EQUAL(words / 3, count);
+    CHECK(count >= 2 * ELEMENTS);
+}
+
+TEST_F(var_ring_fixture, mm_var_ring_pads_at_wrap)
+{
+    sc_can_mm_slot_t in;
+    sc_can_mm_slot_t out[4];
+    uint32_t seq_in = 0;
+    uint32_t seq_out = 0;
+    uint32_t count = 0;
+    bool padded = false;
+
+    for (uint32_t round = 0; round < 200; ++round) {
+        uint32_t n = 1 + round % 4;
+
+        for (uint32_t i = 0; i < n; ++i) {
+            // mix of record sizes so that records meet the end of the array at varying offsets
+            uint8_t const dlc = static_cast<uint8_t>((seq_in * 7) % 16);
+
+            in = make_rx(seq_in++, dlc, dlc > 8 ? SC_CAN_FRAME_FLAG_FDF : 0);
+
+            padded |= sc::mm::var_words(&in) > words - hdr->put_index % words;
+
+            CHECK_EQUAL(SC_DLL_ERROR_NONE, producer.push(&in));
+        }
+
+        for (uint32_t left = n; left; left -= count) {
+            CHECK_EQUAL(SC_DLL_ERROR_NONE, consumer.pop(out, sizeof(out) / sizeof(out[0]), &count));
+            CHECK(count > 0);
+
+            for (uint32_t i = 0; i < count; ++i, ++seq_out) {
+                sc_can_mm_slot_t expected = make_rx(seq_out, out[i].rx.dlc, out[i].rx.flags);
+
+                CHECK_EQUAL(seq_out, out[i].rx.can_id);
+                CHECK_EQUAL(0, memcmp(expected.rx.data, out[i].rx.data, sc::mm::var_dlc_to_len(out[i].rx.dlc)));
+            }
+        }
+    }
+
+    CHECK(padded);
+    CHECK_EQUAL(hdr->put_index, hdr->get_index);
+}
+
+TEST_F(var_ring_fixture, mm_var_ring_round_trips_across_index_wrap)
+{
+    sc_can_mm_slot_t in;
+    sc_can_mm_slot_t out[4];
+    uint32_t seq_in = 0;
+    uint32_t seq_out = 0;
+    uint32_t count = 0;
+
+    CHECK_EQUAL(64u, words);
+
+    // a bit more than a ring short of the wrap, not at a ring boundary
+    hdr->put_index = UINT32_MAX - 100;
+    hdr->get_index = UINT32_MAX - 100;
+    producer.attach(hdr, ELEMENTS);
+    consumer.attach(hdr, ELEMENTS);
+
+    for (uint32_t round = 0; round < 100; ++round) {
+        uint32_t n = 1 + round % 4;
+
+        for (uint32_t i = 0; i < n; ++i) {
+            uint8_t const dlc = static_cast<uint8_t>((seq_in * 5) % 16);
+
+            in = make_rx(seq_in++, dlc, dlc > 8 ? SC_CAN_FRAME_FLAG_FDF : 0);
+            CHECK_EQUAL(SC_DLL_ERROR_NONE, producer.push(&in));
+        }
+
+        for (uint32_t left = n; left; left -= count) {
+            CHECK_EQUAL(SC_DLL_ERROR_NONE, consumer.pop(out, sizeof(out) / sizeof(out[0]), &count));
+            CHECK(count > 0);
+
+            if (!count) {
+                return;
+            }
+
+            for (uint32_t i = 0; i < count; ++i, ++seq_out) {
+                sc_can_mm_slot_t expected = make_rx(seq_out, out[i].rx.dlc, out[i].rx.flags);
+
+                CHECK_EQUAL(seq_out, out[i].rx.can_id);
+                CHECK_EQUAL(0, memcmp(expected.rx.data, out[i].rx.data, sc::mm::var_dlc_to_len(out[i].rx.dlc)));
+            }
+        }
+    }
+
+    CHECK(hdr->put_index < UINT32_MAX - 100); // wrapped
+    CHECK_EQUAL(hdr->put_index, hdr->get_index);
+}
+
+TEST_F(var_ring_fixture, mm_var_ring_skips_unknown_and_rejects_malformed_records)
+{
+    sc_can_mm_slot_t slot = make_rx(1, 8, 0);
+    sc_can_mm_slot_t out[2];
+    uint32_t count = 0;
+    sc_mm_var_header* rec = reinterpret_cast<sc_mm_var_header*>(hdr->elements);
+
+    // unknown record type
+    rec->type = 0x7f;
+    rec->words = 2;
+    hdr->put_index = 2;
+    producer.attach(hdr, ELEMENTS);
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, producer.push(&slot));
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, consumer.pop(out, 2, &count));
+    CHECK_EQUAL(1u, count);
+    CHECK_EQUAL(1u, out[0].rx.can_id);
+
+    // record claims to be larger than what was published
+    rec = const_cast<sc_mm_var_header*>(consumer.record());
+    rec->type = SC_MM_DATA_TYPE_CAN_RX;
+    rec->words = 4;
+    reinterpret_cast<sc_mm_var_can_rx*>(rec)->dlc = 8;
+    hdr->put_index += 3;
+    CHECK_EQUAL(SC_DLL_ERROR_PROTO_VIOLATION, consumer.pop(out, 2, &count));
+
+    // record too small for its payload
+    rec->words = 2;
+    CHECK_EQUAL(SC_DLL_ERROR_PROTO_VIOLATION, consumer.pop(out, 2, &count));
+
+    rec->words = 0;
+    CHECK_EQUAL(SC_DLL_ERROR_PROTO_VIOLATION, consumer.pop(out, 2, &count));
+}
+
+struct bc_ring_fixture
+{
+    enum {
+        ELEMENTS = 8,
+    };
+
+    std::vector<uint64_t> mem;
+    sc_can_mm_bc_header* hdr;
+    sc::mm::bc_ring_producer producer;
+    sc::mm::bc_ring_consumer consumers[2];
+
+    bc_ring_fixture()
+        : mem((sizeof(sc_can_mm_bc_header) + ELEMENTS * sizeof(sc_can_mm_slot_t) + 7) / 8)
+    {
+        hdr = reinterpret_cast<sc_can_mm_bc_header*>(mem.data());
+        producer.attach(hdr, ELEMENTS);
+
+        for (uint8_t i = 0; i < 2; ++i) {
+            producer.add_client(i);
+            consumers[i].attach(hdr, ELEMENTS, i);
+        }
+    }
+
+    void put(uint8_t type, uint32_t seq)
+    {
+        sc_can_mm_slot_t* slot = producer.claim();
+
+        slot->hdr.type = type;
+        slot->rx.can_id = seq;
+        producer.commit();
+    }
+};
+
+TEST_F(bc_ring_fixture, mm_bc_ring_delivers_to_all_clients)
+{
+    sc_can_mm_slot_t out[ELEMENTS];
+    uint32_t popped = 0;
+
+    for (uint32_t i = 0; i < 3; ++i) {
+        put(SC_MM_DATA_TYPE_CAN_RX, i);
+    }
+
+    for (size_t c = 0; c < 2; ++c) {
+        CHECK_EQUAL(SC_DLL_ERROR_NONE, consumers[c].pop(out, ELEMENTS, &popped));
+        CHECK_EQUAL(3u, popped);
+
+        for (uint32_t i = 0; i < popped; ++i) {
+            CHECK_EQUAL(i, out[i].rx.can_id);
+        }
+
+        CHECK_EQUAL(3u, hdr->clients[c].get_index);
+    }
+
+    CHECK_EQUAL(0u, hdr->clients[0].can_lost_rx);
+}
+
+TEST_F(bc_ring_fixture, mm_bc_ring_overrun_counts_lost_by_type)
+{
+    sc_can_mm_slot_t out[ELEMENTS];
+    uint32_t popped = 0;
+    uint32_t count = 0;
+
+    // client 1 keeps up, client 0 doesn't read at all
+    for (uint32_t i = 0; i < ELEMENTS + 3; ++i) {
+        put(i & 1 ? SC_MM_DATA_TYPE_CAN_STATUS : SC_MM_DATA_TYPE_CAN_RX, i);
+
+        CHECK_EQUAL(SC_DLL_ERROR_NONE, consumers[1].pop(out, ELEMENTS, &popped));
+        CHECK_EQUAL(1u, popped);
+    }
+
+    CHECK_EQUAL(2u, hdr->clients[0].can_lost_rx);
+    CHECK_EQUAL(1u, hdr->clients[0].can_lost_status);
+    CHECK_EQUAL(0u, hdr->clients[1].can_lost_rx);
+    CHECK_EQUAL(0u, hdr->clients[1].can_lost_status);
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, consumers[0].readable(&count));
+    CHECK_EQUAL((uint32_t)ELEMENTS, count);
+    CHECK_EQUAL(3u, consumers[0].slot()->rx.can_id);
+    CHECK_EQUAL(3u, producer.slowest());
+}
+
+TEST_F(bc_ring_fixture, mm_bc_ring_consume_fails_after_overrun)
+{
+    uint32_t count = 0;
+
+    put(SC_MM_DATA_TYPE_CAN_RX, 0);
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, consumers[0].readable(&count));
+    CHECK_EQUAL(1u, count);
+
+    // overwrites the slot the client is looking at
+    for (uint32_t i = 1; i <= ELEMENTS; ++i) {
+        put(SC_MM_DATA_TYPE_CAN_RX, i);
+    }
+
+    CHECK_EQUAL(SC_DLL_ERROR_AGAIN, consumers[0].consume(count));
+    CHECK_EQUAL(1u, hdr->clients[0].can_lost_rx);
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, consumers[0].readable(&count));
+    CHECK_EQUAL((uint32_t)ELEMENTS, count);
+    CHECK_EQUAL(1u, consumers[0].slot()->rx.can_id);
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, consumers[0].consume(count));
+}
+
+TEST_F(bc_ring_fixture, mm_bc_ring_wake_skips_polling_clients)
+{
+    CHECK_EQUAL(0u, producer.wake());
+
+    consumers[1].poll(true);
+    put(SC_MM_DATA_TYPE_CAN_RX, 0);
+    put(SC_MM_DATA_TYPE_CAN_RX, 1);
+
+    CHECK_EQUAL(1u, producer.wake());
+    CHECK_EQUAL(0u, producer.wake());
+
+    producer.remove_client(0);
+    consumers[1].poll(false);
+    put(SC_MM_DATA_TYPE_CAN_RX, 2);
+
+    CHECK_EQUAL(2u, producer.wake());
+}
+
+TEST_F(bc_ring_fixture, mm_bc_ring_backlog_follows_slowest_client)
+{
+    sc_can_mm_slot_t out[ELEMENTS];
+    uint32_t popped = 0;
+
+    CHECK_EQUAL(0u, producer.backlog());
+
+    for (uint32_t i = 0; i < 5; ++i) {
+        put(SC_MM_DATA_TYPE_CAN_RX, i);
+    }
+
+    CHECK_EQUAL(5u, producer.backlog());
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, consumers[0].pop(out, 3, &popped));
+    CHECK_EQUAL(5u, producer.backlog());
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, consumers[1].pop(out, ELEMENTS, &popped));
+    CHECK_EQUAL(2u, producer.backlog());
+
+    // rogue cursor
+    hdr->clients[1].get_index = producer.index() + 1;
+    CHECK_EQUAL((uint32_t)ELEMENTS, producer.backlog());
+
+    producer.remove_client(1);
+    CHECK_EQUAL(2u, producer.backlog());
+}
+
+TEST (mm_bc_ring_lost_plus_received_equals_sent)
+{
+    enum {
+        ELEMENTS = 64,
+        COUNT = 200000,
+        CLIENTS = 3,
+    };
+
+    std::vector<uint64_t> mem((sizeof(sc_can_mm_bc_header) + ELEMENTS * sizeof(sc_can_mm_slot_t) + 7) / 8);
+    sc_can_mm_bc_header* hdr = reinterpret_cast<sc_can_mm_bc_header*>(mem.data());
+    sc::mm::bc_ring_producer producer;
+    std::thread threads[CLIENTS];
+    uint32_t received[CLIENTS];
+    bool ordered[CLIENTS];
+
+    producer.attach(hdr, ELEMENTS);
+
+    for (uint8_t i = 0; i < CLIENTS; ++i) {
+        producer.add_client(i);
+        received[i] = 0;
+        ordered[i] = true;
+    }
+
+    for (uint8_t i = 0; i < CLIENTS; ++i) {
+        threads[i] = std::thread([&, i] {
+            sc::mm::bc_ring_consumer consumer;
+            sc_can_mm_slot_t out[16];
+            uint32_t next = 0;
+            // vary speed, the first client is slowest
+            uint32_t const capacity = 1 + i * 7;
+
+            consumer.attach(hdr, ELEMENTS, i);
+
+            while (next < COUNT) {
+                uint32_t popped = 0;
+
+                if (consumer.pop(out, capacity, &popped)) {
+                    ordered[i] = false;
+                    break;
+                }
+
+                if (!popped) {
+                    std::this_thread::yield();
+                    continue;
+                }
+
+                for (uint32_t k = 0; k < popped; ++k) {
+                    if (out[k].rx.can_id < next) {
+                        ordered[i] = false;
+                    }
+
+                    next = out[k].rx.can_id + 1;
+                }
+
+                received[i] += popped;
+            }
+        });
+    }
+
+    for (uint32_t seq = 0; seq < COUNT; ++seq) {
+        sc_can_mm_slot_t* slot = producer.claim();
+
+        slot->rx.type = SC_MM_DATA_TYPE_CAN_RX;
+        slot->rx.can_id = seq;
+        producer.commit();
+    }
+
+    for (uint8_t i = 0; i < CLIENTS; ++i) {
+        threads[i].join();
+
+        CHECK(ordered[i]);
+        CHECK_EQUAL((uint32_t)COUNT, received[i] + hdr->clients[i].can_lost_rx);
+    }
+}
+
+#ifndef _WIN32
+TEST (mm_ring_posix_mapping_is_shared_across_processes)
+{
+    enum {
+        ELEMENTS = 256,
+        COUNT = 200000,
+    };
+
+    char name[64];
+    sc::mm::posix_ring_mapping mapping;
+    sc::mm::ring_consumer consumer;
+    sc_can_mm_slot_t out[64];
+    uint32_t expected = 0;
+    bool ordered = true;
+    int status = -1;
+    pid_t pid = -1;
+
+    snprintf(name, sizeof(name), "/supercan-test-%d", (int)getpid());
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, mapping.create(name, ELEMENTS));
+    CHECK_EQUAL(SC_DLL_ERROR_DEVICE_BUSY, sc::mm::posix_ring_mapping().create(name, ELEMENTS));
+
+    pid = fork();
+    CHECK(pid >= 0);
+
+    if (0 == pid) {
+        // producer process, maps the ring by name
+        sc::mm::posix_ring_mapping child;
+        sc::mm::ring_producer producer;
+        sc_can_mm_slot_t in[37];
+        uint32_t seq = 0;
+
+        if (child.open(name, ELEMENTS)) {
+            _exit(1);
+        }
+
+        producer.attach(child.header(), child.elements());
+
+        while (seq < COUNT) {
+            uint32_t n = 1 + seq % 37;
+            uint32_t pushed = 0;
+
+            if (n > COUNT - seq) {
+                n = COUNT - seq;
+            }
+
+            for (uint32_t i = 0; i < n; ++i) {
+                in[i] = ring_fixture::make(seq + i);
+            }
+
+            if (producer.push(in, n, &pushed)) {
+                _exit(2);
+            }
+
+            if (!pushed) {
+                sched_yield();
+            }
+
+            seq += pushed;
+        }
+
+        _exit(0);
+    }
+
+    consumer.attach(mapping.header(), mapping.elements());
+
+    while (expected < COUNT) {
+        uint32_t popped = 0;
+
+        if (consumer.pop(out, 64, &popped)) {
+            ordered = false;
+            break;
+        }
+
+        if (!popped) {
+            sched_yield();
+        }
+
+        for (uint32_t i = 0; i < popped; ++i) {
+            if (out[i].rx.can_id != expected++) {
+                ordered = false;
+            }
+        }
+    }
+
+    waitpid(pid, &status, 0);
+
+    CHECK(ordered);
+    CHECK_EQUAL((uint32_t)COUNT, expected);
+    CHECK(WIFEXITED(status));
+    CHECK_EQUAL(0, WEXITSTATUS(status));
+}
+#endif
+
+} // anon
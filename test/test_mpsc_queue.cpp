@@ -0,0 +1,198 @@
+#include <CppUnitLite2.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "supercan_mpsc_queue.h"
+
+namespace
+{
+
+struct entry
+{
+    uint32_t producer;
+    uint32_t seq;
+};
+
+typedef sc::mpsc_queue<entry> queue_t;
+
+bool push(queue_t* q, uint32_t producer, uint32_t seq)
+{
+    return q->push([=](entry* e) {
+        e->producer = producer;
+        e->seq = seq;
+    });
+}
+
+/* Runs producers against a consumer that drains (and optionally
+ * resizes) the queue, returns the number of ordering violations.
+ *
+ * Entries pushed are either consumed or dropped by a shrinking resize.
+ */
+unsigned run_producers(queue_t* q, unsigned producers, uint32_t count, bool resize, uint64_t* pushed, uint64_t* consumed, uint64_t* dropped)
+{
+    std::vector<std::thread> threads;
+    std::vector<uint32_t> next(producers, 0);
+    std::atomic<unsigned> running(producers);
+    std::atomic<uint64_t> ok(0);
+    unsigned violations = 0;
+    unsigned rounds = 0;
+
+    *consumed = 0;
+    *dropped = 0;
+
+    for (unsigned p = 0; p < producers; ++p) {
+        threads.emplace_back([=, &ok, &running] {
+            for (uint32_t i = 0; i < count; ++i) {
+                // retry while full or resizing, sleep to let the consumer run on a single core
+                while (!push(q, p, i)) {
+                    std::this_thread::sleep_for(std::chrono::microseconds(10));
+                }
+
+                ok.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            running.fetch_sub(1, std::memory_order_release);
+        });
+    }
+
+    auto consume = [&](entry const* e) {
+        if (e->seq < next[e->producer]) {
+            ++violations;
+        }
+
+        next[e->producer] = e->seq + 1;
+        ++*consumed;
+    };
+
+    while (running.load(std::memory_order_acquire)) {
+        q->drain(consume, 64);
+
+        if (resize && ++rounds % 128 == 0) {
+            uint32_t n = 0;
+
+            if (SC_DLL_ERROR_NONE != q->resize(q->capacity() == 64 ? 256 : 64, &n)) {
+                ++violations;
+            }
+
+            *dropped += n;
+        }
+    }
+
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    q->drain(consume, ~static_cast<size_t>(0));
+    *pushed = ok.load();
+
+    return violations;
+}
+
+TEST (mpsc_queue_validates_capacity)
+{
+    queue_t q;
+    entry e = { 0, 0 };
+
+    CHECK_EQUAL(0u, q.capacity());
+    CHECK(!push(&q, 0, 0));
+    CHECK_EQUAL(0u, q.drain([&](entry const* x) { e = *x; }, 1));
+
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, q.init(0));
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, q.init(3));
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, q.init(queue_t::MAX_CAPACITY * 2));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, q.init(4));
+    CHECK_EQUAL(4u, q.capacity());
+}
+
+TEST (mpsc_queue_fails_push_when_full)
+{
+    queue_t q;
+    uint32_t seen[8] = { 0 };
+    size_t n = 0;
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, q.init(4));
+    CHECK(q.empty());
+
+    for (uint32_t i = 0; i < 4; ++i) {
+        CHECK(push(&q, 0, i));
+    }
+
+    CHECK(!push(&q, 0, 4));
+    CHECK(!q.empty());
+
+    // drain in order, max limits
+    CHECK_EQUAL(3u, q.drain([&](entry const* e) { seen[n++] = e->seq; }, 3));
+    CHECK(push(&q, 0, 5));
+    CHECK_EQUAL(2u, q.drain([&](entry const* e) { seen[n++] = e->seq; }, 8));
+    CHECK(q.empty());
+
+    CHECK_EQUAL(0u, seen[0]);
+    CHECK_EQUAL(1u, seen[1]);
+    CHECK_EQUAL(2u, seen[2]);
+    CHECK_EQUAL(3u, seen[3]);
+    CHECK_EQUAL(5u, seen[4]);
+}
+
+TEST (mpsc_queue_resize_keeps_entries)
+{
+    queue_t q;
+    uint32_t dropped = 0;
+    uint32_t seen[8] = { 0 };
+    size_t n = 0;
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, q.init(8));
+
+    for (uint32_t i = 0; i < 6; ++i) {
+        CHECK(push(&q, 0, i));
+    }
+
+    CHECK_EQUAL(1u, q.drain([&](entry const* e) { seen[n++] = e->seq; }, 1));
+
+    // shrink, one entry doesn't fit
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, q.resize(5, &dropped));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, q.resize(4, &dropped));
+    CHECK_EQUAL(1u, dropped);
+    CHECK_EQUAL(4u, q.capacity());
+    CHECK(!push(&q, 0, 6));
+
+    CHECK_EQUAL(4u, q.drain([&](entry const* e) { seen[n++] = e->seq; }, 8));
+    CHECK(push(&q, 0, 6));
+    CHECK_EQUAL(1u, q.drain([&](entry const* e) { seen[n++] = e->seq; }, 8));
+
+    CHECK_EQUAL(0u, seen[0]);
+    CHECK_EQUAL(1u, seen[1]);
+    CHECK_EQUAL(4u, seen[4]);
+    CHECK_EQUAL(6u, seen[5]);
+}
+
+TEST (mpsc_queue_keeps_order_per_producer)
+{
+    queue_t q;
+    uint64_t pushed = 0;
+    uint64_t consumed = 0;
+    uint64_t dropped = 0;
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, q.init(64));
+    CHECK_EQUAL(0u, run_producers(&q, 4, 20000, false, &pushed, &consumed, &dropped));
+    CHECK_EQUAL(uint64_t(4 * 20000), pushed);
+    CHECK_EQUAL(pushed, consumed);
+    CHECK_EQUAL(0u, dropped);
+}
+
+TEST (mpsc_queue_resizes_under_load)
+{
+    queue_t q;
+    uint64_t pushed = 0;
+    uint64_t consumed = 0;
+    uint64_t dropped = 0;
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, q.init(64));
+    CHECK_EQUAL(0u, run_producers(&q, 4, 20000, true, &pushed, &consumed, &dropped));
+    CHECK_EQUAL(uint64_t(4 * 20000), pushed);
+    CHECK_EQUAL(pushed, consumed + dropped);
+}
+
+} // anon
@@ -0,0 +1,205 @@
+#include <CppUnitLite2.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "supercan_error.h"
+#include "supercan_pool.h"
+
+namespace
+{
+
+template<typename F>
+bool wait_for(F&& f)
+{
+    auto const deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+
+    while (!f()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+
+        std::this_thread::yield();
+    }
+
+    return true;
+}
+
+struct counter
+{
+    std::atomic<uint32_t> runs;
+
+    counter() : runs(0) {}
+
+    static void run(void* ctx)
+    {
+        static_cast<counter*>(ctx)->runs.fetch_add(1);
+    }
+};
+
+TEST (pool_start_validates_arguments)
+{
+    sc::worker_pool pool;
+
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, pool.start(0, nullptr));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, pool.start(2, nullptr));
+    CHECK_EQUAL(2u, pool.workers());
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_OPERATION, pool.start(2, nullptr));
+
+    CHECK(pool.native_handle(0) != pool.native_handle(1));
+
+    pool.stop();
+    CHECK_EQUAL(0u, pool.workers());
+}
+
+TEST (pool_start_applies_affinity)
+{
+    sc::worker_pool pool;
+    uint64_t const affinity[] = { 1, 0 };
+    counter c;
+    sc::pool_task task(&counter::run, &c, 0);
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, pool.start(2, affinity));
+
+    pool.post(&task);
+    CHECK(wait_for([&] { return 1 == c.runs.load(); }));
+}
+
+TEST (pool_runs_tasks_on_all_workers)
+{
+    enum { TASKS = 64 };
+
+    sc::worker_pool pool;
+    counter c[TASKS];
+    sc::pool_task tasks[TASKS];
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, pool.start(3, nullptr));
+
+    for (uint32_t i = 0; i < TASKS; ++i) {
+        tasks[i].run = &counter::run;
+        tasks[i].ctx = &c[i];
+        tasks[i].home = i;
+        pool.post(&tasks[i]);
+    }
+
+    CHECK(wait_for([&] {
+        for (uint32_t i = 0; i < TASKS; ++i) {
+            if (!c[i].runs.load()) {
+                return false;
+            }
+        }
+
+        return true;
+    }));
+}
+
+struct exclusive
+{
+    std::atomic<uint32_t> posted;
+    std::atomic<uint32_t> seen;
+    std::atomic<bool> running;
+    std::atomic<bool> overlap;
+
+    exclusive() : posted(0), seen(0), running(false), overlap(false) {}
+
+    static void run(void* ctx)
+    {
+        exclusive* self = static_cast<exclusive*>(ctx);
+
+        if (self->running.exchange(true)) {
+            self->overlap = true;
+        }
+
+        self->seen = self->posted.load();
+        self->running = false;
+    }
+};
+
+TEST (pool_task_runs_exclusively_and_after_last_post)
+{
+    enum { POSTS = 100000 };
+
+    sc::worker_pool pool;
+    exclusive e;
+    sc::pool_task task(&exclusive::run, &e, 0);
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, pool.start(2, nullptr));
+
+    for (uint32_t i = 1; i <= POSTS; ++i) {
+        e.posted = i;
+        pool.post(&task);
+    }
+
+    CHECK(wait_for([&] { return POSTS == e.seen.load(); }));
+    CHECK(!e.overlap);
+}
+
+struct blocker
+{
+    std::atomic<bool> started;
+    std::atomic<bool> release;
+
+    blocker() : started(false), release(false) {}
+
+    static void run(void* ctx)
+    {
+        blocker* self = static_cast<blocker*>(ctx);
+
+        self->started = true;
+
+        while (!self->release) {
+            std::this_thread::yield();
+        }
+    }
+};
+
+TEST (pool_idle_worker_steals_from_busy_one)
+{
+    sc::worker_pool pool;
+    blocker b;
+    counter c;
+    sc::pool_task busy(&blocker::run, &b, 0);
+    sc::pool_task task(&counter::run, &c, 0);
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, pool.start(2, nullptr));
+
+    pool.post(&busy);
+    CHECK(wait_for([&] { return b.started.load(); }));
+
+    // same home as the blocked task
+    pool.post(&task);
+    CHECK(wait_for([&] { return 1 == c.runs.load(); }));
+
+    b.release = true;
+
+    CHECK(pool.steals() >= 1);
+}
+
+TEST (pool_wait_returns_once_task_has_run)
+{
+    sc::worker_pool pool;
+    blocker b;
+    sc::pool_task task(&blocker::run, &b, 0);
+    std::atomic<bool> waited(false);
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, pool.start(1, nullptr));
+
+    pool.post(&task);
+    CHECK(wait_for([&] { return b.started.load(); }));
+
+    std::thread t([&] {
+        pool.wait(&task);
+        waited = true;
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    CHECK(!waited);
+
+    b.release = true;
+    t.join();
+
+    CHECK(waited);
+}
+
+} // anon
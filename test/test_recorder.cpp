@@ -0,0 +1,389 @@
+#include <CppUnitLite2.h>
+
+#include <string.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "supercan_error.h"
+#include "supercan_recorder.h"
+
+namespace
+{
+
+struct memory_sink : public sc::record_sink
+{
+    std::vector<uint8_t> data;
+    std::mutex lock;
+    std::condition_variable cv;
+    uint32_t writes;
+    uint32_t syncs;
+    bool blocked;
+
+    memory_sink() : writes(0), syncs(0), blocked(false) {}
+
+    int write(void const* ptr, size_t bytes) override
+    {
+        std::unique_lock<std::mutex> g(lock);
+
+        while (blocked) {
+            cv.wait(g);
+        }
+
+        data.insert(data.end(), static_cast<uint8_t const*>(ptr), static_cast<uint8_t const*>(ptr) + bytes);
+        ++writes;
+
+        return SC_DLL_ERROR_NONE;
+    }
+
+    int sync() override
+    {
+        std::lock_guard<std::mutex> g(lock);
+        ++syncs;
+        return SC_DLL_ERROR_NONE;
+    }
+
+    void block(bool on)
+    {
+        {
+            std::lock_guard<std::mutex> g(lock);
+            blocked = on;
+        }
+
+        cv.notify_all();
+    }
+};
+
+struct memory_source : public sc::record_source
+{
+    std::vector<uint8_t> const* data;
+    size_t offset;
+    size_t max_read;
+
+    memory_source(std::vector<uint8_t> const* d) : data(d), offset(0), max_read(7) {}
+
+    // short reads on purpose
+    int read(void* ptr, size_t bytes, size_t* got) override
+    {
+        size_t n = data->size() - offset;
+
+        n = n < bytes ? n : bytes;
+        n = n < max_read ? n : max_read;
+        memcpy(ptr, data->data() + offset, n);
+        offset += n;
+        *got = n;
+
+        return SC_DLL_ERROR_NONE;
+    }
+};
+
+sc_can_mm_slot_t make_rx(uint32_t seq)
+{
+    sc_can_mm_slot_t slot;
+
+    memset(&slot, 0, sizeof(slot));
+    slot.rx.type = SC_MM_DATA_TYPE_CAN_RX;
+    slot.rx.can_id = seq;
+    slot.rx.dlc = static_cast<uint8_t>(seq % 9);
+    slot.rx.timestamp_us = seq * 10;
+
+    for (uint8_t i = 0; i < 8; ++i) {
+        slot.rx.data[i] = static_cast<uint8_t>(seq + i);
+    }
+
+    return slot;
+}
+
+/* Decodes a recording, returns the number of records or -1 if malformed */
+int decode(std::vector<uint8_t> const& data, std::vector<sc_can_mm_slot_t>* slots, uint32_t* chunks)
+{
+    sc_rec_file_header file;
+    size_t offset = sizeof(file);
+
+    *chunks = 0;
+
+    if (data.size() < sizeof(file)) {
+        return -1;
+    }
+
+    memcpy(&file, data.data(), sizeof(file));
+
+    if (memcmp(file.magic, SC_REC_FILE_MAGIC, sizeof(file.magic)) || SC_REC_FILE_VERSION != file.version) {
+        return -1;
+    }
+
+    while (offset < data.size()) {
+        sc_rec_chunk_header hdr;
+        std::vector<uint64_t> words;
+
+        if (offset + sizeof(hdr) > data.size()) {
+            return -1;
+        }
+
+        memcpy(&hdr, data.data() + offset, sizeof(hdr));
+        offset += sizeof(hdr);
+
+        if (SC_REC_CHUNK_MAGIC != hdr.magic || *chunks != hdr.seq) {
+            return -1;
+        }
+
+        if (offset + hdr.words * SC_MM_VAR_WORD_SIZE > data.size()) {
+            return -1;
+        }
+
+        words.resize(hdr.words);
+        memcpy(words.data(), data.data() + offset, hdr.words * SC_MM_VAR_WORD_SIZE);
+        offset += hdr.words * SC_MM_VAR_WORD_SIZE;
+
+        for (uint32_t pos = 0, i = 0; i < hdr.records; ++i) {
+            sc_can_mm_slot_t slot;
+
+            if (pos >= hdr.words || sc::mm::var_decode(&words[pos], hdr.words - pos, &slot)) {
+                return -1;
+            }
+
+            pos += sc::mm::var_words(&slot);
+            slots->push_back(slot);
+        }
+
+        ++*chunks;
+    }
+
+    return static_cast<int>(slots->size());
+}
+
+TEST (recorder_start_validates_arguments)
+{
+    sc::recorder r;
+    memory_sink sink;
+
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, r.start(nullptr, 0, 0));
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, r.start(&sink, 16, 0));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, r.start(&sink, 0, 0));
+    CHECK(r.started());
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_OPERATION, r.start(&sink, 0, 0));
+
+    r.stop();
+    CHECK(!r.started());
+    CHECK_EQUAL(sizeof(sc_rec_file_header), sink.data.size());
+}
+
+TEST (recorder_round_trips_records_across_chunks)
+{
+    enum { COUNT = 1000 };
+
+    sc::recorder r;
+    memory_sink sink;
+    std::vector<sc_can_mm_slot_t> slots;
+    sc::recorder_stats stats;
+    uint32_t chunks = 0;
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, r.start(&sink, sc::recorder::MIN_CHUNK_BYTES, 0));
+
+    for (uint32_t i = 0; i < COUNT; ++i) {
+        sc_can_mm_slot_t slot = make_rx(i);
+
+        r.record(&slot);
+
+        // keep the producer behind the I/O thread to rule out drops
+        if (i % 16 == 15) {
+            r.flush();
+            r.stats(&stats);
+
+            while (stats.chunks * 16 < i + 1) {
+                std::this_thread::yield();
+                r.stats(&stats);
+            }
+        }
+    }
+
+    r.stop();
+    r.stats(&stats);
+
+    CHECK_EQUAL(0u, stats.dropped);
+    CHECK_EQUAL(COUNT, stats.records);
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, stats.error);
+    CHECK_EQUAL(sink.data.size(), stats.bytes);
+    CHECK_EQUAL(COUNT, decode(sink.data, &slots, &chunks));
+    CHECK_EQUAL(stats.chunks, chunks);
+
+    for (uint32_t i = 0; i < slots.size(); ++i) {
+        sc_can_mm_slot_t expected = make_rx(i);
+
+        CHECK_EQUAL(SC_MM_DATA_TYPE_CAN_RX, slots[i].rx.type);
+        CHECK_EQUAL(i, slots[i].rx.can_id);
+        CHECK_EQUAL(expected.rx.dlc, slots[i].rx.dlc);
+        CHECK_EQUAL(expected.rx.timestamp_us, slots[i].rx.timestamp_us);
+        CHECK_EQUAL(0, memcmp(expected.rx.data, slots[i].rx.data, expected.rx.dlc));
+    }
+}
+
+TEST (recorder_drops_instead_of_blocking)
+{
+    sc::recorder r;
+    memory_sink sink;
+    std::vector<sc_can_mm_slot_t> slots;
+    sc::recorder_stats stats;
+    uint32_t chunks = 0;
+    uint32_t count = 0;
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, r.start(&sink, sc::recorder::MIN_CHUNK_BYTES, 0));
+    sink.block(true);
+
+    // fill both buffers while the I/O thread is stuck in write
+    for (r.stats(&stats); !stats.dropped; r.stats(&stats)) {
+        sc_can_mm_slot_t slot = make_rx(count++);
+
+        r.record(&slot);
+    }
+
+    sink.block(false);
+    r.stop();
+    r.stats(&stats);
+
+    CHECK(stats.dropped >= 1);
+    CHECK_EQUAL(count, stats.records + stats.dropped);
+    CHECK_EQUAL(static_cast<int>(stats.records), decode(sink.data, &slots, &chunks));
+    CHECK_EQUAL(2u, chunks);
+}
+
+TEST (recorder_batches_syncs)
+{
+    sc::recorder r;
+    memory_sink sink;
+    sc::recorder_stats stats;
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, r.start(&sink, sc::recorder::MIN_CHUNK_BYTES, 4));
+
+    for (uint32_t i = 0; i < 10; ++i) {
+        sc_can_mm_slot_t slot = make_rx(i);
+
+        r.record(&slot);
+        r.flush();
+
+        do {
+            std::this_thread::yield();
+            r.stats(&stats);
+        } while (stats.chunks < i + 1);
+    }
+
+    r.stats(&stats);
+    CHECK_EQUAL(2u, stats.syncs);
+
+    // stop syncs the remaining 2 chunks
+    r.stop();
+    r.stats(&stats);
+    CHECK_EQUAL(3u, stats.syncs);
+    CHECK_EQUAL(3u, sink.syncs);
+    CHECK_EQUAL(11u, sink.writes);
+}
+
+TEST (recorder_stop_writes_partial_chunk)
+{
+    sc::recorder r;
+    memory_sink sink;
+    std::vector<sc_can_mm_slot_t> slots;
+    uint32_t chunks = 0;
+    sc_can_mm_slot_t status;
+
+    memset(&status, 0, sizeof(status));
+    status.status.type = SC_MM_DATA_TYPE_CAN_STATUS;
+    status.status.timestamp_us = 42;
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, r.start(&sink, 0, 0));
+
+    r.record(&status);
+    r.stop();
+
+    CHECK_EQUAL(1, decode(sink.data, &slots, &chunks));
+    CHECK_EQUAL(1u, chunks);
+    CHECK_EQUAL(SC_MM_DATA_TYPE_CAN_STATUS, slots[0].status.type);
+    CHECK_EQUAL(42u, slots[0].status.timestamp_us);
+}
+
+TEST (record_reader_reads_all_records)
+{
+    enum { COUNT = 200 };
+
+    sc::recorder r;
+    sc::record_reader reader;
+    memory_sink sink;
+    sc_can_mm_slot_t slot;
+    bool end = false;
+    uint32_t count = 0;
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, r.start(&sink, sc::recorder::MIN_CHUNK_BYTES, 0));
+
+    for (uint32_t i = 0; i < COUNT; ++i) {
+        slot = make_rx(i);
+        r.record(&slot);
+
+        if (i % 16 == 15) {
+            sc::recorder_stats stats;
+
+            r.flush();
+
+            do {
+                std::this_thread::yield();
+                r.stats(&stats);
+            } while (stats.chunks * 16 < i + 1);
+        }
+    }
+
+    r.stop();
+
+    memory_source source(&sink.data);
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, reader.open(&source));
+
+    for (;;) {
+        CHECK_EQUAL(SC_DLL_ERROR_NONE, reader.next(&slot, &end));
+
+        if (end) {
+            break;
+        }
+
+        CHECK_EQUAL(SC_MM_DATA_TYPE_CAN_RX, slot.rx.type);
+        CHECK_EQUAL(count, slot.rx.can_id);
+        ++count;
+    }
+
+    CHECK_EQUAL(COUNT, count);
+}
+
+TEST (record_reader_stops_at_truncated_chunk)
+{
+    sc::recorder r;
+    sc::record_reader reader;
+    memory_sink sink;
+    sc_can_mm_slot_t slot;
+    bool end = false;
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, r.start(&sink, 0, 0));
+
+    slot = make_rx(1);
+    r.record(&slot);
+    r.stop();
+
+    // chop off the last record word
+    sink.data.resize(sink.data.size() - SC_MM_VAR_WORD_SIZE);
+
+    memory_source source(&sink.data);
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, reader.open(&source));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, reader.next(&slot, &end));
+    CHECK(end);
+}
+
+TEST (record_reader_rejects_foreign_data)
+{
+    sc::record_reader reader;
+    std::vector<uint8_t> data(64, 0x42);
+    memory_source source(&data);
+
+    CHECK_EQUAL(SC_DLL_ERROR_PROTO_VIOLATION, reader.open(&source));
+}
+
+} // anon
@@ -0,0 +1,343 @@
+#include <CppUnitLite2.h>
+
+#include <string.h>
+
+#include <vector>
+
+#include "supercan_error.h"
+#include "supercan_proto.h"
+#include "supercan_cmd.h"
+#include "supercan_replay.h"
+#include "supercan_sim.h"
+#include "supercan_stream.h"
+
+namespace
+{
+
+struct memory_sink : public sc::record_sink
+{
+    std::vector<uint8_t> data;
+
+    int write(void const* ptr, size_t bytes) override
+    {
+        data.insert(data.end(), static_cast<uint8_t const*>(ptr), static_cast<uint8_t const*>(ptr) + bytes);
+        return SC_DLL_ERROR_NONE;
+    }
+
+    int sync() override
+    {
+        return SC_DLL_ERROR_NONE;
+    }
+};
+
+struct memory_source : public sc::record_source
+{
+    std::vector<uint8_t> const* data;
+    size_t offset;
+
+    memory_source(std::vector<uint8_t> const* d) : data(d), offset(0) {}
+
+    int read(void* ptr, size_t bytes, size_t* got) override
+    {
+        size_t n = data->size() - offset;
+
+        n = n < bytes ? n : bytes;
+        memcpy(ptr, data->data() + offset, n);
+        offset += n;
+        *got = n;
+
+        return SC_DLL_ERROR_NONE;
+    }
+};
+
+sc_can_mm_slot_t make_frame(uint8_t type, uint32_t can_id, uint64_t ts_us)
+{
+    sc_can_mm_slot_t slot;
+
+    memset(&slot, 0, sizeof(slot));
+
+    if (SC_MM_DATA_TYPE_CAN_RX == type) {
+        slot.rx.type = SC_MM_DATA_TYPE_CAN_RX;
+        slot.rx.can_id = can_id;
+        slot.rx.dlc = 2;
+        slot.rx.timestamp_us = ts_us;
+        slot.rx.data[0] = static_cast<uint8_t>(can_id);
+        slot.rx.data[1] = static_cast<uint8_t>(can_id >> 8);
+    }
+    else if (SC_MM_DATA_TYPE_CAN_TX == type) {
+        slot.tx.type = SC_MM_DATA_TYPE_CAN_TX;
+        slot.tx.can_id = can_id;
+        slot.tx.dlc = 1;
+        slot.tx.flags = SC_CAN_FRAME_FLAG_EXT;
+        slot.tx.echo = 1;
+        slot.tx.timestamp_us = ts_us;
+        slot.tx.data[0] = static_cast<uint8_t>(can_id);
+    }
+    else {
+        slot.status.type = SC_MM_DATA_TYPE_CAN_STATUS;
+        slot.status.timestamp_us = ts_us;
+    }
+
+    return slot;
+}
+
+struct recording
+{
+    sc::recorder rec;
+    memory_sink sink;
+    memory_source source;
+    sc::record_reader reader;
+
+    recording() : source(&sink.data)
+    {
+        rec.start(&sink, 0, 0);
+    }
+
+    void add(sc_can_mm_slot_t const& slot)
+    {
+        rec.record(&slot);
+    }
+
+    int open()
+    {
+        rec.stop();
+        return reader.open(&source);
+    }
+};
+
+TEST (replay_keeps_recorded_spacing)
+{
+    recording r;
+    sc::replay replay;
+    sc_mm_can_tx frames[4];
+    uint32_t taken = 0;
+    uint32_t wait_us = 0;
+
+    r.add(make_frame(SC_MM_DATA_TYPE_CAN_RX, 1, 1000));
+    r.add(make_frame(SC_MM_DATA_TYPE_CAN_RX, 2, 1100));
+    r.add(make_frame(SC_MM_DATA_TYPE_CAN_STATUS, 0, 1200));
+    r.add(make_frame(SC_MM_DATA_TYPE_CAN_TX, 3, 1350));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, r.open());
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, replay.start(&r.reader, 50000, 10, sc::replay::FLAG_RX | sc::replay::FLAG_TX));
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, replay.next(50000, frames, 4, &taken, &wait_us));
+    CHECK_EQUAL(1u, taken);
+    CHECK_EQUAL(1u, frames[0].can_id);
+    CHECK_EQUAL(50000u, frames[0].timestamp_us);
+    CHECK_EQUAL(2, frames[0].dlc);
+    CHECK_EQUAL(1, frames[0].data[0]);
+    CHECK_EQUAL(90u, wait_us);
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, replay.next(50090, frames, 4, &taken, &wait_us));
+    CHECK_EQUAL(1u, taken);
+    CHECK_EQUAL(2u, frames[0].can_id);
+    CHECK_EQUAL(50100u, frames[0].timestamp_us);
+    CHECK_EQUAL(250u, wait_us);
+
+    CHECK(!replay.end());
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, replay.next(50340, frames, 4, &taken, &wait_us));
+    CHECK_EQUAL(1u, taken);
+    CHECK_EQUAL(3u, frames[0].can_id);
+    CHECK_EQUAL(SC_CAN_FRAME_FLAG_EXT, frames[0].flags);
+    CHECK_EQUAL(50350u, frames[0].timestamp_us);
+    CHECK_EQUAL(UINT32_MAX, wait_us);
+    CHECK(replay.end());
+}
+
+TEST (replay_filters_by_direction)
+{
+    recording r;
+    sc::replay replay;
+    sc_mm_can_tx frames[4];
+    uint32_t taken = 0;
+    uint32_t wait_us = 0;
+
+    r.add(make_frame(SC_MM_DATA_TYPE_CAN_RX, 1, 1000));
+    r.add(make_frame(SC_MM_DATA_TYPE_CAN_TX, 2, 1100));
+    r.add(make_frame(SC_MM_DATA_TYPE_CAN_RX, 3, 1200));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, r.open());
+
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, replay.start(&r.reader, 0, 0, 0));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, replay.start(&r.reader, 0, 0, sc::replay::FLAG_TX));
+
+    // the first replayed frame defines the time base
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, replay.next(0, frames, 4, &taken, &wait_us));
+    CHECK_EQUAL(1u, taken);
+    CHECK_EQUAL(2u, frames[0].can_id);
+    CHECK_EQUAL(0u, frames[0].timestamp_us);
+    CHECK(replay.end());
+}
+
+TEST (replay_respects_capacity_and_counts_late_frames)
+{
+    recording r;
+    sc::replay replay;
+    sc_mm_can_tx frames[2];
+    uint32_t taken = 0;
+    uint32_t wait_us = 0;
+    sc::replay_stats stats;
+
+    for (uint32_t i = 0; i < 3; ++i) {
+        r.add(make_frame(SC_MM_DATA_TYPE_CAN_RX, i, i * 10));
+    }
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, r.open());
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, replay.start(&r.reader, 100, 0, sc::replay::FLAG_RX));
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, replay.next(125, frames, 2, &taken, &wait_us));
+    CHECK_EQUAL(2u, taken);
+    CHECK_EQUAL(0u, wait_us);
+
+    replay.sent(frames[0].timestamp_us, 120);
+    replay.sent(frames[1].timestamp_us, 105);
+
+    replay.stats(&stats);
+    CHECK_EQUAL(2u, stats.queued);
+    CHECK_EQUAL(2u, stats.late);
+    CHECK_EQUAL(2u, stats.sent);
+    CHECK_EQUAL(-5, stats.error_min_us);
+    CHECK_EQUAL(20, stats.error_max_us);
+    CHECK_EQUAL(25u, stats.error_abs_sum_us);
+}
+
+/* Replays a recording of full bus load with gaps through the simulated
+ * device and returns the TX timing jitter or -1 on failure.
+ */
+int64_t sim_replay_jitter(uint32_t frames_total, sc::replay_stats* stats)
+{
+    enum {
+        FRAME_US = 100,
+        STEP_US = 10,
+        EPP_SIZE = 64,
+        RX_COUNT = 8,
+    };
+
+    struct context
+    {
+        sc::replay replay;
+        uint64_t targets[256];
+        uint32_t in_flight;
+        uint32_t txr;
+
+        static int on_rx_batch(void* ctx, sc_can_frame_t const* frames, size_t count)
+        {
+            context* self = static_cast<context*>(ctx);
+
+            for (size_t i = 0; i < count; ++i) {
+                if (SC_MSG_CAN_TXR == frames[i].type) {
+                    self->replay.sent(self->targets[frames[i].track_id], frames[i].timestamp_us);
+                    --self->in_flight;
+                    ++self->txr;
+                }
+            }
+
+            return SC_DLL_ERROR_NONE;
+        }
+    };
+
+    recording r;
+    context c;
+    sc_sim_config_t config;
+    sc_sim_t sim;
+    sc_transport_t can;
+    sc_transport_t cmd;
+    sc_stream_core_t core;
+    struct sc_msg_config bus;
+    uint8_t rsp[64];
+    uint64_t ts = 0;
+    uint32_t track_id = 0;
+    int64_t jitter = -1;
+
+    // back to back frames, every 100th frame followed by 5 ms of silence
+    for (uint32_t i = 0; i < frames_total; ++i) {
+        r.add(make_frame(SC_MM_DATA_TYPE_CAN_RX, i, ts));
+        ts += (i % 100 == 99) ? 5000 : FRAME_US;
+    }
+
+    if (r.open()) {
+        return -1;
+    }
+
+    c.in_flight = 0;
+    c.txr = 0;
+
+    sc_sim_config_init(&config);
+    config.echo = 0;
+    config.tx_rate_hz = 1000000 / FRAME_US;
+    config.in_transfers = RX_COUNT;
+    sc_sim_init(&sim, &config);
+    sc_sim_can_transport(&sim, &can);
+    sc_stream_core_init(&core, &can, config.msg_buffer_size, EPP_SIZE, RX_COUNT, 0);
+    sc_stream_core_set_rx_batch_callback(&core, &c, &context::on_rx_batch, 0);
+    sc_stream_core_start(&core);
+
+    bus.id = SC_MSG_BUS;
+    bus.len = sizeof(bus);
+    bus.arg = 1;
+    sc_sim_cmd_transport(&sim, &cmd);
+    sc_cmd_exchange(&cmd, (uint8_t const*)&bus, sizeof(bus), rsp, sizeof(rsp), nullptr, 0);
+
+    // device and host time are the same in the simulation
+    c.replay.start(&r.reader, sim.now_us + 1000, FRAME_US, sc::replay::FLAG_RX);
+
+    for (uint32_t guard = 0; (!c.replay.end() || c.in_flight) && guard < frames_total * 1000; ++guard) {
+        sc_mm_can_tx frames[8];
+        uint32_t taken = 0;
+        uint32_t wait_us = 0;
+        uint32_t const credits = config.tx_fifo_size - c.in_flight;
+
+        c.replay.next(sim.now_us, frames, credits < 8 ? credits : 8, &taken, &wait_us);
+
+        if (taken) {
+            sc_stream_core_tx_batch_begin(&core);
+
+            for (uint32_t i = 0; i < taken; ++i) {
+                uint8_t msg[sizeof(struct sc_msg_can_tx4) + 8] = { SC_MSG_CAN_TX4, sizeof(msg), frames[i].dlc, SC_CAN_FRAME_FLAG_TX4 };
+                struct sc_msg_can_tx4* tx = reinterpret_cast<struct sc_msg_can_tx4*>(msg);
+                uint8_t const* buffers[] = { msg };
+                uint16_t const sizes[] = { sizeof(msg) };
+                size_t added = 0;
+
+                tx->can_id = frames[i].can_id;
+                tx->track_id = static_cast<uint8_t>(track_id);
+                memcpy(tx->data, frames[i].data, 8);
+                c.targets[track_id & 0xff] = frames[i].timestamp_us;
+                ++track_id;
+                ++c.in_flight;
+                sc_stream_core_tx_batch_add(&core, buffers, sizes, 1, &added);
+            }
+
+            sc_stream_core_tx_batch_end(&core);
+        }
+
+        sc_sim_advance(&sim, STEP_US);
+
+        while (SC_DLL_ERROR_NONE == sc_stream_core_rx(&core, 0));
+    }
+
+    c.replay.stats(stats);
+
+    if (c.txr == frames_total && !sim.stats.tx_dropped) {
+        jitter = stats->error_max_us - stats->error_min_us;
+    }
+
+    sc_stream_core_uninit(&core);
+    sc_sim_uninit(&sim);
+
+    return jitter;
+}
+
+TEST (replay_reproduces_timing_at_full_bus_load)
+{
+    sc::replay_stats stats;
+    int64_t jitter = sim_replay_jitter(1000, &stats);
+
+    CHECK(jitter >= 0);
+    CHECK(jitter <= 10);
+    CHECK_EQUAL(1000u, stats.sent);
+    CHECK_EQUAL(0u, stats.late);
+    CHECK(stats.error_abs_sum_us <= 10 * stats.sent);
+}
+
+} // anon
@@ -0,0 +1,405 @@
+#include <CppUnitLite2.h>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "supercan_proto.h"
+#include "supercan_error.h"
+#include "supercan_rx.h"
+
+#ifndef ARRAY_SIZE
+    #define ARRAY_SIZE(x) (sizeof(x)/sizeof((x)[0]))
+#endif
+
+namespace
+{
+
+static inline uint32_t bswap32(uint32_t x)
+{
+    return ((x & 0xff) << 24) | ((x & 0xff00) << 8) | ((x >> 8) & 0xff00) | (x >> 24);
+}
+
+struct rx_fixture
+{
+    sc_rx_decoder_t dec;
+    std::vector<uint8_t> buf;
+    sc_can_frame_t frames[16];
+    size_t offset;
+    size_t count;
+
+    rx_fixture()
+        : offset(0)
+        , count(0)
+    {
+        sc_rx_decoder_init(&dec, 0);
+        memset(frames, 0, sizeof(frames));
+    }
+
+    void add_rx(uint32_t can_id, uint32_t ts, uint8_t dlc, uint8_t flags = 0)
+    {
+        size_t len = sizeof(struct sc_msg_can_rx) + dlc;
+        len = (len + SC_MSG_CAN_LEN_MULTIPLE - 1) & ~(size_t)(SC_MSG_CAN_LEN_MULTIPLE - 1);
+        size_t at = buf.size();
+        buf.resize(at + len);
+        struct sc_msg_can_rx* rx = (struct sc_msg_can_rx*)&buf[at];
+        rx->id = SC_MSG_CAN_RX;
+        rx->len = (uint8_t)len;
+        rx->dlc = dlc;
+        rx->flags = flags;
+        rx->can_id = can_id;
+        rx->timestamp_us = ts;
+        for (uint8_t i = 0; i < dlc; ++i) {
+            rx->data[i] = i;
+        }
+    }
+
+    void add_txr(uint8_t track_id, uint32_t ts)
+    {
+        size_t at = buf.size();
+        buf.resize(at + sizeof(struct sc_msg_can_txr));
+        struct sc_msg_can_txr* txr = (struct sc_msg_can_txr*)&buf[at];
+        txr->id = SC_MSG_CAN_TXR;
+        txr->len = sizeof(*txr);
+        txr->flags = SC_CAN_FRAME_FLAG_DRP;
+        txr->track_id = track_id;
+        txr->timestamp_us = ts;
+    }
+
+    void add_raw(uint8_t id, uint8_t len)
+    {
+        size_t at = buf.size();
+        buf.resize(at + len);
+        buf[at] = id;
+        buf[at + 1] = len;
+    }
+
+    int decode(size_t capacity = ARRAY_SIZE(frames))
+    {
+        return sc_rx_decode(&dec, buf.data(), buf.size(), &offset, frames, capacity, &count);
+    }
+
+    // fields of a frame that are valid for its type, payload copied out of the transfer
+    struct decoded
+    {
+        uint32_t can_id;
+        uint8_t type;
+        uint8_t track_id;
+        uint8_t dlc;
+        uint8_t data[64];
+
+        bool operator==(decoded const& other) const
+        {
+            return can_id == other.can_id &&
+                type == other.type &&
+                track_id == other.track_id &&
+                dlc == other.dlc &&
+                0 == memcmp(data, other.data, sizeof(data));
+        }
+    };
+
+    void collect(std::vector<decoded>* out)
+    {
+        for (size_t i = 0; i < count; ++i) {
+            decoded d;
+
+            memset(&d, 0, sizeof(d));
+            d.type = frames[i].type;
+
+            if (SC_MSG_CAN_TXR == d.type) {
+                d.track_id = frames[i].track_id;
+            }
+            else if (SC_MSG_CAN_RX == d.type) {
+                d.can_id = frames[i].can_id;
+                d.dlc = frames[i].dlc;
+                if (frames[i].data) {
+                    memcpy(d.data, frames[i].data, d.dlc);
+                }
+            }
+
+            out->push_back(d);
+        }
+    }
+
+    // decodes buf as a sequence of transfers, cut at the given offsets
+    int decode_split(std::vector<size_t> const& cuts, size_t capacity, std::vector<decoded>* out)
+    {
+        std::vector<uint8_t> whole(buf);
+        size_t start = 0;
+        int error = SC_DLL_ERROR_NONE;
+
+        for (size_t i = 0; i <= cuts.size() && !error; ++i) {
+            size_t stop = i < cuts.size() ? cuts[i] : whole.size();
+
+            buf.assign(whole.begin() + start, whole.begin() + stop);
+            offset = 0;
+
+            while (!error && offset < buf.size()) {
+                error = decode(capacity);
+                collect(out);
+
+                if (!count) {
+                    break;
+                }
+            }
+
+            start = stop;
+        }
+
+        buf.swap(whole);
+
+        return error;
+    }
+};
+
+TEST_F(rx_fixture, empty_buffer_yields_no_frames)
+{
+    int error = decode();
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, error);
+    CHECK_EQUAL(0u, count);
+    CHECK_EQUAL(0u, offset);
+}
+
+TEST_F(rx_fixture, rx_and_txr_messages_are_decoded_in_order)
+{
+    add_rx(0x123, 10, 8, SC_CAN_FRAME_FLAG_EXT);
+    add_txr(7, 20);
+    add_rx(0x456, 30, 0, SC_CAN_FRAME_FLAG_RTR);
+
+    int error = decode();
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, error);
+    CHECK_EQUAL(3u, count);
+    CHECK_EQUAL(buf.size(), offset);
+
+    CHECK_EQUAL(SC_MSG_CAN_RX, frames[0].type);
+    CHECK_EQUAL(0x123u, frames[0].can_id);
+    CHECK_EQUAL(8, frames[0].dlc);
+    CHECK_EQUAL(SC_CAN_FRAME_FLAG_EXT, frames[0].flags);
+    CHECK_EQUAL(10u, frames[0].timestamp_us);
+    CHECK(frames[0].data == &buf[sizeof(struct sc_msg_can_rx)]);
+    CHECK_EQUAL(7, frames[0].data[7]);
+
+    CHECK_EQUAL(SC_MSG_CAN_TXR, frames[1].type);
+    CHECK_EQUAL(7, frames[1].track_id);
+    CHECK_EQUAL(SC_CAN_FRAME_FLAG_DRP, frames[1].flags);
+    CHECK_EQUAL(20u, frames[1].timestamp_us);
+
+    CHECK_EQUAL(SC_MSG_CAN_RX, frames[2].type);
+    CHECK(frames[2].data == NULL);
+}
+
+TEST_F(rx_fixture, eof_message_terminates_buffer)
+{
+    add_txr(1, 1);
+    add_raw(SC_MSG_EOF, 4);
+    add_txr(2, 2);
+
+    int error = decode();
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, error);
+    CHECK_EQUAL(1u, count);
+    CHECK_EQUAL(buf.size(), offset);
+}
+
+TEST_F(rx_fixture, unknown_messages_are_skipped)
+{
+    add_raw(SC_MSG_USER_OFFSET, 12);
+    add_txr(3, 3);
+
+    int error = decode();
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, error);
+    CHECK_EQUAL(1u, count);
+    CHECK_EQUAL(3, frames[0].track_id);
+}
+
+TEST_F(rx_fixture, truncated_messages_are_protocol_violations)
+{
+    add_rx(0x1, 1, 8);
+    buf.resize(buf.size() - 4);
+
+    int error = decode();
+    CHECK_EQUAL(SC_DLL_ERROR_PROTO_VIOLATION, error);
+    CHECK_EQUAL(0u, count);
+
+    buf.clear();
+    offset = 0;
+    add_raw(SC_MSG_CAN_TXR, 4);
+    error = decode();
+    CHECK_EQUAL(SC_DLL_ERROR_PROTO_VIOLATION, error);
+
+    buf.clear();
+    offset = 0;
+    add_raw(SC_MSG_CAN_RX, 2);
+    buf.resize(8);
+    error = decode();
+    CHECK_EQUAL(SC_DLL_ERROR_PROTO_VIOLATION, error);
+}
+
+TEST_F(rx_fixture, decoding_resumes_when_capacity_is_exhausted)
+{
+    for (uint8_t i = 0; i < 5; ++i) {
+        add_txr(i, i);
+    }
+
+    size_t total = 0;
+    for (;;) {
+        int error = decode(2);
+        CHECK_EQUAL(SC_DLL_ERROR_NONE, error);
+        for (size_t i = 0; i < count; ++i) {
+            CHECK_EQUAL(total + i, frames[i].track_id);
+        }
+        total += count;
+        if (offset == buf.size()) {
+            break;
+        }
+        CHECK_EQUAL(2u, count);
+    }
+
+    CHECK_EQUAL(5u, total);
+}
+
+TEST_F(rx_fixture, device_byte_order_is_swapped)
+{
+    sc_rx_decoder_init(&dec, 1);
+    add_rx(bswap32(0x1abcdef), bswap32(0x01020304), 0);
+
+    int error = decode();
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, error);
+    CHECK_EQUAL(1u, count);
+    CHECK_EQUAL(0x1abcdefu, frames[0].can_id);
+    CHECK_EQUAL(0x01020304u, frames[0].timestamp_us);
+}
+
+TEST_F(rx_fixture, timestamps_are_extended_to_64_bit)
+{
+    add_txr(0, UINT32_MAX);
+    add_txr(1, 5);
+
+    int error = decode();
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, error);
+    CHECK_EQUAL(2u, count);
+    CHECK_EQUAL((UINT64_C(1) << 32) + 5, frames[1].timestamp_us);
+}
+
+TEST_F(rx_fixture, partial_messages_are_reassembled_at_every_split)
+{
+    std::vector<decoded> expected;
+
+    add_rx(0x123, 1, 8);
+    add_txr(7, 2);
+    add_rx(0x1abcdef, 3, 7, SC_CAN_FRAME_FLAG_EXT);
+    add_raw(0xfe, 12);
+    add_txr(8, 4);
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, decode());
+    collect(&expected);
+    CHECK_EQUAL(4u, expected.size());
+
+    for (size_t cut = 1; cut < buf.size(); ++cut) {
+        std::vector<decoded> actual;
+        std::vector<size_t> cuts(1, cut);
+
+        sc_rx_decoder_init(&dec, 0);
+        sc_rx_decoder_set_reassembly(&dec, 1);
+
+        CHECK_EQUAL(SC_DLL_ERROR_NONE, decode_split(cuts, ARRAY_SIZE(frames), &actual));
+        CHECK(expected == actual);
+        CHECK_EQUAL(0u, dec.reassembly.size);
+    }
+}
+
+TEST_F(rx_fixture, randomly_split_transfers_decode_like_whole_buffer)
+{
+    std::mt19937 rng(0x5c);
+    std::uniform_int_distribution<int> kind(0, 3);
+    std::uniform_int_distribution<int> dlc(0, 8);
+    std::uniform_int_distribution<size_t> chunk(1, 96);
+    std::uniform_int_distribution<size_t> capacity(1, ARRAY_SIZE(frames));
+    std::vector<decoded> expected;
+
+    for (uint32_t i = 0; i < 2000; ++i) {
+        switch (kind(rng)) {
+        case 0:
+            add_txr((uint8_t)i, i);
+            break;
+        case 1:
+            add_raw(0xfe, (uint8_t)(4 + 4 * (i % 16)));
+            break;
+        default:
+            add_rx(i, i, (uint8_t)dlc(rng), SC_CAN_FRAME_FLAG_FDF);
+            break;
+        }
+    }
+
+    // reference
+    offset = 0;
+    while (offset < buf.size()) {
+        int error = decode();
+        CHECK_EQUAL(SC_DLL_ERROR_NONE, error);
+        if (error) {
+            break;
+        }
+        collect(&expected);
+    }
+
+    for (int round = 0; round < 20; ++round) {
+        std::vector<decoded> actual;
+        std::vector<size_t> cuts;
+        size_t at = chunk(rng);
+
+        while (at < buf.size()) {
+            cuts.push_back(at);
+            at += chunk(rng);
+        }
+
+        sc_rx_decoder_init(&dec, 0);
+        sc_rx_decoder_set_reassembly(&dec, 1);
+
+        CHECK_EQUAL(SC_DLL_ERROR_NONE, decode_split(cuts, capacity(rng), &actual));
+        CHECK_EQUAL(expected.size(), actual.size());
+        CHECK(expected == actual);
+    }
+}
+
+TEST_F(rx_fixture, reassembly_rejects_invalid_carried_header)
+{
+    sc_rx_decoder_set_reassembly(&dec, 1);
+
+    // length shorter than the header
+    buf.resize(2);
+    buf[0] = SC_MSG_CAN_TXR;
+    buf[1] = 2;
+    CHECK_EQUAL(SC_DLL_ERROR_PROTO_VIOLATION, decode());
+    CHECK_EQUAL(0u, dec.reassembly.size);
+
+    // same, header split across transfers
+    buf.assign(1, SC_MSG_CAN_TXR);
+    offset = 0;
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, decode());
+    CHECK_EQUAL(1u, offset);
+    CHECK_EQUAL(1u, dec.reassembly.size);
+
+    buf.assign(3, 0);
+    buf[0] = 2;
+    offset = 0;
+    CHECK_EQUAL(SC_DLL_ERROR_PROTO_VIOLATION, decode());
+    CHECK_EQUAL(0u, dec.reassembly.size);
+}
+
+TEST_F(rx_fixture, reassembly_discards_trailing_end_of_input)
+{
+    sc_rx_decoder_set_reassembly(&dec, 1);
+    add_txr(1, 1);
+    buf.resize(buf.size() + 2);
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, decode());
+    CHECK_EQUAL(1u, count);
+    CHECK_EQUAL(buf.size(), offset);
+    CHECK_EQUAL(0u, dec.reassembly.size);
+}
+
+TEST (rx_frame_count_covers_smallest_messages)
+{
+    CHECK_EQUAL(64, SC_CAN_FRAME_COUNT(512));
+    CHECK_EQUAL(1, SC_CAN_FRAME_COUNT(4));
+}
+
+} // anon
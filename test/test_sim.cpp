@@ -0,0 +1,438 @@
+#include <CppUnitLite2.h>
+#include <cstring>
+#include <vector>
+
+#include "supercan_proto.h"
+#include "supercan_error.h"
+#include "supercan_cmd.h"
+#include "supercan_sim.h"
+#include "supercan_stream.h"
+
+namespace
+{
+
+enum {
+    RX_COUNT = 4,
+    EPP_SIZE = 64,
+};
+
+struct sim_fixture
+{
+    sc_sim_config_t config;
+    sc_sim_t sim;
+    sc_transport_t cmd;
+    sc_transport_t can;
+    sc_stream_core_t core;
+    uint8_t tx[64];
+    uint8_t rx[64];
+    std::vector<sc_can_frame_t> frames;
+    std::vector<uint8_t> frame_data;
+    bool started;
+
+    sim_fixture()
+        : started(false)
+    {
+        sc_sim_config_init(&config);
+        memset(&sim, 0, sizeof(sim));
+        memset(&core, 0, sizeof(core));
+    }
+
+    ~sim_fixture()
+    {
+        if (started) {
+            sc_stream_core_uninit(&core);
+        }
+
+        sc_sim_uninit(&sim);
+    }
+
+    int init()
+    {
+        int error = sc_sim_init(&sim, &config);
+        if (error) {
+            return error;
+        }
+
+        sc_sim_cmd_transport(&sim, &cmd);
+        sc_sim_can_transport(&sim, &can);
+
+        return SC_DLL_ERROR_NONE;
+    }
+
+    int start_stream()
+    {
+        int error = sc_stream_core_init(&core, &can, config.msg_buffer_size, EPP_SIZE, RX_COUNT, 0);
+        if (error) {
+            return error;
+        }
+
+        started = true;
+
+        error = sc_stream_core_set_rx_batch_callback(&core, this, &sim_fixture::on_rx_batch, 0);
+        if (error) {
+            return error;
+        }
+
+        return sc_stream_core_start(&core);
+    }
+
+    static int on_rx_batch(void* ctx, sc_can_frame_t const* f, size_t count)
+    {
+        sim_fixture* self = static_cast<sim_fixture*>(ctx);
+
+        for (size_t i = 0; i < count; ++i) {
+            self->frames.push_back(f[i]);
+            if (SC_MSG_CAN_RX == f[i].type) {
+                self->frame_data.push_back(f[i].data[0]);
+            }
+        }
+
+        return SC_DLL_ERROR_NONE;
+    }
+
+    void drain()
+    {
+        while (SC_DLL_ERROR_NONE == sc_stream_core_rx(&core, 0));
+    }
+
+    int run(size_t bytes, uint16_t* size)
+    {
+        return sc_cmd_exchange(&cmd, tx, (uint16_t)bytes, rx, sizeof(rx), size, 0);
+    }
+
+    int8_t command_error(size_t bytes)
+    {
+        uint16_t size = 0;
+        struct sc_msg_error const* e = (struct sc_msg_error const*)rx;
+
+        if (run(bytes, &size) || size < sizeof(*e) || SC_MSG_ERROR != e->id) {
+            return SC_ERROR_UNKNOWN;
+        }
+
+        return e->error;
+    }
+
+    int8_t bus(bool on)
+    {
+        struct sc_msg_config* msg = (struct sc_msg_config*)tx;
+
+        msg->id = SC_MSG_BUS;
+        msg->len = sizeof(*msg);
+        msg->arg = on;
+
+        return command_error(sizeof(*msg));
+    }
+
+    int8_t features(uint8_t op, uint32_t arg)
+    {
+        struct sc_msg_features* msg = (struct sc_msg_features*)tx;
+
+        msg->id = SC_MSG_FEATURES;
+        msg->len = sizeof(*msg);
+        msg->unused = 0;
+        msg->op = op;
+        msg->arg = arg;
+
+        return command_error(sizeof(*msg));
+    }
+
+    size_t tx4(size_t offset, uint32_t can_id, uint8_t track_id, uint8_t value)
+    {
+        struct sc_msg_can_tx4* msg = (struct sc_msg_can_tx4*)&tx[offset];
+
+        memset(msg, 0, sizeof(*msg) + 8);
+        msg->id = SC_MSG_CAN_TX4;
+        msg->len = sizeof(*msg) + 8;
+        msg->dlc = 8;
+        msg->flags = SC_CAN_FRAME_FLAG_TX4;
+        msg->can_id = can_id;
+        msg->track_id = track_id;
+        memset(msg->data, value, 8);
+
+        return offset + msg->len;
+    }
+
+    int send(size_t bytes)
+    {
+        int error = sc_stream_core_tx_batch_begin(&core);
+        uint8_t const* buffers[] = { tx };
+        uint16_t const sizes[] = { (uint16_t)bytes };
+        size_t added = 0;
+
+        if (error) {
+            return error;
+        }
+
+        error = sc_stream_core_tx_batch_add(&core, buffers, sizes, 1, &added);
+        if (error) {
+            return error;
+        }
+
+        return sc_stream_core_tx_batch_end(&core);
+    }
+
+    size_t count(uint8_t type) const
+    {
+        size_t c = 0;
+
+        for (size_t i = 0; i < frames.size(); ++i) {
+            c += frames[i].type == type;
+        }
+
+        return c;
+    }
+};
+
+TEST (sim_init_rejects_invalid_config)
+{
+    sc_sim_config_t config;
+    sc_sim_t sim;
+
+    sc_sim_config_init(&config);
+    config.tx_fifo_size = 0;
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, sc_sim_init(&sim, &config));
+
+    sc_sim_config_init(&config);
+    config.msg_buffer_size = 510;
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, sc_sim_init(&sim, &config));
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_sim_init(&sim, nullptr));
+    sc_sim_uninit(&sim);
+}
+
+TEST_F(sim_fixture, hello_reports_protocol_and_cmd_buffer_size)
+{
+    struct sc_msg_hello const* hello = (struct sc_msg_hello const*)rx;
+    uint16_t size = 0;
+
+    config.byte_order = SC_BYTE_ORDER_BE;
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, init());
+
+    tx[0] = SC_MSG_HELLO_DEVICE;
+    tx[1] = sizeof(struct sc_msg_req);
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, run(sizeof(struct sc_msg_req), &size));
+    CHECK_EQUAL(sizeof(*hello), size);
+    CHECK_EQUAL(SC_MSG_HELLO_HOST, hello->id);
+    CHECK_EQUAL(SC_VERSION, hello->proto_version);
+    CHECK_EQUAL(SC_BYTE_ORDER_BE, hello->byte_order);
+    CHECK_EQUAL(0, rx[4]);
+    CHECK_EQUAL(64, rx[5]);
+}
+
+TEST_F(sim_fixture, device_and_can_info)
+{
+    struct sc_msg_dev_info const* dev_info = (struct sc_msg_dev_info const*)rx;
+    struct sc_msg_can_info const* can_info = (struct sc_msg_can_info const*)rx;
+    uint16_t size = 0;
+
+    config.tx_fifo_size = 7;
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, init());
+
+    tx[0] = SC_MSG_DEVICE_INFO;
+    tx[1] = sizeof(struct sc_msg_req);
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, run(sizeof(struct sc_msg_req), &size));
+    CHECK_EQUAL(sizeof(*dev_info), size);
+    CHECK_EQUAL(SC_MSG_DEVICE_INFO, dev_info->id);
+    CHECK_EQUAL(config.feat_perm, dev_info->feat_perm);
+    CHECK_EQUAL(config.feat_conf, dev_info->feat_conf);
+
+    tx[0] = SC_MSG_CAN_INFO;
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, run(sizeof(struct sc_msg_req), &size));
+    CHECK_EQUAL(sizeof(*can_info), size);
+    CHECK_EQUAL(SC_MSG_CAN_INFO, can_info->id);
+    CHECK_EQUAL(config.msg_buffer_size, can_info->msg_buffer_size);
+    CHECK_EQUAL(config.can_clk_hz, can_info->can_clk_hz);
+    CHECK_EQUAL(7, can_info->tx_fifo_size);
+}
+
+TEST_F(sim_fixture, bittiming_is_validated)
+{
+    struct sc_msg_bittiming* bt = (struct sc_msg_bittiming*)tx;
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, init());
+
+    bt->id = SC_MSG_NM_BITTIMING;
+    bt->len = sizeof(*bt);
+    bt->sjw = 1;
+    bt->tseg2 = 16;
+    bt->brp = 1;
+    bt->tseg1 = 63;
+    CHECK_EQUAL(SC_ERROR_NONE, command_error(sizeof(*bt)));
+    CHECK_EQUAL(63, sim.nm_tseg1);
+
+    bt->brp = 0;
+    CHECK_EQUAL(SC_ERROR_PARAM, command_error(sizeof(*bt)));
+
+    bt->len = 4;
+    CHECK_EQUAL(SC_ERROR_SHORT, command_error(4));
+
+    bt->id = SC_MSG_DT_BITTIMING;
+    bt->len = sizeof(*bt);
+    bt->brp = 2;
+    bt->tseg1 = 7;
+    bt->tseg2 = 2;
+    CHECK_EQUAL(SC_ERROR_NONE, command_error(sizeof(*bt)));
+    CHECK_EQUAL(2, sim.dt_brp);
+
+    CHECK_EQUAL(SC_ERROR_NONE, bus(true));
+    bt->id = SC_MSG_NM_BITTIMING;
+    bt->len = sizeof(*bt);
+    bt->sjw = 1;
+    bt->tseg2 = 16;
+    bt->brp = 1;
+    bt->tseg1 = 63;
+    CHECK_EQUAL(SC_ERROR_BUSY, command_error(sizeof(*bt)));
+}
+
+TEST_F(sim_fixture, features_and_unknown_commands)
+{
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, init());
+
+    CHECK_EQUAL(SC_ERROR_NONE, features(SC_FEAT_OP_OR, SC_FEATURE_FLAG_FDF));
+    CHECK_EQUAL(SC_FEATURE_FLAG_FDF | SC_FEATURE_FLAG_TXR, sim.features);
+    CHECK_EQUAL(SC_ERROR_UNSUPPORTED, features(SC_FEAT_OP_OR, SC_FEATURE_FLAG_GEN));
+    CHECK_EQUAL(SC_ERROR_PARAM, features(0x7f, 0));
+    CHECK_EQUAL(SC_ERROR_NONE, features(SC_FEAT_OP_CLEAR, 0));
+    CHECK_EQUAL(SC_FEATURE_FLAG_TXR, sim.features);
+
+    tx[0] = SC_MSG_USER_OFFSET;
+    tx[1] = 4;
+    CHECK_EQUAL(SC_ERROR_UNSUPPORTED, command_error(4));
+}
+
+TEST_F(sim_fixture, replies_to_every_command_in_buffer)
+{
+    uint16_t size = 0;
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, init());
+
+    for (size_t i = 0; i < 3; ++i) {
+        struct sc_msg_config* msg = (struct sc_msg_config*)&tx[i * sizeof(*msg)];
+        msg->id = SC_MSG_BUS;
+        msg->len = sizeof(*msg);
+        msg->arg = i == 1;
+    }
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, run(3 * sizeof(struct sc_msg_config), &size));
+    CHECK_EQUAL(3 * sizeof(struct sc_msg_error), size);
+    CHECK_EQUAL(SC_MSG_ERROR, rx[8]);
+    CHECK_EQUAL(0, sim.bus_on);
+    CHECK_EQUAL(3u, sim.stats.commands);
+}
+
+TEST_F(sim_fixture, tx_yields_receipt_and_echo)
+{
+    size_t bytes = 0;
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, init());
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, start_stream());
+    CHECK_EQUAL(SC_ERROR_NONE, bus(true));
+
+    bytes = tx4(0, 0x123, 5, 0xaa);
+    bytes = tx4(bytes, 0x124, 6, 0xbb);
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, send(bytes));
+    drain();
+
+    CHECK_EQUAL(2u, count(SC_MSG_CAN_TXR));
+    CHECK_EQUAL(2u, count(SC_MSG_CAN_RX));
+    CHECK_EQUAL(5, frames[0].track_id);
+    CHECK_EQUAL(0x123u, frames[1].can_id);
+    CHECK_EQUAL(0xaa, frame_data[0]);
+    CHECK_EQUAL(0xbb, frame_data[1]);
+}
+
+TEST_F(sim_fixture, full_tx_fifo_drops_frames)
+{
+    size_t bytes = 0;
+
+    config.tx_fifo_size = 2;
+    config.tx_rate_hz = 1000;
+    config.echo = 0;
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, init());
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, start_stream());
+    CHECK_EQUAL(SC_ERROR_NONE, bus(true));
+
+    for (uint8_t i = 0; i < 3; ++i) {
+        bytes = tx4(bytes, 0x100 + i, i, i);
+    }
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, send(bytes));
+    drain();
+
+    // third frame is dropped right away
+    CHECK_EQUAL(1u, frames.size());
+    CHECK_EQUAL(2, frames[0].track_id);
+    CHECK(frames[0].flags & SC_CAN_FRAME_FLAG_DRP);
+
+    sc_sim_advance(&sim, 2000);
+    drain();
+
+    CHECK_EQUAL(3u, frames.size());
+    CHECK_EQUAL(0, frames[1].track_id);
+    CHECK_EQUAL(1000u, frames[1].timestamp_us);
+    CHECK_EQUAL(1, frames[2].track_id);
+    CHECK_EQUAL(2000u, frames[2].timestamp_us);
+    CHECK_EQUAL(1u, sim.stats.tx_dropped);
+}
+
+TEST_F(sim_fixture, generates_traffic_at_configured_rates)
+{
+    config.rx_rate_hz = 10000;
+    config.error_rate_hz = 100;
+    config.status_interval_us = 5000;
+    config.rx_dlc = 15;
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, init());
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, start_stream());
+
+    // nothing while off bus
+    sc_sim_advance(&sim, 10000);
+    drain();
+    CHECK_EQUAL(0u, frames.size());
+
+    CHECK_EQUAL(SC_ERROR_NONE, bus(true));
+
+    for (int i = 0; i < 10; ++i) {
+        sc_sim_advance(&sim, 1000);
+        drain();
+    }
+
+    CHECK_EQUAL(100u, count(SC_MSG_CAN_RX));
+    CHECK_EQUAL(1u, count(SC_MSG_CAN_ERROR));
+    CHECK_EQUAL(2u, count(SC_MSG_CAN_STATUS));
+    CHECK_EQUAL(0u, sim.stats.rx_lost);
+
+    for (size_t i = 1; i < frames.size(); ++i) {
+        CHECK(frames[i - 1].timestamp_us <= frames[i].timestamp_us);
+    }
+
+    for (size_t i = 0; i < frames.size(); ++i) {
+        if (SC_MSG_CAN_RX == frames[i].type) {
+            CHECK_EQUAL(15, frames[i].dlc);
+            CHECK(frames[i].flags & SC_CAN_FRAME_FLAG_FDF);
+            break;
+        }
+    }
+}
+
+TEST_F(sim_fixture, slow_host_loses_frames)
+{
+    config.rx_rate_hz = 100000;
+    config.status_interval_us = 100000;
+    config.in_transfers = 2;
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, init());
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, start_stream());
+    CHECK_EQUAL(SC_ERROR_NONE, bus(true));
+
+    sc_sim_advance(&sim, 99999);
+    drain();
+    CHECK(sim.stats.rx_lost > 0);
+
+    sc_sim_advance(&sim, 1);
+    drain();
+
+    CHECK_EQUAL(SC_MSG_CAN_STATUS, frames.back().type);
+    CHECK_EQUAL(sim.stats.rx_lost, frames.back().rx_lost);
+    CHECK_EQUAL(sim.stats.rx, count(SC_MSG_CAN_RX));
+}
+
+} // anon
@@ -0,0 +1,46 @@
+#include <CppUnitLite2.h>
+
+#include "supercan_stats.h"
+
+namespace
+{
+
+TEST (stats_log2_bucket)
+{
+    CHECK_EQUAL(0u, sc_stats_log2_bucket(0));
+    CHECK_EQUAL(1u, sc_stats_log2_bucket(1));
+    CHECK_EQUAL(2u, sc_stats_log2_bucket(2));
+    CHECK_EQUAL(2u, sc_stats_log2_bucket(3));
+    CHECK_EQUAL(3u, sc_stats_log2_bucket(4));
+    CHECK_EQUAL(11u, sc_stats_log2_bucket(1024));
+    CHECK_EQUAL(SC_STATS_LOG2_BUCKETS - 1u, sc_stats_log2_bucket(UINT32_MAX));
+}
+
+TEST (stats_log2_bucket_min_is_inverse_of_bucket)
+{
+    for (unsigned i = 0; i < SC_STATS_LOG2_BUCKETS; ++i) {
+        CHECK_EQUAL(i, sc_stats_log2_bucket((uint32_t)sc_stats_log2_bucket_min(i)));
+    }
+}
+
+TEST (stats_log2_add_and_sub)
+{
+    sc_stats_log2_t h = {};
+    sc_stats_log2_t base = {};
+
+    sc_stats_log2_add(&h, 0);
+    sc_stats_log2_add(&h, 7);
+    sc_stats_log2_add(&h, UINT64_C(1) << 40);
+    CHECK_EQUAL(3u, sc_stats_log2_count(&h));
+    CHECK_EQUAL(1u, h.buckets[0]);
+    CHECK_EQUAL(1u, h.buckets[3]);
+    CHECK_EQUAL(1u, h.buckets[SC_STATS_LOG2_BUCKETS - 1]);
+
+    base = h;
+    sc_stats_log2_add(&h, 5);
+    sc_stats_log2_sub(&h, &base);
+    CHECK_EQUAL(1u, sc_stats_log2_count(&h));
+    CHECK_EQUAL(1u, h.buckets[3]);
+}
+
+} // anon
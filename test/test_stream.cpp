@@ -0,0 +1,765 @@
+#include <CppUnitLite2.h>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "supercan_proto.h"
+#include "supercan_error.h"
+#include "supercan_loopback.h"
+#include "supercan_stream.h"
+
+namespace
+{
+
+enum {
+    BUFFER_SIZE = 512,
+    EPP_SIZE = 64,
+    RX_COUNT = 4,
+};
+
+struct stream_fixture
+{
+    sc_loopback_t lb;
+    sc_transport_t t;
+    sc_stream_core_t core;
+    std::vector<uint8_t> written;
+    std::vector<size_t> write_sizes;
+    std::vector<uint8_t> rx_ids;
+    std::vector<sc_can_frame_t> frames;
+    size_t batches;
+    int write_error;
+    uint64_t now_us;
+
+    stream_fixture()
+        : batches(0)
+        , write_error(SC_DLL_ERROR_NONE)
+        , now_us(0)
+    {
+        sc_loopback_init(&lb, BUFFER_SIZE, 8, RX_COUNT);
+        sc_loopback_set_write_callback(&lb, this, &stream_fixture::on_write);
+        sc_loopback_transport(&lb, &t);
+        sc_stream_core_init(&core, &t, BUFFER_SIZE, EPP_SIZE, RX_COUNT, 0);
+    }
+
+    ~stream_fixture()
+    {
+        sc_stream_core_uninit(&core);
+        sc_loopback_uninit(&lb);
+    }
+
+    static int on_write(void* ctx, uint8_t const* ptr, size_t bytes)
+    {
+        stream_fixture* self = static_cast<stream_fixture*>(ctx);
+        if (self->write_error) {
+            return self->write_error;
+        }
+        self->written.insert(self->written.end(), ptr, ptr + bytes);
+        self->write_sizes.push_back(bytes);
+        return SC_DLL_ERROR_NONE;
+    }
+
+    static uint64_t clock(void* ctx)
+    {
+        return static_cast<stream_fixture*>(ctx)->now_us;
+    }
+
+    int auto_flush(uint16_t bytes, uint32_t latency_us)
+    {
+        sc_stream_tx_flush_t policy;
+
+        policy.clock = &stream_fixture::clock;
+        policy.clock_ctx = this;
+        policy.bytes = bytes;
+        policy.latency_us = latency_us;
+
+        return sc_stream_core_set_tx_auto_flush(&core, &policy);
+    }
+
+    static int on_rx(void* ctx, void const* ptr, uint16_t bytes)
+    {
+        stream_fixture* self = static_cast<stream_fixture*>(ctx);
+        struct sc_msg_header const* msg = static_cast<struct sc_msg_header const*>(ptr);
+        (void)bytes;
+        self->rx_ids.push_back(msg->id);
+        return SC_DLL_ERROR_NONE;
+    }
+
+    static int on_rx_batch(void* ctx, sc_can_frame_t const* frames, size_t count)
+    {
+        stream_fixture* self = static_cast<stream_fixture*>(ctx);
+        self->frames.insert(self->frames.end(), frames, frames + count);
+        ++self->batches;
+        return SC_DLL_ERROR_NONE;
+    }
+
+    static int on_rx_batch_slow(void* ctx, sc_can_frame_t const* frames, size_t count)
+    {
+        stream_fixture* self = static_cast<stream_fixture*>(ctx);
+        (void)frames;
+        self->now_us += 50 * count;
+        return SC_DLL_ERROR_NONE;
+    }
+
+    void push_txrs(uint8_t first_track_id, unsigned count)
+    {
+        std::vector<uint8_t> buf(count * sizeof(struct sc_msg_can_txr));
+
+        for (unsigned i = 0; i < count; ++i) {
+            struct sc_msg_can_txr* txr = (struct sc_msg_can_txr*)&buf[i * sizeof(*txr)];
+            txr->id = SC_MSG_CAN_TXR;
+            txr->len = sizeof(*txr);
+            txr->flags = 0;
+            txr->track_id = (uint8_t)(first_track_id + i);
+            txr->timestamp_us = i;
+        }
+
+        sc_loopback_push(&lb, buf.data(), buf.size());
+    }
+
+    // receives TXR messages as transfers cut at random offsets
+    int rx_txrs_split(unsigned count, unsigned seed)
+    {
+        std::vector<uint8_t> buf(count * sizeof(struct sc_msg_can_txr));
+        std::mt19937 rng(seed);
+        std::uniform_int_distribution<size_t> chunk(1, BUFFER_SIZE);
+
+        for (unsigned i = 0; i < count; ++i) {
+            struct sc_msg_can_txr* txr = (struct sc_msg_can_txr*)&buf[i * sizeof(*txr)];
+            txr->id = SC_MSG_CAN_TXR;
+            txr->len = sizeof(*txr);
+            txr->flags = 0;
+            txr->track_id = (uint8_t)i;
+            txr->timestamp_us = i;
+        }
+
+        for (size_t at = 0; at < buf.size(); ) {
+            size_t bytes = chunk(rng);
+
+            if (bytes > buf.size() - at) {
+                bytes = buf.size() - at;
+            }
+
+            sc_loopback_push(&lb, &buf[at], bytes);
+            at += bytes;
+
+            int error = sc_stream_core_rx(&core, 0);
+            if (error) {
+                return error;
+            }
+        }
+
+        return SC_DLL_ERROR_NONE;
+    }
+
+    int add(uint8_t value)
+    {
+        uint8_t msg[4] = { value, value, value, value };
+        uint8_t const* buffers[] = { msg };
+        uint16_t const sizes[] = { sizeof(msg) };
+        size_t added = 0;
+
+        return sc_stream_core_tx_batch_add(&core, buffers, sizes, 1, &added);
+    }
+};
+
+TEST (stream_core_init_rejects_invalid_params)
+{
+    sc_loopback_t lb;
+    sc_transport_t t;
+    sc_stream_core_t core;
+
+    sc_loopback_init(&lb, BUFFER_SIZE, 1, 1);
+    sc_loopback_transport(&lb, &t);
+
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, sc_stream_core_init(&core, nullptr, BUFFER_SIZE, EPP_SIZE, 1, 0));
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, sc_stream_core_init(&core, &t, 0, EPP_SIZE, 1, 0));
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, sc_stream_core_init(&core, &t, BUFFER_SIZE + 1, EPP_SIZE, 1, 0));
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, sc_stream_core_init(&core, &t, BUFFER_SIZE, 0, 1, 0));
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, sc_stream_core_init(&core, &t, BUFFER_SIZE, EPP_SIZE, 0, 0));
+
+    sc_loopback_uninit(&lb);
+}
+
+TEST_F(stream_fixture, start_requires_rx_callback)
+{
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_OPERATION, sc_stream_core_start(&core));
+}
+
+TEST_F(stream_fixture, rx_times_out_without_data)
+{
+    sc_stream_core_set_rx_callback(&core, this, &stream_fixture::on_rx);
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_start(&core));
+    CHECK_EQUAL(SC_DLL_ERROR_TIMEOUT, sc_stream_core_rx(&core, 0));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, core.error);
+}
+
+TEST_F(stream_fixture, rx_invokes_callback_per_message)
+{
+    sc_stream_core_set_rx_callback(&core, this, &stream_fixture::on_rx);
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_start(&core));
+
+    // more transfers than read requests to exercise resubmission
+    for (unsigned i = 0; i < RX_COUNT + 2; ++i) {
+        push_txrs(0, 3);
+        CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_rx(&core, 0));
+    }
+
+    CHECK_EQUAL((RX_COUNT + 2) * 3, rx_ids.size());
+    CHECK_EQUAL(SC_MSG_CAN_TXR, rx_ids[0]);
+    CHECK_EQUAL(2, core.rx_next);
+}
+
+TEST_F(stream_fixture, rx_delivers_decoded_batches)
+{
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_set_rx_batch_callback(&core, this, &stream_fixture::on_rx_batch, 2));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_start(&core));
+
+    push_txrs(10, 5);
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_rx(&core, 0));
+
+    CHECK_EQUAL(3u, batches);
+    CHECK_EQUAL(5u, frames.size());
+    for (size_t i = 0; i < frames.size(); ++i) {
+        CHECK_EQUAL(10 + i, frames[i].track_id);
+    }
+}
+
+TEST_F(stream_fixture, rx_reports_malformed_transfers_and_keeps_going)
+{
+    uint8_t bad[8] = { SC_MSG_CAN_TXR, 12 };
+
+    sc_stream_core_set_rx_callback(&core, this, &stream_fixture::on_rx);
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_start(&core));
+
+    sc_loopback_push(&lb, bad, sizeof(bad));
+    CHECK_EQUAL(SC_DLL_ERROR_PROTO_VIOLATION, sc_stream_core_rx(&core, 0));
+
+    push_txrs(0, 1);
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_rx(&core, 0));
+    CHECK_EQUAL(1u, rx_ids.size());
+}
+
+TEST_F(stream_fixture, rx_reassembles_messages_split_across_transfers)
+{
+    sc_stream_core_set_rx_callback(&core, this, &stream_fixture::on_rx);
+    sc_stream_core_set_rx_reassembly(&core, 1);
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_start(&core));
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, rx_txrs_split(200, 1));
+
+    CHECK_EQUAL(200u, rx_ids.size());
+    CHECK_EQUAL(SC_MSG_CAN_TXR, rx_ids[0]);
+    CHECK_EQUAL(SC_MSG_CAN_TXR, rx_ids[199]);
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, core.error);
+}
+
+TEST_F(stream_fixture, rx_reassembles_batches_split_across_transfers)
+{
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_set_rx_batch_callback(&core, this, &stream_fixture::on_rx_batch, 0));
+    sc_stream_core_set_rx_reassembly(&core, 1);
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_start(&core));
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, rx_txrs_split(200, 2));
+
+    CHECK_EQUAL(200u, frames.size());
+    for (size_t i = 0; i < frames.size(); ++i) {
+        CHECK_EQUAL((uint8_t)i, frames[i].track_id);
+    }
+}
+
+TEST_F(stream_fixture, tx_batch_fills_buffer_up_to_capacity)
+{
+    uint8_t msg[256] = { 0 };
+    uint8_t const* buffers[] = { msg, msg, msg };
+    uint16_t const sizes[] = { 256, 252, 8 };
+    size_t added = 0;
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_batch_begin(&core));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_batch_add(&core, buffers, sizes, 3, &added));
+    CHECK_EQUAL(2u, added);
+    CHECK_EQUAL(508, core.tx_size);
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_OPERATION, sc_stream_core_tx_batch_begin(&core));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_batch_end(&core));
+    CHECK_EQUAL(0, core.tx_size);
+    CHECK_EQUAL(1u, write_sizes.size());
+    CHECK_EQUAL(508u, write_sizes[0]);
+}
+
+TEST_F(stream_fixture, tx_alternates_buffers)
+{
+    uint8_t a[4] = { 1, 1, 1, 1 };
+    uint8_t b[4] = { 2, 2, 2, 2 };
+    uint8_t const* buffers[] = { a };
+    uint16_t const sizes[] = { 4 };
+    size_t added = 0;
+
+    for (int i = 0; i < 3; ++i) {
+        buffers[0] = i & 1 ? b : a;
+        CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_batch_begin(&core));
+        CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_batch_add(&core, buffers, sizes, 1, &added));
+        CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_batch_end(&core));
+    }
+
+    CHECK_EQUAL(1, core.tx_index);
+    CHECK_EQUAL(12u, written.size());
+    CHECK_EQUAL(1, written[0]);
+    CHECK_EQUAL(2, written[4]);
+    CHECK_EQUAL(1, written[8]);
+}
+
+TEST_F(stream_fixture, tx_reserve_encodes_in_place)
+{
+    uint8_t* ptr = nullptr;
+    uint8_t* next = nullptr;
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_batch_begin(&core));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_reserve(&core, 8, &ptr));
+    memset(ptr, 0x11, 8);
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_commit(&core, 8));
+    CHECK_EQUAL(8, core.tx_size);
+
+    // commit less than reserved
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_reserve(&core, 16, &next));
+    CHECK(next == ptr + 8);
+    memset(next, 0x22, 4);
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, sc_stream_core_tx_commit(&core, 20));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_commit(&core, 4));
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, sc_stream_core_tx_commit(&core, 4));
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_batch_end(&core));
+    CHECK_EQUAL(12u, written.size());
+    CHECK_EQUAL(0x11, written[7]);
+    CHECK_EQUAL(0x22, written[8]);
+}
+
+TEST_F(stream_fixture, tx_reserve_reports_full_batch)
+{
+    uint8_t* ptr = nullptr;
+
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, sc_stream_core_tx_reserve(&core, 0, &ptr));
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, sc_stream_core_tx_reserve(&core, BUFFER_SIZE + 4, &ptr));
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_reserve(&core, BUFFER_SIZE - 4, &ptr));
+    memset(ptr, 0x33, BUFFER_SIZE - 4);
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_commit(&core, BUFFER_SIZE - 4));
+    CHECK_EQUAL(SC_DLL_ERROR_BUFFER_TOO_SMALL, sc_stream_core_tx_reserve(&core, 8, &ptr));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_batch_end(&core));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_reserve(&core, 8, &ptr));
+}
+
+TEST_F(stream_fixture, tx_auto_flush_requires_clock_for_latency)
+{
+    sc_stream_tx_flush_t policy;
+
+    memset(&policy, 0, sizeof(policy));
+    policy.latency_us = 100;
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, sc_stream_core_set_tx_auto_flush(&core, &policy));
+    policy.latency_us = 0;
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_set_tx_auto_flush(&core, &policy));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_set_tx_auto_flush(&core, nullptr));
+    CHECK_EQUAL(0, core.tx_auto_flush);
+}
+
+TEST_F(stream_fixture, tx_auto_flush_on_capacity)
+{
+    std::vector<uint8_t> msg(4 * 130, 0x44);
+    std::vector<uint8_t const*> buffers(130);
+    std::vector<uint16_t> sizes(130, 4);
+    size_t added = 0;
+
+    for (size_t i = 0; i < buffers.size(); ++i) {
+        buffers[i] = &msg[i * 4];
+    }
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, auto_flush(0, 0));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_batch_begin(&core));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_batch_add(&core, buffers.data(), sizes.data(), 130, &added));
+    CHECK_EQUAL(130u, added);
+    CHECK_EQUAL(1u, write_sizes.size());
+    CHECK_EQUAL(BUFFER_SIZE, write_sizes[0]);
+    CHECK_EQUAL(8, core.tx_size);
+
+    // batch stays open
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_batch_begin(&core));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_batch_end(&core));
+
+    CHECK_EQUAL(1u, core.tx_flush_stats.capacity);
+    CHECK_EQUAL(1u, core.tx_flush_stats.manual);
+    CHECK_EQUAL(130u, core.tx_flush_stats.messages);
+}
+
+TEST_F(stream_fixture, tx_auto_flush_on_bytes)
+{
+    uint8_t* ptr = nullptr;
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, auto_flush(16, 0));
+
+    for (int i = 0; i < 5; ++i) {
+        CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_reserve(&core, 4, &ptr));
+        memset(ptr, i, 4);
+        CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_commit(&core, 4));
+    }
+
+    CHECK_EQUAL(1u, write_sizes.size());
+    CHECK_EQUAL(16u, write_sizes[0]);
+    CHECK_EQUAL(4, core.tx_size);
+
+    for (int i = 0; i < 5; ++i) {
+        CHECK_EQUAL(SC_DLL_ERROR_NONE, add((uint8_t)i));
+    }
+
+    CHECK_EQUAL(2u, write_sizes.size());
+    CHECK_EQUAL(8, core.tx_size);
+    CHECK_EQUAL(2u, core.tx_flush_stats.bytes);
+    CHECK_EQUAL(0u, core.tx_flush_stats.capacity);
+    CHECK_EQUAL(8u, core.tx_flush_stats.messages);
+}
+
+TEST_F(stream_fixture, tx_auto_flush_splits_batch_add_at_threshold)
+{
+    uint8_t msg[4 * 10];
+    uint8_t const* buffers[10];
+    uint16_t sizes[10];
+    size_t added = 0;
+
+    for (size_t i = 0; i < 10; ++i) {
+        memset(&msg[i * 4], (int)i, 4);
+        buffers[i] = &msg[i * 4];
+        sizes[i] = 4;
+    }
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, auto_flush(16, 0));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_batch_add(&core, buffers, sizes, 10, &added));
+    CHECK_EQUAL(10u, added);
+    CHECK_EQUAL(2u, write_sizes.size());
+    CHECK_EQUAL(16u, write_sizes[0]);
+    CHECK_EQUAL(16u, write_sizes[1]);
+    CHECK_EQUAL(8, core.tx_size);
+    CHECK_EQUAL(4, written[16]);
+}
+
+TEST_F(stream_fixture, tx_auto_flush_on_latency)
+{
+    uint32_t wait_us = 0;
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, auto_flush(0, 1000));
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_flush_if_due(&core, &wait_us));
+    CHECK_EQUAL(UINT32_MAX, wait_us);
+
+    now_us = 100;
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, add(1));
+    now_us = 600;
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, add(2));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_flush_if_due(&core, &wait_us));
+    CHECK_EQUAL(500u, wait_us);
+    CHECK(written.empty());
+
+    // adding a message past the deadline sends the batch
+    now_us = 1100;
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, add(3));
+    CHECK_EQUAL(12u, written.size());
+
+    now_us = 1200;
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, add(4));
+    now_us = 2200;
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_flush_if_due(&core, &wait_us));
+    CHECK_EQUAL(16u, written.size());
+    CHECK_EQUAL(UINT32_MAX, wait_us);
+
+    CHECK_EQUAL(2u, core.tx_flush_stats.latency);
+    CHECK_EQUAL(4u, core.tx_flush_stats.messages);
+}
+
+TEST_F(stream_fixture, tx_appends_eof_instead_of_zlp)
+{
+    uint8_t msg[EPP_SIZE];
+    uint8_t const* buffers[] = { msg };
+    uint16_t const sizes[] = { EPP_SIZE };
+    size_t added = 0;
+
+    memset(msg, 0xff, sizeof(msg));
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_batch_add(&core, buffers, sizes, 1, &added));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_batch_end(&core));
+    CHECK_EQUAL(EPP_SIZE + 4u, written.size());
+    CHECK_EQUAL(0, written[EPP_SIZE]);
+}
+
+TEST_F(stream_fixture, tx_rejects_unaligned_batches)
+{
+    uint8_t msg[3] = { 0 };
+    uint8_t const* buffers[] = { msg };
+    uint16_t const sizes[] = { 3 };
+    size_t added = 0;
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_batch_add(&core, buffers, sizes, 1, &added));
+    CHECK_EQUAL(SC_DLL_ERROR_PROTO_VIOLATION, sc_stream_core_tx_batch_end(&core));
+    CHECK(written.empty());
+}
+
+TEST_F(stream_fixture, transport_errors_are_sticky)
+{
+    sc_stream_core_set_rx_callback(&core, this, &stream_fixture::on_rx);
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_start(&core));
+
+    // reaping a read that wasn't submitted is a transport error
+    t.cancel(t.ctx, SC_TRANSPORT_DIR_IN, 0);
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_OPERATION, sc_stream_core_rx(&core, 0));
+
+    push_txrs(0, 1);
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_OPERATION, sc_stream_core_rx(&core, 0));
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_OPERATION, sc_stream_core_tx_batch_end(&core));
+}
+
+TEST_F(stream_fixture, tx_count_can_only_change_while_idle)
+{
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, sc_stream_core_set_tx_count(&core, 1));
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_PARAM, sc_stream_core_set_tx_count(&core, SC_STREAM_TX_MAX_BUFFERS + 1));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_set_tx_count(&core, 0));
+    CHECK_EQUAL(SC_STREAM_TX_BUFFERS, core.tx_count);
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, add(1));
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_OPERATION, sc_stream_core_set_tx_count(&core, 4));
+
+    write_error = SC_DLL_ERROR_AGAIN;
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_batch_submit(&core));
+    CHECK_EQUAL(SC_DLL_ERROR_INVALID_OPERATION, sc_stream_core_set_tx_count(&core, 4));
+}
+
+TEST_F(stream_fixture, tx_ring_keeps_writes_in_flight)
+{
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_set_tx_count(&core, 4));
+
+    // device doesn't accept data
+    write_error = SC_DLL_ERROR_AGAIN;
+
+    for (uint8_t i = 0; i < 3; ++i) {
+        CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_batch_begin(&core));
+        CHECK_EQUAL(SC_DLL_ERROR_NONE, add(i));
+        CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_batch_submit(&core));
+    }
+
+    CHECK_EQUAL(3, core.tx_inflight);
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, add(3));
+    CHECK_EQUAL(SC_DLL_ERROR_AGAIN, sc_stream_core_tx_batch_submit(&core));
+    CHECK_EQUAL(4, core.tx_size);
+    CHECK_EQUAL(SC_DLL_ERROR_TIMEOUT, sc_stream_core_tx_poll(&core, 0));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, core.error);
+
+    write_error = SC_DLL_ERROR_NONE;
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_poll(&core, 0));
+    CHECK_EQUAL(0, core.tx_inflight);
+    CHECK_EQUAL(12u, written.size());
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_batch_submit(&core));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_poll(&core, 0));
+    CHECK_EQUAL(16u, written.size());
+
+    for (uint8_t i = 0; i < 4; ++i) {
+        CHECK_EQUAL(i, written[i * 4]);
+    }
+}
+
+TEST_F(stream_fixture, tx_drops_eof_of_kept_batch)
+{
+    uint8_t msg[EPP_SIZE];
+    uint8_t const* buffers[] = { msg };
+    uint16_t const sizes[] = { EPP_SIZE };
+    size_t added = 0;
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_set_tx_count(&core, 2));
+
+    // device doesn't accept data, the only other buffer stays in flight
+    write_error = SC_DLL_ERROR_AGAIN;
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, add(0));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_batch_submit(&core));
+    CHECK_EQUAL(1, core.tx_inflight);
+
+    // a multiple of the endpoint packet size asks for the EOF marker
+    memset(msg, 1, sizeof(msg));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_batch_add(&core, buffers, sizes, 1, &added));
+    CHECK_EQUAL(SC_DLL_ERROR_AGAIN, sc_stream_core_tx_batch_submit(&core));
+    CHECK_EQUAL(EPP_SIZE, core.tx_size);
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, add(2));
+
+    write_error = SC_DLL_ERROR_NONE;
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_poll(&core, 0));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_batch_submit(&core));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_poll(&core, 0));
+
+    CHECK_EQUAL(4u + EPP_SIZE + 4u, written.size());
+    CHECK_EQUAL(0, written[0]);
+    CHECK_EQUAL(1, written[4]);
+    CHECK_EQUAL(1, written[4 + EPP_SIZE - 1]);
+    CHECK_EQUAL(2, written[4 + EPP_SIZE]);
+}
+
+TEST_F(stream_fixture, tx_poll_without_writes_in_flight)
+{
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_poll(&core, 0));
+}
+
+TEST_F(stream_fixture, stats_count_rx_transfers)
+{
+    sc_stream_stats_t stats;
+
+    sc_stream_core_set_rx_callback(&core, this, &stream_fixture::on_rx);
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_start(&core));
+
+    push_txrs(0, 1);
+    push_txrs(0, 3);
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_rx(&core, 0));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_rx(&core, 0));
+
+    sc_stream_core_stats(&core, &stats, 0);
+    CHECK_EQUAL(2u, stats.rx_transfers);
+    CHECK_EQUAL(4 * sizeof(struct sc_msg_can_txr), stats.rx_bytes);
+    CHECK_EQUAL(4u, stats.rx_messages);
+    CHECK_EQUAL(0u, stats.rx_callback_us);
+    CHECK_EQUAL(1u, stats.rx_transfer_messages.buckets[1]);
+    CHECK_EQUAL(1u, stats.rx_transfer_messages.buckets[2]);
+    CHECK_EQUAL(2u, sc_stats_log2_count(&stats.rx_transfer_bytes));
+    CHECK_EQUAL(0u, sc_stats_log2_count(&stats.rx_transfer_callback_us));
+}
+
+TEST_F(stream_fixture, stats_track_rx_pending_low_water_mark)
+{
+    sc_stream_stats_t stats;
+
+    sc_stream_core_set_rx_callback(&core, this, &stream_fixture::on_rx);
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_start(&core));
+
+    sc_stream_core_stats(&core, &stats, 0);
+    CHECK_EQUAL(UINT32_MAX, stats.rx_pending_min);
+
+    push_txrs(0, 1);
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_rx(&core, 0));
+    sc_stream_core_stats(&core, &stats, 0);
+    CHECK_EQUAL(RX_COUNT - 1, stats.rx_pending_min);
+
+    // backlog of completed transfers
+    push_txrs(0, 1);
+    push_txrs(0, 1);
+    push_txrs(0, 1);
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_rx(&core, 0));
+    sc_stream_core_stats(&core, &stats, 1);
+    CHECK_EQUAL(RX_COUNT - 3, stats.rx_pending_min);
+
+    sc_stream_core_stats(&core, &stats, 0);
+    CHECK_EQUAL(UINT32_MAX, stats.rx_pending_min);
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_rx(&core, 0));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_rx(&core, 0));
+    sc_stream_core_stats(&core, &stats, 0);
+    CHECK_EQUAL(RX_COUNT - 2, stats.rx_pending_min);
+}
+
+TEST_F(stream_fixture, stats_time_rx_processing)
+{
+    sc_stream_stats_t stats;
+
+    sc_stream_core_set_clock(&core, &stream_fixture::clock, this);
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_set_rx_batch_callback(&core, this, &stream_fixture::on_rx_batch_slow, 0));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_start(&core));
+
+    push_txrs(0, 2);
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_rx(&core, 0));
+
+    sc_stream_core_stats(&core, &stats, 0);
+    CHECK_EQUAL(2u, stats.rx_messages);
+    CHECK_EQUAL(100u, stats.rx_callback_us);
+    CHECK_EQUAL(1u, stats.rx_transfer_callback_us.buckets[7]);
+}
+
+TEST_F(stream_fixture, stats_count_tx_transfers_and_waits)
+{
+    sc_stream_stats_t stats;
+
+    sc_stream_core_set_clock(&core, &stream_fixture::clock, this);
+
+    for (uint8_t i = 0; i < 3; ++i) {
+        CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_batch_begin(&core));
+        CHECK_EQUAL(SC_DLL_ERROR_NONE, add(i));
+        CHECK_EQUAL(SC_DLL_ERROR_NONE, add(i));
+        CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_batch_end(&core));
+    }
+
+    sc_stream_core_stats(&core, &stats, 0);
+    CHECK_EQUAL(3u, stats.tx_transfers);
+    CHECK_EQUAL(24u, stats.tx_bytes);
+    CHECK_EQUAL(6u, stats.tx_messages);
+    CHECK_EQUAL(3u, stats.tx_transfer_messages.buckets[2]);
+    CHECK_EQUAL(3u, stats.tx_transfer_bytes.buckets[4]);
+
+    // default ring of two buffers waits from the second batch on
+    CHECK_EQUAL(2u, stats.tx_waits);
+    CHECK_EQUAL(0u, stats.tx_wait_us);
+    CHECK_EQUAL(2u, stats.tx_wait_us_hist.buckets[0]);
+
+    // submit never waits
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, add(3));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_batch_submit(&core));
+    sc_stream_core_stats(&core, &stats, 0);
+    CHECK_EQUAL(2u, stats.tx_waits);
+}
+
+TEST_F(stream_fixture, stats_reset_starts_new_period)
+{
+    sc_stream_stats_t stats;
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, add(1));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_batch_end(&core));
+
+    sc_stream_core_stats(&core, nullptr, 1);
+    sc_stream_core_stats(&core, &stats, 0);
+    CHECK_EQUAL(0u, stats.tx_transfers);
+    CHECK_EQUAL(0u, stats.tx_bytes);
+    CHECK_EQUAL(0u, sc_stats_log2_count(&stats.tx_transfer_bytes));
+
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, add(2));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_batch_end(&core));
+    sc_stream_core_stats(&core, &stats, 0);
+    CHECK_EQUAL(1u, stats.tx_transfers);
+    CHECK_EQUAL(4u, stats.tx_bytes);
+    CHECK_EQUAL(1u, sc_stats_log2_count(&stats.tx_transfer_bytes));
+}
+
+TEST_F(stream_fixture, stats_scrape_and_reset_while_sending)
+{
+    enum { BATCHES = 20000 };
+    sc_stream_stats_t stats;
+    int error = SC_DLL_ERROR_NONE;
+
+    std::thread sender([&] {
+        for (unsigned i = 0; i < BATCHES && !error; ++i) {
+            error = add(1);
+
+            if (!error) {
+                error = sc_stream_core_tx_batch_end(&core);
+            }
+        }
+    });
+
+    for (unsigned i = 0; i < 1000; ++i) {
+        sc_stream_core_stats(&core, &stats, i & 1);
+        CHECK(stats.tx_transfers <= BATCHES);
+        CHECK(sc_stats_log2_count(&stats.tx_transfer_messages) <= BATCHES);
+    }
+
+    sender.join();
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, error);
+
+    // the reset is carried out by the next batch
+    sc_stream_core_stats(&core, nullptr, 1);
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, add(1));
+    CHECK_EQUAL(SC_DLL_ERROR_NONE, sc_stream_core_tx_batch_end(&core));
+    sc_stream_core_stats(&core, &stats, 0);
+    CHECK_EQUAL(1u, stats.tx_transfers);
+    CHECK_EQUAL(1u, sc_stats_log2_count(&stats.tx_transfer_messages));
+}
+
+} // anon
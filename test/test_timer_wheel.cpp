@@ -0,0 +1,211 @@
+#include <CppUnitLite2.h>
+
+#include <vector>
+
+#include "supercan_timer_wheel.h"
+
+namespace
+{
+
+struct test_timer
+{
+    sc::timer_wheel::timer timer;   // must be first
+    uint64_t fired;
+    uint32_t count;
+};
+
+// returns the first tick at which a timer fired early or late, NEVER if none did
+uint64_t step_until(sc::timer_wheel* wheel, uint64_t last)
+{
+    uint64_t bad = sc::timer_wheel::NEVER;
+
+    for (uint64_t now = wheel->now(); now <= last; ++now) {
+        wheel->advance(now, [&](sc::timer_wheel::timer* t) {
+            test_timer* x = reinterpret_cast<test_timer*>(t);
+
+            x->fired = now;
+            ++x->count;
+
+            if (t->due != now && bad == sc::timer_wheel::NEVER) {
+                bad = now;
+            }
+        });
+    }
+
+    return bad;
+}
+
+uint32_t lcg(uint32_t* state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+TEST (timer_wheel_expires_on_due_tick)
+{
+    uint64_t const dues[] = { 0, 1, 63, 64, 65, 127, 128, 4095, 4096, 4097, 262143, 262144, 300000 };
+    std::vector<test_timer> timers(sizeof(dues) / sizeof(dues[0]));
+    sc::timer_wheel wheel;
+
+    for (size_t i = 0; i < timers.size(); ++i) {
+        timers[i].timer.due = dues[i];
+        timers[i].fired = 0;
+        timers[i].count = 0;
+        wheel.insert(&timers[i].timer);
+    }
+
+    CHECK_EQUAL(timers.size(), wheel.size());
+    CHECK_EQUAL(uint64_t(sc::timer_wheel::NEVER), step_until(&wheel, 300001));
+    CHECK_EQUAL(0u, wheel.size());
+
+    for (size_t i = 0; i < timers.size(); ++i) {
+        CHECK_EQUAL(1u, timers[i].count);
+        CHECK_EQUAL(dues[i], timers[i].fired);
+    }
+}
+
+TEST (timer_wheel_parks_timers_beyond_span)
+{
+    uint64_t const span = uint64_t(1) << (sc::timer_wheel::SLOT_BITS * sc::timer_wheel::LEVELS);
+    sc::timer_wheel wheel;
+    test_timer t;
+    uint32_t calls = 0;
+
+    wheel.reset(12345);
+    t.timer.due = 12345 + 3 * span + 17;
+    t.count = 0;
+    wheel.insert(&t.timer);
+
+    // jump from wakeup to wakeup as a caller of next would
+    while (!t.count && calls < 1000) {
+        uint64_t const tick = wheel.next();
+
+        CHECK(tick <= t.timer.due);
+
+        wheel.advance(tick, [&](sc::timer_wheel::timer* x) {
+            reinterpret_cast<test_timer*>(x)->fired = tick;
+            ++reinterpret_cast<test_timer*>(x)->count;
+        });
+
+        ++calls;
+    }
+
+    CHECK_EQUAL(1u, t.count);
+    CHECK_EQUAL(t.timer.due, t.fired);
+    CHECK(calls < 32);
+}
+
+TEST (timer_wheel_next_skips_idle_ticks)
+{
+    sc::timer_wheel wheel;
+    test_timer t;
+    uint32_t calls = 0;
+
+    CHECK_EQUAL(uint64_t(sc::timer_wheel::NEVER), wheel.next());
+
+    t.timer.due = 100000;
+    t.count = 0;
+    wheel.insert(&t.timer);
+
+    while (!t.count) {
+        uint64_t const tick = wheel.next();
+
+        wheel.advance(tick, [&](sc::timer_wheel::timer* x) {
+            reinterpret_cast<test_timer*>(x)->fired = tick;
+            ++reinterpret_cast<test_timer*>(x)->count;
+        });
+
+        ++calls;
+    }
+
+    CHECK_EQUAL(100000u, t.fired);
+    // one call per level at most
+    CHECK(calls <= sc::timer_wheel::LEVELS);
+    CHECK_EQUAL(uint64_t(sc::timer_wheel::NEVER), wheel.next());
+}
+
+TEST (timer_wheel_removed_timers_dont_fire)
+{
+    std::vector<test_timer> timers(3);
+    sc::timer_wheel wheel;
+
+    for (size_t i = 0; i < timers.size(); ++i) {
+        timers[i].timer.due = 5000;
+        timers[i].count = 0;
+        wheel.insert(&timers[i].timer);
+    }
+
+    wheel.remove(&timers[1].timer);
+    CHECK(!timers[1].timer.linked());
+    CHECK_EQUAL(2u, wheel.size());
+
+    wheel.advance(10000, [](sc::timer_wheel::timer* x) {
+        ++reinterpret_cast<test_timer*>(x)->count;
+    });
+
+    CHECK_EQUAL(1u, timers[0].count);
+    CHECK_EQUAL(0u, timers[1].count);
+    CHECK_EQUAL(1u, timers[2].count);
+}
+
+TEST (timer_wheel_matches_reference)
+{
+    std::vector<test_timer> timers(500);
+    std::vector<uint64_t> expected(timers.size());
+    sc::timer_wheel wheel;
+    uint32_t state = 42;
+    uint64_t now = 0;
+    uint32_t early = 0;
+    uint32_t late = 0;
+    uint32_t fired = 0;
+
+    wheel.reset(0);
+
+    for (size_t i = 0; i < timers.size(); ++i) {
+        // spread over all levels
+        uint32_t const shift = lcg(&state) % 22;
+
+        timers[i].timer.due = 1 + (lcg(&state) & ((1u << shift) - 1));
+        timers[i].count = 0;
+        wheel.insert(&timers[i].timer);
+    }
+
+    while (wheel.size()) {
+        uint64_t const step = 1 + lcg(&state) % 5000;
+
+        now += step;
+
+        // remove some at random
+        if (lcg(&state) % 4 == 0) {
+            test_timer* t = &timers[lcg(&state) % timers.size()];
+
+            if (t->timer.linked()) {
+                wheel.remove(&t->timer);
+            }
+        }
+
+        wheel.advance(now, [&](sc::timer_wheel::timer* x) {
+            ++fired;
+
+            if (x->due > now) {
+                ++early;
+            }
+            else if (x->due + step <= now) {
+                // should have fired on the previous call
+                ++late;
+            }
+
+            // re-arm some for a later tick
+            if (lcg(&state) % 3 == 0) {
+                x->due = now + 1 + lcg(&state) % 100000;
+                wheel.insert(x);
+            }
+        });
+    }
+
+    CHECK(fired >= 400);
+    CHECK_EQUAL(0u, early);
+    CHECK_EQUAL(0u, late);
+}
+
+} // anon
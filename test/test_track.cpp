@@ -0,0 +1,160 @@
+#include <CppUnitLite2.h>
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "supercan_track.h"
+
+namespace
+{
+
+TEST (track_ids_init_limits_ids_to_count)
+{
+    sc_track_ids_t t;
+    bool seen[SC_TRACK_IDS];
+
+    memset(seen, 0, sizeof(seen));
+    sc_track_ids_init(&t, 40);
+
+    for (int i = 0; i < 40; ++i) {
+        int const id = sc_track_id_alloc(&t);
+
+        CHECK(id >= 0 && id < 40);
+        CHECK(!seen[id]);
+        seen[id] = true;
+    }
+
+    CHECK_EQUAL(-1, sc_track_id_alloc(&t));
+}
+
+TEST (track_ids_init_clamps_to_id_space)
+{
+    sc_track_ids_t t;
+    int count = 0;
+
+    sc_track_ids_init(&t, 1000);
+
+    while (sc_track_id_alloc(&t) >= 0) {
+        ++count;
+    }
+
+    CHECK_EQUAL(SC_TRACK_IDS, count);
+}
+
+TEST (track_ids_freed_id_is_reused)
+{
+    sc_track_ids_t t;
+    int id = -1;
+
+    sc_track_ids_init(&t, 2);
+    CHECK(sc_track_id_alloc(&t) >= 0);
+    id = sc_track_id_alloc(&t);
+    CHECK(id >= 0);
+    CHECK_EQUAL(-1, sc_track_id_alloc(&t));
+
+    CHECK_EQUAL(0, sc_track_id_free(&t, (uint32_t)id));
+    CHECK_EQUAL(id, sc_track_id_alloc(&t));
+    CHECK_EQUAL(-1, sc_track_id_alloc(&t));
+}
+
+TEST (track_ids_free_wakes_waiting_allocator_once)
+{
+    sc_track_ids_t t;
+    int id = -1;
+
+    sc_track_ids_init(&t, 1);
+    id = sc_track_id_alloc(&t);
+    CHECK_EQUAL(0, id);
+
+    sc_track_ids_wait(&t);
+    CHECK_EQUAL(-1, sc_track_id_alloc(&t));
+
+    CHECK_EQUAL(1, sc_track_id_free(&t, (uint32_t)id));
+    CHECK_EQUAL(0, sc_track_id_alloc(&t));
+    CHECK_EQUAL(0, sc_track_id_free(&t, 0));
+}
+
+TEST (track_ids_free_wakes_once_a_quarter_is_free)
+{
+    sc_track_ids_t t;
+
+    sc_track_ids_init(&t, 8);
+
+    for (int i = 0; i < 8; ++i) {
+        CHECK_EQUAL(i, sc_track_id_alloc(&t));
+    }
+
+    sc_track_ids_wait(&t);
+    CHECK_EQUAL(-1, sc_track_id_alloc(&t));
+
+    CHECK_EQUAL(0, sc_track_id_free(&t, 3));
+    CHECK_EQUAL(1, sc_track_id_free(&t, 5));
+}
+
+TEST (track_ids_never_hand_out_ids_in_use)
+{
+    enum {
+        FRAMES = 200000,
+        FIFO = 48,
+    };
+
+    sc_track_ids_t t;
+    std::atomic<uint32_t> in_use[SC_TRACK_IDS];
+    std::atomic<uint32_t> queue[SC_TRACK_IDS];
+    std::atomic<uint32_t> put(0);
+    std::atomic<bool> double_alloc(false);
+    std::atomic<bool> bad_free(false);
+    uint32_t get = 0;
+
+    sc_track_ids_init(&t, FIFO);
+
+    for (size_t i = 0; i < SC_TRACK_IDS; ++i) {
+        in_use[i] = 0;
+        queue[i] = 0;
+    }
+
+    // allocates like TxMain, queue stands in for the device
+    std::thread tx([&] {
+        for (uint32_t sent = 0; sent < FRAMES; ) {
+            int const id = sc_track_id_alloc(&t);
+
+            if (id < 0) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            if (in_use[id].exchange(1)) {
+                double_alloc = true;
+            }
+
+            queue[put.load(std::memory_order_relaxed) % SC_TRACK_IDS].store((uint32_t)id, std::memory_order_relaxed);
+            put.store(put.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+            ++sent;
+        }
+    });
+
+    // frees like the TXR handler
+    while (get < FRAMES) {
+        if (get == put.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        uint32_t const id = queue[get++ % SC_TRACK_IDS].load(std::memory_order_relaxed);
+
+        if (!in_use[id].exchange(0)) {
+            bad_free = true;
+        }
+
+        sc_track_id_free(&t, id);
+    }
+
+    tx.join();
+
+    CHECK(!double_alloc);
+    CHECK(!bad_free);
+}
+
+} // anon
@@ -0,0 +1,170 @@
+#include <CppUnitLite2.h>
+
+#include <deque>
+
+#include "supercan_tx_prio.h"
+
+namespace
+{
+
+TEST (tx_prio_key_orders_like_arbitration)
+{
+    // lower id wins
+    CHECK(sc_tx_prio_key(0x100, 0) < sc_tx_prio_key(0x101, 0));
+    CHECK(sc_tx_prio_key(0x100 << 18, SC_CAN_FRAME_FLAG_EXT) < sc_tx_prio_key(0x101 << 18, SC_CAN_FRAME_FLAG_EXT));
+    CHECK(sc_tx_prio_key(1, SC_CAN_FRAME_FLAG_EXT) < sc_tx_prio_key(2, SC_CAN_FRAME_FLAG_EXT));
+
+    // base id is compared first
+    CHECK(sc_tx_prio_key(0x100, 0) < sc_tx_prio_key(0x101 << 18, SC_CAN_FRAME_FLAG_EXT));
+    CHECK(sc_tx_prio_key(0x100 << 18 | 0x3ffff, SC_CAN_FRAME_FLAG_EXT) < sc_tx_prio_key(0x101, 0));
+
+    // standard wins over extended with the same base id
+    CHECK(sc_tx_prio_key(0x100, 0) < sc_tx_prio_key(0x100 << 18, SC_CAN_FRAME_FLAG_EXT));
+    CHECK(sc_tx_prio_key(0x100, SC_CAN_FRAME_FLAG_RTR) < sc_tx_prio_key(0x100 << 18, SC_CAN_FRAME_FLAG_EXT));
+
+    // data wins over remote
+    CHECK(sc_tx_prio_key(0x100, 0) < sc_tx_prio_key(0x100, SC_CAN_FRAME_FLAG_RTR));
+    CHECK(sc_tx_prio_key(5, SC_CAN_FRAME_FLAG_EXT) < sc_tx_prio_key(5, SC_CAN_FRAME_FLAG_EXT | SC_CAN_FRAME_FLAG_RTR));
+
+    // flags that don't take part in arbitration are ignored
+    CHECK_EQUAL(sc_tx_prio_key(0x100, 0), sc_tx_prio_key(0x100, SC_CAN_FRAME_FLAG_FDF | SC_CAN_FRAME_FLAG_BRS));
+}
+
+TEST (tx_prio_pick_selects_lowest_key)
+{
+    sc_tx_prio_t p;
+
+    sc_tx_prio_init(&p);
+    CHECK_EQUAL(-1, sc_tx_prio_pick(&p));
+
+    sc_tx_prio_set(&p, 0, sc_tx_prio_key(0x700, 0));
+    sc_tx_prio_set(&p, 3, sc_tx_prio_key(0x010, 0));
+    sc_tx_prio_set(&p, 7, sc_tx_prio_key(0x200, 0));
+    CHECK_EQUAL(3, sc_tx_prio_pick(&p));
+
+    sc_tx_prio_clear(&p, 3);
+    CHECK_EQUAL(7, sc_tx_prio_pick(&p));
+
+    // ties go to the lower source
+    sc_tx_prio_set(&p, 5, sc_tx_prio_key(0x200, 0));
+    CHECK_EQUAL(5, sc_tx_prio_pick(&p));
+
+    sc_tx_prio_clear(&p, 0);
+    sc_tx_prio_clear(&p, 5);
+    sc_tx_prio_clear(&p, 7);
+    CHECK_EQUAL(-1, sc_tx_prio_pick(&p));
+}
+
+TEST (tx_prio_credits_share_fifo)
+{
+    CHECK_EQUAL(16u, sc_tx_prio_credits(32, 2));
+    CHECK_EQUAL(10u, sc_tx_prio_credits(32, 3));
+    CHECK_EQUAL(32u, sc_tx_prio_credits(32, 0));
+    CHECK_EQUAL(1u, sc_tx_prio_credits(4, 8));
+}
+
+/* Deterministic model of the TX path
+ *
+ * Source 0 keeps its ring full of low priority frames, source 1 queues a
+ * high priority frame every few bus slots. The device FIFO sends one
+ * frame per bus slot in FIFO order.
+ */
+enum {
+    SIM_FIFO_SIZE = 16,
+    SIM_QUANTUM = 32,
+    SIM_SLOTS = 10000,
+    SIM_PERIOD = 7,
+};
+
+struct sim_frame {
+    uint32_t can_id;
+    uint32_t source;
+    uint32_t queued;
+};
+
+uint32_t sim_worst_latency(bool prio)
+{
+    std::deque<sim_frame> rings[2];
+    std::deque<sim_frame> fifo;
+    uint32_t in_flight[2] = { 0, 0 };
+    uint32_t const credits = sc_tx_prio_credits(SIM_FIFO_SIZE, 2);
+    uint32_t worst = 0;
+
+    for (uint32_t now = 0; now < SIM_SLOTS; ++now) {
+        while (rings[0].size() < 64) {
+            rings[0].push_back(sim_frame{ 0x700, 0, now });
+        }
+
+        if (0 == now % SIM_PERIOD) {
+            rings[1].push_back(sim_frame{ 0x010, 1, now });
+        }
+
+        if (prio) {
+            sc_tx_prio_t p;
+
+            for (;;) {
+                sc_tx_prio_init(&p);
+
+                for (uint32_t i = 0; i < 2; ++i) {
+                    if (!rings[i].empty() && in_flight[i] < credits) {
+                        sc_tx_prio_set(&p, i, sc_tx_prio_key(rings[i].front().can_id, 0));
+                    }
+                }
+
+                int const source = sc_tx_prio_pick(&p);
+
+                if (source < 0 || fifo.size() == SIM_FIFO_SIZE) {
+                    break;
+                }
+
+                fifo.push_back(rings[source].front());
+                rings[source].pop_front();
+                ++in_flight[source];
+            }
+        }
+        else {
+            // round robin, up to a quantum per source
+            for (uint32_t i = 0; i < 2; ++i) {
+                for (uint32_t count = 0; count < SIM_QUANTUM && !rings[i].empty() && fifo.size() < SIM_FIFO_SIZE; ++count) {
+                    fifo.push_back(rings[i].front());
+                    rings[i].pop_front();
+                    ++in_flight[i];
+                }
+            }
+        }
+
+        // bus
+        if (!fifo.empty()) {
+            sim_frame const f = fifo.front();
+
+            fifo.pop_front();
+            --in_flight[f.source];
+
+            if (1 == f.source && now - f.queued > worst) {
+                worst = now - f.queued;
+            }
+        }
+    }
+
+    // frames that never made it count as well
+    if (!rings[1].empty() && SIM_SLOTS - rings[1].front().queued > worst) {
+        worst = SIM_SLOTS - rings[1].front().queued;
+    }
+
+    return worst;
+}
+
+TEST (tx_prio_bounds_high_priority_latency_under_load)
+{
+    uint32_t const fifo_worst = sim_worst_latency(false);
+    uint32_t const prio_worst = sim_worst_latency(true);
+
+    // high priority frames queue up behind a full FIFO of bulk frames
+    CHECK(fifo_worst >= SIM_FIFO_SIZE - 1);
+
+    // ... but only behind the bulk source's share with the priority scheduler
+    CHECK(prio_worst <= sc_tx_prio_credits(SIM_FIFO_SIZE, 2));
+    CHECK(prio_worst < fifo_worst);
+}
+
+} // anon
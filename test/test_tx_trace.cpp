@@ -0,0 +1,151 @@
+#include <CppUnitLite2.h>
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+#include "supercan_tx_trace.h"
+
+namespace
+{
+
+struct tx_latency_fixture
+{
+    sc_mm_tx_latency page;
+
+    tx_latency_fixture()
+    {
+        memset(&page, 0, sizeof(page));
+    }
+};
+
+uint64_t bucket_sum(sc_mm_tx_latency_stage const* stage)
+{
+    uint64_t sum = 0;
+
+    for (unsigned i = 0; i < SC_MM_TX_LATENCY_BUCKETS; ++i) {
+        sum += stage->buckets[i];
+    }
+
+    return sum;
+}
+
+TEST_F(tx_latency_fixture, add_splits_stages)
+{
+    sc_tx_latency_add(&page, 1000, 1100, 1500);
+
+    CHECK_EQUAL(2u, page.seq);
+    CHECK_EQUAL(1u, page.frames);
+    CHECK_EQUAL(100u, page.server.sum_us);
+    CHECK_EQUAL(100u, page.server.max_us);
+    CHECK_EQUAL(1u, page.server.buckets[sc_stats_log2_bucket(100)]);
+    CHECK_EQUAL(400u, page.device.sum_us);
+    CHECK_EQUAL(1u, page.device.buckets[sc_stats_log2_bucket(400)]);
+    CHECK_EQUAL(500u, page.total.sum_us);
+    CHECK_EQUAL(1u, page.total.buckets[sc_stats_log2_bucket(500)]);
+
+    sc_tx_latency_add(&page, 2000, 2010, 2020);
+
+    CHECK_EQUAL(4u, page.seq);
+    CHECK_EQUAL(2u, page.frames);
+    CHECK_EQUAL(110u, page.server.sum_us);
+    CHECK_EQUAL(100u, page.server.max_us);
+    CHECK_EQUAL(500u, page.total.max_us);
+    CHECK_EQUAL(2u, bucket_sum(&page.total));
+}
+
+TEST_F(tx_latency_fixture, add_clamps_inconsistent_times)
+{
+    // bus time estimated before the submit
+    sc_tx_latency_add(&page, 1000, 1100, 1050);
+    CHECK_EQUAL(50u, page.server.sum_us);
+    CHECK_EQUAL(0u, page.device.sum_us);
+    CHECK_EQUAL(50u, page.total.sum_us);
+
+    // bus time estimated before the dequeue
+    sc_tx_latency_add(&page, 1000, 1100, 900);
+    CHECK_EQUAL(50u, page.server.sum_us);
+    CHECK_EQUAL(0u, page.device.sum_us);
+    CHECK_EQUAL(50u, page.total.sum_us);
+
+    // device reported the frame before the submit was stamped
+    sc_tx_latency_add(&page, 1000, 0, 1200);
+    CHECK_EQUAL(250u, page.server.sum_us);
+    CHECK_EQUAL(0u, page.device.sum_us);
+    CHECK_EQUAL(250u, page.total.sum_us);
+
+    CHECK_EQUAL(3u, page.frames);
+    CHECK_EQUAL(3u, page.device.buckets[0]);
+}
+
+TEST_F(tx_latency_fixture, reset_keeps_seq_even)
+{
+    sc_tx_latency_add(&page, 1000, 1100, 1500);
+    sc_tx_latency_reset(&page);
+
+    CHECK_EQUAL(4u, page.seq);
+    CHECK_EQUAL(0u, page.frames);
+    CHECK_EQUAL(0u, page.total.max_us);
+    CHECK_EQUAL(0u, bucket_sum(&page.total));
+}
+
+TEST_F(tx_latency_fixture, percentile_is_bucket_upper_bound)
+{
+    CHECK_EQUAL(0u, sc_tx_latency_percentile(&page.total, page.frames, 500));
+
+    // 98 frames at 100 us, 2 at 3000 us
+    for (unsigned i = 0; i < 98; ++i) {
+        sc_tx_latency_add(&page, 0, 50, 100);
+    }
+
+    sc_tx_latency_add(&page, 0, 50, 3000);
+    sc_tx_latency_add(&page, 0, 50, 3000);
+
+    CHECK_EQUAL(127u, sc_tx_latency_percentile(&page.total, page.frames, 500));
+    CHECK_EQUAL(127u, sc_tx_latency_percentile(&page.total, page.frames, 980));
+    CHECK_EQUAL(3000u, sc_tx_latency_percentile(&page.total, page.frames, 990));
+    CHECK_EQUAL(3000u, sc_tx_latency_percentile(&page.total, page.frames, 1000));
+
+    // never above the max
+    CHECK_EQUAL(50u, sc_tx_latency_percentile(&page.server, page.frames, 500));
+}
+
+TEST_F(tx_latency_fixture, read_returns_consistent_snapshot)
+{
+    enum { FRAMES = 200000 };
+    std::atomic<bool> done(false);
+    unsigned torn = 0;
+    unsigned reads = 0;
+
+    std::thread writer([&] {
+        for (unsigned i = 0; i < FRAMES; ++i) {
+            sc_tx_latency_add(&page, 0, 10, 30);
+        }
+
+        done.store(true, std::memory_order_release);
+    });
+
+    do {
+        sc_mm_tx_latency copy;
+
+        if (SC_DLL_ERROR_NONE != sc_tx_latency_read(&page, &copy)) {
+            continue;
+        }
+
+        ++reads;
+
+        if (copy.server.sum_us != copy.frames * 10 ||
+            copy.device.sum_us != copy.frames * 20 ||
+            bucket_sum(&copy.total) != copy.frames) {
+            ++torn;
+        }
+    } while (!done.load(std::memory_order_acquire));
+
+    writer.join();
+
+    CHECK(reads > 0);
+    CHECK_EQUAL(0u, torn);
+    CHECK_EQUAL(uint64_t(FRAMES), page.frames);
+}
+
+} // anon